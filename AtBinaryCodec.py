@@ -0,0 +1,96 @@
+import struct
+
+COMMAND = 1
+RESPONSE = 2
+FRAME = 3
+LORA_RX = 4
+LORA_TX = 5
+PULL = 6
+ECHO = 7
+
+DELIMITER = b'\x00'
+
+# must match lora_config_t
+LORA_CONFIG_FORMAT = '<BQQQQIBBBbHBBBBBhB'
+LORA_CONFIG_FIELDS = ['protocolVersion', 'startTimeMillis', 'endTimeMillis', 'currentTimeMillis', 'freq', 'bw', 'sf', 'cr', 'syncWord', 'power', 'preambleLength', 'gain', 'ldo', 'useCrc', 'useExplicitHeader', 'length', 'ocp', 'pin']
+# must match at_codec_frame_t
+FRAME_FORMAT = '<ihfQQH'
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+            else:
+                crc = (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    output = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            output.append(len(block) + 1)
+            output += block
+            block = bytearray()
+            continue
+        block.append(b)
+        if len(block) == 254:
+            output.append(255)
+            output += block
+            block = bytearray()
+    output.append(len(block) + 1)
+    output += block
+    return bytes(output)
+
+
+def cobs_decode(data):
+    output = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError('invalid COBS data')
+        output += data[i + 1:i + code]
+        i += code
+        if code != 255 and i < len(data):
+            output.append(0)
+    return bytes(output)
+
+
+def encode(message_type, payload=b''):
+    message = struct.pack('<BH', message_type, len(payload)) + payload
+    message += struct.pack('<H', crc16(message))
+    return cobs_encode(message) + DELIMITER
+
+
+def decode(data):
+    message = cobs_decode(data.rstrip(DELIMITER))
+    if len(message) < 5:
+        raise ValueError('message is too short')
+    message_type, length = struct.unpack('<BH', message[:3])
+    if length + 5 != len(message):
+        raise ValueError('invalid length')
+    if crc16(message[:-2]) != struct.unpack('<H', message[-2:])[0]:
+        raise ValueError('invalid crc')
+    return message_type, message[3:-2]
+
+
+def pack_lora_config(config):
+    return struct.pack(LORA_CONFIG_FORMAT, *[config.get(field, 0) for field in LORA_CONFIG_FIELDS])
+
+
+def unpack_frame(payload):
+    header_length = struct.calcsize(FRAME_FORMAT)
+    frequency_error, rssi, snr, timestamp, timestamp_micros, data_length = struct.unpack(FRAME_FORMAT, payload[:header_length])
+    return {
+        'data': payload[header_length:header_length + data_length],
+        'rssi': rssi,
+        'snr': snr,
+        'frequencyError': frequency_error,
+        'timestamp': timestamp,
+        'timestampMicros': timestamp_micros
+    }
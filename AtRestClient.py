@@ -1,31 +1,123 @@
+import json
 import requests
 from requests.auth import HTTPBasicAuth
 
+try:
+    import cbor2
+except ImportError:
+    cbor2 = None
+
+try:
+    import websocket
+except ImportError:
+    websocket = None
+
 
 class AtRestClient:
 
-    def __init__(self, baseurl, user, password):
+    def __init__(self, baseurl, user, password, useCbor=False):
         self.baseurl = baseurl
         self.user = user
         self.password = password
+        # requests and responses are encoded using CBOR. requires cbor2. payload data should be bytes
+        self.useCbor = useCbor
+
+    def decode(self, response):
+        if response.headers.get('Content-Type') == 'application/cbor':
+            return cbor2.loads(response.content)
+        return response.json()
+
+    def post(self, path, payload):
+        if self.useCbor:
+            headers = {'Content-Type': 'application/cbor', 'Accept': 'application/cbor'}
+            return requests.post('http://' + self.baseurl + path, data = cbor2.dumps(payload), headers = headers, auth=HTTPBasicAuth(self.user, self.password))
+        return requests.post('http://' + self.baseurl + path, json = payload, auth=HTTPBasicAuth(self.user, self.password))
+
+    def get(self, path, params = None):
+        headers = {'Accept': 'application/cbor'} if self.useCbor else {}
+        return requests.get('http://' + self.baseurl + path, params = params, headers = headers, auth=HTTPBasicAuth(self.user, self.password))
 
     def getStatus(self):
-        return requests.get('http://' + self.baseurl + '/api/v2/status', auth=HTTPBasicAuth(self.user, self.password))
+        return self.get('/api/v2/status')
 
     def startLoRaRx(self, payload):
-        return requests.post('http://' + self.baseurl + '/api/v2/lora/rx/start', json = payload, auth=HTTPBasicAuth(self.user, self.password))
+        return self.post('/api/v2/lora/rx/start', payload)
 
     def loRaTx(self, payload):
-        return requests.post('http://' + self.baseurl + '/api/v2/lora/tx', json = payload, auth=HTTPBasicAuth(self.user, self.password))
+        return self.post('/api/v2/lora/tx', payload)
 
     def startFskRx(self, payload):
-        return requests.post('http://' + self.baseurl + '/api/v2/fsk/rx/start', json = payload, auth=HTTPBasicAuth(self.user, self.password))
+        return self.post('/api/v2/fsk/rx/start', payload)
 
     def fskTx(self, payload):
-        return requests.post('http://' + self.baseurl + '/api/v2/fsk/tx', json = payload, auth=HTTPBasicAuth(self.user, self.password))
+        return self.post('/api/v2/fsk/tx', payload)
+
+    def startLoRaScan(self, payload):
+        return self.post('/api/v2/lora/scan/start', payload)
+
+    def getLoRaScan(self):
+        return self.get('/api/v2/lora/scan')
+
+    def loadSchedule(self, payload):
+        return self.post('/api/v2/schedule', payload)
+
+    def getSchedule(self):
+        return self.get('/api/v2/schedule')
+
+    def getJournal(self):
+        return self.get('/api/v2/journal')
+
+    def ackJournal(self, sequence):
+        return self.post('/api/v2/journal/ack', {'sequence': sequence})
+
+    def pullRx(self, limit=None, cursor=None):
+        params = {}
+        if limit is not None:
+            params['limit'] = limit
+        if cursor is not None:
+            params['cursor'] = cursor
+        return self.get('/api/v2/rx/pull', params)
+
+    # yields (id, frame) for every received frame. returns when the connection is closed
+    def streamRx(self, cursor=None):
+        params = {} if cursor is None else {'cursor': cursor}
+        response = requests.get('http://' + self.baseurl + '/api/v2/rx/stream', params = params, stream = True, auth=HTTPBasicAuth(self.user, self.password))
+        response.raise_for_status()
+        event = {}
+        for line in response.iter_lines(decode_unicode = True):
+            if line:
+                if not line.startswith(':'):
+                    name, _, value = line.partition(':')
+                    event[name] = value.lstrip()
+                continue
+            if 'data' in event and event.get('event', 'message') == 'message':
+                yield int(event['id']), json.loads(event['data'])
+            event = {}
+
+    # requires websocket-client. received frames and responses are returned by receiveWs
+    def connectWs(self):
+        ws = websocket.WebSocket()
+        header = {'Authorization': requests.auth._basic_auth_str(self.user, self.password)}
+        if self.useCbor:
+            header['Accept'] = 'application/cbor'
+        ws.connect('ws://' + self.baseurl + '/api/v2/ws', header = header)
+        return ws
+
+    def sendWs(self, ws, id, type, payload = None):
+        message = dict(payload or {}, id = id, type = type)
+        if self.useCbor:
+            ws.send_binary(cbor2.dumps(message))
+        else:
+            ws.send(json.dumps(message))
+
+    def receiveWs(self, ws):
+        opcode, data = ws.recv_data()
+        if opcode == websocket.ABNF.OPCODE_BINARY:
+            return cbor2.loads(data)
+        return json.loads(data)
 
     def stopRx(self):
         payload = {
             ## empty
         }
-        return requests.post('http://' + self.baseurl + '/api/v2/rx/stop', json = payload, auth=HTTPBasicAuth(self.user, self.password))
\ No newline at end of file
+        return self.post('/api/v2/rx/stop', payload)
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include "at_cbor.h"
+#include <string.h>
+
+#define AT_CBOR_INDEFINITE 31
+#define AT_CBOR_FALSE 20
+#define AT_CBOR_TRUE 21
+#define AT_CBOR_FLOAT16 25
+#define AT_CBOR_FLOAT32 26
+#define AT_CBOR_FLOAT64 27
+// nested arrays and maps while skipping
+#define AT_CBOR_MAX_DEPTH 8
+// required fields are tracked using bitmask
+#define AT_CBOR_MAX_FIELDS 32
+
+#define ERROR_CHECK(x)        \
+  do {                        \
+    esp_err_t __err_rc = (x); \
+    if (__err_rc != ESP_OK) { \
+      return __err_rc;        \
+    }                         \
+  } while (0)
+
+void at_cbor_writer_init(uint8_t *buffer, size_t capacity, at_cbor_writer_t *writer) {
+  writer->buffer = buffer;
+  writer->capacity = capacity;
+  writer->length = 0;
+}
+
+static esp_err_t at_cbor_write(const uint8_t *data, size_t data_length, at_cbor_writer_t *writer) {
+  if (writer->capacity - writer->length < data_length) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(writer->buffer + writer->length, data, data_length);
+  writer->length += data_length;
+  return ESP_OK;
+}
+
+esp_err_t at_cbor_write_head(uint8_t major, uint64_t value, at_cbor_writer_t *writer) {
+  uint8_t head[AT_CBOR_MAX_HEAD_LENGTH];
+  size_t length;
+  if (value < 24) {
+    head[0] = (major << 5) | value;
+    length = 1;
+  } else if (value <= UINT8_MAX) {
+    head[0] = (major << 5) | 24;
+    length = 2;
+  } else if (value <= UINT16_MAX) {
+    head[0] = (major << 5) | 25;
+    length = 3;
+  } else if (value <= UINT32_MAX) {
+    head[0] = (major << 5) | 26;
+    length = 5;
+  } else {
+    head[0] = (major << 5) | 27;
+    length = 9;
+  }
+  // big-endian
+  for (size_t i = length - 1; i > 0; i--) {
+    head[i] = value & 0xFF;
+    value >>= 8;
+  }
+  return at_cbor_write(head, length, writer);
+}
+
+esp_err_t at_cbor_write_uint(uint64_t value, at_cbor_writer_t *writer) {
+  return at_cbor_write_head(AT_CBOR_MAJOR_UINT, value, writer);
+}
+
+esp_err_t at_cbor_write_int(int64_t value, at_cbor_writer_t *writer) {
+  if (value >= 0) {
+    return at_cbor_write_head(AT_CBOR_MAJOR_UINT, value, writer);
+  }
+  return at_cbor_write_head(AT_CBOR_MAJOR_NEGATIVE, (uint64_t) (-1 - value), writer);
+}
+
+esp_err_t at_cbor_write_float(float value, at_cbor_writer_t *writer) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint8_t head[5] = {(AT_CBOR_MAJOR_SIMPLE << 5) | AT_CBOR_FLOAT32, bits >> 24, bits >> 16, bits >> 8, bits};
+  return at_cbor_write(head, sizeof(head), writer);
+}
+
+esp_err_t at_cbor_write_bool(bool value, at_cbor_writer_t *writer) {
+  uint8_t head = (AT_CBOR_MAJOR_SIMPLE << 5) | (value ? AT_CBOR_TRUE : AT_CBOR_FALSE);
+  return at_cbor_write(&head, 1, writer);
+}
+
+esp_err_t at_cbor_write_text(const char *value, at_cbor_writer_t *writer) {
+  size_t length = strlen(value);
+  ERROR_CHECK(at_cbor_write_head(AT_CBOR_MAJOR_TEXT, length, writer));
+  return at_cbor_write((const uint8_t *) value, length, writer);
+}
+
+esp_err_t at_cbor_write_bytes(const uint8_t *data, size_t data_length, at_cbor_writer_t *writer) {
+  ERROR_CHECK(at_cbor_write_head(AT_CBOR_MAJOR_BYTES, data_length, writer));
+  return at_cbor_write(data, data_length, writer);
+}
+
+void at_cbor_reader_init(const uint8_t *data, size_t length, at_cbor_reader_t *reader) {
+  reader->data = data;
+  reader->length = length;
+  reader->offset = 0;
+}
+
+esp_err_t at_cbor_read_head(uint8_t *major, uint64_t *value, at_cbor_reader_t *reader) {
+  if (reader->offset >= reader->length) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uint8_t initial = reader->data[reader->offset];
+  uint8_t info = initial & 0x1F;
+  size_t length;
+  if (info < 24) {
+    length = 0;
+  } else if (info <= 27) {
+    length = 1 << (info - 24);
+  } else if (info == AT_CBOR_INDEFINITE) {
+    return ESP_ERR_NOT_SUPPORTED;
+  } else {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (reader->length - reader->offset - 1 < length) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uint64_t result = (length == 0 ? info : 0);
+  for (size_t i = 0; i < length; i++) {
+    result = (result << 8) | reader->data[reader->offset + 1 + i];
+  }
+  reader->offset += 1 + length;
+  *major = initial >> 5;
+  *value = result;
+  return ESP_OK;
+}
+
+esp_err_t at_cbor_read_int(int64_t *value, at_cbor_reader_t *reader) {
+  size_t offset = reader->offset;
+  uint8_t major;
+  uint64_t head;
+  ERROR_CHECK(at_cbor_read_head(&major, &head, reader));
+  if (major == AT_CBOR_MAJOR_UINT && head <= INT64_MAX) {
+    *value = (int64_t) head;
+    return ESP_OK;
+  }
+  if (major == AT_CBOR_MAJOR_NEGATIVE && head <= INT64_MAX) {
+    *value = -1 - (int64_t) head;
+    return ESP_OK;
+  }
+  if (major == AT_CBOR_MAJOR_SIMPLE && (head == AT_CBOR_FALSE || head == AT_CBOR_TRUE)) {
+    *value = (head == AT_CBOR_TRUE ? 1 : 0);
+    return ESP_OK;
+  }
+  reader->offset = offset;
+  return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t at_cbor_read_string(const uint8_t **data, size_t *length, at_cbor_reader_t *reader) {
+  size_t offset = reader->offset;
+  uint8_t major;
+  uint64_t head;
+  ERROR_CHECK(at_cbor_read_head(&major, &head, reader));
+  if (major != AT_CBOR_MAJOR_BYTES && major != AT_CBOR_MAJOR_TEXT) {
+    reader->offset = offset;
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (reader->length - reader->offset < head) {
+    reader->offset = offset;
+    return ESP_ERR_INVALID_SIZE;
+  }
+  *data = reader->data + reader->offset;
+  *length = (size_t) head;
+  reader->offset += (size_t) head;
+  return ESP_OK;
+}
+
+static esp_err_t at_cbor_skip_depth(uint8_t depth, at_cbor_reader_t *reader) {
+  if (depth > AT_CBOR_MAX_DEPTH) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  uint8_t major;
+  uint64_t head;
+  ERROR_CHECK(at_cbor_read_head(&major, &head, reader));
+  switch (major) {
+    case AT_CBOR_MAJOR_BYTES:
+    case AT_CBOR_MAJOR_TEXT:
+      if (reader->length - reader->offset < head) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      reader->offset += (size_t) head;
+      return ESP_OK;
+    case AT_CBOR_MAJOR_MAP:
+      // every entry is key and value. each item is at least 1 byte
+      if (head > (reader->length - reader->offset) / 2) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      head *= 2;
+      // fallthrough
+    case AT_CBOR_MAJOR_ARRAY:
+      for (uint64_t i = 0; i < head; i++) {
+        ERROR_CHECK(at_cbor_skip_depth(depth + 1, reader));
+      }
+      return ESP_OK;
+    case 6:
+      // tag is followed by the tagged item
+      return at_cbor_skip_depth(depth + 1, reader);
+    default:
+      return ESP_OK;
+  }
+}
+
+esp_err_t at_cbor_skip(at_cbor_reader_t *reader) {
+  return at_cbor_skip_depth(0, reader);
+}
+
+const at_cbor_field_t *at_cbor_field_find(const at_cbor_field_t *fields, size_t fields_length, const char *name, size_t name_length) {
+  for (size_t i = 0; i < fields_length; i++) {
+    if (strlen(fields[i].name) == name_length && memcmp(fields[i].name, name, name_length) == 0) {
+      return &fields[i];
+    }
+  }
+  return NULL;
+}
+
+esp_err_t at_cbor_field_set_text(const at_cbor_field_t *field, const char *value, size_t value_length, void *result) {
+  if (field->type != AT_CBOR_FIELD_TEXT) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // 1 is for \0
+  if (value_length >= field->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  char *target = (char *) result + field->offset;
+  memcpy(target, value, value_length);
+  target[value_length] = '\0';
+  return ESP_OK;
+}
+
+esp_err_t at_cbor_field_set_int(const at_cbor_field_t *field, int64_t value, void *result) {
+  uint8_t *target = (uint8_t *) result + field->offset;
+  if (field->type == AT_CBOR_FIELD_UINT) {
+    if (value < 0 || (field->size < 8 && (uint64_t) value >> (field->size * 8) != 0)) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  } else if (field->type == AT_CBOR_FIELD_INT) {
+    if (field->size < 8) {
+      int64_t limit = (int64_t) 1 << (field->size * 8 - 1);
+      if (value < -limit || value >= limit) {
+        return ESP_ERR_INVALID_ARG;
+      }
+    }
+  } else {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // structures are packed, so members might be unaligned
+  switch (field->size) {
+    case 1: {
+      uint8_t cur = (uint8_t) value;
+      memcpy(target, &cur, sizeof(cur));
+      return ESP_OK;
+    }
+    case 2: {
+      uint16_t cur = (uint16_t) value;
+      memcpy(target, &cur, sizeof(cur));
+      return ESP_OK;
+    }
+    case 4: {
+      uint32_t cur = (uint32_t) value;
+      memcpy(target, &cur, sizeof(cur));
+      return ESP_OK;
+    }
+    case 8: {
+      uint64_t cur = (uint64_t) value;
+      memcpy(target, &cur, sizeof(cur));
+      return ESP_OK;
+    }
+    default:
+      return ESP_ERR_INVALID_ARG;
+  }
+}
+
+static esp_err_t at_cbor_read_array(const at_cbor_field_t *field, void *result, at_cbor_reader_t *reader) {
+  uint8_t major;
+  uint64_t head;
+  ERROR_CHECK(at_cbor_read_head(&major, &head, reader));
+  if (major != AT_CBOR_MAJOR_ARRAY || head > field->capacity) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint8_t *elements = (uint8_t *) result + field->offset;
+  for (size_t i = 0; i < head; i++) {
+    ERROR_CHECK(at_cbor_read_struct(field->fields, field->fields_length, elements + i * field->element_size, reader));
+  }
+  size_t length = (size_t) head;
+  memcpy((uint8_t *) result + field->length_offset, &length, sizeof(length));
+  return ESP_OK;
+}
+
+esp_err_t at_cbor_read_struct(const at_cbor_field_t *fields, size_t fields_length, void *result, at_cbor_reader_t *reader) {
+  if (fields_length > AT_CBOR_MAX_FIELDS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint8_t major;
+  uint64_t entries;
+  ERROR_CHECK(at_cbor_read_head(&major, &entries, reader));
+  if (major != AT_CBOR_MAJOR_MAP) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint32_t found = 0;
+  for (uint64_t i = 0; i < entries; i++) {
+    const uint8_t *key = NULL;
+    size_t key_length = 0;
+    ERROR_CHECK(at_cbor_read_string(&key, &key_length, reader));
+    const at_cbor_field_t *field = at_cbor_field_find(fields, fields_length, (const char *) key, key_length);
+    if (field == NULL) {
+      ERROR_CHECK(at_cbor_skip(reader));
+      continue;
+    }
+    switch (field->type) {
+      case AT_CBOR_FIELD_UINT:
+      case AT_CBOR_FIELD_INT: {
+        int64_t value;
+        ERROR_CHECK(at_cbor_read_int(&value, reader));
+        ERROR_CHECK(at_cbor_field_set_int(field, value, result));
+        break;
+      }
+      case AT_CBOR_FIELD_BYTES: {
+        const uint8_t *data = NULL;
+        size_t data_length = 0;
+        ERROR_CHECK(at_cbor_read_string(&data, &data_length, reader));
+        at_cbor_bytes_t *bytes = (at_cbor_bytes_t *) ((uint8_t *) result + field->offset);
+        if (data_length > bytes->capacity) {
+          return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(bytes->data, data, data_length);
+        bytes->length = data_length;
+        break;
+      }
+      case AT_CBOR_FIELD_TEXT: {
+        const uint8_t *data = NULL;
+        size_t data_length = 0;
+        ERROR_CHECK(at_cbor_read_string(&data, &data_length, reader));
+        ERROR_CHECK(at_cbor_field_set_text(field, (const char *) data, data_length, result));
+        break;
+      }
+      case AT_CBOR_FIELD_ARRAY:
+        ERROR_CHECK(at_cbor_read_array(field, result, reader));
+        break;
+    }
+    found |= 1UL << (field - fields);
+  }
+  for (size_t i = 0; i < fields_length; i++) {
+    if (fields[i].required && (found & (1UL << i)) == 0) {
+      return ESP_ERR_NOT_FOUND;
+    }
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,111 @@
+#ifndef at_cbor_h
+#define at_cbor_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// subset of CBOR (RFC 8949): integers, float32, booleans, byte and text strings, arrays and maps of definite length
+#define AT_CBOR_MAJOR_UINT 0
+#define AT_CBOR_MAJOR_NEGATIVE 1
+#define AT_CBOR_MAJOR_BYTES 2
+#define AT_CBOR_MAJOR_TEXT 3
+#define AT_CBOR_MAJOR_ARRAY 4
+#define AT_CBOR_MAJOR_MAP 5
+#define AT_CBOR_MAJOR_SIMPLE 7
+
+// the longest head: major type + 8 bytes of length
+#define AT_CBOR_MAX_HEAD_LENGTH 9
+
+typedef struct {
+  uint8_t *buffer;
+  size_t capacity;
+  size_t length;
+} at_cbor_writer_t;
+
+typedef struct {
+  const uint8_t *data;
+  size_t length;
+  size_t offset;
+} at_cbor_reader_t;
+
+typedef enum {
+  AT_CBOR_FIELD_UINT,
+  AT_CBOR_FIELD_INT,
+  // at_cbor_bytes_t. hex string in JSON
+  AT_CBOR_FIELD_BYTES,
+  // char array of the given size. stored with \0
+  AT_CBOR_FIELD_TEXT,
+  // array of structures described by fields
+  AT_CBOR_FIELD_ARRAY
+} at_cbor_field_type_t;
+
+typedef struct {
+  uint8_t *data;
+  size_t capacity;
+  size_t length;
+} at_cbor_bytes_t;
+
+// describes how map item is stored into structure
+typedef struct at_cbor_field_t {
+  const char *name;
+  at_cbor_field_type_t type;
+  size_t offset;
+  // size of integer or char array in bytes
+  uint8_t size;
+  bool required;
+  // array only. number of elements is stored into size_t at length_offset
+  const struct at_cbor_field_t *fields;
+  size_t fields_length;
+  size_t element_size;
+  size_t capacity;
+  size_t length_offset;
+} at_cbor_field_t;
+
+#define AT_CBOR_UINT(str, structure, member, req) {.name = str, .type = AT_CBOR_FIELD_UINT, .offset = offsetof(structure, member), .size = sizeof(((structure *) 0)->member), .required = req}
+#define AT_CBOR_INT(str, structure, member, req) {.name = str, .type = AT_CBOR_FIELD_INT, .offset = offsetof(structure, member), .size = sizeof(((structure *) 0)->member), .required = req}
+#define AT_CBOR_BYTES(str, structure, member, req) {.name = str, .type = AT_CBOR_FIELD_BYTES, .offset = offsetof(structure, member), .required = req}
+#define AT_CBOR_TEXT(str, structure, member, req) {.name = str, .type = AT_CBOR_FIELD_TEXT, .offset = offsetof(structure, member), .size = sizeof(((structure *) 0)->member), .required = req}
+
+void at_cbor_writer_init(uint8_t *buffer, size_t capacity, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_head(uint8_t major, uint64_t value, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_uint(uint64_t value, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_int(int64_t value, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_float(float value, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_bool(bool value, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_text(const char *value, at_cbor_writer_t *writer);
+
+esp_err_t at_cbor_write_bytes(const uint8_t *data, size_t data_length, at_cbor_writer_t *writer);
+
+void at_cbor_reader_init(const uint8_t *data, size_t length, at_cbor_reader_t *reader);
+
+// returns ESP_ERR_INVALID_SIZE if input is truncated and ESP_ERR_NOT_SUPPORTED for indefinite length
+esp_err_t at_cbor_read_head(uint8_t *major, uint64_t *value, at_cbor_reader_t *reader);
+
+// integer or boolean
+esp_err_t at_cbor_read_int(int64_t *value, at_cbor_reader_t *reader);
+
+// byte or text string. data points into the input
+esp_err_t at_cbor_read_string(const uint8_t **data, size_t *length, at_cbor_reader_t *reader);
+
+esp_err_t at_cbor_skip(at_cbor_reader_t *reader);
+
+// reads map into structure using the fields. unknown keys are skipped
+esp_err_t at_cbor_read_struct(const at_cbor_field_t *fields, size_t fields_length, void *result, at_cbor_reader_t *reader);
+
+const at_cbor_field_t *at_cbor_field_find(const at_cbor_field_t *fields, size_t fields_length, const char *name, size_t name_length);
+
+// ESP_ERR_INVALID_SIZE if text doesn't fit into the field
+esp_err_t at_cbor_field_set_text(const at_cbor_field_t *field, const char *value, size_t value_length, void *result);
+
+// ESP_ERR_INVALID_ARG if value doesn't fit into the field
+esp_err_t at_cbor_field_set_int(const at_cbor_field_t *field, int64_t value, void *result);
+
+#endif
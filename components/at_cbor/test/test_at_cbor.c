@@ -0,0 +1,191 @@
+#include <unity.h>
+#include <string.h>
+#include "at_cbor.h"
+
+typedef struct {
+  uint64_t freq;
+  uint8_t sf;
+  int8_t power;
+  int16_t ocp;
+  at_cbor_bytes_t data;
+} test_item_t;
+
+typedef struct {
+  uint32_t id;
+  char name[8];
+  test_item_t items[2];
+  size_t items_length;
+} test_request_t;
+
+static const at_cbor_field_t ITEM_FIELDS[] = {
+    AT_CBOR_UINT("freq", test_item_t, freq, true),
+    AT_CBOR_UINT("sf", test_item_t, sf, true),
+    AT_CBOR_INT("power", test_item_t, power, false),
+    AT_CBOR_INT("ocp", test_item_t, ocp, false),
+    AT_CBOR_BYTES("data", test_item_t, data, false)
+};
+
+static const at_cbor_field_t REQUEST_FIELDS[] = {
+    AT_CBOR_UINT("id", test_request_t, id, true),
+    AT_CBOR_TEXT("name", test_request_t, name, false),
+    {.name = "items", .type = AT_CBOR_FIELD_ARRAY, .offset = offsetof(test_request_t, items), .required = true, .fields = ITEM_FIELDS, .fields_length = sizeof(ITEM_FIELDS) / sizeof(ITEM_FIELDS[0]), .element_size = sizeof(test_item_t), .capacity = 2, .length_offset = offsetof(test_request_t, items_length)}
+};
+
+static uint8_t item_data[2][4];
+
+static void init_request(test_request_t *request) {
+  memset(request, 0, sizeof(test_request_t));
+  for (int i = 0; i < 2; i++) {
+    request->items[i].data.data = item_data[i];
+    request->items[i].data.capacity = sizeof(item_data[i]);
+  }
+}
+
+TEST_CASE("write head", "[at_cbor]") {
+  uint8_t buffer[32];
+  at_cbor_writer_t writer;
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  // examples from RFC 8949 appendix A
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_uint(23, &writer));
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_uint(24, &writer));
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_uint(1000, &writer));
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_int(-1000, &writer));
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_uint(1000000000000, &writer));
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_float(100000.0f, &writer));
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_write_text("IETF", &writer));
+  uint8_t expected[] = {0x17, 0x18, 0x18, 0x19, 0x03, 0xe8, 0x39, 0x03, 0xe7, 0x1b, 0x00, 0x00, 0x00, 0xe8, 0xd4, 0xa5, 0x10, 0x00, 0xfa, 0x47, 0xc3, 0x50, 0x00, 0x64, 0x49, 0x45, 0x54, 0x46};
+  TEST_ASSERT_EQUAL(sizeof(expected), writer.length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buffer, sizeof(expected));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_cbor_write_text("IETF", &writer));
+}
+
+TEST_CASE("read struct", "[at_cbor]") {
+  uint8_t buffer[128];
+  at_cbor_writer_t writer;
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 4, &writer);
+  at_cbor_write_text("unknown", &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_ARRAY, 2, &writer);
+  at_cbor_write_text("skip", &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 1, &writer);
+  at_cbor_write_uint(1, &writer);
+  at_cbor_write_float(1.5f, &writer);
+  at_cbor_write_text("items", &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_ARRAY, 2, &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 4, &writer);
+  at_cbor_write_text("freq", &writer);
+  at_cbor_write_uint(868100000, &writer);
+  at_cbor_write_text("sf", &writer);
+  at_cbor_write_uint(9, &writer);
+  at_cbor_write_text("power", &writer);
+  at_cbor_write_int(-4, &writer);
+  uint8_t data[] = {0xca, 0xfe};
+  at_cbor_write_text("data", &writer);
+  at_cbor_write_bytes(data, sizeof(data), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 3, &writer);
+  at_cbor_write_text("sf", &writer);
+  at_cbor_write_uint(12, &writer);
+  at_cbor_write_text("freq", &writer);
+  at_cbor_write_uint(433000000, &writer);
+  at_cbor_write_text("ocp", &writer);
+  at_cbor_write_int(-240, &writer);
+  at_cbor_write_text("id", &writer);
+  at_cbor_write_uint(70000, &writer);
+  at_cbor_write_text("name", &writer);
+  at_cbor_write_text("lora", &writer);
+
+  test_request_t request;
+  init_request(&request);
+  at_cbor_reader_t reader;
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_OK, at_cbor_read_struct(REQUEST_FIELDS, 3, &request, &reader));
+  TEST_ASSERT_EQUAL(writer.length, reader.offset);
+  TEST_ASSERT_EQUAL(70000, request.id);
+  TEST_ASSERT_EQUAL_STRING("lora", request.name);
+  TEST_ASSERT_EQUAL(2, request.items_length);
+  TEST_ASSERT_EQUAL(868100000, request.items[0].freq);
+  TEST_ASSERT_EQUAL(9, request.items[0].sf);
+  TEST_ASSERT_EQUAL(-4, request.items[0].power);
+  TEST_ASSERT_EQUAL(sizeof(data), request.items[0].data.length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, request.items[0].data.data, sizeof(data));
+  TEST_ASSERT_EQUAL(433000000, request.items[1].freq);
+  TEST_ASSERT_EQUAL(12, request.items[1].sf);
+  TEST_ASSERT_EQUAL(-240, request.items[1].ocp);
+  TEST_ASSERT_EQUAL(0, request.items[1].data.length);
+
+  // every truncation is detected
+  for (size_t i = 0; i < writer.length; i++) {
+    init_request(&request);
+    at_cbor_reader_init(buffer, i, &reader);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, at_cbor_read_struct(REQUEST_FIELDS, 3, &request, &reader));
+  }
+}
+
+TEST_CASE("read invalid struct", "[at_cbor]") {
+  uint8_t buffer[64];
+  at_cbor_writer_t writer;
+  test_request_t request;
+  at_cbor_reader_t reader;
+
+  // required field is missing
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 1, &writer);
+  at_cbor_write_text("id", &writer);
+  at_cbor_write_uint(1, &writer);
+  init_request(&request);
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, at_cbor_read_struct(REQUEST_FIELDS, 3, &request, &reader));
+
+  // value doesn't fit into uint8_t
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 2, &writer);
+  at_cbor_write_text("freq", &writer);
+  at_cbor_write_uint(1, &writer);
+  at_cbor_write_text("sf", &writer);
+  at_cbor_write_uint(256, &writer);
+  init_request(&request);
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_cbor_read_struct(ITEM_FIELDS, sizeof(ITEM_FIELDS) / sizeof(ITEM_FIELDS[0]), &request.items[0], &reader));
+
+  // negative value for unsigned field
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 1, &writer);
+  at_cbor_write_text("freq", &writer);
+  at_cbor_write_int(-1, &writer);
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_cbor_read_struct(ITEM_FIELDS, sizeof(ITEM_FIELDS) / sizeof(ITEM_FIELDS[0]), &request.items[0], &reader));
+
+  // byte string is longer than the buffer
+  uint8_t data[5] = {0};
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 1, &writer);
+  at_cbor_write_text("data", &writer);
+  at_cbor_write_bytes(data, sizeof(data), &writer);
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_cbor_read_struct(ITEM_FIELDS, sizeof(ITEM_FIELDS) / sizeof(ITEM_FIELDS[0]), &request.items[0], &reader));
+
+  // text is longer than the buffer
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 2, &writer);
+  at_cbor_write_text("id", &writer);
+  at_cbor_write_uint(1, &writer);
+  at_cbor_write_text("name", &writer);
+  at_cbor_write_text("12345678", &writer);
+  init_request(&request);
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_cbor_read_struct(REQUEST_FIELDS, 3, &request, &reader));
+
+  // more elements than the capacity
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_MAP, 1, &writer);
+  at_cbor_write_text("items", &writer);
+  at_cbor_write_head(AT_CBOR_MAJOR_ARRAY, 3, &writer);
+  init_request(&request);
+  at_cbor_reader_init(buffer, writer.length, &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_cbor_read_struct(REQUEST_FIELDS, 3, &request, &reader));
+
+  // indefinite length map
+  uint8_t indefinite[] = {0xbf, 0xff};
+  at_cbor_reader_init(indefinite, sizeof(indefinite), &reader);
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, at_cbor_read_struct(REQUEST_FIELDS, 3, &request, &reader));
+}
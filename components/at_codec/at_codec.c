@@ -0,0 +1,112 @@
+#include "at_codec.h"
+
+#define AT_CODEC_CRC_INIT 0xFFFF
+
+static const uint16_t CRC16_NIBBLES[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+typedef struct {
+  uint8_t *output;
+  size_t output_capacity;
+  size_t position;
+  size_t code_position;
+  uint8_t code;
+} at_codec_cobs_t;
+
+uint16_t at_codec_crc16(const uint8_t *data, size_t data_length, uint16_t crc) {
+  for (size_t i = 0; i < data_length; i++) {
+    crc = (crc << 4) ^ CRC16_NIBBLES[((crc >> 12) ^ (data[i] >> 4)) & 0x0F];
+    crc = (crc << 4) ^ CRC16_NIBBLES[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F];
+  }
+  return crc;
+}
+
+static esp_err_t at_codec_cobs_put(const uint8_t *data, size_t data_length, at_codec_cobs_t *cobs) {
+  for (size_t i = 0; i < data_length; i++) {
+    if (data[i] != 0) {
+      if (cobs->position >= cobs->output_capacity) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      cobs->output[cobs->position++] = data[i];
+      cobs->code++;
+    }
+    if (data[i] == 0 || cobs->code == 0xFF) {
+      if (cobs->position >= cobs->output_capacity) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      cobs->output[cobs->code_position] = cobs->code;
+      cobs->code_position = cobs->position++;
+      cobs->code = 1;
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t at_codec_encode(uint8_t type, const uint8_t *payload, size_t payload_length, uint8_t *output, size_t output_capacity, size_t *output_length) {
+  if (payload_length > AT_CODEC_MAX_PAYLOAD_LENGTH || output_capacity < 2) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uint8_t header[AT_CODEC_HEADER_LENGTH] = {type, payload_length & 0xFF, (payload_length >> 8) & 0xFF};
+  uint16_t crc = at_codec_crc16(header, sizeof(header), AT_CODEC_CRC_INIT);
+  crc = at_codec_crc16(payload, payload_length, crc);
+  uint8_t footer[AT_CODEC_CRC_LENGTH] = {crc & 0xFF, (crc >> 8) & 0xFF};
+  // reserve 1 byte for the delimiter
+  at_codec_cobs_t cobs = {
+      .output = output,
+      .output_capacity = output_capacity - 1,
+      .position = 1,
+      .code_position = 0,
+      .code = 1
+  };
+  esp_err_t code = at_codec_cobs_put(header, sizeof(header), &cobs);
+  if (code == ESP_OK) {
+    code = at_codec_cobs_put(payload, payload_length, &cobs);
+  }
+  if (code == ESP_OK) {
+    code = at_codec_cobs_put(footer, sizeof(footer), &cobs);
+  }
+  if (code != ESP_OK) {
+    return code;
+  }
+  output[cobs.code_position] = cobs.code;
+  output[cobs.position++] = AT_CODEC_DELIMITER;
+  *output_length = cobs.position;
+  return ESP_OK;
+}
+
+esp_err_t at_codec_decode(uint8_t *input, size_t input_length, uint8_t *type, uint8_t **payload, size_t *payload_length) {
+  if (input_length > 0 && input[input_length - 1] == AT_CODEC_DELIMITER) {
+    input_length--;
+  }
+  size_t read = 0;
+  size_t written = 0;
+  while (read < input_length) {
+    uint8_t code = input[read++];
+    if (code == 0 || read + code - 1 > input_length) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    for (uint8_t i = 1; i < code; i++) {
+      input[written++] = input[read++];
+    }
+    if (code != 0xFF && read < input_length) {
+      input[written++] = 0;
+    }
+  }
+  if (written < AT_CODEC_HEADER_LENGTH + AT_CODEC_CRC_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  size_t length = input[1] | (input[2] << 8);
+  if (length + AT_CODEC_HEADER_LENGTH + AT_CODEC_CRC_LENGTH != written) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uint16_t expected = input[written - 2] | (input[written - 1] << 8);
+  if (at_codec_crc16(input, written - AT_CODEC_CRC_LENGTH, AT_CODEC_CRC_INIT) != expected) {
+    return ESP_ERR_INVALID_CRC;
+  }
+  *type = input[0];
+  *payload = input + AT_CODEC_HEADER_LENGTH;
+  *payload_length = length;
+  return ESP_OK;
+}
@@ -0,0 +1,47 @@
+#ifndef at_codec_h
+#define at_codec_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+// binary message: type (1 byte), payload length (2 bytes, LE), payload, CRC-16/CCITT-FALSE (2 bytes, LE)
+// the whole message is COBS-encoded and terminated with AT_CODEC_DELIMITER
+#define AT_CODEC_DELIMITER 0x00
+#define AT_CODEC_HEADER_LENGTH 3
+#define AT_CODEC_CRC_LENGTH 2
+// COBS adds 1 byte for every 254 bytes + 1 overhead byte + delimiter
+#define AT_CODEC_MAX_ENCODED_LENGTH(x) ((x) + AT_CODEC_HEADER_LENGTH + AT_CODEC_CRC_LENGTH + ((x) + AT_CODEC_HEADER_LENGTH + AT_CODEC_CRC_LENGTH) / 254 + 2)
+
+typedef enum {
+  AT_CODEC_COMMAND = 1,   // text AT command without terminator
+  AT_CODEC_RESPONSE = 2,  // text response
+  AT_CODEC_FRAME = 3,     // at_codec_frame_t + data
+  AT_CODEC_LORA_RX = 4,   // lora_config_t
+  AT_CODEC_LORA_TX = 5,   // lora_config_t + data
+  AT_CODEC_PULL = 6,      // no payload. frames returned as AT_CODEC_FRAME, then "OK" response
+  AT_CODEC_ECHO = 7       // payload sent back as is
+} at_codec_type_t;
+
+#pragma pack(push, 1)
+typedef struct {
+  int32_t frequency_error;
+  int16_t rssi;
+  float snr;
+  uint64_t timestamp;
+  uint64_t timestamp_micros;
+  uint16_t data_length;
+} at_codec_frame_t;
+#pragma pack(pop)
+
+// at_codec_frame_t and fixed length fsk packet up to 2047 bytes
+#define AT_CODEC_MAX_PAYLOAD_LENGTH (sizeof(at_codec_frame_t) + 2047)
+
+uint16_t at_codec_crc16(const uint8_t *data, size_t data_length, uint16_t crc);
+
+esp_err_t at_codec_encode(uint8_t type, const uint8_t *payload, size_t payload_length, uint8_t *output, size_t output_capacity, size_t *output_length);
+
+// decoded in-place. trailing delimiter is optional. payload points into input
+esp_err_t at_codec_decode(uint8_t *input, size_t input_length, uint8_t *type, uint8_t **payload, size_t *payload_length);
+
+#endif
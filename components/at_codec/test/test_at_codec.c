@@ -0,0 +1,66 @@
+#include <unity.h>
+#include <string.h>
+#include "at_codec.h"
+
+static void assert_round_trip(const uint8_t *payload, size_t payload_length) {
+  static uint8_t encoded[AT_CODEC_MAX_ENCODED_LENGTH(AT_CODEC_MAX_PAYLOAD_LENGTH)];
+  size_t encoded_length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_codec_encode(AT_CODEC_FRAME, payload, payload_length, encoded, sizeof(encoded), &encoded_length));
+  TEST_ASSERT_TRUE(encoded_length <= AT_CODEC_MAX_ENCODED_LENGTH(payload_length));
+  // delimiter must appear only at the end
+  for (size_t i = 0; i < encoded_length - 1; i++) {
+    TEST_ASSERT_NOT_EQUAL(AT_CODEC_DELIMITER, encoded[i]);
+  }
+  TEST_ASSERT_EQUAL(AT_CODEC_DELIMITER, encoded[encoded_length - 1]);
+  uint8_t type = 0;
+  uint8_t *decoded = NULL;
+  size_t decoded_length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_codec_decode(encoded, encoded_length, &type, &decoded, &decoded_length));
+  TEST_ASSERT_EQUAL(AT_CODEC_FRAME, type);
+  TEST_ASSERT_TRUE(payload_length == decoded_length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(payload, decoded, payload_length);
+}
+
+TEST_CASE("crc16", "[at_codec]") {
+  const char *check = "123456789";
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, at_codec_crc16((const uint8_t *) check, strlen(check), 0xFFFF));
+}
+
+TEST_CASE("encode and decode", "[at_codec]") {
+  static uint8_t payload[AT_CODEC_MAX_PAYLOAD_LENGTH + 1];
+  memset(payload, 0, sizeof(payload));
+  assert_round_trip(payload, 0);
+  assert_round_trip(payload, AT_CODEC_MAX_PAYLOAD_LENGTH);
+  memset(payload, 0xFF, sizeof(payload));
+  assert_round_trip(payload, AT_CODEC_MAX_PAYLOAD_LENGTH);
+  // long runs without zeros around COBS block boundary
+  for (size_t length = 250; length < 260; length++) {
+    assert_round_trip(payload, length);
+  }
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t) i;
+  }
+  assert_round_trip(payload, AT_CODEC_MAX_PAYLOAD_LENGTH);
+  // longer than at_codec_frame_t and the longest fsk packet
+  static uint8_t encoded[AT_CODEC_MAX_ENCODED_LENGTH(AT_CODEC_MAX_PAYLOAD_LENGTH + 1)];
+  size_t encoded_length = 0;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_codec_encode(AT_CODEC_FRAME, payload, sizeof(payload), encoded, sizeof(encoded), &encoded_length));
+}
+
+TEST_CASE("decode corrupted", "[at_codec]") {
+  uint8_t payload[] = {0xca, 0xfe, 0x00, 0x10};
+  uint8_t encoded[AT_CODEC_MAX_ENCODED_LENGTH(sizeof(payload))];
+  size_t encoded_length = 0;
+  uint8_t type = 0;
+  uint8_t *decoded = NULL;
+  size_t decoded_length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_codec_encode(AT_CODEC_ECHO, payload, sizeof(payload), encoded, sizeof(encoded), &encoded_length));
+  encoded[encoded_length - 3] ^= 0x01;
+  TEST_ASSERT_NOT_EQUAL(ESP_OK, at_codec_decode(encoded, encoded_length, &type, &decoded, &decoded_length));
+
+  TEST_ASSERT_EQUAL(ESP_OK, at_codec_encode(AT_CODEC_ECHO, payload, sizeof(payload), encoded, sizeof(encoded), &encoded_length));
+  TEST_ASSERT_NOT_EQUAL(ESP_OK, at_codec_decode(encoded, encoded_length - 3, &type, &decoded, &decoded_length));
+
+  uint8_t small[4];
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_codec_encode(AT_CODEC_ECHO, payload, sizeof(payload), small, sizeof(small), &encoded_length));
+}
@@ -0,0 +1,34 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_timer.h>
+#include "at_codec.h"
+
+#define BENCH_ITERATIONS 1000
+#define BENCH_BAUD_RATE 115200
+// 8N1
+#define BENCH_BITS_PER_BYTE 10
+
+TEST_CASE("binary loopback benchmark", "[at_codec][bench]") {
+  uint8_t payload[sizeof(at_codec_frame_t) + 255];
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t) i;
+  }
+  uint8_t encoded[AT_CODEC_MAX_ENCODED_LENGTH(sizeof(payload))];
+  size_t encoded_length = 0;
+  uint8_t type = 0;
+  uint8_t *decoded = NULL;
+  size_t decoded_length = 0;
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, at_codec_encode(AT_CODEC_FRAME, payload, sizeof(payload), encoded, sizeof(encoded), &encoded_length));
+    TEST_ASSERT_EQUAL(ESP_OK, at_codec_decode(encoded, encoded_length, &type, &decoded, &decoded_length));
+  }
+  int64_t took = esp_timer_get_time() - start;
+  // same frame in text mode: hex data + ",-120,9.75,-1234,1700000000000\r\n"
+  size_t text_length = 255 * 2 + 32;
+  printf("codec: %" PRId64 " frames/s. at %d baud binary: %zu bytes %d frames/s text: %zu bytes %d frames/s\n", (took > 0 ? (int64_t) BENCH_ITERATIONS * 1000000 / took : 0),
+         BENCH_BAUD_RATE, encoded_length, (int) (BENCH_BAUD_RATE / BENCH_BITS_PER_BYTE / encoded_length),
+         text_length, (int) (BENCH_BAUD_RATE / BENCH_BITS_PER_BYTE / text_length));
+}
@@ -78,6 +78,8 @@ esp_err_t lora_at_config_create(lora_at_config_t **config) {
   result->init_display = (display_init == 1);
   ERROR_CHECK_IGNORE_NOT_FOUND(nvs_get_u64(out_handle, "period", &result->deep_sleep_period_micros));
   ERROR_CHECK_IGNORE_NOT_FOUND(nvs_get_u64(out_handle, "inactivity", &result->inactivity_period_micros));
+  ERROR_CHECK_IGNORE_NOT_FOUND(nvs_get_u32(out_handle, "uart_baud", &result->uart_baud_rate));
+  ERROR_CHECK_IGNORE_NOT_FOUND(nvs_get_u8(out_handle, "uart_flow", &result->uart_flow_control));
   ERROR_CHECK_IGNORE_NOT_FOUND(lora_at_config_read_bt_address(out_handle, result));
   nvs_close(out_handle);
   *config = result;
@@ -106,6 +108,18 @@ esp_err_t lora_at_config_set_dsconfig(uint64_t inactivity_period_micros, uint64_
   return ESP_OK;
 }
 
+esp_err_t lora_at_config_set_uart(uint32_t uart_baud_rate, uint8_t uart_flow_control, lora_at_config_t *config) {
+  nvs_handle_t out_handle;
+  ERROR_CHECK(nvs_open(at_config_label, NVS_READWRITE, &out_handle));
+  ERROR_CHECK(nvs_set_u32(out_handle, "uart_baud", uart_baud_rate));
+  ERROR_CHECK(nvs_set_u8(out_handle, "uart_flow", uart_flow_control));
+  ERROR_CHECK(nvs_commit(out_handle));
+  nvs_close(out_handle);
+  config->uart_baud_rate = uart_baud_rate;
+  config->uart_flow_control = uart_flow_control;
+  return ESP_OK;
+}
+
 esp_err_t lora_at_config_set_bt_address(uint8_t *bt_address, size_t bt_address_len, lora_at_config_t *config) {
   if (bt_address != NULL) {
     nvs_handle_t out_handle;
@@ -12,6 +12,8 @@ typedef struct {
   uint8_t *bt_address; // mac address in hex format
   uint64_t deep_sleep_period_micros;
   uint64_t inactivity_period_micros;
+  uint32_t uart_baud_rate; // 0 - use default
+  uint8_t uart_flow_control; // 0 - disabled, 1 - RTS/CTS
 } lora_at_config_t;
 
 esp_err_t lora_at_config_create(lora_at_config_t **config);
@@ -22,6 +24,8 @@ esp_err_t lora_at_config_set_bt_address(uint8_t *bt_address, size_t bt_address_l
 
 esp_err_t lora_at_config_set_dsconfig(uint64_t inactivity_period_micros, uint64_t deep_sleep_period_micros, lora_at_config_t *config);
 
+esp_err_t lora_at_config_set_uart(uint32_t uart_baud_rate, uint8_t uart_flow_control, lora_at_config_t *config);
+
 void lora_at_config_destroy(lora_at_config_t *config);
 
 #endif //LORA_AT_AT_CONFIG_H
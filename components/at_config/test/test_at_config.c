@@ -14,6 +14,8 @@ TEST_CASE("init empty", "[at_config]") {
   TEST_ASSERT_EQUAL(0, at_config->inactivity_period_micros);
   TEST_ASSERT_EQUAL(0, at_config->deep_sleep_period_micros);
   TEST_ASSERT_NULL(at_config->bt_address);
+  TEST_ASSERT_EQUAL(0, at_config->uart_baud_rate);
+  TEST_ASSERT_EQUAL(0, at_config->uart_flow_control);
   lora_at_config_destroy(at_config);
 }
 
@@ -37,4 +39,13 @@ TEST_CASE("set config", "[at_config]") {
   lora_at_config_destroy(at_config);
 }
 
-
+TEST_CASE("set uart config", "[at_config]") {
+  ESP_ERROR_CHECK(lora_at_config_create(&at_config));
+  ESP_ERROR_CHECK(lora_at_config_set_uart(921600, 1, at_config));
+  lora_at_config_destroy(at_config);
+  ESP_ERROR_CHECK(lora_at_config_create(&at_config));
+  TEST_ASSERT_EQUAL(921600, at_config->uart_baud_rate);
+  TEST_ASSERT_EQUAL(1, at_config->uart_flow_control);
+  ESP_ERROR_CHECK(lora_at_config_set_uart(0, 0, at_config));
+  lora_at_config_destroy(at_config);
+}
@@ -0,0 +1,147 @@
+#include "at_command.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+typedef struct {
+  const char *name;
+  size_t name_length;
+} at_command_key_t;
+
+static int at_command_compare(const void *key, const void *element) {
+  const at_command_key_t *command_key = key;
+  const at_command_t *command = element;
+  int result = strncmp(command_key->name, command->name, command_key->name_length);
+  if (result != 0) {
+    return result;
+  }
+  // key is a prefix of command name
+  return command->name[command_key->name_length] == '\0' ? 0 : -1;
+}
+
+const at_command_t *at_command_find(const at_command_t *commands, size_t commands_length, char *input, char **args) {
+  // command name includes "=" or "?"
+  size_t name_length = strcspn(input, "=?");
+  if (input[name_length] != '\0') {
+    name_length++;
+  }
+  at_command_key_t key = {
+      .name = input,
+      .name_length = name_length
+  };
+  *args = input + name_length;
+  return bsearch(&key, commands, commands_length, sizeof(at_command_t), at_command_compare);
+}
+
+bool at_command_sorted(const at_command_t *commands, size_t commands_length) {
+  for (size_t i = 1; i < commands_length; i++) {
+    at_command_key_t key = {
+        .name = commands[i - 1].name,
+        .name_length = strlen(commands[i - 1].name)
+    };
+    // the same order bsearch expects. duplicates are not allowed
+    if (at_command_compare(&key, &commands[i]) >= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static esp_err_t at_command_parse_number(const char *token, char type, at_command_arg_t *arg) {
+  if (*token == '\0') {
+    return ESP_ERR_INVALID_ARG;
+  }
+  char *end = NULL;
+  errno = 0;
+  switch (type) {
+    case 'B':
+    case 'H':
+    case 'I':
+    case 'Q': {
+      if (*token == '-') {
+        return ESP_ERR_INVALID_ARG;
+      }
+      unsigned long long value = strtoull(token, &end, 10);
+      uint64_t max;
+      if (type == 'B') {
+        max = UINT8_MAX;
+      } else if (type == 'H') {
+        max = UINT16_MAX;
+      } else if (type == 'I') {
+        max = UINT32_MAX;
+      } else {
+        max = UINT64_MAX;
+      }
+      if (errno != 0 || *end != '\0' || value > max) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      arg->u = value;
+      return ESP_OK;
+    }
+    case 'b':
+    case 'h': {
+      long long value = strtoll(token, &end, 10);
+      int64_t max = (type == 'b' ? INT8_MAX : INT16_MAX);
+      int64_t min = (type == 'b' ? INT8_MIN : INT16_MIN);
+      if (errno != 0 || *end != '\0' || value > max || value < min) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      arg->i = value;
+      return ESP_OK;
+    }
+    default:
+      return ESP_ERR_INVALID_ARG;
+  }
+}
+
+esp_err_t at_command_parse_args(const char *schema, char *input, at_command_arg_t *args, uint8_t *args_length) {
+  *args_length = 0;
+  if (schema == NULL || *schema == '\0') {
+    return (*input == '\0' ? ESP_OK : ESP_ERR_INVALID_ARG);
+  }
+  char *token = input;
+  const char *type = schema;
+  while (1) {
+    if (*args_length >= AT_COMMAND_MAX_ARGS) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    char *token_end = strchr(token, ',');
+    bool last_token = (token_end == NULL);
+    if (!last_token) {
+      *token_end = '\0';
+    }
+    if (*type == 's') {
+      args[*args_length].s = token;
+    } else {
+      esp_err_t code = at_command_parse_number(token, *type, &args[*args_length]);
+      if (code != ESP_OK) {
+        return code;
+      }
+    }
+    (*args_length)++;
+    type++;
+    if (last_token || *type == '\0') {
+      // both schema and input should end at the same time
+      return (last_token && *type == '\0') ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    token = token_end + 1;
+  }
+}
+
+esp_err_t at_command_process(const at_command_t *commands, size_t commands_length, char *input, void *ctx) {
+  char *args_str = NULL;
+  const at_command_t *command = at_command_find(commands, commands_length, input, &args_str);
+  if (command == NULL) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  at_command_arg_t args[AT_COMMAND_MAX_ARGS];
+  uint8_t args_length = 0;
+  if (!(command->empty_args_allowed && *args_str == '\0')) {
+    esp_err_t code = at_command_parse_args(command->schema, args_str, args, &args_length);
+    if (code != ESP_OK) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+  command->handler(args, args_length, ctx);
+  return ESP_OK;
+}
@@ -0,0 +1,40 @@
+#ifndef LORA_AT_AT_COMMAND_H
+#define LORA_AT_AT_COMMAND_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define AT_COMMAND_MAX_ARGS 16
+
+typedef union {
+  uint64_t u;
+  int64_t i;
+  char *s;
+} at_command_arg_t;
+
+typedef void (*at_command_handler_t)(at_command_arg_t *args, uint8_t args_length, void *ctx);
+
+// schema is a list of argument types, one character per argument:
+//   B - uint8_t, b - int8_t, H - uint16_t, h - int16_t, I - uint32_t, Q - uint64_t, s - string
+typedef struct {
+  const char *name;
+  const char *schema;
+  bool empty_args_allowed;
+  at_command_handler_t handler;
+} at_command_t;
+
+// commands must be sorted by name (strcmp order)
+const at_command_t *at_command_find(const at_command_t *commands, size_t commands_length, char *input, char **args);
+
+// false if at_command_find can't find some commands in this table
+bool at_command_sorted(const at_command_t *commands, size_t commands_length);
+
+// input is tokenized in-place. string arguments point into input
+esp_err_t at_command_parse_args(const char *schema, char *input, at_command_arg_t *args, uint8_t *args_length);
+
+// ESP_ERR_NOT_FOUND if command is unknown. ESP_ERR_INVALID_ARG if arguments don't match schema
+esp_err_t at_command_process(const at_command_t *commands, size_t commands_length, char *input, void *ctx);
+
+#endif //LORA_AT_AT_COMMAND_H
@@ -10,11 +10,35 @@
 #include <sdkconfig.h>
 #include <at_util.h>
 #include <esp_mac.h>
+#include <at_perf.h>
+#include "at_command.h"
 
 #ifndef CONFIG_AT_UART_BUFFER_LENGTH
 #define CONFIG_AT_UART_BUFFER_LENGTH 1024
 #endif
 
+#ifndef CONFIG_AT_FRAME_BUFFER_CAPACITY
+#define CONFIG_AT_FRAME_BUFFER_CAPACITY 32
+#endif
+
+#ifdef CONFIG_AT_FRAME_BUFFER_DROP_NEWEST
+#define AT_FRAME_BUFFER_POLICY AT_UTIL_RING_DROP_NEWEST
+#else
+#define AT_FRAME_BUFFER_POLICY AT_UTIL_RING_DROP_OLDEST
+#endif
+
+typedef struct {
+  void (*callback)(char *, size_t, void *ctx);
+  void *ctx;
+  at_handler_t *handler;
+} at_handler_request_t;
+
+#define AT_HANDLER_REQUEST(x)                                        \
+  at_handler_request_t *__request = (at_handler_request_t *) (x);    \
+  at_handler_t *handler = __request->handler;                        \
+  void (*callback)(char *, size_t, void *) = __request->callback;    \
+  void *ctx = __request->ctx
+
 #define ERROR_CHECK(y, x)        \
   do {                        \
     esp_err_t __err_rc = (x); \
@@ -24,23 +48,29 @@
     }                         \
   } while (0)
 
-esp_err_t at_handler_create(lora_at_config_t *at_config, lora_at_display *display, sx127x_wrapper *device, ble_client *bluetooth, at_timer_t *timer, at_handler_t **handler) {
+esp_err_t at_handler_create(lora_at_config_t *at_config, lora_at_display *display, sx127x_wrapper *device, ble_client *bluetooth, at_timer_t *timer, sx127x_util_tx_queue_t *tx_queue, sx127x_util_scan_t *scan, at_handler_t **handler) {
   at_handler_t *result = malloc(sizeof(at_handler_t));
   if (result == NULL) {
     return ESP_ERR_NO_MEM;
   }
-  result->buffer_length = CONFIG_AT_UART_BUFFER_LENGTH;
   result->at_config = at_config;
   result->display = display;
   result->device = device;
   result->bluetooth = bluetooth;
   result->timer = timer;
-  result->output_buffer = malloc(sizeof(uint8_t) * (result->buffer_length + 1)); // 1 is for \0
-  if (result->output_buffer == NULL) {
+  result->tx_queue = tx_queue;
+  result->scan = scan;
+  result->scan_channels_length = 0;
+  result->tx_pipeline = false;
+  result->fsk_packet_length = 0;
+  result->frames = NULL;
+  result->writer = NULL;
+  esp_err_t code = at_writer_create(CONFIG_AT_UART_BUFFER_LENGTH, &result->writer);
+  if (code != ESP_OK) {
     at_handler_destroy(result);
-    return ESP_ERR_NO_MEM;
+    return code;
   }
-  esp_err_t code = at_util_vector_create(&result->frames);
+  code = at_util_ring_create(CONFIG_AT_FRAME_BUFFER_CAPACITY, AT_FRAME_BUFFER_POLICY, &result->frames);
   if (code != ESP_OK) {
     at_handler_destroy(result);
     return code;
@@ -50,267 +80,538 @@ esp_err_t at_handler_create(lora_at_config_t *at_config, lora_at_display *displa
 }
 
 void at_handler_respond(at_handler_t *handler, void (*callback)(char *, size_t, void *ctx), void *ctx, const char *response, ...) {
-  memset(handler->output_buffer, 0, handler->buffer_length);
+  at_writer_begin(callback, ctx, handler->writer);
   va_list args;
   va_start (args, response);
-  vsnprintf(handler->output_buffer, handler->buffer_length, response, args);
+  at_writer_vprintf(handler->writer, response, args);
   va_end (args);
-  callback(handler->output_buffer, strlen(handler->output_buffer), ctx);
+  at_writer_flush(handler->writer);
 }
 
 void at_handler_handle_pull(void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler) {
-  for (size_t i = 0; i < at_util_vector_size(handler->frames); i++) {
-    sx127x_frame_t *cur_frame = NULL;
-    at_util_vector_get(i, (void *) &cur_frame, handler->frames);
-    int code = at_util_hex2string(cur_frame->data, cur_frame->data_length, handler->message);
-    if (code != 0) {
-      at_handler_respond(handler, callback, ctx, "unable to convert to hex\r\n");
-      sx127x_util_frame_destroy(cur_frame);
-      continue;
+  // frames are streamed in chunks instead of one response per frame
+  at_writer_begin(callback, ctx, handler->writer);
+  sx127x_frame_t *cur_frame = NULL;
+  while (at_util_ring_pop((void **) &cur_frame, handler->frames) == ESP_OK) {
+    at_writer_hex(cur_frame->data, cur_frame->data_length, handler->writer);
+    at_writer_printf(handler->writer, ",%d,%g,%d,%" PRIu64 ",%" PRIu64, cur_frame->rssi, cur_frame->snr, cur_frame->frequency_error, cur_frame->timestamp, cur_frame->timestamp_micros);
+    // only frames received during scan have channel
+    if (cur_frame->channel >= 0) {
+      at_writer_printf(handler->writer, ",%d", cur_frame->channel);
     }
-    at_handler_respond(handler, callback, ctx, "%s,%d,%g,%d,%" PRIu64 "\r\n", handler->message, cur_frame->rssi, cur_frame->snr, cur_frame->frequency_error, cur_frame->timestamp);
+    at_writer_write("\r\n", 2, handler->writer);
+    at_perf_record(AT_PERF_ISR_TO_UART, cur_frame->interrupt_stamp);
     sx127x_util_frame_destroy(cur_frame);
   }
-  at_util_vector_clear(handler->frames);
-  at_handler_respond(handler, callback, ctx, "OK\r\n");
+  at_writer_write("OK\r\n", 4, handler->writer);
+  at_writer_flush(handler->writer);
 }
 
 esp_err_t at_handler_add_frame(sx127x_frame_t *frame, at_handler_t *handler) {
-  return at_util_vector_add(frame, handler->frames);
+  sx127x_frame_t *dropped = NULL;
+  esp_err_t code = at_util_ring_push(frame, (void **) &dropped, handler->frames);
+  sx127x_util_frame_destroy(dropped);
+  return code;
 }
 
-void at_handler_process(char *input, size_t input_length, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler) {
-  if (strcmp("AT", input) == 0) {
+static void at_handler_handle_at(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+}
+
+static void at_handler_handle_gmr(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  //Should be taken from esp-idf default app version?
+  at_handler_respond(handler, callback, ctx, "2.0\r\nOK\r\n");
+}
+
+static void at_handler_handle_state(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  uint8_t registers[0x80];
+  sx127x_dump_registers(registers, handler->device->device);
+  for (int i = 0; i < sizeof(registers); i++) {
+    if (i != 0) {
+      printf(",");
+    }
+    printf("0x%x", registers[i]);
+  }
+  printf("\n");
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+}
+
+static void at_handler_handle_reset(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
+  esp_err_t code = sx127x_util_restart(handler->device);
+  if (code != ESP_OK) {
+    at_handler_respond(handler, callback, ctx, "Unable to reset sx127x chip: %s\r\nERROR\r\n", esp_err_to_name(code));
+  } else {
     at_handler_respond(handler, callback, ctx, "OK\r\n");
-    return;
   }
-  if (strcmp("AT+GMR", input) == 0) {
-    //Should be taken from esp-idf default app version?
-    at_handler_respond(handler, callback, ctx, "2.0\r\nOK\r\n");
-    return;
+}
+
+static void at_handler_handle_display_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_handler_respond(handler, callback, ctx, "%d\r\nOK\r\n", (handler->at_config->init_display ? 1 : 0));
+}
+
+static void at_handler_handle_display_set(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  int enabled = (int) args[0].u;
+  if (enabled) {
+    ERROR_CHECK("unable to start", lora_at_display_start(handler->display));
+  } else {
+    ERROR_CHECK("unable to stop", lora_at_display_stop(handler->display));
   }
-  if (strcmp("AT+STATE", input) == 0) {
-    uint8_t registers[0x80];
-    sx127x_dump_registers(registers, handler->device->device);
-    for (int i = 0; i < sizeof(registers); i++) {
-      if (i != 0) {
-        printf(",");
-      }
-      printf("0x%x", registers[i]);
-    }
-    printf("\n");
+  ERROR_CHECK("unable to save config", lora_at_config_set_display(enabled, handler->at_config));
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+}
+
+static void at_handler_handle_time_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  time_t timer = time(NULL);
+  struct tm *tm_info = localtime(&timer);
+  char buffer[26];
+  strftime(buffer, 26, "%Y-%m-%d %H:%M:%S", tm_info);
+  at_handler_respond(handler, callback, ctx, "%s\r\nOK\r\n", buffer);
+}
+
+static void at_handler_handle_time_set(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  uint64_t time = args[0].u;
+  struct timeval now;
+  now.tv_sec = (time_t) (time / 1000);
+  now.tv_usec = (suseconds_t) ((time % 1000) * 1000);
+  int code = settimeofday(&now, NULL);
+  if (code != 0) {
+    at_handler_respond(handler, callback, ctx, "%s\r\nERROR\r\n", strerror(errno));
+  } else {
     at_handler_respond(handler, callback, ctx, "OK\r\n");
-    return;
   }
-  if (strcmp("AT+RESET", input) == 0) {
-    esp_err_t code = sx127x_util_reset();
+}
+
+static void at_handler_handle_min_freq(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_handler_respond(handler, callback, ctx, "%" PRIu64 "\r\nOK\r\n", sx127x_util_get_min_frequency());
+}
+
+static void at_handler_handle_max_freq(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_handler_respond(handler, callback, ctx, "%" PRIu64 "\r\nOK\r\n", sx127x_util_get_max_frequency());
+}
+
+static void at_handler_handle_bluetooth_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  if (handler->at_config->bt_address != NULL) {
+    esp_err_t code = at_util_hex_encode(handler->at_config->bt_address, sizeof(uint8_t) * BT_ADDRESS_LENGTH, handler->message, sizeof(handler->message), false, ':', NULL);
     if (code != ESP_OK) {
-      at_handler_respond(handler, callback, ctx, "Unable to reset sx127x chip: %s\r\nERROR\r\n", esp_err_to_name(code));
+      at_handler_respond(handler, callback, ctx, "Unable to convert MAC address to string: %s\r\n", esp_err_to_name(code));
     } else {
-      at_handler_respond(handler, callback, ctx, "OK\r\n");
+      at_handler_respond(handler, callback, ctx, "Server: %s\r\n", handler->message);
     }
-    return;
-  }
-  if (strcmp("AT+DISPLAY?", input) == 0) {
-    at_handler_respond(handler, callback, ctx, "%d\r\nOK\r\n", (handler->at_config->init_display ? 1 : 0));
-    return;
-  }
-  if (strcmp("AT+TIME?", input) == 0) {
-    time_t timer = time(NULL);
-    struct tm *tm_info = localtime(&timer);
-    char buffer[26];
-    strftime(buffer, 26, "%Y-%m-%d %H:%M:%S", tm_info);
-    at_handler_respond(handler, callback, ctx, "%s\r\nOK\r\n", buffer);
-    return;
-  }
-  if (strcmp("AT+MINFREQ?", input) == 0) {
-    at_handler_respond(handler, callback, ctx, "%" PRIu64 "\r\nOK\r\n", sx127x_util_get_min_frequency());
-    return;
   }
-  if (strcmp("AT+MAXFREQ?", input) == 0) {
-    at_handler_respond(handler, callback, ctx, "%" PRIu64 "\r\nOK\r\n", sx127x_util_get_max_frequency());
-    return;
-  }
-  if (strcmp("AT+BLUETOOTH?", input) == 0) {
-    if (handler->at_config->bt_address != NULL) {
-      esp_err_t code = at_util_hex2string(handler->at_config->bt_address, sizeof(uint8_t) * BT_ADDRESS_LENGTH, handler->message);
-      if (code != ESP_OK) {
-        at_handler_respond(handler, callback, ctx, "Unable to convert MAC address to string: %s\r\n", esp_err_to_name(code));
-      } else {
-        at_handler_respond(handler, callback, ctx, "Server: %.2s:%.2s:%.2s:%.2s:%.2s:%.2s\r\n", handler->message, handler->message + 2, handler->message + 4, handler->message + 6, handler->message + 8, handler->message + 10);
-      }
-    }
-    uint8_t mac[BT_ADDRESS_LENGTH];
-    esp_err_t code = esp_read_mac(mac, ESP_MAC_BT);
+  uint8_t mac[BT_ADDRESS_LENGTH];
+  esp_err_t code = esp_read_mac(mac, ESP_MAC_BT);
+  if (code != ESP_OK) {
+    at_handler_respond(handler, callback, ctx, "Unable to read bluetooth address: %s\r\nERROR\r\n", esp_err_to_name(code));
+  } else {
+    code = at_util_hex_encode(mac, sizeof(mac), handler->message, sizeof(handler->message), false, ':', NULL);
     if (code != ESP_OK) {
-      at_handler_respond(handler, callback, ctx, "Unable to read bluetooth address: %s\r\nERROR\r\n", esp_err_to_name(code));
+      at_handler_respond(handler, callback, ctx, "Unable to convert MAC address to string: %s\r\nERROR\r\n", esp_err_to_name(code));
     } else {
-      code = at_util_hex2string(mac, sizeof(mac), handler->message);
-      if (code != ESP_OK) {
-        at_handler_respond(handler, callback, ctx, "Unable to convert MAC address to string: %s\r\nERROR\r\n", esp_err_to_name(code));
-      } else {
-        at_handler_respond(handler, callback, ctx, "LoraAt: %.2s:%.2s:%.2s:%.2s:%.2s:%.2s\r\nOK\r\n", handler->message, handler->message + 2, handler->message + 4, handler->message + 6, handler->message + 8, handler->message + 10);
-      }
+      at_handler_respond(handler, callback, ctx, "LoraAt: %s\r\nOK\r\n", handler->message);
     }
+  }
+}
+
+static void at_handler_handle_bluetooth_set(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  if (args_length == 0) {
+    ERROR_CHECK("unable to save config", lora_at_config_set_bt_address(NULL, 0, handler->at_config));
+    ble_client_disconnect(handler->bluetooth);
+    at_handler_respond(handler, callback, ctx, "OK\r\n");
     return;
   }
-  if (strcmp("AT+DSCONFIG=", input) == 0) {
+  char *address = args[0].s;
+  if (strlen(address) == 17) {
+    ERROR_CHECK("unable to convert address to hex", at_util_hex_decode(address, strlen(address), handler->message_hex, sizeof(handler->message_hex), &handler->message_hex_length));
+    ERROR_CHECK("unable to save config", lora_at_config_set_bt_address(handler->message_hex, handler->message_hex_length, handler->at_config));
+    at_handler_respond(handler, callback, ctx, "OK\r\n");
+  } else {
+    at_handler_respond(handler, callback, ctx, "invalid address format. expected: 00:00:00:00:00:00\r\nERROR\r\n");
+  }
+}
+
+static void at_handler_handle_dsconfig(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  if (args_length == 0) {
     ERROR_CHECK("unable to stop timer", at_timer_stop(handler->timer));
     ERROR_CHECK("unable to save config", lora_at_config_set_dsconfig(0, 0, handler->at_config));
     at_handler_respond(handler, callback, ctx, "OK\r\n");
     return;
   }
-  if (strcmp("AT+BLUETOOTH=", input) == 0) {
-    ERROR_CHECK("unable to save config", lora_at_config_set_bt_address(NULL, 0, handler->at_config));
-    ble_client_disconnect(handler->bluetooth);
+  uint64_t inactivity_period_millis = args[0].u;
+  uint64_t deep_sleep_period_millis = args[1].u;
+  ERROR_CHECK("unable to start timer", at_timer_start(inactivity_period_millis * 1000, handler->timer));
+  ERROR_CHECK("unable to save config", lora_at_config_set_dsconfig(inactivity_period_millis * 1000, deep_sleep_period_millis * 1000, handler->at_config));
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+}
+
+static void at_handler_handle_stop_rx(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
+  ERROR_CHECK("unable to stop RX", sx127x_util_stop_rx(handler->device));
+  at_handler_handle_pull(callback, ctx, handler);
+  ERROR_CHECK("unable to set display status", lora_at_display_set_status("IDLE", handler->display));
+}
+
+static void at_handler_handle_pull_command(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_handler_handle_pull(callback, ctx, handler);
+}
+
+static void at_handler_parse_lora_rx(at_command_arg_t *args, lora_config_t *state) {
+  state->freq = args[0].u;
+  state->bw = (uint32_t) args[1].u;
+  state->sf = (uint8_t) args[2].u;
+  state->cr = (uint8_t) args[3].u;
+  state->syncWord = (uint8_t) args[4].u;
+  state->preambleLength = (uint16_t) args[5].u;
+  state->gain = (uint8_t) args[6].u;
+  state->ldo = (uint8_t) args[7].u;
+  state->useCrc = (uint8_t) args[8].u;
+  state->useExplicitHeader = (uint8_t) args[9].u;
+  state->length = (uint8_t) args[10].u;
+}
+
+static void at_handler_handle_lora_rx(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  lora_config_t state;
+  at_handler_parse_lora_rx(args, &state);
+  at_handler_lora_rx(SX127x_MODE_RX_CONT, &state, callback, ctx, handler);
+}
+
+static void at_handler_handle_lora_cad_rx(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  lora_config_t state;
+  at_handler_parse_lora_rx(args, &state);
+  at_handler_lora_rx(SX127x_MODE_CAD, &state, callback, ctx, handler);
+}
+
+static void at_handler_handle_lora_scan_set(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  if (handler->scan == NULL) {
+    at_handler_respond(handler, callback, ctx, "scan is not available\r\nERROR\r\n");
+    return;
+  }
+  if (args_length == 0) {
+    handler->scan_channels_length = 0;
+    ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
     at_handler_respond(handler, callback, ctx, "OK\r\n");
+    lora_at_display_set_status("IDLE", handler->display);
     return;
   }
-  if (strcmp("AT+STOPRX", input) == 0) {
-    ERROR_CHECK("unable to stop RX", sx127x_util_stop_rx(handler->device));
-    at_handler_handle_pull(callback, ctx, handler);
-    ERROR_CHECK("unable to set display status", lora_at_display_set_status("IDLE", handler->display));
+  if (handler->scan_channels_length >= SX127X_UTIL_SCAN_MAX_CHANNELS) {
+    at_handler_respond(handler, callback, ctx, "expected at most %d channels\r\nERROR\r\n", SX127X_UTIL_SCAN_MAX_CHANNELS);
     return;
   }
-  if (strcmp("AT+PULL", input) == 0) {
-    at_handler_handle_pull(callback, ctx, handler);
+  sx127x_util_scan_channel_t *channel = &handler->scan_channels[handler->scan_channels_length];
+  *channel = (sx127x_util_scan_channel_t) {0};
+  channel->dwell_millis = (uint32_t) args[0].u;
+  channel->priority = (uint8_t) args[1].u;
+  at_handler_parse_lora_rx(args + 2, &channel->config);
+  ERROR_CHECK("unable to scan", sx127x_util_scan_start(handler->scan_channels, handler->scan_channels_length + 1, handler->scan));
+  handler->scan_channels_length++;
+  at_handler_respond(handler, callback, ctx, "%d\r\nOK\r\n", handler->scan_channels_length - 1);
+  lora_at_display_set_status("SCAN", handler->display);
+}
+
+static void at_handler_handle_lora_scan_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_writer_begin(callback, ctx, handler->writer);
+  at_writer_printf(handler->writer, "%s\r\n", (sx127x_util_scan_running(handler->scan) ? "running" : "stopped"));
+  for (uint8_t i = 0; i < handler->scan_channels_length; i++) {
+    sx127x_util_scan_stats_t stats = {0};
+    sx127x_util_scan_get_stats(i, &stats, handler->scan);
+    sx127x_util_scan_channel_t *channel = &handler->scan_channels[i];
+    at_writer_printf(handler->writer, "%d: freq: %" PRIu64 " sf: %d dwell: %" PRIu32 " priority: %d visits: %" PRIu32 " hits: %" PRIu32 " misses: %" PRIu32 " frames: %" PRIu32 "\r\n", i, channel->config.freq, channel->config.sf, channel->dwell_millis,
+                     channel->priority, stats.visits, stats.hits, stats.misses, stats.frames);
+  }
+  at_writer_write("OK\r\n", 4, handler->writer);
+  at_writer_flush(handler->writer);
+}
+
+static void at_handler_handle_lora_tx(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  lora_config_t state;
+  state.freq = args[1].u;
+  state.bw = (uint32_t) args[2].u;
+  state.sf = (uint8_t) args[3].u;
+  state.cr = (uint8_t) args[4].u;
+  state.syncWord = (uint8_t) args[5].u;
+  state.preambleLength = (uint16_t) args[6].u;
+  state.ldo = (uint8_t) args[7].u;
+  state.useCrc = (uint8_t) args[8].u;
+  state.useExplicitHeader = (uint8_t) args[9].u;
+  state.length = (uint8_t) args[10].u;
+  state.power = (int8_t) args[11].i;
+  state.ocp = (int16_t) args[12].i;
+  state.pin = (uint8_t) args[13].u;
+  ERROR_CHECK("unable to convert HEX to byte array", at_util_hex_decode(args[0].s, strlen(args[0].s), handler->message_hex, sizeof(handler->message_hex), &handler->message_hex_length));
+  at_handler_lora_tx(handler->message_hex, handler->message_hex_length, &state, callback, ctx, handler);
+}
+
+static void at_handler_handle_fsk_rx(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  fsk_config_t fsk_config;
+  fsk_config.freq = args[0].u;
+  fsk_config.bitrate = (uint32_t) args[1].u;
+  fsk_config.freq_deviation = (uint32_t) args[2].u;
+  fsk_config.preamble = (uint16_t) args[3].u;
+  fsk_config.encoding = (uint8_t) args[5].u;
+  fsk_config.data_shaping = (uint8_t) args[6].u;
+  fsk_config.crc = (uint8_t) args[7].u;
+  fsk_config.rx_bandwidth = (uint32_t) args[8].u;
+  fsk_config.rx_afc_bandwidth = (uint32_t) args[9].u;
+  ERROR_CHECK("unable to convert HEX to byte array", at_util_hex_decode(args[4].s, strlen(args[4].s), handler->syncword_hex, sizeof(handler->syncword_hex), &handler->syncword_hex_length));
+  fsk_config.syncword = handler->syncword_hex;
+  fsk_config.syncword_length = handler->syncword_hex_length;
+  fsk_config.packet_length = handler->fsk_packet_length;
+  ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
+  ERROR_CHECK("unable to rx", sx127x_util_fsk_rx(&fsk_config, handler->device));
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+  lora_at_display_set_status("RX", handler->display);
+}
+
+static void at_handler_handle_fsk_length_set(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  if (args[0].u > SX127X_UTIL_MAX_FSK_PACKET_LENGTH) {
+    at_handler_respond(handler, callback, ctx, "expected 0 - %d\r\nERROR\r\n", SX127X_UTIL_MAX_FSK_PACKET_LENGTH);
     return;
   }
-  int enabled;
-  int matched = sscanf(input, "AT+DISPLAY=%d", &enabled);
-  if (matched == 1) {
-    if (enabled) {
-      ERROR_CHECK("unable to start", lora_at_display_start(handler->display));
-    } else {
-      ERROR_CHECK("unable to stop", lora_at_display_stop(handler->display));
+  handler->fsk_packet_length = (uint16_t) args[0].u;
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+}
+
+static void at_handler_handle_fsk_length_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_handler_respond(handler, callback, ctx, "%d\r\nOK\r\n", handler->fsk_packet_length);
+}
+
+static void at_handler_respond_submitted(esp_err_t code, uint32_t id, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler) {
+  if (code != ESP_OK) {
+    if (sx127x_util_tx_queue_pending(handler->tx_queue) == 0) {
+      lora_at_display_set_status("IDLE", handler->display);
     }
-    ERROR_CHECK("unable to save config", lora_at_config_set_display(enabled, handler->at_config));
-    at_handler_respond(handler, callback, ctx, "OK\r\n");
+    at_handler_respond(handler, callback, ctx, "unable to submit tx: %s\r\nERROR\r\n", esp_err_to_name(code));
     return;
   }
-  uint64_t inactivity_period_millis;
-  uint64_t deep_sleep_period_millis;
-  matched = sscanf(input, "AT+DSCONFIG=%" PRIu64 ",%" PRIu64, &inactivity_period_millis, &deep_sleep_period_millis);
-  if (matched == 2) {
-    ERROR_CHECK("unable to start timer", at_timer_start(inactivity_period_millis * 1000, handler->timer));
-    ERROR_CHECK("unable to save config", lora_at_config_set_dsconfig(inactivity_period_millis * 1000, deep_sleep_period_millis * 1000, handler->at_config));
-    at_handler_respond(handler, callback, ctx, "OK\r\n");
+  // completion will be reported as "+TXDONE:<id>,<status>"
+  at_handler_respond(handler, callback, ctx, "+TX:%" PRIu32 "\r\nOK\r\n", id);
+}
+
+static void at_handler_handle_tx_pipeline_set(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  if (args[0].u > 1) {
+    at_handler_respond(handler, callback, ctx, "expected 0 or 1\r\nERROR\r\n");
     return;
   }
-  uint64_t time;
-  matched = sscanf(input, "AT+TIME=%" PRIu64, &time);
-  if (matched == 1) {
-    struct timeval now;
-    now.tv_sec = (time_t) (time / 1000);
-    now.tv_usec = (suseconds_t) ((time % 1000) * 1000);
-    int code = settimeofday(&now, NULL);
-    if (code != 0) {
-      at_handler_respond(handler, callback, ctx, "%s\r\nERROR\r\n", strerror(errno));
-    } else {
-      at_handler_respond(handler, callback, ctx, "OK\r\n");
-    }
+  if (args[0].u == 1 && handler->tx_queue == NULL) {
+    at_handler_respond(handler, callback, ctx, "tx queue is not available\r\nERROR\r\n");
     return;
   }
-  lora_config_t state;
-  matched = sscanf(input, "AT+LORARX=%" PRIu64 ",%" PRIu32 ",%hhu,%hhu,%hhu,%hu,%hhu,%hhu,%hhu,%hhu,%hhu", &state.freq, &state.bw, &state.sf, &state.cr, &state.syncWord, &state.preambleLength, &state.gain, &state.ldo, &state.useCrc, &state.useExplicitHeader, &state.length);
-  if (matched == 11) {
-    ERROR_CHECK("unable to rx", sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &state, handler->device));
-    at_handler_respond(handler, callback, ctx, "OK\r\n");
-    lora_at_display_set_status("RX", handler->display);
-    return;
+  handler->tx_pipeline = (args[0].u == 1);
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+}
+
+static void at_handler_handle_tx_pipeline_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  uint32_t pending = 0;
+  uint32_t completed = 0;
+  if (handler->tx_queue != NULL) {
+    pending = sx127x_util_tx_queue_pending(handler->tx_queue);
+    completed = handler->tx_queue->completed;
   }
+  at_handler_respond(handler, callback, ctx, "%d\r\npending: %" PRIu32 " completed: %" PRIu32 "\r\nsettings written: %" PRIu32 " skipped: %" PRIu32 "\r\nOK\r\n", (handler->tx_pipeline ? 1 : 0), pending, completed, handler->device->settings_written,
+                     handler->device->settings_skipped);
+}
 
-  memset(handler->message, '\0', sizeof(handler->message));
-  matched = sscanf(input, "AT+LORACADRX=%" PRIu64 ",%" PRIu32 ",%hhu,%hhu,%hhu,%hu,%hhu,%hhu,%hhu,%hhu,%hhu", &state.freq, &state.bw, &state.sf, &state.cr, &state.syncWord, &state.preambleLength, &state.gain, &state.ldo, &state.useCrc, &state.useExplicitHeader, &state.length);
-  if (matched == 11) {
-    ERROR_CHECK("unable to cadrx", sx127x_util_lora_rx(SX127x_MODE_CAD, &state, handler->device));
-    at_handler_respond(handler, callback, ctx, "OK\r\n");
-    lora_at_display_set_status("CAD", handler->display);
+static void at_handler_handle_perf_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_perf_stats_t stats;
+  if (at_perf_get_stats(AT_PERF_DIO_ISR, &stats) == ESP_ERR_NOT_SUPPORTED) {
+    at_handler_respond(handler, callback, ctx, "performance tracing is disabled\r\nERROR\r\n");
     return;
   }
+  float cycles_per_micro = at_perf_cycles_per_micro();
+  at_writer_begin(callback, ctx, handler->writer);
+  for (int i = 0; i < AT_PERF_POINTS_LENGTH; i++) {
+    at_perf_get_stats(i, &stats);
+    float avg = (stats.count == 0 ? 0.0F : stats.total_cycles / (float) stats.count);
+    at_writer_printf(handler->writer, "%s: count: %" PRIu32 " min: %.2fus avg: %.2fus max: %.2fus cross-core: %" PRIu32 "\r\n", at_perf_point_name(i), stats.count, stats.min_cycles / cycles_per_micro,
+                     avg / cycles_per_micro, stats.max_cycles / cycles_per_micro, stats.cross_core);
+  }
+  at_writer_write("OK\r\n", 4, handler->writer);
+  at_writer_flush(handler->writer);
+}
 
-  memset(handler->message, '\0', sizeof(handler->message));
-  matched = sscanf(input, "AT+LORATX=%[^,],%" PRIu64 ",%" PRIu32 ",%hhu,%hhu,%hhu,%hu,%hhu,%hhu,%hhu,%hhu,%hhd,%hd,%hhu", handler->message, &state.freq, &state.bw, &state.sf, &state.cr, &state.syncWord, &state.preambleLength, &state.ldo, &state.useCrc, &state.useExplicitHeader, &state.length,
-                   &state.power, &state.ocp, &state.pin);
-  if (matched == 14) {
-    ERROR_CHECK("unable to convert HEX to byte array", at_util_string2hex(handler->message, handler->message_hex, &handler->message_hex_length));
-    lora_at_display_set_status("TX", handler->display);
-    esp_err_t code = sx127x_util_lora_tx(handler->message_hex, handler->message_hex_length, &state, handler->device);
-    if (code != ESP_OK) {
-      lora_at_display_set_status("IDLE", handler->display);
-      at_handler_respond(handler, callback, ctx, "unable to tx: %s\r\nERROR\r\n", esp_err_to_name(code));
-      return;
-    }
-    // will be sent from tx callback when message was actually sent
-    // this will allow client applications to send next message
-    // only when the previous was sent
-    // callback("OK\r\n", ctx);
-    return;
+static void at_handler_handle_irq_get(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
+  at_util_irq_t dio;
+  sx127x_util_interrupt_stats(&dio);
+  sx127x_util_dio_stats_t lines;
+  sx127x_util_dio_stats(&lines);
+  at_util_irq_t timer = {0};
+  if (handler->timer != NULL) {
+    timer = handler->timer->irq;
   }
+  at_handler_respond(handler, callback, ctx, "dio: interrupts: %" PRIu32 " handled: %" PRIu32 " coalesced: %" PRIu32 " max pending: %" PRIu32 " missed: %" PRIu32 "\r\ndio0: %" PRIu32 " dio1: %" PRIu32 " dio2: %" PRIu32 " ignored: %" PRIu32 " direct: %" PRIu32 "\r\ntimer: interrupts: %" PRIu32 " handled: %" PRIu32 " coalesced: %" PRIu32 " max pending: %" PRIu32 " missed: %" PRIu32 "\r\nOK\r\n",
+                     dio.interrupts, dio.handled, dio.coalesced, dio.max_pending, dio.missed, lines.interrupts[0], lines.interrupts[1], lines.interrupts[2], lines.ignored, lines.direct, timer.interrupts, timer.handled, timer.coalesced, timer.max_pending, timer.missed);
+}
 
+static void at_handler_handle_fsk_tx(at_command_arg_t *args, uint8_t args_length, void *arg) {
+  AT_HANDLER_REQUEST(arg);
   fsk_config_t fsk_config;
-  memset(handler->syncword, '\0', sizeof(handler->syncword));
-  matched = sscanf(input, "AT+FSKRX=%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%hu,%[^,],%hhu,%hhu,%hhu,%" PRIu32 ",%" PRIu32, &fsk_config.freq, &fsk_config.bitrate, &fsk_config.freq_deviation, &fsk_config.preamble, handler->syncword, &fsk_config.encoding, &fsk_config.data_shaping, &fsk_config.crc,
-                   &fsk_config.rx_bandwidth, &fsk_config.rx_afc_bandwidth);
-  if (matched == 10) {
-    ERROR_CHECK("unable to convert HEX to byte array", at_util_string2hex(handler->syncword, handler->syncword_hex, &handler->syncword_hex_length));
-    fsk_config.syncword = handler->syncword_hex;
-    fsk_config.syncword_length = handler->syncword_hex_length;
-    ERROR_CHECK("unable to rx", sx127x_util_fsk_rx(&fsk_config, handler->device));
-    at_handler_respond(handler, callback, ctx, "OK\r\n");
-    lora_at_display_set_status("RX", handler->display);
+  fsk_config.freq = args[1].u;
+  fsk_config.bitrate = (uint32_t) args[2].u;
+  fsk_config.freq_deviation = (uint32_t) args[3].u;
+  fsk_config.preamble = (uint16_t) args[4].u;
+  fsk_config.encoding = (uint8_t) args[6].u;
+  fsk_config.data_shaping = (uint8_t) args[7].u;
+  fsk_config.crc = (uint8_t) args[8].u;
+  fsk_config.power = (int8_t) args[9].i;
+  fsk_config.ocp = (int16_t) args[10].i;
+  fsk_config.pin = (uint8_t) args[11].u;
+  ERROR_CHECK("unable to convert HEX to byte array", at_util_hex_decode(args[5].s, strlen(args[5].s), handler->syncword_hex, sizeof(handler->syncword_hex), &handler->syncword_hex_length));
+  fsk_config.syncword = handler->syncword_hex;
+  fsk_config.syncword_length = handler->syncword_hex_length;
+  fsk_config.packet_length = handler->fsk_packet_length;
+  ERROR_CHECK("unable to convert HEX to byte array", at_util_hex_decode(args[0].s, strlen(args[0].s), handler->message_hex, sizeof(handler->message_hex), &handler->message_hex_length));
+  ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
+  lora_at_display_set_status("TX", handler->display);
+  if (handler->tx_pipeline) {
+    uint32_t id;
+    esp_err_t code = sx127x_util_tx_queue_submit_fsk(handler->message_hex, handler->message_hex_length, &fsk_config, handler->tx_queue, &id);
+    at_handler_respond_submitted(code, id, callback, ctx, handler);
     return;
   }
-
-  memset(handler->message, '\0', sizeof(handler->message));
-  memset(handler->syncword, '\0', sizeof(handler->syncword));
-  matched = sscanf(input, "AT+FSKTX=%[^,],%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%hu,%[^,],%hhu,%hhu,%hhu,%hhd,%hd,%hhu", handler->message, &fsk_config.freq, &fsk_config.bitrate, &fsk_config.freq_deviation, &fsk_config.preamble, handler->syncword, &fsk_config.encoding, &fsk_config.data_shaping,
-                   &fsk_config.crc, &fsk_config.power, &fsk_config.ocp, &fsk_config.pin);
-  if (matched == 12) {
-    ERROR_CHECK("unable to convert HEX to byte array", at_util_string2hex(handler->syncword, handler->syncword_hex, &handler->syncword_hex_length));
-    fsk_config.syncword = handler->syncword_hex;
-    fsk_config.syncword_length = handler->syncword_hex_length;
-// set tx before actually running function because if the race with tx_Callback
-    ERROR_CHECK("unable to convert HEX to byte array", at_util_string2hex(handler->message, handler->message_hex, &handler->message_hex_length));
-    lora_at_display_set_status("TX", handler->display);
-    esp_err_t code = sx127x_util_fsk_tx(handler->message_hex, handler->message_hex_length, &fsk_config, handler->device);
-    if (code != ESP_OK) {
-      lora_at_display_set_status("IDLE", handler->display);
-      at_handler_respond(handler, callback, ctx, "unable to tx: %s\r\nERROR\r\n", esp_err_to_name(code));
-      return;
-    }
-// will be sent from tx callback when message was actually sent
-// this will allow client applications to send next message
-// only when the previous was sent
-// callback("OK\r\n", ctx);
+  esp_err_t code = sx127x_util_fsk_tx(handler->message_hex, handler->message_hex_length, &fsk_config, handler->device);
+  if (code != ESP_OK) {
+    lora_at_display_set_status("IDLE", handler->display);
+    at_handler_respond(handler, callback, ctx, "unable to tx: %s\r\nERROR\r\n", esp_err_to_name(code));
     return;
   }
+  // will be sent from tx callback when message was actually sent
+  // this will allow client applications to send next message
+  // only when the previous was sent
+  // callback("OK\r\n", ctx);
+}
 
-  memset(handler->message, '\0', sizeof(handler->message));
-  matched = sscanf(input, "AT+BLUETOOTH=%[^,]", handler->message);
-  if (matched == 1) {
-    size_t message_length = strlen(handler->message);
-    if (message_length == 17) {
-      ERROR_CHECK("unable to convert address to hex", at_util_string2hex(handler->message, handler->message_hex, &handler->message_hex_length));
-      ERROR_CHECK("unable to save config", lora_at_config_set_bt_address(handler->message_hex, handler->message_hex_length, handler->at_config));
-      at_handler_respond(handler, callback, ctx, "OK\r\n");
-    } else {
-      at_handler_respond(handler, callback, ctx, "invalid address format. expected: 00:00:00:00:00:00\r\nERROR\r\n");
-    }
+// sorted by name. at_command_find does binary search
+static const at_command_t at_handler_commands[] = {
+    {"AT", NULL, false, at_handler_handle_at},
+    {"AT+BLUETOOTH=", "s", true, at_handler_handle_bluetooth_set},
+    {"AT+BLUETOOTH?", NULL, false, at_handler_handle_bluetooth_get},
+    {"AT+DISPLAY=", "I", false, at_handler_handle_display_set},
+    {"AT+DISPLAY?", NULL, false, at_handler_handle_display_get},
+    {"AT+DSCONFIG=", "QQ", true, at_handler_handle_dsconfig},
+    {"AT+FSKLEN=", "H", false, at_handler_handle_fsk_length_set},
+    {"AT+FSKLEN?", NULL, false, at_handler_handle_fsk_length_get},
+    {"AT+FSKRX=", "QIIHsBBBII", false, at_handler_handle_fsk_rx},
+    {"AT+FSKTX=", "sQIIHsBBBbhB", false, at_handler_handle_fsk_tx},
+    {"AT+GMR", NULL, false, at_handler_handle_gmr},
+    {"AT+IRQ?", NULL, false, at_handler_handle_irq_get},
+    {"AT+LORACADRX=", "QIBBBHBBBBB", false, at_handler_handle_lora_cad_rx},
+    {"AT+LORARX=", "QIBBBHBBBBB", false, at_handler_handle_lora_rx},
+    {"AT+LORASCAN=", "IBQIBBBHBBBBB", true, at_handler_handle_lora_scan_set},
+    {"AT+LORASCAN?", NULL, false, at_handler_handle_lora_scan_get},
+    {"AT+LORATX=", "sQIBBBHBBBBbhB", false, at_handler_handle_lora_tx},
+    {"AT+MAXFREQ?", NULL, false, at_handler_handle_max_freq},
+    {"AT+MINFREQ?", NULL, false, at_handler_handle_min_freq},
+    {"AT+PERF?", NULL, false, at_handler_handle_perf_get},
+    {"AT+PULL", NULL, false, at_handler_handle_pull_command},
+    {"AT+RESET", NULL, false, at_handler_handle_reset},
+    {"AT+STATE", NULL, false, at_handler_handle_state},
+    {"AT+STOPRX", NULL, false, at_handler_handle_stop_rx},
+    {"AT+TIME=", "Q", false, at_handler_handle_time_set},
+    {"AT+TIME?", NULL, false, at_handler_handle_time_get},
+    {"AT+TXPIPE=", "B", false, at_handler_handle_tx_pipeline_set},
+    {"AT+TXPIPE?", NULL, false, at_handler_handle_tx_pipeline_get},
+};
+
+const at_command_t *at_handler_get_commands(size_t *commands_length) {
+  *commands_length = sizeof(at_handler_commands) / sizeof(at_command_t);
+  return at_handler_commands;
+}
+
+void at_handler_pull_frames(void (*frame_callback)(sx127x_frame_t *frame, void *ctx), void *ctx, at_handler_t *handler) {
+  sx127x_frame_t *cur_frame = NULL;
+  while (at_util_ring_pop((void **) &cur_frame, handler->frames) == ESP_OK) {
+    frame_callback(cur_frame, ctx);
+    at_perf_record(AT_PERF_ISR_TO_UART, cur_frame->interrupt_stamp);
+    sx127x_util_frame_destroy(cur_frame);
+  }
+}
+
+void at_handler_lora_rx(sx127x_mode_t mode, lora_config_t *config, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler) {
+  ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
+  if (mode == SX127x_MODE_CAD) {
+    ERROR_CHECK("unable to cadrx", sx127x_util_lora_rx(mode, config, handler->device));
+  } else {
+    ERROR_CHECK("unable to rx", sx127x_util_lora_rx(mode, config, handler->device));
+  }
+  at_handler_respond(handler, callback, ctx, "OK\r\n");
+  lora_at_display_set_status((mode == SX127x_MODE_CAD ? "CAD" : "RX"), handler->display);
+}
+
+void at_handler_lora_tx(uint8_t *data, size_t data_length, lora_config_t *config, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler) {
+  if (data_length > SX127X_UTIL_MAX_PACKET_LENGTH) {
+    at_handler_respond(handler, callback, ctx, "unable to tx: %s\r\nERROR\r\n", esp_err_to_name(ESP_ERR_INVALID_SIZE));
+    return;
+  }
+  ERROR_CHECK("unable to stop scan", sx127x_util_scan_stop(handler->scan));
+  lora_at_display_set_status("TX", handler->display);
+  if (handler->tx_pipeline) {
+    uint32_t id;
+    esp_err_t code = sx127x_util_tx_queue_submit_lora(data, data_length, config, handler->tx_queue, &id);
+    at_handler_respond_submitted(code, id, callback, ctx, handler);
+    return;
+  }
+  esp_err_t code = sx127x_util_lora_tx(data, data_length, config, handler->device);
+  if (code != ESP_OK) {
+    lora_at_display_set_status("IDLE", handler->display);
+    at_handler_respond(handler, callback, ctx, "unable to tx: %s\r\nERROR\r\n", esp_err_to_name(code));
     return;
   }
-  at_handler_respond(handler, callback, ctx, "unknown command\r\nERROR\r\n");
+  // will be sent from tx callback when message was actually sent
+  // this will allow client applications to send next message
+  // only when the previous was sent
+  // callback("OK\r\n", ctx);
+}
+
+void at_handler_process(char *input, size_t input_length, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler) {
+  at_handler_request_t request = {
+      .callback = callback,
+      .ctx = ctx,
+      .handler = handler
+  };
+  esp_err_t code = at_command_process(at_handler_commands, sizeof(at_handler_commands) / sizeof(at_command_t), input, &request);
+  if (code != ESP_OK) {
+    at_handler_respond(handler, callback, ctx, "unknown command\r\nERROR\r\n");
+  }
 }
 
 void at_handler_destroy(at_handler_t *handler) {
   if (handler == NULL) {
     return;
   }
-  if (handler->output_buffer != NULL) {
-    free(handler->output_buffer);
-  }
+  at_writer_destroy(handler->writer);
   if (handler->frames != NULL) {
-    at_util_vector_destroy(handler->frames);
+    sx127x_frame_t *cur_frame = NULL;
+    while (at_util_ring_pop((void **) &cur_frame, handler->frames) == ESP_OK) {
+      sx127x_util_frame_destroy(cur_frame);
+    }
+    at_util_ring_destroy(handler->frames);
   }
   free(handler);
 }
\ No newline at end of file
@@ -5,22 +5,34 @@
 #include <at_config.h>
 #include <display.h>
 #include <sx127x_util.h>
+#include <sx127x_util_tx.h>
+#include <sx127x_util_scan.h>
 #include <at_util.h>
 #include <ble_client.h>
 #include <at_timer.h>
+#include "at_writer.h"
+#include "at_command.h"
 
 typedef struct {
-  at_util_vector_t *frames;
-  size_t buffer_length;
-  char *output_buffer;
+  at_util_ring_t *frames;
+  at_writer_t *writer;
   lora_at_config_t *at_config;
   lora_at_display *display;
   sx127x_wrapper *device;
   ble_client *bluetooth;
   at_timer_t *timer;
+  sx127x_util_tx_queue_t *tx_queue;
+  sx127x_util_scan_t *scan;
+  // channels added by AT+LORASCAN=. scan is restarted after every change
+  sx127x_util_scan_channel_t scan_channels[SX127X_UTIL_SCAN_MAX_CHANNELS];
+  uint8_t scan_channels_length;
+  // submit transmissions into tx_queue and respond immediately
+  bool tx_pipeline;
+  // fixed length of fsk packets. 0 - variable length
+  uint16_t fsk_packet_length;
 
   char message[514];
-  uint8_t message_hex[255];
+  uint8_t message_hex[SX127X_UTIL_MAX_FSK_PACKET_LENGTH];
   size_t message_hex_length;
 
   char syncword[18];
@@ -28,12 +40,22 @@ typedef struct {
   size_t syncword_hex_length;
 } at_handler_t;
 
-esp_err_t at_handler_create(lora_at_config_t *at_config, lora_at_display *display, sx127x_wrapper *device, ble_client *bluetooth, at_timer_t *timer, at_handler_t **handler);
+esp_err_t at_handler_create(lora_at_config_t *at_config, lora_at_display *display, sx127x_wrapper *device, ble_client *bluetooth, at_timer_t *timer, sx127x_util_tx_queue_t *tx_queue, sx127x_util_scan_t *scan, at_handler_t **handler);
 
 void at_handler_process(char *input, size_t input_length, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler);
 
+// the table used by at_handler_process
+const at_command_t *at_handler_get_commands(size_t *commands_length);
+
 esp_err_t at_handler_add_frame(sx127x_frame_t *frame, at_handler_t *handler);
 
+// frames are destroyed after frame_callback
+void at_handler_pull_frames(void (*frame_callback)(sx127x_frame_t *frame, void *ctx), void *ctx, at_handler_t *handler);
+
+void at_handler_lora_rx(sx127x_mode_t mode, lora_config_t *config, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler);
+
+void at_handler_lora_tx(uint8_t *data, size_t data_length, lora_config_t *config, void (*callback)(char *, size_t, void *ctx), void *ctx, at_handler_t *handler);
+
 void at_handler_destroy(at_handler_t *handler);
 
 #endif //LORA_AT_AT_HANDLER_H
@@ -0,0 +1,113 @@
+#include "at_writer.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <at_util.h>
+
+esp_err_t at_writer_create(size_t chunk_length, at_writer_t **writer) {
+  at_writer_t *result = malloc(sizeof(at_writer_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  *result = (at_writer_t) {0};
+  result->chunk_length = chunk_length;
+  for (int i = 0; i < 2; i++) {
+    result->chunks[i] = malloc(sizeof(char) * (chunk_length + 1)); // 1 is for \0
+    if (result->chunks[i] == NULL) {
+      at_writer_destroy(result);
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  *writer = result;
+  return ESP_OK;
+}
+
+void at_writer_begin(void (*callback)(char *, size_t, void *ctx), void *ctx, at_writer_t *writer) {
+  writer->callback = callback;
+  writer->ctx = ctx;
+  writer->position = 0;
+}
+
+void at_writer_flush(at_writer_t *writer) {
+  if (writer->position == 0) {
+    return;
+  }
+  char *chunk = writer->chunks[writer->current];
+  chunk[writer->position] = '\0';
+  writer->callback(chunk, writer->position, writer->ctx);
+  writer->current = (writer->current + 1) % 2;
+  writer->position = 0;
+}
+
+void at_writer_write(const char *data, size_t data_length, at_writer_t *writer) {
+  while (data_length > 0) {
+    size_t available = writer->chunk_length - writer->position;
+    size_t length = (data_length < available ? data_length : available);
+    memcpy(writer->chunks[writer->current] + writer->position, data, length);
+    writer->position += length;
+    data += length;
+    data_length -= length;
+    if (writer->position == writer->chunk_length) {
+      at_writer_flush(writer);
+    }
+  }
+}
+
+void at_writer_hex(const uint8_t *data, size_t data_length, at_writer_t *writer) {
+  while (data_length > 0) {
+    size_t available = (writer->chunk_length - writer->position) / 2;
+    if (available == 0) {
+      at_writer_flush(writer);
+      continue;
+    }
+    size_t length = (data_length < available ? data_length : available);
+    // chunk has extra byte for \0 written by hex2string
+    at_util_hex2string(data, length, writer->chunks[writer->current] + writer->position);
+    writer->position += length * 2;
+    data += length;
+    data_length -= length;
+  }
+}
+
+void at_writer_vprintf(at_writer_t *writer, const char *format, va_list args) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    size_t available = writer->chunk_length - writer->position;
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(writer->chunks[writer->current] + writer->position, available + 1, format, copy);
+    va_end(copy);
+    if (length < 0) {
+      return;
+    }
+    if (length <= available) {
+      writer->position += length;
+      return;
+    }
+    if (writer->position == 0) {
+      // doesn't fit into empty chunk. send truncated
+      writer->position = writer->chunk_length;
+      at_writer_flush(writer);
+      return;
+    }
+    at_writer_flush(writer);
+  }
+}
+
+void at_writer_printf(at_writer_t *writer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  at_writer_vprintf(writer, format, args);
+  va_end(args);
+}
+
+void at_writer_destroy(at_writer_t *writer) {
+  if (writer == NULL) {
+    return;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (writer->chunks[i] != NULL) {
+      free(writer->chunks[i]);
+    }
+  }
+  free(writer);
+}
@@ -0,0 +1,38 @@
+#ifndef LORA_AT_AT_WRITER_H
+#define LORA_AT_AT_WRITER_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+// output is formatted directly into one of two chunks.
+// once chunk is full it is passed to the callback and writer switches to the other chunk.
+// callback should consume the chunk before the next one is flushed
+typedef struct {
+  char *chunks[2];
+  size_t chunk_length;
+  uint8_t current;
+  size_t position;
+  void (*callback)(char *, size_t, void *ctx);
+  void *ctx;
+} at_writer_t;
+
+esp_err_t at_writer_create(size_t chunk_length, at_writer_t **writer);
+
+void at_writer_begin(void (*callback)(char *, size_t, void *ctx), void *ctx, at_writer_t *writer);
+
+void at_writer_write(const char *data, size_t data_length, at_writer_t *writer);
+
+void at_writer_hex(const uint8_t *data, size_t data_length, at_writer_t *writer);
+
+// single formatted output is limited by chunk_length
+void at_writer_printf(at_writer_t *writer, const char *format, ...);
+
+void at_writer_vprintf(at_writer_t *writer, const char *format, va_list args);
+
+void at_writer_flush(at_writer_t *writer);
+
+void at_writer_destroy(at_writer_t *writer);
+
+#endif //LORA_AT_AT_WRITER_H
@@ -0,0 +1,149 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "at_command.h"
+#include "at_handler.h"
+
+static int last_command = -1;
+static uint8_t last_args_length = 0;
+static at_command_arg_t last_args[AT_COMMAND_MAX_ARGS];
+
+static void test_handler(at_command_arg_t *args, uint8_t args_length, void *ctx) {
+  last_command = *((int *) ctx);
+  last_args_length = args_length;
+  memcpy(last_args, args, sizeof(at_command_arg_t) * args_length);
+}
+
+static const at_command_t test_commands[] = {
+    {"AT", NULL, false, test_handler},
+    {"AT+BLUETOOTH=", "s", true, test_handler},
+    {"AT+DISPLAY=", "I", false, test_handler},
+    {"AT+DISPLAY?", NULL, false, test_handler},
+    {"AT+LORATX=", "sQIBBBHBBBBbhB", false, test_handler},
+    {"AT+PULL", NULL, false, test_handler},
+};
+
+static esp_err_t test_process(const char *command) {
+  char input[1024];
+  snprintf(input, sizeof(input), "%s", command);
+  last_command = -1;
+  int ctx = 1;
+  return at_command_process(test_commands, sizeof(test_commands) / sizeof(at_command_t), input, &ctx);
+}
+
+static void assert_found(const char *command, const char *expected_name) {
+  char input[128];
+  snprintf(input, sizeof(input), "%s", command);
+  char *args = NULL;
+  const at_command_t *result = at_command_find(test_commands, sizeof(test_commands) / sizeof(at_command_t), input, &args);
+  if (expected_name == NULL) {
+    TEST_ASSERT_NULL(result);
+  } else {
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING(expected_name, result->name);
+  }
+}
+
+TEST_CASE("find command", "[at_handler]") {
+  assert_found("AT", "AT");
+  assert_found("AT+PULL", "AT+PULL");
+  assert_found("AT+DISPLAY?", "AT+DISPLAY?");
+  assert_found("AT+DISPLAY=1", "AT+DISPLAY=");
+  assert_found("AT+BLUETOOTH=", "AT+BLUETOOTH=");
+  assert_found("AT+DISPLAY", NULL);
+  assert_found("AT+PULLS", NULL);
+  assert_found("A", NULL);
+  assert_found("", NULL);
+  assert_found("AT+UNKNOWN=1", NULL);
+}
+
+TEST_CASE("parse arguments", "[at_handler]") {
+  char input[] = "cafe,433125000,125000,9,7,18,8,0,1,1,0,-3,-120,0";
+  at_command_arg_t args[AT_COMMAND_MAX_ARGS];
+  uint8_t args_length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_command_parse_args("sQIBBBHBBBBbhB", input, args, &args_length));
+  TEST_ASSERT_EQUAL(14, args_length);
+  TEST_ASSERT_EQUAL_STRING("cafe", args[0].s);
+  TEST_ASSERT_TRUE(433125000 == args[1].u);
+  TEST_ASSERT_TRUE(125000 == args[2].u);
+  TEST_ASSERT_TRUE(18 == args[5].u);
+  TEST_ASSERT_TRUE(8 == args[6].u);
+  TEST_ASSERT_TRUE(-3 == args[11].i);
+  TEST_ASSERT_TRUE(-120 == args[12].i);
+}
+
+static void assert_invalid_args(const char *schema, const char *args_str) {
+  char input[128];
+  snprintf(input, sizeof(input), "%s", args_str);
+  at_command_arg_t args[AT_COMMAND_MAX_ARGS];
+  uint8_t args_length = 0;
+  TEST_ASSERT_NOT_EQUAL(ESP_OK, at_command_parse_args(schema, input, args, &args_length));
+}
+
+TEST_CASE("parse invalid arguments", "[at_handler]") {
+  assert_invalid_args("B", "256");
+  assert_invalid_args("B", "-1");
+  assert_invalid_args("b", "128");
+  assert_invalid_args("b", "-129");
+  assert_invalid_args("H", "65536");
+  assert_invalid_args("h", "-32769");
+  assert_invalid_args("I", "4294967296");
+  assert_invalid_args("Q", "18446744073709551616");
+  assert_invalid_args("I", "12a");
+  assert_invalid_args("I", "");
+  assert_invalid_args("II", "1");
+  assert_invalid_args("I", "1,2");
+  assert_invalid_args(NULL, "1");
+}
+
+TEST_CASE("process command", "[at_handler]") {
+  TEST_ASSERT_EQUAL(ESP_OK, test_process("AT"));
+  TEST_ASSERT_EQUAL(1, last_command);
+  TEST_ASSERT_EQUAL(0, last_args_length);
+
+  TEST_ASSERT_EQUAL(ESP_OK, test_process("AT+BLUETOOTH="));
+  TEST_ASSERT_EQUAL(0, last_args_length);
+  TEST_ASSERT_EQUAL(ESP_OK, test_process("AT+BLUETOOTH=00:00:00:00:00:00"));
+  TEST_ASSERT_EQUAL(1, last_args_length);
+  TEST_ASSERT_EQUAL_STRING("00:00:00:00:00:00", last_args[0].s);
+
+  TEST_ASSERT_EQUAL(ESP_OK, test_process("AT+DISPLAY=1"));
+  TEST_ASSERT_TRUE(1 == last_args[0].u);
+
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, test_process("AT+DISPLAY="));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, test_process("AT+DISPLAY?1"));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, test_process("AT+LORATX=cafe,433125000"));
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, test_process("AT+UNKNOWN"));
+  TEST_ASSERT_EQUAL(-1, last_command);
+}
+
+TEST_CASE("commands are sorted", "[at_handler]") {
+  size_t commands_length = 0;
+  const at_command_t *commands = at_handler_get_commands(&commands_length);
+  TEST_ASSERT_TRUE(commands_length > 0);
+  TEST_ASSERT_TRUE(at_command_sorted(commands, commands_length));
+  TEST_ASSERT_TRUE(at_command_sorted(test_commands, sizeof(test_commands) / sizeof(at_command_t)));
+  // every command is found by its own name
+  for (size_t i = 0; i < commands_length; i++) {
+    char input[32];
+    snprintf(input, sizeof(input), "%s", commands[i].name);
+    char *args = NULL;
+    TEST_ASSERT_EQUAL_PTR(&commands[i], at_command_find(commands, commands_length, input, &args));
+  }
+
+  const at_command_t unsorted[] = {
+      {"AT+PULL", NULL, false, test_handler},
+      {"AT+DISPLAY?", NULL, false, test_handler},
+  };
+  TEST_ASSERT_FALSE(at_command_sorted(unsorted, 2));
+  const at_command_t prefix_after[] = {
+      {"AT+DISPLAY=", NULL, false, test_handler},
+      {"AT", NULL, false, test_handler},
+  };
+  TEST_ASSERT_FALSE(at_command_sorted(prefix_after, 2));
+  const at_command_t duplicates[] = {
+      {"AT+PULL", NULL, false, test_handler},
+      {"AT+PULL", NULL, false, test_handler},
+  };
+  TEST_ASSERT_FALSE(at_command_sorted(duplicates, 2));
+}
@@ -0,0 +1,126 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_timer.h>
+#include "at_command.h"
+#include "at_handler.h"
+
+#define BENCH_ITERATIONS 1000
+
+static const char *bench_corpus[] = {
+    "AT",
+    "AT+GMR",
+    "AT+PULL",
+    "AT+TIME=1700000000000",
+    "AT+LORARX=433125000,125000,9,7,18,8,0,0,1,1,0",
+    "AT+LORATX=cafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafecafe,433125000,125000,9,7,18,8,0,1,1,0,2,120,4",
+    "AT+FSKRX=433125000,4800,5000,4,12ad,0,0,1,5000,10000",
+    "AT+FSKTX=cafecafecafecafecafecafecafecafe,433125000,4800,5000,4,12ad,0,0,1,2,120,4",
+    "AT+BLUETOOTH=00:00:00:00:00:00",
+    "AT+DSCONFIG=",
+    "AT+STOPRX",
+};
+
+// strcmp/sscanf cascade of at_handler_process before the command table. parsing only
+static bool bench_legacy_dispatch(const char *input) {
+  static const char *exact[] = {"AT", "AT+GMR", "AT+STATE", "AT+RESET", "AT+DISPLAY?", "AT+TIME?", "AT+MINFREQ?", "AT+MAXFREQ?", "AT+BLUETOOTH?", "AT+DSCONFIG=", "AT+BLUETOOTH=", "AT+STOPRX", "AT+PULL"};
+  for (size_t i = 0; i < sizeof(exact) / sizeof(char *); i++) {
+    if (strcmp(exact[i], input) == 0) {
+      return true;
+    }
+  }
+  char message[514];
+  char syncword[18];
+  int enabled;
+  uint64_t u64_a;
+  uint64_t u64_b;
+  uint32_t u32_a;
+  uint32_t u32_b;
+  uint32_t u32_c;
+  uint16_t u16_a;
+  int16_t i16_a;
+  uint8_t u8[8];
+  int8_t i8_a;
+  if (sscanf(input, "AT+DISPLAY=%d", &enabled) == 1) {
+    return true;
+  }
+  if (sscanf(input, "AT+DSCONFIG=%" PRIu64 ",%" PRIu64, &u64_a, &u64_b) == 2) {
+    return true;
+  }
+  if (sscanf(input, "AT+TIME=%" PRIu64, &u64_a) == 1) {
+    return true;
+  }
+  if (sscanf(input, "AT+LORARX=%" PRIu64 ",%" PRIu32 ",%hhu,%hhu,%hhu,%hu,%hhu,%hhu,%hhu,%hhu,%hhu", &u64_a, &u32_a, &u8[0], &u8[1], &u8[2], &u16_a, &u8[3], &u8[4], &u8[5], &u8[6], &u8[7]) == 11) {
+    return true;
+  }
+  if (sscanf(input, "AT+LORACADRX=%" PRIu64 ",%" PRIu32 ",%hhu,%hhu,%hhu,%hu,%hhu,%hhu,%hhu,%hhu,%hhu", &u64_a, &u32_a, &u8[0], &u8[1], &u8[2], &u16_a, &u8[3], &u8[4], &u8[5], &u8[6], &u8[7]) == 11) {
+    return true;
+  }
+  if (sscanf(input, "AT+LORATX=%[^,],%" PRIu64 ",%" PRIu32 ",%hhu,%hhu,%hhu,%hu,%hhu,%hhu,%hhu,%hhu,%hhd,%hd,%hhu", message, &u64_a, &u32_a, &u8[0], &u8[1], &u8[2], &u16_a, &u8[3], &u8[4], &u8[5], &u8[6], &i8_a, &i16_a, &u8[7]) == 14) {
+    return true;
+  }
+  if (sscanf(input, "AT+FSKRX=%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%hu,%[^,],%hhu,%hhu,%hhu,%" PRIu32 ",%" PRIu32, &u64_a, &u32_a, &u32_b, &u16_a, syncword, &u8[0], &u8[1], &u8[2], &u32_c, &u32_a) == 10) {
+    return true;
+  }
+  if (sscanf(input, "AT+FSKTX=%[^,],%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%hu,%[^,],%hhu,%hhu,%hhu,%hhd,%hd,%hhu", message, &u64_a, &u32_a, &u32_b, &u16_a, syncword, &u8[0], &u8[1], &u8[2], &i8_a, &i16_a, &u8[3]) == 12) {
+    return true;
+  }
+  return sscanf(input, "AT+BLUETOOTH=%[^,]", message) == 1;
+}
+
+// the same lookup and parsing as at_handler_process. handlers are not called, because they need the radio
+static bool bench_table_dispatch(const at_command_t *commands, size_t commands_length, char *input) {
+  char *args_str = NULL;
+  const at_command_t *command = at_command_find(commands, commands_length, input, &args_str);
+  if (command == NULL) {
+    return false;
+  }
+  if (command->empty_args_allowed && *args_str == '\0') {
+    return true;
+  }
+  at_command_arg_t args[AT_COMMAND_MAX_ARGS];
+  uint8_t args_length = 0;
+  return at_command_parse_args(command->schema, args_str, args, &args_length) == ESP_OK;
+}
+
+static void bench_report(const char *name, uint32_t processed, int64_t took) {
+  printf("%s commands: %" PRIu32 " took: %" PRId64 "us commands/second: %" PRId64 "\n", name, processed, took, (took > 0 ? (int64_t) processed * 1000000 / took : 0));
+}
+
+TEST_CASE("command corpus benchmark", "[at_handler][bench]") {
+  size_t corpus_length = sizeof(bench_corpus) / sizeof(char *);
+  size_t commands_length = 0;
+  const at_command_t *commands = at_handler_get_commands(&commands_length);
+  char input[512];
+
+  uint32_t legacy_processed = 0;
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    for (size_t j = 0; j < corpus_length; j++) {
+      if (bench_legacy_dispatch(bench_corpus[j])) {
+        legacy_processed++;
+      }
+    }
+  }
+  int64_t legacy_took = esp_timer_get_time() - start;
+
+  uint32_t processed = 0;
+  start = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    for (size_t j = 0; j < corpus_length; j++) {
+      // tokenizer works in-place
+      strcpy(input, bench_corpus[j]);
+      if (bench_table_dispatch(commands, commands_length, input)) {
+        processed++;
+      }
+    }
+  }
+  int64_t took = esp_timer_get_time() - start;
+
+  TEST_ASSERT_EQUAL(BENCH_ITERATIONS * corpus_length, legacy_processed);
+  TEST_ASSERT_EQUAL(BENCH_ITERATIONS * corpus_length, processed);
+  bench_report("cascade", legacy_processed, legacy_took);
+  bench_report("table", processed, took);
+  printf("speedup: %.2fx\n", (took > 0 ? (double) legacy_took / (double) took : 0.0));
+}
@@ -0,0 +1,60 @@
+#include <unity.h>
+#include <string.h>
+#include "at_writer.h"
+
+static char captured[4096];
+static size_t captured_length = 0;
+static int flushes = 0;
+
+static void capture_callback(char *output, size_t output_length, void *ctx) {
+  TEST_ASSERT_TRUE(output_length <= *((size_t *) ctx));
+  memcpy(captured + captured_length, output, output_length);
+  captured_length += output_length;
+  captured[captured_length] = '\0';
+  flushes++;
+}
+
+static at_writer_t *create_writer(size_t *chunk_length) {
+  at_writer_t *writer = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_writer_create(*chunk_length, &writer));
+  captured_length = 0;
+  captured[0] = '\0';
+  flushes = 0;
+  at_writer_begin(capture_callback, chunk_length, writer);
+  return writer;
+}
+
+TEST_CASE("writer flushes full chunks", "[at_handler]") {
+  size_t chunk_length = 8;
+  at_writer_t *writer = create_writer(&chunk_length);
+  at_writer_write("0123456789", 10, writer);
+  TEST_ASSERT_EQUAL(1, flushes);
+  at_writer_printf(writer, ",%d\r\n", -120);
+  at_writer_flush(writer);
+  TEST_ASSERT_EQUAL_STRING("0123456789,-120\r\n", captured);
+  // nothing to flush
+  at_writer_flush(writer);
+  TEST_ASSERT_EQUAL(3, flushes);
+  at_writer_destroy(writer);
+}
+
+TEST_CASE("writer hex across chunks", "[at_handler]") {
+  size_t chunk_length = 7;
+  at_writer_t *writer = create_writer(&chunk_length);
+  uint8_t data[] = {0xca, 0xfe, 0x10, 0x00, 0xff, 0x01, 0x02};
+  at_writer_write("a", 1, writer);
+  at_writer_hex(data, sizeof(data), writer);
+  at_writer_write("OK\r\n", 4, writer);
+  at_writer_flush(writer);
+  TEST_ASSERT_EQUAL_STRING("aCAFE1000FF0102OK\r\n", captured);
+  at_writer_destroy(writer);
+}
+
+TEST_CASE("writer truncates too long output", "[at_handler]") {
+  size_t chunk_length = 4;
+  at_writer_t *writer = create_writer(&chunk_length);
+  at_writer_printf(writer, "%s", "too long");
+  at_writer_flush(writer);
+  TEST_ASSERT_EQUAL_STRING("too ", captured);
+  at_writer_destroy(writer);
+}
@@ -0,0 +1,81 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <esp_timer.h>
+#include <at_util.h>
+#include "at_writer.h"
+
+#define BENCH_FRAMES 500
+#define BENCH_BUFFER_LENGTH 1024
+
+typedef struct {
+  uint8_t data[255];
+  int16_t rssi;
+  float snr;
+  int32_t frequency_error;
+  uint64_t timestamp;
+} bench_frame_t;
+
+static bench_frame_t bench_frame;
+
+static void mock_uart_sink(char *output, size_t output_length, void *ctx) {
+  *((size_t *) ctx) += output_length;
+}
+
+static void legacy_respond(char *buffer, size_t *sent, const char *response, ...) {
+  memset(buffer, 0, BENCH_BUFFER_LENGTH);
+  va_list args;
+  va_start (args, response);
+  vsnprintf(buffer, BENCH_BUFFER_LENGTH, response, args);
+  va_end (args);
+  mock_uart_sink(buffer, strlen(buffer), sent);
+}
+
+// AT+PULL as it was: hex into message, then vsnprintf into the output buffer for every frame
+static int64_t bench_legacy(size_t *sent) {
+  char message[514];
+  char buffer[BENCH_BUFFER_LENGTH + 1];
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < BENCH_FRAMES; i++) {
+    at_util_hex2string(bench_frame.data, sizeof(bench_frame.data), message);
+    legacy_respond(buffer, sent, "%s,%d,%g,%d,%" PRIu64 "\r\n", message, bench_frame.rssi, bench_frame.snr, bench_frame.frequency_error, bench_frame.timestamp);
+  }
+  legacy_respond(buffer, sent, "OK\r\n");
+  return esp_timer_get_time() - start;
+}
+
+static int64_t bench_writer(size_t *sent) {
+  at_writer_t *writer = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_writer_create(BENCH_BUFFER_LENGTH, &writer));
+  int64_t start = esp_timer_get_time();
+  at_writer_begin(mock_uart_sink, sent, writer);
+  for (int i = 0; i < BENCH_FRAMES; i++) {
+    at_writer_hex(bench_frame.data, sizeof(bench_frame.data), writer);
+    at_writer_printf(writer, ",%d,%g,%d,%" PRIu64 "\r\n", bench_frame.rssi, bench_frame.snr, bench_frame.frequency_error, bench_frame.timestamp);
+  }
+  at_writer_write("OK\r\n", 4, writer);
+  at_writer_flush(writer);
+  int64_t took = esp_timer_get_time() - start;
+  at_writer_destroy(writer);
+  return took;
+}
+
+TEST_CASE("pull writer benchmark", "[at_handler][bench]") {
+  for (size_t i = 0; i < sizeof(bench_frame.data); i++) {
+    bench_frame.data[i] = (uint8_t) i;
+  }
+  bench_frame.rssi = -120;
+  bench_frame.snr = 9.75f;
+  bench_frame.frequency_error = -1234;
+  bench_frame.timestamp = 1700000000000;
+  size_t legacy_sent = 0;
+  size_t writer_sent = 0;
+  int64_t legacy_micros = bench_legacy(&legacy_sent);
+  int64_t writer_micros = bench_writer(&writer_sent);
+  TEST_ASSERT_TRUE(legacy_sent == writer_sent);
+  printf("frames: %d bytes: %zu legacy: %" PRId64 "us (%" PRId64 " bytes/s) writer: %" PRId64 "us (%" PRId64 " bytes/s)\n", BENCH_FRAMES, writer_sent,
+         legacy_micros, (legacy_micros > 0 ? (int64_t) legacy_sent * 1000000 / legacy_micros : 0),
+         writer_micros, (writer_micros > 0 ? (int64_t) writer_sent * 1000000 / writer_micros : 0));
+}
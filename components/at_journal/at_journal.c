@@ -0,0 +1,450 @@
+#include "at_journal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <at_codec.h>
+
+#define SECTOR_MAGIC 0x4C4E524A
+#define RECORD_FRAME 0x01
+#define RECORD_ACK 0x02
+#define RECORD_ALIGN(x) (((x) + 3) & ~3)
+
+#define ERROR_CHECK(x)        \
+  do {                        \
+    esp_err_t __err_rc = (x); \
+    if (__err_rc != ESP_OK) { \
+      return __err_rc;        \
+    }                         \
+  } while (0)
+
+static const char *TAG = "lora-at";
+
+#pragma pack(push, 1)
+typedef struct {
+  uint32_t magic;
+  // incremented every time sector is erased. the newest sector has the biggest counter
+  uint32_t counter;
+} at_journal_sector_t;
+
+typedef struct {
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t length;
+  uint16_t crc;
+} at_journal_record_t;
+#pragma pack(pop)
+
+static uint32_t at_journal_sectors(at_journal_t *journal) {
+  return journal->partition->size / journal->partition->erase_size;
+}
+
+// offset at the sector boundary belongs to the previous sector. records never start there
+static uint32_t at_journal_sector_of(uint32_t offset, at_journal_t *journal) {
+  uint32_t erase_size = journal->partition->erase_size;
+  if (offset % erase_size == 0) {
+    return offset / erase_size - 1;
+  }
+  return offset / erase_size;
+}
+
+static uint32_t at_journal_first_record(uint32_t sector, at_journal_t *journal) {
+  return sector * journal->partition->erase_size + sizeof(at_journal_sector_t);
+}
+
+static bool at_journal_sector_end(uint32_t offset, at_journal_t *journal) {
+  uint32_t erase_size = journal->partition->erase_size;
+  return offset % erase_size == 0 || erase_size - offset % erase_size < sizeof(at_journal_record_t);
+}
+
+static uint32_t at_journal_next_sector(uint32_t offset, at_journal_t *journal) {
+  uint32_t next = (at_journal_sector_of(offset, journal) + 1) % at_journal_sectors(journal);
+  return at_journal_first_record(next, journal);
+}
+
+// reads the whole record into journal->record. ESP_ERR_NOT_FOUND if there are no more records in the sector
+static esp_err_t at_journal_read_record(uint32_t offset, at_journal_record_t *record, at_journal_t *journal) {
+  if (at_journal_sector_end(offset, journal)) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  ERROR_CHECK(esp_partition_read(journal->partition, offset, record, sizeof(at_journal_record_t)));
+  if (record->type == 0xFF) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  uint32_t remaining = journal->partition->erase_size - offset % journal->partition->erase_size;
+  if ((record->type != RECORD_FRAME && record->type != RECORD_ACK) || record->length > sizeof(at_journal_slot_t) || sizeof(at_journal_record_t) + record->length > remaining) {
+    return ESP_ERR_INVALID_CRC;
+  }
+  ERROR_CHECK(esp_partition_read(journal->partition, offset + sizeof(at_journal_record_t), journal->record, record->length));
+  if (at_codec_crc16(journal->record, record->length, 0xFFFF) != record->crc) {
+    return ESP_ERR_INVALID_CRC;
+  }
+  return ESP_OK;
+}
+
+static uint32_t at_journal_record_sequence(at_journal_t *journal) {
+  uint32_t sequence;
+  memcpy(&sequence, journal->record, sizeof(sequence));
+  return sequence;
+}
+
+// returns offset of the next record or rtc->write_offset
+static uint32_t at_journal_skip(uint32_t offset, const at_journal_record_t *record, at_journal_t *journal) {
+  uint32_t result = offset + RECORD_ALIGN(sizeof(at_journal_record_t) + record->length);
+  if (result != journal->rtc->write_offset && at_journal_sector_end(result, journal)) {
+    result = at_journal_next_sector(result, journal);
+  }
+  return result;
+}
+
+// iterates over records between offset and rtc->write_offset. corrupted records and the rest of their sector are skipped
+static esp_err_t at_journal_next(uint32_t *offset, at_journal_record_t *record, at_journal_t *journal) {
+  while (*offset != journal->rtc->write_offset) {
+    esp_err_t code = at_journal_read_record(*offset, record, journal);
+    if (code == ESP_OK) {
+      return ESP_OK;
+    }
+    if (code != ESP_ERR_NOT_FOUND && code != ESP_ERR_INVALID_CRC) {
+      return code;
+    }
+    if (at_journal_sector_of(*offset, journal) == journal->rtc->write_sector) {
+      // can't go beyond the last written sector
+      *offset = journal->rtc->write_offset;
+      break;
+    }
+    *offset = at_journal_next_sector(*offset, journal);
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t at_journal_open_sector(at_journal_t *journal) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  uint32_t next = (rtc->write_sector + 1) % at_journal_sectors(journal);
+  // the oldest sector is overwritten. count frames that were not delivered
+  if (rtc->read_offset != rtc->write_offset && at_journal_sector_of(rtc->read_offset, journal) == next) {
+    uint32_t offset = rtc->read_offset;
+    at_journal_record_t record;
+    while (at_journal_sector_of(offset, journal) == next && at_journal_read_record(offset, &record, journal) == ESP_OK) {
+      if (record.type == RECORD_FRAME && at_journal_record_sequence(journal) > rtc->acked_sequence) {
+        rtc->stats.dropped++;
+        rtc->flash_frames--;
+      }
+      offset += RECORD_ALIGN(sizeof(at_journal_record_t) + record.length);
+    }
+    rtc->read_offset = at_journal_first_record((next + 1) % at_journal_sectors(journal), journal);
+  }
+  uint32_t erase_size = journal->partition->erase_size;
+  ERROR_CHECK(esp_partition_erase_range(journal->partition, next * erase_size, erase_size));
+  rtc->stats.sector_erases++;
+  at_journal_sector_t sector = {
+      .magic = SECTOR_MAGIC,
+      .counter = rtc->sector_counter + 1
+  };
+  ERROR_CHECK(esp_partition_write(journal->partition, next * erase_size, &sector, sizeof(sector)));
+  rtc->sector_counter = sector.counter;
+  bool empty = (rtc->read_offset == rtc->write_offset);
+  rtc->write_sector = next;
+  rtc->write_offset = at_journal_first_record(next, journal);
+  if (empty || rtc->flash_frames == 0) {
+    rtc->read_offset = rtc->write_offset;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t at_journal_write(uint8_t type, const void *payload, uint16_t length, at_journal_t *journal) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  uint32_t size = RECORD_ALIGN(sizeof(at_journal_record_t) + length);
+  uint32_t erase_size = journal->partition->erase_size;
+  uint32_t sector_end = (rtc->write_sector + 1) * erase_size;
+  if (sector_end - rtc->write_offset < size) {
+    ERROR_CHECK(at_journal_open_sector(journal));
+  }
+  at_journal_record_t record = {
+      .type = type,
+      .reserved = 0,
+      .length = length,
+      .crc = at_codec_crc16(payload, length, 0xFFFF)
+  };
+  memset(journal->record, 0, size);
+  memcpy(journal->record, &record, sizeof(record));
+  memcpy(journal->record + sizeof(record), payload, length);
+  ERROR_CHECK(esp_partition_write(journal->partition, rtc->write_offset, journal->record, size));
+  rtc->write_offset += size;
+  rtc->stats.flash_writes++;
+  return ESP_OK;
+}
+
+// moves RTC frames into flash log
+static esp_err_t at_journal_flush(at_journal_t *journal) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  while (rtc->slots_length > 0) {
+    at_journal_slot_t *slot = &rtc->slots[rtc->first_slot];
+    ERROR_CHECK(at_journal_write(RECORD_FRAME, slot, sizeof(at_journal_header_t) + slot->header.data_length, journal));
+    rtc->flash_frames++;
+    rtc->first_slot = (rtc->first_slot + 1) % CONFIG_AT_JOURNAL_RTC_FRAMES;
+    rtc->slots_length--;
+  }
+  return ESP_OK;
+}
+
+// skips delivered frames and ack records
+static esp_err_t at_journal_advance(at_journal_t *journal, uint32_t *acked) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  at_journal_record_t record;
+  uint32_t offset = rtc->read_offset;
+  esp_err_t code;
+  while ((code = at_journal_next(&offset, &record, journal)) == ESP_OK) {
+    if (record.type == RECORD_FRAME) {
+      if (at_journal_record_sequence(journal) > rtc->acked_sequence) {
+        break;
+      }
+      (*acked)++;
+    }
+    offset = at_journal_skip(offset, &record, journal);
+  }
+  rtc->read_offset = offset;
+  if (code != ESP_OK && code != ESP_ERR_NOT_FOUND) {
+    return code;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t at_journal_recover(at_journal_t *journal) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  uint32_t sectors = at_journal_sectors(journal);
+  int32_t newest = -1;
+  int32_t oldest = -1;
+  uint32_t newest_counter = 0;
+  uint32_t oldest_counter = UINT32_MAX;
+  for (uint32_t i = 0; i < sectors; i++) {
+    at_journal_sector_t sector;
+    ERROR_CHECK(esp_partition_read(journal->partition, i * journal->partition->erase_size, &sector, sizeof(sector)));
+    if (sector.magic != SECTOR_MAGIC) {
+      continue;
+    }
+    if (newest < 0 || sector.counter > newest_counter) {
+      newest = (int32_t) i;
+      newest_counter = sector.counter;
+    }
+    if (oldest < 0 || sector.counter < oldest_counter) {
+      oldest = (int32_t) i;
+      oldest_counter = sector.counter;
+    }
+  }
+  if (newest < 0) {
+    ESP_LOGI(TAG, "journal is empty");
+    rtc->write_sector = sectors - 1;
+    rtc->write_offset = rtc->read_offset = at_journal_first_record(rtc->write_sector, journal);
+    return at_journal_open_sector(journal);
+  }
+  rtc->write_sector = newest;
+  rtc->sector_counter = newest_counter;
+  // find the end of the newest sector
+  uint32_t offset = at_journal_first_record(newest, journal);
+  at_journal_record_t record;
+  esp_err_t code;
+  while ((code = at_journal_read_record(offset, &record, journal)) == ESP_OK) {
+    offset += RECORD_ALIGN(sizeof(at_journal_record_t) + record.length);
+  }
+  if (code == ESP_ERR_INVALID_CRC) {
+    // partially written record. continue in the next sector
+    offset = (newest + 1) * journal->partition->erase_size;
+  } else if (code != ESP_ERR_NOT_FOUND) {
+    return code;
+  }
+  rtc->write_offset = offset;
+  rtc->read_offset = at_journal_first_record(oldest, journal);
+
+  uint32_t max_frame = 0;
+  uint32_t max_ack = 0;
+  offset = rtc->read_offset;
+  while ((code = at_journal_next(&offset, &record, journal)) == ESP_OK) {
+    uint32_t sequence = at_journal_record_sequence(journal);
+    if (record.type == RECORD_FRAME && sequence > max_frame) {
+      max_frame = sequence;
+    } else if (record.type == RECORD_ACK && sequence > max_ack) {
+      max_ack = sequence;
+    }
+    offset = at_journal_skip(offset, &record, journal);
+  }
+  if (code != ESP_ERR_NOT_FOUND) {
+    return code;
+  }
+  rtc->acked_sequence = max_ack;
+  rtc->next_sequence = (max_frame > max_ack ? max_frame : max_ack) + 1;
+  offset = rtc->read_offset;
+  while (at_journal_next(&offset, &record, journal) == ESP_OK) {
+    if (record.type == RECORD_FRAME && at_journal_record_sequence(journal) > max_ack) {
+      rtc->flash_frames++;
+    }
+    offset = at_journal_skip(offset, &record, journal);
+  }
+  uint32_t acked = 0;
+  ERROR_CHECK(at_journal_advance(journal, &acked));
+  ESP_LOGI(TAG, "journal recovered. pending: %" PRIu32 " next: %" PRIu32, rtc->flash_frames, rtc->next_sequence);
+  return ESP_OK;
+}
+
+esp_err_t at_journal_create(const esp_partition_t *partition, at_journal_rtc_t *rtc, at_journal_t **journal) {
+  if (partition != NULL && (partition->erase_size == 0 || partition->size / partition->erase_size < 2)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  at_journal_t *result = malloc(sizeof(at_journal_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  result->rtc = rtc;
+  result->partition = partition;
+  result->lock = xSemaphoreCreateMutex();
+  if (result->lock == NULL) {
+    at_journal_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  if (!rtc->initialized) {
+    memset(rtc, 0, sizeof(at_journal_rtc_t));
+    rtc->next_sequence = 1;
+    if (partition != NULL) {
+      esp_err_t code = at_journal_recover(result);
+      if (code != ESP_OK) {
+        at_journal_destroy(result);
+        return code;
+      }
+    }
+    rtc->initialized = true;
+  }
+  *journal = result;
+  return ESP_OK;
+}
+
+esp_err_t at_journal_append(sx127x_frame_t *frame, at_journal_t *journal) {
+  if (frame->data_length > SX127X_UTIL_MAX_PACKET_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  at_journal_rtc_t *rtc = journal->rtc;
+  esp_err_t code = ESP_OK;
+  xSemaphoreTake(journal->lock, portMAX_DELAY);
+  if (rtc->slots_length == CONFIG_AT_JOURNAL_RTC_FRAMES) {
+    if (journal->partition != NULL) {
+      code = at_journal_flush(journal);
+    } else {
+      // no flash. the oldest frame is lost
+      rtc->first_slot = (rtc->first_slot + 1) % CONFIG_AT_JOURNAL_RTC_FRAMES;
+      rtc->slots_length--;
+      rtc->stats.dropped++;
+    }
+  }
+  if (code == ESP_OK) {
+    at_journal_slot_t *slot = &rtc->slots[(rtc->first_slot + rtc->slots_length) % CONFIG_AT_JOURNAL_RTC_FRAMES];
+    slot->header.sequence = rtc->next_sequence++;
+    slot->header.frequency_error = frame->frequency_error;
+    slot->header.rssi = frame->rssi;
+    slot->header.snr = frame->snr;
+    slot->header.timestamp = frame->timestamp;
+    slot->header.timestamp_micros = frame->timestamp_micros;
+    slot->header.data_length = frame->data_length;
+    memcpy(slot->data, frame->data, frame->data_length);
+    rtc->slots_length++;
+    rtc->stats.appended++;
+  }
+  xSemaphoreGive(journal->lock);
+  return code;
+}
+
+static void at_journal_read_slot(const at_journal_slot_t *slot, at_journal_frame_t *result) {
+  memset(result, 0, sizeof(at_journal_frame_t));
+  result->sequence = slot->header.sequence;
+  result->frame.frequency_error = slot->header.frequency_error;
+  result->frame.rssi = slot->header.rssi;
+  result->frame.snr = slot->header.snr;
+  result->frame.timestamp = slot->header.timestamp;
+  result->frame.timestamp_micros = slot->header.timestamp_micros;
+  result->frame.channel = -1;
+  result->frame.data_length = slot->header.data_length;
+  memcpy(result->data, slot->data, slot->header.data_length);
+  result->frame.data = result->data;
+}
+
+esp_err_t at_journal_peek(at_journal_frame_t *frames, size_t capacity, size_t *length, at_journal_t *journal) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  esp_err_t code = ESP_OK;
+  *length = 0;
+  xSemaphoreTake(journal->lock, portMAX_DELAY);
+  if (journal->partition != NULL && rtc->flash_frames > 0) {
+    uint32_t offset = rtc->read_offset;
+    at_journal_record_t record;
+    while (*length < capacity && (code = at_journal_next(&offset, &record, journal)) == ESP_OK) {
+      if (record.type == RECORD_FRAME && at_journal_record_sequence(journal) > rtc->acked_sequence) {
+        at_journal_read_slot((at_journal_slot_t *) journal->record, &frames[*length]);
+        (*length)++;
+      }
+      offset = at_journal_skip(offset, &record, journal);
+    }
+    if (code == ESP_ERR_NOT_FOUND) {
+      code = ESP_OK;
+    }
+  }
+  for (uint8_t i = 0; code == ESP_OK && i < rtc->slots_length && *length < capacity; i++) {
+    at_journal_slot_t *slot = &rtc->slots[(rtc->first_slot + i) % CONFIG_AT_JOURNAL_RTC_FRAMES];
+    if (slot->header.sequence > rtc->acked_sequence) {
+      at_journal_read_slot(slot, &frames[*length]);
+      (*length)++;
+    }
+  }
+  xSemaphoreGive(journal->lock);
+  return code;
+}
+
+esp_err_t at_journal_ack(uint32_t sequence, at_journal_t *journal) {
+  at_journal_rtc_t *rtc = journal->rtc;
+  xSemaphoreTake(journal->lock, portMAX_DELAY);
+  if (sequence >= rtc->next_sequence) {
+    xSemaphoreGive(journal->lock);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (sequence <= rtc->acked_sequence) {
+    xSemaphoreGive(journal->lock);
+    return ESP_OK;
+  }
+  rtc->acked_sequence = sequence;
+  esp_err_t code = ESP_OK;
+  uint32_t acked = 0;
+  if (journal->partition != NULL && rtc->flash_frames > 0) {
+    code = at_journal_advance(journal, &acked);
+    rtc->flash_frames -= acked;
+    // delivered frames are not sent again after reset
+    if (code == ESP_OK && acked > 0) {
+      code = at_journal_write(RECORD_ACK, &sequence, sizeof(sequence), journal);
+    }
+  }
+  while (rtc->slots_length > 0 && rtc->slots[rtc->first_slot].header.sequence <= sequence) {
+    rtc->first_slot = (rtc->first_slot + 1) % CONFIG_AT_JOURNAL_RTC_FRAMES;
+    rtc->slots_length--;
+    acked++;
+  }
+  rtc->stats.acked += acked;
+  xSemaphoreGive(journal->lock);
+  return code;
+}
+
+uint32_t at_journal_pending(at_journal_t *journal) {
+  xSemaphoreTake(journal->lock, portMAX_DELAY);
+  uint32_t result = journal->rtc->flash_frames + journal->rtc->slots_length;
+  xSemaphoreGive(journal->lock);
+  return result;
+}
+
+void at_journal_get_stats(at_journal_stats_t *stats, at_journal_t *journal) {
+  xSemaphoreTake(journal->lock, portMAX_DELAY);
+  *stats = journal->rtc->stats;
+  xSemaphoreGive(journal->lock);
+}
+
+void at_journal_destroy(at_journal_t *journal) {
+  if (journal == NULL) {
+    return;
+  }
+  if (journal->lock != NULL) {
+    vSemaphoreDelete(journal->lock);
+  }
+  free(journal);
+}
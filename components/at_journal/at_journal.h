@@ -0,0 +1,99 @@
+#ifndef LORA_AT_AT_JOURNAL_H
+#define LORA_AT_AT_JOURNAL_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <sx127x_util.h>
+#include <sdkconfig.h>
+
+// most recent frames are kept in RTC slow memory. every frame takes 287 bytes
+#ifndef CONFIG_AT_JOURNAL_RTC_FRAMES
+#define CONFIG_AT_JOURNAL_RTC_FRAMES 4
+#endif
+
+#define AT_JOURNAL_PARTITION_SUBTYPE 0x40
+
+#pragma pack(push, 1)
+typedef struct {
+  uint32_t sequence;
+  int32_t frequency_error;
+  int16_t rssi;
+  float snr;
+  uint64_t timestamp;
+  uint64_t timestamp_micros;
+  uint16_t data_length;
+} at_journal_header_t;
+
+typedef struct {
+  at_journal_header_t header;
+  uint8_t data[SX127X_UTIL_MAX_PACKET_LENGTH];
+} at_journal_slot_t;
+#pragma pack(pop)
+
+typedef struct {
+  uint32_t appended;
+  uint32_t acked;
+  // overwritten before they were acked
+  uint32_t dropped;
+  uint32_t flash_writes;
+  uint32_t sector_erases;
+} at_journal_stats_t;
+
+// survives deep sleep. re-created from the flash log after reset
+typedef struct {
+  bool initialized;
+  uint32_t next_sequence;
+  // frames up to and including this sequence were delivered
+  uint32_t acked_sequence;
+  at_journal_slot_t slots[CONFIG_AT_JOURNAL_RTC_FRAMES];
+  uint8_t first_slot;
+  uint8_t slots_length;
+  // flash log positions
+  uint32_t write_sector;
+  uint32_t write_offset;
+  uint32_t read_offset;
+  uint32_t sector_counter;
+  uint32_t flash_frames;
+  at_journal_stats_t stats;
+} at_journal_rtc_t;
+
+typedef struct {
+  uint32_t sequence;
+  // data points into this structure. shouldn't be destroyed
+  sx127x_frame_t frame;
+  uint8_t data[SX127X_UTIL_MAX_PACKET_LENGTH];
+} at_journal_frame_t;
+
+typedef struct {
+  at_journal_rtc_t *rtc;
+  // NULL if there is no journal partition. only RTC memory is used
+  const esp_partition_t *partition;
+  SemaphoreHandle_t lock;
+  // record with the longest frame
+  uint8_t record[sizeof(at_journal_slot_t) + 16];
+} at_journal_t;
+
+// partition can be NULL. flash log is recovered if rtc is not initialized
+esp_err_t at_journal_create(const esp_partition_t *partition, at_journal_rtc_t *rtc, at_journal_t **journal);
+
+// frame is copied into RTC memory. full RTC ring is moved into flash in one batch
+esp_err_t at_journal_append(sx127x_frame_t *frame, at_journal_t *journal);
+
+// oldest frames that were not acked yet. frames stay in the journal until at_journal_ack
+esp_err_t at_journal_peek(at_journal_frame_t *frames, size_t capacity, size_t *length, at_journal_t *journal);
+
+// marks all frames up to and including sequence as delivered
+esp_err_t at_journal_ack(uint32_t sequence, at_journal_t *journal);
+
+uint32_t at_journal_pending(at_journal_t *journal);
+
+void at_journal_get_stats(at_journal_stats_t *stats, at_journal_t *journal);
+
+void at_journal_destroy(at_journal_t *journal);
+
+#endif //LORA_AT_AT_JOURNAL_H
@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <string.h>
+#include <at_journal.h>
+
+static at_journal_rtc_t rtc;
+static at_journal_frame_t frames[16];
+
+static const esp_partition_t *erase_partition() {
+  const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, AT_JOURNAL_PARTITION_SUBTYPE, "journal");
+  TEST_ASSERT_NOT_NULL(partition);
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_erase_range(partition, 0, partition->size));
+  return partition;
+}
+
+static void append_frame(uint8_t value, uint16_t data_length, at_journal_t *journal) {
+  uint8_t data[SX127X_UTIL_MAX_PACKET_LENGTH];
+  memset(data, value, data_length);
+  sx127x_frame_t frame = {0};
+  frame.rssi = -value;
+  frame.timestamp = value;
+  frame.data = data;
+  frame.data_length = data_length;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_append(&frame, journal));
+}
+
+static void assert_frame(uint32_t sequence, uint16_t data_length, at_journal_frame_t *actual) {
+  uint8_t expected[SX127X_UTIL_MAX_PACKET_LENGTH];
+  memset(expected, (uint8_t) sequence, data_length);
+  TEST_ASSERT_EQUAL(sequence, actual->sequence);
+  TEST_ASSERT_EQUAL(-((uint8_t) sequence), actual->frame.rssi);
+  TEST_ASSERT_EQUAL((uint8_t) sequence, actual->frame.timestamp);
+  TEST_ASSERT_EQUAL(data_length, actual->frame.data_length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual->frame.data, data_length);
+}
+
+TEST_CASE("journal rtc only", "[at_journal]") {
+  memset(&rtc, 0, sizeof(rtc));
+  at_journal_t *journal = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_create(NULL, &rtc, &journal));
+  for (int i = 1; i <= CONFIG_AT_JOURNAL_RTC_FRAMES + 2; i++) {
+    append_frame(i, 10, journal);
+  }
+  at_journal_stats_t stats;
+  at_journal_get_stats(&stats, journal);
+  TEST_ASSERT_EQUAL(2, stats.dropped);
+  TEST_ASSERT_EQUAL(CONFIG_AT_JOURNAL_RTC_FRAMES, at_journal_pending(journal));
+
+  size_t length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_peek(frames, 2, &length, journal));
+  TEST_ASSERT_EQUAL(2, length);
+  assert_frame(3, 10, &frames[0]);
+  assert_frame(4, 10, &frames[1]);
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_ack(4, journal));
+  TEST_ASSERT_EQUAL(CONFIG_AT_JOURNAL_RTC_FRAMES - 2, at_journal_pending(journal));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_journal_ack(CONFIG_AT_JOURNAL_RTC_FRAMES + 3, journal));
+
+  sx127x_frame_t large = {0};
+  large.data_length = SX127X_UTIL_MAX_PACKET_LENGTH + 1;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_journal_append(&large, journal));
+  at_journal_destroy(journal);
+}
+
+TEST_CASE("journal flash", "[at_journal]") {
+  const esp_partition_t *partition = erase_partition();
+  memset(&rtc, 0, sizeof(rtc));
+  at_journal_t *journal = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_create(partition, &rtc, &journal));
+  uint32_t total = CONFIG_AT_JOURNAL_RTC_FRAMES * 2 + 2;
+  for (uint32_t i = 1; i <= total; i++) {
+    append_frame(i, i * 10, journal);
+  }
+  TEST_ASSERT_EQUAL(total, at_journal_pending(journal));
+  size_t length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_peek(frames, 16, &length, journal));
+  TEST_ASSERT_EQUAL(total, length);
+  for (uint32_t i = 0; i < total; i++) {
+    assert_frame(i + 1, (i + 1) * 10, &frames[i]);
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_ack(CONFIG_AT_JOURNAL_RTC_FRAMES + 2, journal));
+  TEST_ASSERT_EQUAL(total - CONFIG_AT_JOURNAL_RTC_FRAMES - 2, at_journal_pending(journal));
+  at_journal_destroy(journal);
+
+  // power loss. frames in RTC memory are lost, flash is recovered
+  memset(&rtc, 0, sizeof(rtc));
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_create(partition, &rtc, &journal));
+  TEST_ASSERT_EQUAL(CONFIG_AT_JOURNAL_RTC_FRAMES - 2, at_journal_pending(journal));
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_peek(frames, 16, &length, journal));
+  TEST_ASSERT_EQUAL(CONFIG_AT_JOURNAL_RTC_FRAMES - 2, length);
+  assert_frame(CONFIG_AT_JOURNAL_RTC_FRAMES + 3, (CONFIG_AT_JOURNAL_RTC_FRAMES + 3) * 10, &frames[0]);
+  append_frame(CONFIG_AT_JOURNAL_RTC_FRAMES * 2 + 1, 1, journal);
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_peek(frames, 16, &length, journal));
+  TEST_ASSERT_EQUAL(CONFIG_AT_JOURNAL_RTC_FRAMES - 1, length);
+  TEST_ASSERT_EQUAL(CONFIG_AT_JOURNAL_RTC_FRAMES * 2 + 1, frames[length - 1].sequence);
+  at_journal_destroy(journal);
+}
+
+TEST_CASE("journal wrap", "[at_journal]") {
+  const esp_partition_t *partition = erase_partition();
+  memset(&rtc, 0, sizeof(rtc));
+  at_journal_t *journal = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_create(partition, &rtc, &journal));
+  // more frames than the partition can hold. the oldest sectors are overwritten
+  uint32_t sectors = partition->size / partition->erase_size;
+  uint32_t total = (sectors + 1) * (partition->erase_size / 296);
+  for (uint32_t i = 1; i <= total; i++) {
+    append_frame(i, SX127X_UTIL_MAX_PACKET_LENGTH, journal);
+  }
+  at_journal_stats_t stats;
+  at_journal_get_stats(&stats, journal);
+  TEST_ASSERT_GREATER_THAN(0, stats.dropped);
+  TEST_ASSERT_EQUAL(total - stats.dropped, at_journal_pending(journal));
+  size_t length = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_peek(frames, 1, &length, journal));
+  TEST_ASSERT_EQUAL(1, length);
+  assert_frame(stats.dropped + 1, SX127X_UTIL_MAX_PACKET_LENGTH, &frames[0]);
+
+  // everything delivered
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_ack(total, journal));
+  TEST_ASSERT_EQUAL(0, at_journal_pending(journal));
+  at_journal_destroy(journal);
+  memset(&rtc, 0, sizeof(rtc));
+  TEST_ASSERT_EQUAL(ESP_OK, at_journal_create(partition, &rtc, &journal));
+  TEST_ASSERT_EQUAL(0, at_journal_pending(journal));
+  at_journal_destroy(journal);
+}
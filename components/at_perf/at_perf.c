@@ -0,0 +1,114 @@
+#include "at_perf.h"
+#include <string.h>
+#include <freertos/task.h>
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include <esp_rom_sys.h>
+#endif
+
+#ifndef CONFIG_AT_PERF_RING_LENGTH
+#define CONFIG_AT_PERF_RING_LENGTH 64
+#endif
+
+static const char *POINT_NAMES[] = {"dio_isr", "isr_to_task", "interrupt_task", "read_frame", "isr_to_frame", "isr_to_uart", "isr_to_rest", "isr_to_ble"};
+
+// every core writes only into its own slot. readers on the other core might see partially updated values
+typedef struct {
+  at_perf_stats_t stats[AT_PERF_POINTS_LENGTH];
+  at_perf_event_t events[CONFIG_AT_PERF_RING_LENGTH];
+  uint32_t head;
+} at_perf_core_t;
+
+static at_perf_core_t perf_cores[portNUM_PROCESSORS];
+
+void IRAM_ATTR at_perf_record(at_perf_point_t point, at_perf_stamp_t start) {
+  // tasks and ISRs on the same core are serialized by masking interrupts. no lock between cores is needed
+  UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+  at_perf_stamp_t end = at_perf_now();
+  at_perf_core_t *core = &perf_cores[end.core];
+  at_perf_stats_t *stats = &core->stats[point];
+  if (start.core != end.core) {
+    stats->cross_core++;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+    return;
+  }
+  uint32_t cycles = end.cycles - start.cycles;
+  if (stats->count == 0 || cycles < stats->min_cycles) {
+    stats->min_cycles = cycles;
+  }
+  if (cycles > stats->max_cycles) {
+    stats->max_cycles = cycles;
+  }
+  stats->count++;
+  stats->total_cycles += cycles;
+  at_perf_event_t *event = &core->events[core->head % CONFIG_AT_PERF_RING_LENGTH];
+  event->point = point;
+  event->end_cycles = end.cycles;
+  event->cycles = cycles;
+  core->head++;
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+const char *at_perf_point_name(at_perf_point_t point) {
+  if (point >= AT_PERF_POINTS_LENGTH) {
+    return "unknown";
+  }
+  return POINT_NAMES[point];
+}
+
+esp_err_t at_perf_get_stats(at_perf_point_t point, at_perf_stats_t *stats) {
+  if (point >= AT_PERF_POINTS_LENGTH) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *stats = (at_perf_stats_t) {0};
+  for (int i = 0; i < portNUM_PROCESSORS; i++) {
+    at_perf_stats_t cur = perf_cores[i].stats[point];
+    if (cur.count != 0) {
+      if (stats->count == 0 || cur.min_cycles < stats->min_cycles) {
+        stats->min_cycles = cur.min_cycles;
+      }
+      if (cur.max_cycles > stats->max_cycles) {
+        stats->max_cycles = cur.max_cycles;
+      }
+    }
+    stats->count += cur.count;
+    stats->cross_core += cur.cross_core;
+    stats->total_cycles += cur.total_cycles;
+  }
+  return ESP_OK;
+}
+
+esp_err_t at_perf_get_events(uint8_t core, at_perf_event_t *events, size_t max_events, size_t *length) {
+  if (core >= portNUM_PROCESSORS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  at_perf_core_t *cur = &perf_cores[core];
+  uint32_t head = cur->head;
+  uint32_t available = (head < CONFIG_AT_PERF_RING_LENGTH ? head : CONFIG_AT_PERF_RING_LENGTH);
+  if (available > max_events) {
+    available = max_events;
+  }
+  for (uint32_t i = 0; i < available; i++) {
+    events[i] = cur->events[(head - available + i) % CONFIG_AT_PERF_RING_LENGTH];
+  }
+  *length = available;
+  return ESP_OK;
+}
+
+uint32_t at_perf_cycles_per_micro() {
+#if CONFIG_IDF_TARGET_LINUX
+  // esp_timer is used instead of cycle counter
+  return 1;
+#else
+  return esp_rom_get_cpu_ticks_per_us();
+#endif
+}
+
+void at_perf_reset() {
+  for (int i = 0; i < portNUM_PROCESSORS; i++) {
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    memset(perf_cores[i].stats, 0, sizeof(perf_cores[i].stats));
+    perf_cores[i].head = 0;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+  }
+}
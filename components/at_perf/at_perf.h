@@ -0,0 +1,92 @@
+#ifndef LORA_AT_AT_PERF_H
+#define LORA_AT_AT_PERF_H
+
+#include <esp_err.h>
+#include <esp_attr.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+
+#if CONFIG_AT_PERF_ENABLED
+#if CONFIG_IDF_TARGET_LINUX
+#include <esp_timer.h>
+#else
+#include <esp_cpu.h>
+#endif
+#endif
+
+typedef enum {
+  AT_PERF_DIO_ISR = 0,     // DIO interrupt handler
+  AT_PERF_ISR_TO_TASK,     // interrupt until the interrupt task is woken up
+  AT_PERF_INTERRUPT_TASK,  // sx127x_handle_interrupt including rx/tx callbacks
+  AT_PERF_READ_FRAME,      // sx127x_util_read_frame
+  AT_PERF_ISR_TO_FRAME,    // interrupt until the frame is read
+  AT_PERF_ISR_TO_UART,     // interrupt until the frame is written into uart
+  AT_PERF_ISR_TO_REST,     // interrupt until the frame is serialized into REST response
+  AT_PERF_ISR_TO_BLE,      // interrupt until the frame is sent via bluetooth
+  AT_PERF_POINTS_LENGTH
+} at_perf_point_t;
+
+typedef struct {
+  uint32_t cycles;
+  uint32_t core;
+} at_perf_stamp_t;
+
+typedef struct {
+  uint32_t count;
+  // cycle counters are not synchronized between cores. such spans are counted, but not measured
+  uint32_t cross_core;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint64_t total_cycles;
+} at_perf_stats_t;
+
+typedef struct {
+  uint8_t point;
+  uint32_t end_cycles;
+  uint32_t cycles;
+} at_perf_event_t;
+
+#if CONFIG_AT_PERF_ENABLED
+
+static inline __attribute__((always_inline)) at_perf_stamp_t at_perf_now() {
+  at_perf_stamp_t result;
+#if CONFIG_IDF_TARGET_LINUX
+  result.cycles = (uint32_t) esp_timer_get_time();
+  result.core = 0;
+#else
+  result.cycles = esp_cpu_get_cycle_count();
+  result.core = esp_cpu_get_core_id();
+#endif
+  return result;
+}
+
+// can be called from ISR
+void at_perf_record(at_perf_point_t point, at_perf_stamp_t start);
+
+#else
+
+// tracing compiles to nothing
+static inline __attribute__((always_inline)) at_perf_stamp_t at_perf_now() {
+  return (at_perf_stamp_t) {0};
+}
+
+static inline __attribute__((always_inline)) void at_perf_record(at_perf_point_t point, at_perf_stamp_t start) {
+}
+
+#endif
+
+const char *at_perf_point_name(at_perf_point_t point);
+
+// ESP_ERR_NOT_SUPPORTED if tracing is disabled. stats are merged from all cores
+esp_err_t at_perf_get_stats(at_perf_point_t point, at_perf_stats_t *stats);
+
+// the most recent events of the core, oldest first
+esp_err_t at_perf_get_events(uint8_t core, at_perf_event_t *events, size_t max_events, size_t *length);
+
+uint32_t at_perf_cycles_per_micro();
+
+void at_perf_reset();
+
+#endif //LORA_AT_AT_PERF_H
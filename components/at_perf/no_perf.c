@@ -0,0 +1,21 @@
+#include "at_perf.h"
+
+const char *at_perf_point_name(at_perf_point_t point) {
+  return "unknown";
+}
+
+esp_err_t at_perf_get_stats(at_perf_point_t point, at_perf_stats_t *stats) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t at_perf_get_events(uint8_t core, at_perf_event_t *events, size_t max_events, size_t *length) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+uint32_t at_perf_cycles_per_micro() {
+  return 1;
+}
+
+void at_perf_reset() {
+  //do nothing
+}
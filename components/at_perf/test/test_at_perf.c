@@ -0,0 +1,69 @@
+#include <unity.h>
+#include <at_perf.h>
+
+#if CONFIG_AT_PERF_ENABLED
+
+static at_perf_stamp_t stamp(uint32_t cycles_ago) {
+  at_perf_stamp_t result = at_perf_now();
+  result.cycles -= cycles_ago;
+  return result;
+}
+
+TEST_CASE("stats", "[at_perf]") {
+  at_perf_reset();
+  at_perf_record(AT_PERF_READ_FRAME, stamp(1000));
+  at_perf_record(AT_PERF_READ_FRAME, stamp(3000));
+  at_perf_stats_t stats;
+  TEST_ASSERT_EQUAL(ESP_OK, at_perf_get_stats(AT_PERF_READ_FRAME, &stats));
+  TEST_ASSERT_EQUAL(2, stats.count);
+  TEST_ASSERT_GREATER_OR_EQUAL(1000, stats.min_cycles);
+  TEST_ASSERT_LESS_THAN(3000, stats.min_cycles);
+  TEST_ASSERT_GREATER_OR_EQUAL(3000, stats.max_cycles);
+  TEST_ASSERT_TRUE(stats.total_cycles >= 4000);
+
+  TEST_ASSERT_EQUAL(ESP_OK, at_perf_get_stats(AT_PERF_DIO_ISR, &stats));
+  TEST_ASSERT_EQUAL(0, stats.count);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_perf_get_stats(AT_PERF_POINTS_LENGTH, &stats));
+}
+
+TEST_CASE("cross core", "[at_perf]") {
+  at_perf_reset();
+  at_perf_stamp_t start = at_perf_now();
+  start.core = start.core + 1;
+  at_perf_record(AT_PERF_ISR_TO_UART, start);
+  at_perf_stats_t stats;
+  TEST_ASSERT_EQUAL(ESP_OK, at_perf_get_stats(AT_PERF_ISR_TO_UART, &stats));
+  TEST_ASSERT_EQUAL(0, stats.count);
+  TEST_ASSERT_EQUAL(1, stats.cross_core);
+}
+
+TEST_CASE("events", "[at_perf]") {
+  at_perf_reset();
+  at_perf_event_t events[CONFIG_AT_PERF_RING_LENGTH];
+  size_t length = 0;
+  uint8_t core = at_perf_now().core;
+  TEST_ASSERT_EQUAL(ESP_OK, at_perf_get_events(core, events, CONFIG_AT_PERF_RING_LENGTH, &length));
+  TEST_ASSERT_TRUE(length == 0);
+  // overwrite the oldest
+  for (int i = 0; i < CONFIG_AT_PERF_RING_LENGTH + 1; i++) {
+    at_perf_record((i % 2 == 0 ? AT_PERF_DIO_ISR : AT_PERF_ISR_TO_TASK), at_perf_now());
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, at_perf_get_events(core, events, 2, &length));
+  TEST_ASSERT_TRUE(length == 2);
+  TEST_ASSERT_EQUAL(CONFIG_AT_PERF_RING_LENGTH % 2 == 0 ? AT_PERF_ISR_TO_TASK : AT_PERF_DIO_ISR, events[0].point);
+  TEST_ASSERT_EQUAL(CONFIG_AT_PERF_RING_LENGTH % 2 == 0 ? AT_PERF_DIO_ISR : AT_PERF_ISR_TO_TASK, events[1].point);
+  TEST_ASSERT_EQUAL(ESP_OK, at_perf_get_events(core, events, CONFIG_AT_PERF_RING_LENGTH, &length));
+  TEST_ASSERT_TRUE(length == CONFIG_AT_PERF_RING_LENGTH);
+  TEST_ASSERT_EQUAL_STRING("isr_to_task", at_perf_point_name(AT_PERF_ISR_TO_TASK));
+}
+
+#else
+
+TEST_CASE("disabled", "[at_perf]") {
+  at_perf_stats_t stats;
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, at_perf_get_stats(AT_PERF_DIO_ISR, &stats));
+  // should compile to nothing
+  at_perf_record(AT_PERF_DIO_ISR, at_perf_now());
+}
+
+#endif
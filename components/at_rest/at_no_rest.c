@@ -4,7 +4,7 @@ struct at_rest_t {
   int dummy;
 };
 
-esp_err_t at_rest_create(sx127x_wrapper *device, at_rest **result) {
+esp_err_t at_rest_create(sx127x_wrapper *device, sx127x_util_scan_t *scan, at_schedule_t *schedule, at_journal_t *journal, at_rest **result) {
   *result = NULL;
   return ESP_OK;
 }
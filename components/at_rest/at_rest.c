@@ -1,9 +1,23 @@
 #include "at_rest.h"
 #include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include <esp_log.h>
 #include <cJSON.h>
 #include <at_util.h>
+#include <at_cbor.h>
 #include <esp_tls_crypto.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <at_perf.h>
+#include <sys/time.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include "sdkconfig.h"
 
 #ifndef CONFIG_AT_API_USERNAME
@@ -14,7 +28,35 @@
 #define CONFIG_AT_API_PASSWORD ""
 #endif
 
-#define TEMP_BUFFER_LENGTH 1024
+#ifndef CONFIG_AT_FRAME_BUFFER_CAPACITY
+#define CONFIG_AT_FRAME_BUFFER_CAPACITY 32
+#endif
+
+#ifndef CONFIG_AT_REST_STREAM_SUBSCRIBERS
+#define CONFIG_AT_REST_STREAM_SUBSCRIBERS 2
+#endif
+
+#ifndef CONFIG_AT_REST_WORKERS
+#define CONFIG_AT_REST_WORKERS 1
+#endif
+
+#ifndef CONFIG_AT_REST_PULL_IDLE_TIMEOUT
+#define CONFIG_AT_REST_PULL_IDLE_TIMEOUT 10000
+#endif
+
+#ifdef CONFIG_AT_FRAME_BUFFER_DROP_NEWEST
+#define AT_FRAME_BUFFER_POLICY AT_UTIL_RING_DROP_NEWEST
+#else
+#define AT_FRAME_BUFFER_POLICY AT_UTIL_RING_DROP_OLDEST
+#endif
+
+#define JOURNAL_BATCH_LENGTH 8
+#define AT_REST_CBOR "application/cbor"
+// frames are streamed in chunks of this size instead of building the whole response
+#define CHUNK_LENGTH 512
+
+// request parameters and hex of the longest fsk packet
+#define TEMP_BUFFER_LENGTH (2 * SX127X_UTIL_MAX_FSK_PACKET_LENGTH + 512)
 #define ERROR_CHECK(x)        \
   do {                        \
     esp_err_t __err_rc = (x); \
@@ -35,12 +77,224 @@
 
 static const char *TAG = "at_rest";
 
+typedef struct {
+  lora_config_t config;
+  at_cbor_bytes_t data;
+} at_rest_lora_request_t;
+
+typedef struct {
+  fsk_config_t config;
+  at_cbor_bytes_t syncword;
+  at_cbor_bytes_t data;
+} at_rest_fsk_request_t;
+
+typedef struct {
+  sx127x_util_scan_channel_t channels[SX127X_UTIL_SCAN_MAX_CHANNELS];
+  size_t channels_length;
+} at_rest_scan_request_t;
+
+typedef struct {
+  lora_config_t observations[CONFIG_AT_SCHEDULE_CAPACITY];
+  size_t observations_length;
+} at_rest_schedule_request_t;
+
+typedef struct {
+  uint32_t sequence;
+} at_rest_ack_request_t;
+
+// radio requests that can be sent using HTTP or websocket
+typedef union {
+  at_rest_lora_request_t lora;
+  at_rest_fsk_request_t fsk;
+} at_rest_radio_request_t;
+
+// every websocket message has id and type of request. fields of the request are in the same map
+typedef struct {
+  uint32_t id;
+  char type[16];
+} at_rest_ws_envelope_t;
+
+// prefix is the path to lora_config_t inside the structure
+#define AT_REST_LORA_FIELDS(structure, prefix)                                      \
+  AT_CBOR_UINT("freq", structure, prefix freq, true),                               \
+  AT_CBOR_UINT("bw", structure, prefix bw, true),                                   \
+  AT_CBOR_UINT("sf", structure, prefix sf, true),                                   \
+  AT_CBOR_UINT("cr", structure, prefix cr, true),                                   \
+  AT_CBOR_UINT("syncWord", structure, prefix syncWord, true),                       \
+  AT_CBOR_UINT("preambleLength", structure, prefix preambleLength, true),           \
+  AT_CBOR_UINT("ldo", structure, prefix ldo, true),                                 \
+  AT_CBOR_UINT("useCrc", structure, prefix useCrc, true),                           \
+  AT_CBOR_UINT("useExplicitHeader", structure, prefix useExplicitHeader, true),     \
+  AT_CBOR_UINT("length", structure, prefix length, true),                           \
+  AT_CBOR_UINT("gain", structure, prefix gain, false),                              \
+  AT_CBOR_INT("power", structure, prefix power, false),                             \
+  AT_CBOR_INT("ocp", structure, prefix ocp, false),                                 \
+  AT_CBOR_UINT("pin", structure, prefix pin, false)
+
+#define AT_REST_FSK_FIELDS                                                              \
+  AT_CBOR_UINT("freq", at_rest_fsk_request_t, config.freq, true),                       \
+  AT_CBOR_UINT("bitrate", at_rest_fsk_request_t, config.bitrate, true),                 \
+  AT_CBOR_UINT("freqDeviation", at_rest_fsk_request_t, config.freq_deviation, true),    \
+  AT_CBOR_UINT("preamble", at_rest_fsk_request_t, config.preamble, true),               \
+  AT_CBOR_BYTES("syncword", at_rest_fsk_request_t, syncword, true),                     \
+  AT_CBOR_UINT("encoding", at_rest_fsk_request_t, config.encoding, true),               \
+  AT_CBOR_UINT("dataShaping", at_rest_fsk_request_t, config.data_shaping, true),        \
+  AT_CBOR_UINT("crc", at_rest_fsk_request_t, config.crc, true),                         \
+  AT_CBOR_UINT("packetLength", at_rest_fsk_request_t, config.packet_length, false),     \
+  AT_CBOR_UINT("rxBandwidth", at_rest_fsk_request_t, config.rx_bandwidth, false),       \
+  AT_CBOR_UINT("rxAfcBandwidth", at_rest_fsk_request_t, config.rx_afc_bandwidth, false), \
+  AT_CBOR_INT("power", at_rest_fsk_request_t, config.power, false),                     \
+  AT_CBOR_INT("ocp", at_rest_fsk_request_t, config.ocp, false),                         \
+  AT_CBOR_UINT("pin", at_rest_fsk_request_t, config.pin, false)
+
+#define FIELDS_LENGTH(x) (sizeof(x) / sizeof((x)[0]))
+
+static const at_cbor_field_t LORA_RX_FIELDS[] = {
+    AT_REST_LORA_FIELDS(at_rest_lora_request_t, config.)
+};
+
+static const at_cbor_field_t LORA_TX_FIELDS[] = {
+    AT_REST_LORA_FIELDS(at_rest_lora_request_t, config.),
+    AT_CBOR_BYTES("data", at_rest_lora_request_t, data, true)
+};
+
+static const at_cbor_field_t FSK_RX_FIELDS[] = {
+    AT_REST_FSK_FIELDS
+};
+
+static const at_cbor_field_t FSK_TX_FIELDS[] = {
+    AT_REST_FSK_FIELDS,
+    AT_CBOR_BYTES("data", at_rest_fsk_request_t, data, true)
+};
+
+static const at_cbor_field_t SCAN_CHANNEL_FIELDS[] = {
+    AT_REST_LORA_FIELDS(sx127x_util_scan_channel_t, config.),
+    AT_CBOR_UINT("dwellMillis", sx127x_util_scan_channel_t, dwell_millis, true),
+    AT_CBOR_UINT("priority", sx127x_util_scan_channel_t, priority, false)
+};
+
+static const at_cbor_field_t SCAN_FIELDS[] = {
+    {.name = "channels", .type = AT_CBOR_FIELD_ARRAY, .offset = offsetof(at_rest_scan_request_t, channels), .required = true, .fields = SCAN_CHANNEL_FIELDS, .fields_length = FIELDS_LENGTH(SCAN_CHANNEL_FIELDS), .element_size = sizeof(sx127x_util_scan_channel_t), .capacity = SX127X_UTIL_SCAN_MAX_CHANNELS, .length_offset = offsetof(at_rest_scan_request_t, channels_length)}
+};
+
+static const at_cbor_field_t OBSERVATION_FIELDS[] = {
+    AT_REST_LORA_FIELDS(lora_config_t, ),
+    AT_CBOR_UINT("startTimeMillis", lora_config_t, startTimeMillis, true),
+    AT_CBOR_UINT("endTimeMillis", lora_config_t, endTimeMillis, true)
+};
+
+static const at_cbor_field_t SCHEDULE_FIELDS[] = {
+    {.name = "observations", .type = AT_CBOR_FIELD_ARRAY, .offset = offsetof(at_rest_schedule_request_t, observations), .required = true, .fields = OBSERVATION_FIELDS, .fields_length = FIELDS_LENGTH(OBSERVATION_FIELDS), .element_size = sizeof(lora_config_t), .capacity = CONFIG_AT_SCHEDULE_CAPACITY, .length_offset = offsetof(at_rest_schedule_request_t, observations_length)}
+};
+
+static const at_cbor_field_t ACK_FIELDS[] = {
+    AT_CBOR_UINT("sequence", at_rest_ack_request_t, sequence, true)
+};
+
+static const at_cbor_field_t WS_ENVELOPE_FIELDS[] = {
+    AT_CBOR_UINT("id", at_rest_ws_envelope_t, id, true),
+    AT_CBOR_TEXT("type", at_rest_ws_envelope_t, type, true)
+};
+
+typedef struct {
+  bool active;
+  int fd;
+  // id of the next frame to send
+  uint32_t cursor;
+  bool websocket;
+  bool cbor;
+} at_rest_subscriber_t;
+
+// buffers of one request. requests are handled by several workers at the same time
+typedef struct {
+  at_rest *rest;
+  char temp_buffer[TEMP_BUFFER_LENGTH];
+  size_t body_length;
+  // payload of tx request or copy of the frame that is being sent
+  uint8_t message[SX127X_UTIL_MAX_FSK_PACKET_LENGTH];
+  uint8_t syncword[8];
+  sx127x_frame_t frame;
+  // frames completely written into the chunk and frames that were actually sent
+  uint32_t chunk_frames;
+  uint32_t chunk_delivered;
+  size_t chunk_length;
+  // 1 is for \0 after hex encoding
+  char chunk[CHUNK_LENGTH + 1];
+  int stream_fd;
+  // MSG_DONTWAIT for pushed frames. slow subscriber shouldn't block the server task
+  int stream_flags;
+  // chunks are sent as websocket fragments
+  bool stream_websocket;
+  bool ws_binary;
+  uint32_t ws_fragments;
+} at_rest_scratch_t;
+
+// pool blocks are aligned to pointer size
+#define SCRATCH_BLOCK_SIZE ((sizeof(at_rest_scratch_t) + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *))
+
+typedef esp_err_t (*at_rest_handler_t)(httpd_req_t *req, at_rest_scratch_t *scratch);
+
+typedef struct {
+  const char *uri;
+  httpd_method_t method;
+  at_rest_handler_t handler;
+  // handled by the worker. otherwise in the server task
+  bool async;
+  // uses schedule_request or journal_batch. runs under exclusive_lock
+  bool exclusive;
+  bool websocket;
+} at_rest_route_t;
+
+typedef struct {
+  at_rest *rest;
+  const at_rest_route_t *route;
+} at_rest_endpoint_t;
+
+typedef struct {
+  // NULL stops the worker
+  httpd_req_t *req;
+  const at_rest_route_t *route;
+} at_rest_job_t;
+
 struct at_rest_t {
   sx127x_wrapper *device;
+  sx127x_util_scan_t *scan;
+  at_schedule_t *schedule;
+  at_journal_t *journal;
   httpd_handle_t server;
-  at_util_vector_t *frames;
+  // single producer: at_rest_add_frame is called only from the sx127x interrupt task
+  at_util_ring_t *frames;
+  // protects the pending frames. never held while sending
+  SemaphoreHandle_t lock;
+  // frames taken from the ring, but not consumed by every consumer yet. ids are consecutive
+  sx127x_frame_t *pending[CONFIG_AT_FRAME_BUFFER_CAPACITY];
+  uint32_t pending_first;
+  uint32_t pending_length;
+  uint32_t pending_id;
+  // the first frame not acked by pull. pull becomes a consumer after the first request
+  uint32_t pull_id;
+  bool pull_attached;
+  // pull is detached if it is idle while streams need the space
+  int64_t pull_active_micros;
+  // one pull at a time, so the same frames are not returned twice
+  SemaphoreHandle_t pull_lock;
+  // exclusive routes run one at a time. radio calls are serialized by sx127x_util
+  SemaphoreHandle_t exclusive_lock;
+  // accessed only from the server task. frames are sent from the queued work
+  at_rest_subscriber_t subscribers[CONFIG_AT_REST_STREAM_SUBSCRIBERS];
+  atomic_uint subscribers_length;
+  atomic_bool stream_queued;
   char *digest;
-  char temp_buffer[TEMP_BUFFER_LENGTH];
+  // one for every worker and one for the server task
+  uint8_t *scratch_arena;
+  at_util_pool_t scratch_pool;
+  QueueHandle_t jobs;
+  SemaphoreHandle_t workers_stopped;
+  uint8_t workers_length;
+  at_rest_endpoint_t *endpoints;
+  // used by exclusive routes only
+  at_rest_schedule_request_t schedule_request;
+  at_journal_frame_t journal_batch[JOURNAL_BATCH_LENGTH];
 };
 
 esp_err_t at_rest_respond_auth_failure(httpd_req_t *req) {
@@ -52,277 +306,1358 @@ esp_err_t at_rest_respond_auth_failure(httpd_req_t *req) {
   return ESP_OK;
 }
 
-esp_err_t at_rest_authenticate(httpd_req_t *req) {
+static bool at_rest_is_authorized(httpd_req_t *req, at_rest_scratch_t *scratch) {
   size_t buf_len = httpd_req_get_hdr_value_len(req, "Authorization") + 1;
-  if (buf_len <= 1) {
-    ERROR_CHECK_RETURN(at_rest_respond_auth_failure(req));
-    return ESP_FAIL;
+  if (buf_len <= 1 || buf_len > TEMP_BUFFER_LENGTH) {
+    return false;
   }
-  at_rest *rest = (at_rest *) req->user_ctx;
-  ERROR_CHECK_RETURN(httpd_req_get_hdr_value_str(req, "Authorization", rest->temp_buffer, buf_len));
-  if (strncmp(rest->digest, rest->temp_buffer, buf_len)) {
+  if (httpd_req_get_hdr_value_str(req, "Authorization", scratch->temp_buffer, buf_len) != ESP_OK) {
+    return false;
+  }
+  if (strncmp(scratch->rest->digest, scratch->temp_buffer, buf_len)) {
     ESP_LOGI(TAG, "authentication failed");
+    return false;
+  }
+  return true;
+}
+
+esp_err_t at_rest_authenticate(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  if (!at_rest_is_authorized(req, scratch)) {
     ERROR_CHECK_RETURN(at_rest_respond_auth_failure(req));
     return ESP_FAIL;
   }
   return ESP_OK;
 }
 
+static bool at_rest_header_contains(httpd_req_t *req, const char *field, const char *value) {
+  char header[64];
+  esp_err_t code = httpd_req_get_hdr_value_str(req, field, header, sizeof(header));
+  // truncated value is still usable
+  if (code != ESP_OK && code != ESP_ERR_HTTPD_RESULT_TRUNC) {
+    return false;
+  }
+  return strstr(header, value) != NULL;
+}
+
+static bool at_rest_accepts_cbor(httpd_req_t *req) {
+  return at_rest_header_contains(req, "Accept", AT_REST_CBOR);
+}
+
 esp_err_t at_rest_respond(const char *status, const char *status_message, httpd_req_t *req) {
+  if (at_rest_accepts_cbor(req)) {
+    ERROR_CHECK_RETURN(httpd_resp_set_type(req, AT_REST_CBOR));
+    uint8_t buffer[128];
+    at_cbor_writer_t writer;
+    at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+    ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, (status_message != NULL ? 2 : 1), &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("status", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text(status, &writer));
+    if (status_message != NULL) {
+      ERROR_CHECK_RETURN(at_cbor_write_text("failureMessage", &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_text(status_message, &writer));
+    }
+    return httpd_resp_send(req, (const char *) buffer, writer.length);
+  }
   ERROR_CHECK_RETURN(httpd_resp_set_type(req, "application/json"));
   cJSON *root = cJSON_CreateObject();
   cJSON_AddStringToObject(root, "status", status);
   if (status_message != NULL) {
     cJSON_AddStringToObject(root, "failureMessage", status_message);
   }
-  const char *response = cJSON_Print(root);
+  const char *response = cJSON_PrintUnformatted(root);
   esp_err_t code = httpd_resp_sendstr(req, response);
   free((void *) response);
   cJSON_Delete(root);
   return code;
 }
 
-esp_err_t at_rest_read_body(httpd_req_t *req) {
+static esp_err_t at_rest_read_body(httpd_req_t *req, at_rest_scratch_t *scratch) {
   size_t total_len = req->content_len;
   if (total_len == 0) {
-    return at_rest_respond("FAILURE", "request is empty", req);
+    return ESP_ERR_INVALID_ARG;
   }
+  // 1 is for \0
   if (total_len >= TEMP_BUFFER_LENGTH) {
-    return at_rest_respond("FAILURE", "content is too long", req);
+    return ESP_ERR_INVALID_SIZE;
   }
   size_t cur_len = 0;
-  at_rest *rest = (at_rest *) req->user_ctx;
   while (cur_len < total_len) {
-    int received = httpd_req_recv(req, rest->temp_buffer + cur_len, total_len);
+    int received = httpd_req_recv(req, scratch->temp_buffer + cur_len, total_len - cur_len);
     if (received <= 0) {
-      return at_rest_respond("FAILURE", "unable to read body", req);
+      return ESP_FAIL;
     }
     cur_len += received;
   }
-  rest->temp_buffer[total_len] = '\0';
+  scratch->temp_buffer[total_len] = '\0';
+  scratch->body_length = total_len;
+  return ESP_OK;
+}
+
+static esp_err_t at_rest_json_read_struct(const cJSON *object, const at_cbor_field_t *fields, size_t fields_length, void *result) {
+  if (!cJSON_IsObject(object) || fields_length > 32) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint32_t found = 0;
+  for (const cJSON *item = object->child; item != NULL; item = item->next) {
+    const at_cbor_field_t *field = at_cbor_field_find(fields, fields_length, item->string, strlen(item->string));
+    if (field == NULL) {
+      continue;
+    }
+    switch (field->type) {
+      case AT_CBOR_FIELD_UINT:
+      case AT_CBOR_FIELD_INT:
+        if (cJSON_IsBool(item)) {
+          ERROR_CHECK_RETURN(at_cbor_field_set_int(field, cJSON_IsTrue(item) ? 1 : 0, result));
+        } else if (cJSON_IsNumber(item)) {
+          ERROR_CHECK_RETURN(at_cbor_field_set_int(field, (int64_t) item->valuedouble, result));
+        } else {
+          return ESP_ERR_INVALID_ARG;
+        }
+        break;
+      case AT_CBOR_FIELD_BYTES: {
+        if (!cJSON_IsString(item)) {
+          return ESP_ERR_INVALID_ARG;
+        }
+        at_cbor_bytes_t *bytes = (at_cbor_bytes_t *) ((uint8_t *) result + field->offset);
+        ERROR_CHECK_RETURN(at_util_hex_decode(item->valuestring, strlen(item->valuestring), bytes->data, bytes->capacity, &bytes->length));
+        break;
+      }
+      case AT_CBOR_FIELD_TEXT:
+        if (!cJSON_IsString(item)) {
+          return ESP_ERR_INVALID_ARG;
+        }
+        ERROR_CHECK_RETURN(at_cbor_field_set_text(field, item->valuestring, strlen(item->valuestring), result));
+        break;
+      case AT_CBOR_FIELD_ARRAY: {
+        int length = cJSON_GetArraySize(item);
+        if (!cJSON_IsArray(item) || length > field->capacity) {
+          return ESP_ERR_INVALID_ARG;
+        }
+        uint8_t *elements = (uint8_t *) result + field->offset;
+        size_t index = 0;
+        for (const cJSON *element = item->child; element != NULL; element = element->next, index++) {
+          ERROR_CHECK_RETURN(at_rest_json_read_struct(element, field->fields, field->fields_length, elements + index * field->element_size));
+        }
+        memcpy((uint8_t *) result + field->length_offset, &index, sizeof(index));
+        break;
+      }
+    }
+    found |= 1UL << (field - fields);
+  }
+  for (size_t i = 0; i < fields_length; i++) {
+    if (fields[i].required && (found & (1UL << i)) == 0) {
+      return ESP_ERR_NOT_FOUND;
+    }
+  }
   return ESP_OK;
 }
 
-static esp_err_t at_rest_status(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
+// CBOR message is in temp_buffer. JSON message is already parsed into root
+static esp_err_t at_rest_decode_struct(bool cbor, const cJSON *root, const at_cbor_field_t *fields, size_t fields_length, void *result, at_rest_scratch_t *scratch) {
+  esp_err_t code;
+  if (cbor) {
+    at_cbor_reader_t reader;
+    at_cbor_reader_init((const uint8_t *) scratch->temp_buffer, scratch->body_length, &reader);
+    code = at_cbor_read_struct(fields, fields_length, result, &reader);
+  } else if (root != NULL) {
+    code = at_rest_json_read_struct(root, fields, fields_length, result);
+  } else {
+    code = ESP_ERR_INVALID_ARG;
+  }
+  // truncated input or too long byte string is reported as invalid request
+  if (code != ESP_OK && code != ESP_ERR_NOT_FOUND) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return code;
+}
+
+// body is decoded into the structure described by fields. CBOR if Content-Type is application/cbor, JSON otherwise
+static esp_err_t at_rest_read_request(httpd_req_t *req, at_rest_scratch_t *scratch, const at_cbor_field_t *fields, size_t fields_length, void *result) {
+  ERROR_CHECK_RETURN(at_rest_read_body(req, scratch));
+  bool cbor = at_rest_header_contains(req, "Content-Type", AT_REST_CBOR);
+  cJSON *root = cbor ? NULL : cJSON_Parse(scratch->temp_buffer);
+  esp_err_t code = at_rest_decode_struct(cbor, root, fields, fields_length, result, scratch);
+  cJSON_Delete(root);
+  return code;
+}
+
+static const char *at_rest_request_error_message(esp_err_t code) {
+  switch (code) {
+    case ESP_ERR_NOT_FOUND:
+      return "missing required field";
+    case ESP_ERR_INVALID_SIZE:
+      return "content is too long";
+    case ESP_FAIL:
+      return "unable to read body";
+    default:
+      return "unable to parse request";
+  }
+}
+
+static esp_err_t at_rest_respond_request_error(esp_err_t code, httpd_req_t *req) {
+  return at_rest_respond("FAILURE", at_rest_request_error_message(code), req);
+}
+
+static esp_err_t at_rest_status(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  if (at_rest_accepts_cbor(req)) {
+    ERROR_CHECK_RETURN(httpd_resp_set_type(req, AT_REST_CBOR));
+    uint8_t buffer[64];
+    at_cbor_writer_t writer;
+    at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+    ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, 3, &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("status", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("SUCCESS", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("minFreq", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_uint(sx127x_util_get_min_frequency(), &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("maxFreq", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_uint(sx127x_util_get_max_frequency(), &writer));
+    return httpd_resp_send(req, (const char *) buffer, writer.length);
+  }
   ERROR_CHECK_RETURN(httpd_resp_set_type(req, "application/json"));
   cJSON *root = cJSON_CreateObject();
   cJSON_AddStringToObject(root, "status", "SUCCESS");
   cJSON_AddNumberToObject(root, "minFreq", sx127x_util_get_min_frequency());
   cJSON_AddNumberToObject(root, "maxFreq", sx127x_util_get_max_frequency());
-  const char *response = cJSON_Print(root);
+  const char *response = cJSON_PrintUnformatted(root);
   esp_err_t code = httpd_resp_sendstr(req, response);
   free((void *) response);
   cJSON_Delete(root);
   return code;
 }
 
-static esp_err_t at_rest_rx_pull(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
-  esp_err_t code = httpd_resp_set_type(req, "application/json");
+// pending functions are called with the lock taken
+static void at_rest_pending_evict(at_rest *rest) {
+  sx127x_util_frame_destroy(rest->pending[rest->pending_first]);
+  rest->pending_first = (rest->pending_first + 1) % CONFIG_AT_FRAME_BUFFER_CAPACITY;
+  rest->pending_length--;
+  rest->pending_id++;
+}
+
+// frames consumed by pull and every subscriber are removed. without consumers frames are kept for the first one
+static void at_rest_pending_trim(at_rest *rest) {
+  bool consumers = rest->pull_attached;
+  uint32_t oldest = (rest->pull_attached ? rest->pull_id : rest->pending_id + rest->pending_length);
+  for (size_t i = 0; i < CONFIG_AT_REST_STREAM_SUBSCRIBERS; i++) {
+    at_rest_subscriber_t *subscriber = &rest->subscribers[i];
+    if (!subscriber->active) {
+      continue;
+    }
+    consumers = true;
+    if ((int32_t) (subscriber->cursor - oldest) < 0) {
+      oldest = subscriber->cursor;
+    }
+  }
+  if (!consumers) {
+    return;
+  }
+  while (rest->pending_length > 0 && (int32_t) (oldest - rest->pending_id) > 0) {
+    at_rest_pending_evict(rest);
+  }
+}
+
+static void at_rest_pending_fill(at_rest *rest) {
+  sx127x_frame_t *cur_frame = NULL;
+  at_rest_pending_trim(rest);
+  while (at_util_ring_size(rest->frames) > 0) {
+    if (rest->pending_length == CONFIG_AT_FRAME_BUFFER_CAPACITY) {
+      // frames not acked by pull are never evicted. the rest wait in the ring as if there were no subscribers
+      if (atomic_load(&rest->subscribers_length) == 0) {
+        break;
+      }
+      if (rest->pull_attached && rest->pull_id == rest->pending_id) {
+        if (esp_timer_get_time() - rest->pull_active_micros < CONFIG_AT_REST_PULL_IDLE_TIMEOUT * 1000LL) {
+          break;
+        }
+        // the next pull starts from the oldest buffered frame
+        ESP_LOGI(TAG, "pull is idle. frames are not kept for it anymore");
+        rest->pull_attached = false;
+      }
+      // stream shouldn't stop if somebody is slow. subscribers that haven't sent the oldest frame yet will see the overflow
+      at_rest_pending_evict(rest);
+    }
+    if (at_util_ring_pop((void **) &cur_frame, rest->frames) != ESP_OK) {
+      break;
+    }
+    rest->pending[(rest->pending_first + rest->pending_length) % CONFIG_AT_FRAME_BUFFER_CAPACITY] = cur_frame;
+    rest->pending_length++;
+  }
+}
+
+// frame is copied into the scratch, so it can be sent without the lock. false if the frame was already removed
+static bool at_rest_pending_copy(uint32_t id, at_rest_scratch_t *scratch, uint32_t *first_id) {
+  at_rest *rest = scratch->rest;
+  bool found = false;
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  *first_id = rest->pending_id;
+  if (id - rest->pending_id < rest->pending_length) {
+    sx127x_frame_t *cur_frame = rest->pending[(rest->pending_first + id - rest->pending_id) % CONFIG_AT_FRAME_BUFFER_CAPACITY];
+    scratch->frame = *cur_frame;
+    memcpy(scratch->message, cur_frame->data, cur_frame->data_length);
+    scratch->frame.data = scratch->message;
+    // the same frame might be returned several times
+    if (cur_frame->interrupt_micros != 0) {
+      at_perf_record(AT_PERF_ISR_TO_REST, cur_frame->interrupt_stamp);
+      cur_frame->interrupt_micros = 0;
+    }
+    found = true;
+  }
+  xSemaphoreGive(rest->lock);
+  return found;
+}
+
+static esp_err_t at_rest_socket_send(const char *data, size_t length, at_rest_scratch_t *scratch) {
+  while (length > 0) {
+    int sent = httpd_socket_send(scratch->rest->server, scratch->stream_fd, data, length, scratch->stream_flags);
+    // socket buffer is full
+    if (sent == HTTPD_SOCK_ERR_TIMEOUT) {
+      return ESP_ERR_TIMEOUT;
+    }
+    if (sent <= 0) {
+      return ESP_FAIL;
+    }
+    data += sent;
+    length -= sent;
+  }
+  return ESP_OK;
+}
+
+// stream response was started in the handler. the rest is sent directly into the socket using chunked encoding
+static esp_err_t at_rest_stream_send_chunk(const char *data, size_t length, at_rest_scratch_t *scratch) {
+  char header[16];
+  int header_length = snprintf(header, sizeof(header), "%x\r\n", (unsigned int) length);
+  ERROR_CHECK_RETURN(at_rest_socket_send(header, header_length, scratch));
+  ERROR_CHECK_RETURN(at_rest_socket_send(data, length, scratch));
+  return at_rest_socket_send("\r\n", 2, scratch);
+}
+
+// long messages are split into fragments. the last one has final flag
+static esp_err_t at_rest_ws_send_fragment(bool final, at_rest_scratch_t *scratch) {
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+  // the same framing as httpd_ws_send_frame_async, but sent with stream_flags. server frames are not masked
+  uint8_t header[4];
+  size_t header_length = 2;
+  httpd_ws_type_t type = scratch->ws_fragments > 0 ? HTTPD_WS_TYPE_CONTINUE : (scratch->ws_binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT);
+  header[0] = (final ? 0x80 : 0) | type;
+  // chunk is shorter than 64k
+  if (scratch->chunk_length < 126) {
+    header[1] = scratch->chunk_length;
+  } else {
+    header[1] = 126;
+    header[2] = (scratch->chunk_length >> 8) & 0xFF;
+    header[3] = scratch->chunk_length & 0xFF;
+    header_length = 4;
+  }
+  scratch->ws_fragments = final ? 0 : scratch->ws_fragments + 1;
+  ERROR_CHECK_RETURN(at_rest_socket_send((const char *) header, header_length, scratch));
+  return at_rest_socket_send(scratch->chunk, scratch->chunk_length, scratch);
+#else
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static void at_rest_stream_begin(int fd, bool websocket, int flags, at_rest_scratch_t *scratch) {
+  scratch->stream_fd = fd;
+  scratch->stream_flags = flags;
+  scratch->stream_websocket = websocket;
+  scratch->ws_fragments = 0;
+  scratch->chunk_length = 0;
+}
+
+// req is NULL when frames are sent to the stream subscriber
+static esp_err_t at_rest_chunk_flush(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  if (scratch->chunk_length == 0) {
+    return ESP_OK;
+  }
+  esp_err_t code;
+  if (req != NULL) {
+    code = httpd_resp_send_chunk(req, scratch->chunk, scratch->chunk_length);
+  } else if (scratch->stream_websocket) {
+    code = at_rest_ws_send_fragment(false, scratch);
+  } else {
+    code = at_rest_stream_send_chunk(scratch->chunk, scratch->chunk_length, scratch);
+  }
+  scratch->chunk_length = 0;
+  if (code == ESP_OK) {
+    scratch->chunk_delivered = scratch->chunk_frames;
+  }
+  return code;
+}
+
+static esp_err_t at_rest_chunk_write(const char *str, size_t length, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  while (length > 0) {
+    if (scratch->chunk_length == CHUNK_LENGTH) {
+      ERROR_CHECK_RETURN(at_rest_chunk_flush(req, scratch));
+    }
+    size_t to_copy = CHUNK_LENGTH - scratch->chunk_length;
+    if (to_copy > length) {
+      to_copy = length;
+    }
+    memcpy(scratch->chunk + scratch->chunk_length, str, to_copy);
+    scratch->chunk_length += to_copy;
+    str += to_copy;
+    length -= to_copy;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t at_rest_chunk_printf(httpd_req_t *req, at_rest_scratch_t *scratch, const char *format, ...) {
+  // only short fields and numbers are formatted
+  char buffer[96];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0 || length >= sizeof(buffer)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  return at_rest_chunk_write(buffer, length, req, scratch);
+}
+
+static esp_err_t at_rest_chunk_hex(const uint8_t *data, size_t length, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  while (length > 0) {
+    size_t to_encode = (CHUNK_LENGTH - scratch->chunk_length) / 2;
+    if (to_encode == 0) {
+      ERROR_CHECK_RETURN(at_rest_chunk_flush(req, scratch));
+      continue;
+    }
+    if (to_encode > length) {
+      to_encode = length;
+    }
+    size_t encoded = 0;
+    ERROR_CHECK_RETURN(at_util_hex_encode(data, to_encode, scratch->chunk + scratch->chunk_length, sizeof(scratch->chunk) - scratch->chunk_length, false, '\0', &encoded));
+    scratch->chunk_length += encoded;
+    data += to_encode;
+    length -= to_encode;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t at_rest_chunk_frame(sx127x_frame_t *frame, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_chunk_printf(req, scratch, "{\"data\":\""));
+  ERROR_CHECK_RETURN(at_rest_chunk_hex(frame->data, frame->data_length, req, scratch));
+  ERROR_CHECK_RETURN(at_rest_chunk_printf(req, scratch, "\",\"rssi\":%d,\"snr\":%g,\"frequencyError\":%" PRId32, frame->rssi, frame->snr, frame->frequency_error));
+  ERROR_CHECK_RETURN(at_rest_chunk_printf(req, scratch, ",\"timestamp\":%" PRIu64 ",\"timestampMicros\":%" PRIu64, frame->timestamp, frame->timestamp_micros));
+  if (frame->channel >= 0) {
+    ERROR_CHECK_RETURN(at_rest_chunk_printf(req, scratch, ",\"channel\":%d", frame->channel));
+  }
+  return at_rest_chunk_printf(req, scratch, "}");
+}
+
+// payload is sent as byte string after the other fields
+static esp_err_t at_rest_chunk_cbor_frame(sx127x_frame_t *frame, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  uint8_t buffer[128];
+  at_cbor_writer_t writer;
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, (frame->channel >= 0 ? 7 : 6), &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("rssi", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_int(frame->rssi, &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("snr", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_float(frame->snr, &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("frequencyError", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_int(frame->frequency_error, &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("timestamp", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_uint(frame->timestamp, &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("timestampMicros", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_uint(frame->timestamp_micros, &writer));
+  if (frame->channel >= 0) {
+    ERROR_CHECK_RETURN(at_cbor_write_text("channel", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_uint(frame->channel, &writer));
+  }
+  ERROR_CHECK_RETURN(at_cbor_write_text("data", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_BYTES, frame->data_length, &writer));
+  ERROR_CHECK_RETURN(at_rest_chunk_write((const char *) buffer, writer.length, req, scratch));
+  return at_rest_chunk_write((const char *) frame->data, frame->data_length, req, scratch);
+}
+
+static esp_err_t at_rest_chunk_cbor_header(uint32_t frames, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  uint8_t buffer[32];
+  at_cbor_writer_t writer;
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, 4, &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("status", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("SUCCESS", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("frames", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_ARRAY, frames, &writer));
+  return at_rest_chunk_write((const char *) buffer, writer.length, req, scratch);
+}
+
+static esp_err_t at_rest_chunk_cbor_footer(uint32_t cursor, uint32_t remaining, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  uint8_t buffer[32];
+  at_cbor_writer_t writer;
+  at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+  ERROR_CHECK_RETURN(at_cbor_write_text("cursor", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_uint(cursor, &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_text("remaining", &writer));
+  ERROR_CHECK_RETURN(at_cbor_write_uint(remaining, &writer));
+  return at_rest_chunk_write((const char *) buffer, writer.length, req, scratch);
+}
+
+static esp_err_t at_rest_query_uint32(httpd_req_t *req, at_rest_scratch_t *scratch, const char *key, uint32_t *value, bool *found) {
+  *found = false;
+  size_t length = httpd_req_get_url_query_len(req);
+  if (length == 0) {
+    return ESP_OK;
+  }
+  if (length >= sizeof(scratch->temp_buffer)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  ERROR_CHECK_RETURN(httpd_req_get_url_query_str(req, scratch->temp_buffer, sizeof(scratch->temp_buffer)));
+  char str[16];
+  if (httpd_query_key_value(scratch->temp_buffer, key, str, sizeof(str)) != ESP_OK) {
+    return ESP_OK;
+  }
+  char *end = NULL;
+  unsigned long result = strtoul(str, &end, 10);
+  if (str[0] < '0' || str[0] > '9' || *end != '\0' || result > UINT32_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *value = result;
+  *found = true;
+  return ESP_OK;
+}
+
+static esp_err_t at_rest_send_frames(uint32_t limit, uint32_t cursor, bool with_cursor, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  at_rest *rest = scratch->rest;
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  if (!rest->pull_attached) {
+    rest->pull_attached = true;
+    rest->pull_id = rest->pending_id;
+  }
+  rest->pull_active_micros = esp_timer_get_time();
+  uint32_t end_id = rest->pending_id + rest->pending_length;
+  if (with_cursor) {
+    // cursor from before restart or from the future. nothing can be acked safely
+    if (cursor - rest->pull_id > end_id - rest->pull_id) {
+      ESP_LOGI(TAG, "unknown cursor %" PRIu32 ", expected %" PRIu32 " - %" PRIu32, cursor, rest->pull_id, end_id);
+    } else {
+      rest->pull_id = cursor;
+    }
+  }
+  at_rest_pending_fill(rest);
+  // frames from pull_id are not evicted until pull acks them
+  uint32_t first_id = rest->pull_id;
+  uint32_t available = rest->pending_id + rest->pending_length - first_id;
+  uint32_t length = (available < limit ? available : limit);
+  xSemaphoreGive(rest->lock);
+
+  bool cbor = at_rest_accepts_cbor(req);
+  scratch->chunk_length = 0;
+  scratch->chunk_frames = 0;
+  scratch->chunk_delivered = 0;
+  esp_err_t code = httpd_resp_set_type(req, (cbor ? AT_REST_CBOR : "application/json"));
+  if (code == ESP_OK) {
+    if (cbor) {
+      code = at_rest_chunk_cbor_header(length, req, scratch);
+    } else {
+      code = at_rest_chunk_printf(req, scratch, "{\"status\":\"SUCCESS\",\"frames\":[");
+    }
+  }
+  for (uint32_t i = 0; code == ESP_OK && i < length; i++) {
+    uint32_t pending_id = 0;
+    // frames are acked only by pulls, so they can't be removed in the meantime
+    if (!at_rest_pending_copy(first_id + i, scratch, &pending_id)) {
+      code = ESP_ERR_INVALID_STATE;
+      break;
+    }
+    if (cbor) {
+      code = at_rest_chunk_cbor_frame(&scratch->frame, req, scratch);
+    } else {
+      if (i != 0) {
+        code = at_rest_chunk_printf(req, scratch, ",");
+      }
+      if (code == ESP_OK) {
+        code = at_rest_chunk_frame(&scratch->frame, req, scratch);
+      }
+    }
+    if (code != ESP_OK) {
+      break;
+    }
+    scratch->chunk_frames++;
+  }
+  if (code == ESP_OK) {
+    xSemaphoreTake(rest->lock, portMAX_DELAY);
+    uint32_t remaining = rest->pending_id + rest->pending_length - (first_id + scratch->chunk_frames) + at_util_ring_size(rest->frames);
+    xSemaphoreGive(rest->lock);
+    if (cbor) {
+      code = at_rest_chunk_cbor_footer(first_id + scratch->chunk_frames, remaining, req, scratch);
+    } else {
+      code = at_rest_chunk_printf(req, scratch, "],\"cursor\":%" PRIu32 ",\"remaining\":%" PRIu32 "}", first_id + scratch->chunk_frames, remaining);
+    }
+  }
+  if (code == ESP_OK) {
+    code = at_rest_chunk_flush(req, scratch);
+  }
+  if (code == ESP_OK) {
+    code = httpd_resp_send_chunk(req, NULL, 0);
+  }
   if (code != ESP_OK) {
-    return code;
+    ESP_LOGE(TAG, "unable to send frames: %d. delivered %" PRIu32 " out of %" PRIu32, code, scratch->chunk_delivered, scratch->chunk_frames);
+  }
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  // slow response doesn't make pull idle
+  rest->pull_active_micros = esp_timer_get_time();
+  // connection might drop in the middle. keep frames that were not sent for the next request
+  if (!with_cursor) {
+    rest->pull_id = first_id + scratch->chunk_delivered;
+    at_rest_pending_trim(rest);
+  }
+  xSemaphoreGive(rest->lock);
+  return code;
+}
+
+// without cursor frames are removed once the chunk with them was sent.
+// with cursor frames stay until the next request with the returned cursor
+static esp_err_t at_rest_rx_pull(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  at_rest *rest = scratch->rest;
+  uint32_t limit = UINT32_MAX;
+  uint32_t cursor = 0;
+  bool found = false;
+  bool with_cursor = false;
+  if (at_rest_query_uint32(req, scratch, "limit", &limit, &found) != ESP_OK || (found && limit == 0)) {
+    return at_rest_respond("FAILURE", "invalid limit", req);
   }
+  if (at_rest_query_uint32(req, scratch, "cursor", &cursor, &with_cursor) != ESP_OK) {
+    return at_rest_respond("FAILURE", "invalid cursor", req);
+  }
+  // parallel pulls without cursor would return the same frames
+  xSemaphoreTake(rest->pull_lock, portMAX_DELAY);
+  esp_err_t code = at_rest_send_frames(limit, cursor, with_cursor, req, scratch);
+  xSemaphoreGive(rest->pull_lock);
+  return code;
+}
+
+static void at_rest_stream_work(void *arg);
+
+static void at_rest_stream_schedule(at_rest *rest) {
+  // one queued work sends all frames received so far
+  if (atomic_exchange(&rest->stream_queued, true)) {
+    return;
+  }
+  if (httpd_queue_work(rest->server, at_rest_stream_work, rest) != ESP_OK) {
+    atomic_store(&rest->stream_queued, false);
+  }
+}
+
+static void at_rest_stream_drop(at_rest_subscriber_t *subscriber, at_rest *rest) {
+  subscriber->active = false;
+  atomic_fetch_sub(&rest->subscribers_length, 1);
+  httpd_sess_trigger_close(rest->server, subscriber->fd);
+}
+
+static esp_err_t at_rest_ws_message_end(at_rest_scratch_t *scratch) {
+  esp_err_t code = at_rest_ws_send_fragment(true, scratch);
+  scratch->chunk_length = 0;
+  return code;
+}
+
+static esp_err_t at_rest_sse_send_frames(at_rest_subscriber_t *subscriber, uint32_t end_id, at_rest_scratch_t *scratch) {
+  while ((int32_t) (end_id - subscriber->cursor) > 0) {
+    uint32_t pending_id = 0;
+    // frames were evicted before they were sent: the buffer overflowed
+    if (!at_rest_pending_copy(subscriber->cursor, scratch, &pending_id)) {
+      uint32_t lost = pending_id - subscriber->cursor;
+      ESP_LOGI(TAG, "subscriber %d is too slow. lost frames: %" PRIu32, subscriber->fd, lost);
+      if (at_rest_chunk_printf(NULL, scratch, "event: overflow\ndata: {\"lost\":%" PRIu32 "}\n\n", lost) == ESP_OK && at_rest_chunk_flush(NULL, scratch) == ESP_OK) {
+        at_rest_socket_send("0\r\n\r\n", 5, scratch);
+      }
+      return ESP_ERR_INVALID_STATE;
+    }
+    ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "id: %" PRIu32 "\ndata: ", subscriber->cursor));
+    ERROR_CHECK_RETURN(at_rest_chunk_frame(&scratch->frame, NULL, scratch));
+    ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "\n\n"));
+    subscriber->cursor++;
+  }
+  return at_rest_chunk_flush(NULL, scratch);
+}
+
+// every frame is a separate message
+static esp_err_t at_rest_ws_send_frames(at_rest_subscriber_t *subscriber, uint32_t end_id, at_rest_scratch_t *scratch) {
+  scratch->ws_binary = subscriber->cbor;
+  while ((int32_t) (end_id - subscriber->cursor) > 0) {
+    uint32_t pending_id = 0;
+    // the connection is used for requests as well, so it is not closed. lost frames are skipped
+    if (!at_rest_pending_copy(subscriber->cursor, scratch, &pending_id)) {
+      uint32_t lost = pending_id - subscriber->cursor;
+      ESP_LOGI(TAG, "subscriber %d is too slow. lost frames: %" PRIu32, subscriber->fd, lost);
+      if (subscriber->cbor) {
+        uint8_t buffer[16];
+        at_cbor_writer_t writer;
+        at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+        ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, 1, &writer));
+        ERROR_CHECK_RETURN(at_cbor_write_text("lost", &writer));
+        ERROR_CHECK_RETURN(at_cbor_write_uint(lost, &writer));
+        ERROR_CHECK_RETURN(at_rest_chunk_write((const char *) buffer, writer.length, NULL, scratch));
+      } else {
+        ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "{\"lost\":%" PRIu32 "}", lost));
+      }
+      ERROR_CHECK_RETURN(at_rest_ws_message_end(scratch));
+      subscriber->cursor = pending_id;
+      continue;
+    }
+    if (subscriber->cbor) {
+      uint8_t buffer[32];
+      at_cbor_writer_t writer;
+      at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+      ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, 2, &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_text("cursor", &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_uint(subscriber->cursor, &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_text("frame", &writer));
+      ERROR_CHECK_RETURN(at_rest_chunk_write((const char *) buffer, writer.length, NULL, scratch));
+      ERROR_CHECK_RETURN(at_rest_chunk_cbor_frame(&scratch->frame, NULL, scratch));
+    } else {
+      ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "{\"cursor\":%" PRIu32 ",\"frame\":", subscriber->cursor));
+      ERROR_CHECK_RETURN(at_rest_chunk_frame(&scratch->frame, NULL, scratch));
+      ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "}"));
+    }
+    ERROR_CHECK_RETURN(at_rest_ws_message_end(scratch));
+    subscriber->cursor++;
+  }
+  return ESP_OK;
+}
+
+static void at_rest_stream_work(void *arg) {
+  at_rest *rest = (at_rest *) arg;
+  atomic_store(&rest->stream_queued, false);
+  // one block is reserved for the server task
+  at_rest_scratch_t *scratch = at_util_pool_acquire(&rest->scratch_pool);
+  if (scratch == NULL) {
+    ESP_LOGE(TAG, "no buffers to send frames");
+    return;
+  }
+  scratch->rest = rest;
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  at_rest_pending_fill(rest);
+  uint32_t end_id = rest->pending_id + rest->pending_length;
+  xSemaphoreGive(rest->lock);
+  for (size_t i = 0; i < CONFIG_AT_REST_STREAM_SUBSCRIBERS; i++) {
+    at_rest_subscriber_t *subscriber = &rest->subscribers[i];
+    if (!subscriber->active) {
+      continue;
+    }
+    at_rest_stream_begin(subscriber->fd, subscriber->websocket, MSG_DONTWAIT, scratch);
+    esp_err_t code;
+    if (subscriber->websocket) {
+      code = at_rest_ws_send_frames(subscriber, end_id, scratch);
+    } else {
+      code = at_rest_sse_send_frames(subscriber, end_id, scratch);
+    }
+    if (code == ESP_ERR_TIMEOUT) {
+      ESP_LOGI(TAG, "subscriber %d doesn't read frames", subscriber->fd);
+    } else if (code != ESP_OK) {
+      ESP_LOGI(TAG, "unable to send frames to subscriber %d: %d", subscriber->fd, code);
+    }
+    if (code != ESP_OK) {
+      at_rest_stream_drop(subscriber, rest);
+    }
+  }
+  // frames sent to every subscriber can be removed
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  at_rest_pending_trim(rest);
+  xSemaphoreGive(rest->lock);
+  at_util_pool_release(scratch, &rest->scratch_pool);
+}
+
+static at_rest_subscriber_t *at_rest_subscriber_find_free(at_rest *rest) {
+  for (size_t i = 0; i < CONFIG_AT_REST_STREAM_SUBSCRIBERS; i++) {
+    if (!rest->subscribers[i].active) {
+      return &rest->subscribers[i];
+    }
+  }
+  return NULL;
+}
+
+static void at_rest_subscribe(at_rest_subscriber_t *subscriber, httpd_req_t *req, uint32_t cursor, bool websocket, at_rest *rest) {
+  subscriber->fd = httpd_req_to_sockfd(req);
+  subscriber->websocket = websocket;
+  subscriber->cbor = at_rest_accepts_cbor(req);
+  // cursor and active are read by trim in other tasks
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  subscriber->cursor = cursor;
+  subscriber->active = true;
+  xSemaphoreGive(rest->lock);
+  atomic_fetch_add(&rest->subscribers_length, 1);
+  at_rest_stream_schedule(rest);
+}
+
+// the first frame to send. all buffered frames if cursor is unknown
+static esp_err_t at_rest_stream_cursor(httpd_req_t *req, at_rest_scratch_t *scratch, uint32_t *result) {
+  at_rest *rest = scratch->rest;
+  uint32_t cursor = 0;
+  bool found = false;
+  ERROR_CHECK_RETURN(at_rest_query_uint32(req, scratch, "cursor", &cursor, &found));
+  // EventSource sends id of the last received event on reconnect
+  char last_id[16];
+  if (!found && httpd_req_get_hdr_value_str(req, "Last-Event-ID", last_id, sizeof(last_id)) == ESP_OK) {
+    char *end = NULL;
+    cursor = strtoul(last_id, &end, 10) + 1;
+    found = (end != last_id && *end == '\0');
+  }
+  xSemaphoreTake(rest->lock, portMAX_DELAY);
+  at_rest_pending_fill(rest);
+  if (!found || cursor - rest->pending_id > rest->pending_length) {
+    cursor = rest->pending_id;
+  }
+  xSemaphoreGive(rest->lock);
+  *result = cursor;
+  return ESP_OK;
+}
+
+// server-sent events. frames are sent as soon as they are received until the client disconnects
+static esp_err_t at_rest_rx_stream(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  at_rest *rest = scratch->rest;
+  at_rest_subscriber_t *subscriber = at_rest_subscriber_find_free(rest);
+  if (subscriber == NULL) {
+    ERROR_CHECK_RETURN(httpd_resp_set_status(req, "503 Service Unavailable"));
+    return at_rest_respond("FAILURE", "too many subscribers", req);
+  }
+  uint32_t cursor = 0;
+  if (at_rest_stream_cursor(req, scratch, &cursor) != ESP_OK) {
+    return at_rest_respond("FAILURE", "invalid cursor", req);
+  }
+  ERROR_CHECK_RETURN(httpd_resp_set_type(req, "text/event-stream"));
+  ERROR_CHECK_RETURN(httpd_resp_set_hdr(req, "Cache-Control", "no-cache"));
+  // sends headers. the response is never finished
+  ERROR_CHECK_RETURN(httpd_resp_send_chunk(req, ": connected\n\n", HTTPD_RESP_USE_STRLEN));
+  // frames are sent as json even if cbor is accepted
+  at_rest_subscribe(subscriber, req, cursor, false, rest);
+  return ESP_OK;
+}
+
+static void at_rest_close_fn(httpd_handle_t server, int sockfd) {
+  at_rest *rest = (at_rest *) httpd_get_global_user_ctx(server);
+  for (size_t i = 0; i < CONFIG_AT_REST_STREAM_SUBSCRIBERS; i++) {
+    if (rest->subscribers[i].active && rest->subscribers[i].fd == sockfd) {
+      rest->subscribers[i].active = false;
+      atomic_fetch_sub(&rest->subscribers_length, 1);
+    }
+  }
+  close(sockfd);
+}
+
+static void at_rest_free_ctx(void *ctx) {
+  // at_rest is freed in at_rest_destroy
+}
+
+static esp_err_t at_rest_perf(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  at_perf_stats_t stats;
+  if (at_perf_get_stats(AT_PERF_DIO_ISR, &stats) == ESP_ERR_NOT_SUPPORTED) {
+    return at_rest_respond("FAILURE", "performance tracing is disabled", req);
+  }
+  ERROR_CHECK_RETURN(httpd_resp_set_type(req, "application/json"));
+  double cycles_per_micro = at_perf_cycles_per_micro();
   cJSON *root = cJSON_CreateObject();
   cJSON_AddStringToObject(root, "status", "SUCCESS");
-  at_rest *rest = (at_rest *) req->user_ctx;
-  cJSON *frames = cJSON_AddArrayToObject(root, "frames");
-  for (size_t i = 0; i < at_util_vector_size(rest->frames); i++) {
-    sx127x_frame_t *cur_frame = NULL;
-    at_util_vector_get(i, (void *) &cur_frame, rest->frames);
-    code = at_util_hex2string(cur_frame->data, cur_frame->data_length, rest->temp_buffer);
-    if (code != ESP_OK) {
-      ESP_LOGE(TAG, "unable to serialize string");
-      sx127x_util_frame_destroy(cur_frame);
+  cJSON_AddNumberToObject(root, "cyclesPerMicro", cycles_per_micro);
+  cJSON *points = cJSON_AddArrayToObject(root, "points");
+  for (int i = 0; i < AT_PERF_POINTS_LENGTH; i++) {
+    at_perf_get_stats(i, &stats);
+    cJSON *cur_item = cJSON_CreateObject();
+    cJSON_AddStringToObject(cur_item, "name", at_perf_point_name(i));
+    cJSON_AddNumberToObject(cur_item, "count", stats.count);
+    cJSON_AddNumberToObject(cur_item, "crossCore", stats.cross_core);
+    cJSON_AddNumberToObject(cur_item, "minMicros", stats.min_cycles / cycles_per_micro);
+    cJSON_AddNumberToObject(cur_item, "avgMicros", (stats.count == 0 ? 0.0 : stats.total_cycles / cycles_per_micro / stats.count));
+    cJSON_AddNumberToObject(cur_item, "maxMicros", stats.max_cycles / cycles_per_micro);
+    cJSON_AddItemToArray(points, cur_item);
+  }
+  cJSON *events = cJSON_AddArrayToObject(root, "events");
+  at_perf_event_t recent[16];
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+    size_t length = 0;
+    if (at_perf_get_events(core, recent, sizeof(recent) / sizeof(recent[0]), &length) != ESP_OK) {
       continue;
     }
-    cJSON *cur_item = cJSON_CreateObject();
-    cJSON_AddStringToObject(cur_item, "data", rest->temp_buffer);
-    cJSON_AddNumberToObject(cur_item, "rssi", cur_frame->rssi);
-    cJSON_AddNumberToObject(cur_item, "snr", cur_frame->snr);
-    cJSON_AddNumberToObject(cur_item, "frequencyError", cur_frame->frequency_error);
-    cJSON_AddNumberToObject(cur_item, "timestamp", cur_frame->timestamp);
-    cJSON_AddItemToArray(frames, cur_item);
-    sx127x_util_frame_destroy(cur_frame);
+    for (size_t i = 0; i < length; i++) {
+      cJSON *cur_item = cJSON_CreateObject();
+      cJSON_AddStringToObject(cur_item, "name", at_perf_point_name(recent[i].point));
+      cJSON_AddNumberToObject(cur_item, "core", core);
+      cJSON_AddNumberToObject(cur_item, "endCycles", recent[i].end_cycles);
+      cJSON_AddNumberToObject(cur_item, "micros", recent[i].cycles / cycles_per_micro);
+      cJSON_AddItemToArray(events, cur_item);
+    }
   }
-  at_util_vector_clear(rest->frames);
-  const char *response = cJSON_Print(root);
-  code = httpd_resp_sendstr(req, response);
+  const char *response = cJSON_PrintUnformatted(root);
+  esp_err_t code = httpd_resp_sendstr(req, response);
   free((void *) response);
   cJSON_Delete(root);
   return code;
 }
 
-static esp_err_t at_rest_rx_stop(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
-  esp_err_t code = at_rest_rx_pull(req);
-  if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "Unable to handle", req);
+typedef struct {
+  const char *type;
+  const at_cbor_field_t *fields;
+  size_t fields_length;
+  // byte strings are decoded into buffers of the scratch
+  void (*init)(at_rest_radio_request_t *request, at_rest_scratch_t *scratch);
+  // returns failure message or NULL
+  const char *(*execute)(at_rest_radio_request_t *request, at_rest *rest);
+} at_rest_operation_t;
+
+static void at_rest_lora_tx_init(at_rest_radio_request_t *request, at_rest_scratch_t *scratch) {
+  request->lora.data = (at_cbor_bytes_t) {.data = scratch->message, .capacity = SX127X_UTIL_MAX_PACKET_LENGTH};
+}
+
+static void at_rest_fsk_rx_init(at_rest_radio_request_t *request, at_rest_scratch_t *scratch) {
+  request->fsk.syncword = (at_cbor_bytes_t) {.data = scratch->syncword, .capacity = sizeof(scratch->syncword)};
+}
+
+static void at_rest_fsk_tx_init(at_rest_radio_request_t *request, at_rest_scratch_t *scratch) {
+  at_rest_fsk_rx_init(request, scratch);
+  request->fsk.data = (at_cbor_bytes_t) {.data = scratch->message, .capacity = sizeof(scratch->message)};
+}
+
+static const char *at_rest_lora_tx_execute(at_rest_radio_request_t *request, at_rest *rest) {
+  if (sx127x_util_scan_stop(rest->scan) != ESP_OK) {
+    return "unable to stop scan";
   }
-  at_rest *rest = (at_rest *) req->user_ctx;
-  code = sx127x_util_stop_rx(rest->device);
-  if (code != ESP_OK) {
-    ESP_LOGE(TAG, "unable to stop rx: %d", code);
+  if (sx127x_util_lora_tx(request->lora.data.data, request->lora.data.length, &request->lora.config, rest->device) != ESP_OK) {
+    return "unable to start tx";
   }
-  return ESP_OK;
+  return NULL;
 }
 
-static void at_rest_read_request(lora_config_t *lora_req, cJSON *root) {
-  lora_req->freq = (uint64_t) cJSON_GetObjectItem(root, "freq")->valuedouble;
-  lora_req->bw = (uint32_t) cJSON_GetObjectItem(root, "bw")->valuedouble;
-  lora_req->sf = (uint8_t) cJSON_GetObjectItem(root, "sf")->valueint;
-  lora_req->cr = (uint8_t) cJSON_GetObjectItem(root, "cr")->valueint;
-  lora_req->syncWord = (uint8_t) cJSON_GetObjectItem(root, "syncWord")->valueint;
-  lora_req->preambleLength = (uint16_t) cJSON_GetObjectItem(root, "preambleLength")->valueint;
-  lora_req->ldo = (uint8_t) cJSON_GetObjectItem(root, "ldo")->valueint;
-  lora_req->useCrc = (uint8_t) cJSON_GetObjectItem(root, "useCrc")->valueint;
-  lora_req->useExplicitHeader = (uint8_t) cJSON_GetObjectItem(root, "useExplicitHeader")->valueint;
-  lora_req->length = (uint8_t) cJSON_GetObjectItem(root, "length")->valueint;
-  // rx params
-  if (cJSON_HasObjectItem(root, "gain")) {
-    lora_req->gain = (uint8_t) cJSON_GetObjectItem(root, "gain")->valueint;
+static const char *at_rest_lora_rx_start_execute(at_rest_radio_request_t *request, at_rest *rest) {
+  if (sx127x_util_scan_stop(rest->scan) != ESP_OK) {
+    return "unable to stop scan";
   }
-  // tx params
-  if (cJSON_HasObjectItem(root, "power")) {
-    lora_req->power = (int8_t) cJSON_GetObjectItem(root, "power")->valueint;
+  if (sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &request->lora.config, rest->device) != ESP_OK) {
+    return "unable to rx";
   }
-  if (cJSON_HasObjectItem(root, "ocp")) {
-    lora_req->ocp = (int16_t) cJSON_GetObjectItem(root, "ocp")->valueint;
+  return NULL;
+}
+
+static const char *at_rest_fsk_tx_execute(at_rest_radio_request_t *request, at_rest *rest) {
+  request->fsk.config.syncword = request->fsk.syncword.data;
+  request->fsk.config.syncword_length = (uint8_t) request->fsk.syncword.length;
+  if (sx127x_util_scan_stop(rest->scan) != ESP_OK) {
+    return "unable to stop scan";
   }
-  if (cJSON_HasObjectItem(root, "pin")) {
-    lora_req->pin = (uint8_t) cJSON_GetObjectItem(root, "pin")->valueint;
+  if (sx127x_util_fsk_tx(request->fsk.data.data, request->fsk.data.length, &request->fsk.config, rest->device) != ESP_OK) {
+    return "unable to start tx";
   }
+  return NULL;
 }
 
-static void at_rest_read_fsk_request(fsk_config_t *fsk_req, cJSON *root, uint8_t *syncword) {
-  fsk_req->freq = (uint64_t) cJSON_GetObjectItem(root, "freq")->valuedouble;
-  fsk_req->bitrate = (uint32_t) cJSON_GetObjectItem(root, "bitrate")->valuedouble;
-  fsk_req->freq_deviation = (uint32_t) cJSON_GetObjectItem(root, "freqDeviation")->valuedouble;
-  fsk_req->preamble = (uint16_t) cJSON_GetObjectItem(root, "preamble")->valuedouble;
-  size_t syncword_length = 0;
-  at_util_string2hex(cJSON_GetObjectItem(root, "syncword")->valuestring, syncword, &syncword_length);
-  fsk_req->syncword = syncword;
-  fsk_req->syncword_length = (uint8_t) syncword_length;
-  fsk_req->encoding = (uint8_t) cJSON_GetObjectItem(root, "encoding")->valueint;
-  fsk_req->data_shaping = (uint8_t) cJSON_GetObjectItem(root, "dataShaping")->valueint;
-  fsk_req->crc = (uint8_t) cJSON_GetObjectItem(root, "crc")->valueint;
-  // rx
-  if (cJSON_HasObjectItem(root, "rxBandwidth")) {
-    fsk_req->rx_bandwidth = (uint32_t) cJSON_GetObjectItem(root, "rxBandwidth")->valueint;
+static const char *at_rest_fsk_rx_start_execute(at_rest_radio_request_t *request, at_rest *rest) {
+  request->fsk.config.syncword = request->fsk.syncword.data;
+  request->fsk.config.syncword_length = (uint8_t) request->fsk.syncword.length;
+  if (sx127x_util_scan_stop(rest->scan) != ESP_OK) {
+    return "unable to stop scan";
   }
-  if (cJSON_HasObjectItem(root, "rxAfcBandwidth")) {
-    fsk_req->rx_afc_bandwidth = (uint32_t) cJSON_GetObjectItem(root, "rxAfcBandwidth")->valueint;
+  if (sx127x_util_fsk_rx(&request->fsk.config, rest->device) != ESP_OK) {
+    return "unable to rx";
   }
-  // tx
-  if (cJSON_HasObjectItem(root, "power")) {
-    fsk_req->power = (int8_t) cJSON_GetObjectItem(root, "power")->valueint;
+  return NULL;
+}
+
+// received frames stay in the buffer
+static const char *at_rest_rx_stop_execute(at_rest_radio_request_t *request, at_rest *rest) {
+  esp_err_t code = sx127x_util_scan_stop(rest->scan);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to stop scan: %d", code);
   }
-  if (cJSON_HasObjectItem(root, "ocp")) {
-    fsk_req->ocp = (int16_t) cJSON_GetObjectItem(root, "ocp")->valueint;
+  code = sx127x_util_stop_rx(rest->device);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to stop rx: %d", code);
+  }
+  return NULL;
+}
+
+static const at_rest_operation_t LORA_TX_OPERATION = {"lora/tx", LORA_TX_FIELDS, FIELDS_LENGTH(LORA_TX_FIELDS), at_rest_lora_tx_init, at_rest_lora_tx_execute};
+static const at_rest_operation_t LORA_RX_START_OPERATION = {"lora/rx/start", LORA_RX_FIELDS, FIELDS_LENGTH(LORA_RX_FIELDS), NULL, at_rest_lora_rx_start_execute};
+static const at_rest_operation_t FSK_TX_OPERATION = {"fsk/tx", FSK_TX_FIELDS, FIELDS_LENGTH(FSK_TX_FIELDS), at_rest_fsk_tx_init, at_rest_fsk_tx_execute};
+static const at_rest_operation_t FSK_RX_START_OPERATION = {"fsk/rx/start", FSK_RX_FIELDS, FIELDS_LENGTH(FSK_RX_FIELDS), at_rest_fsk_rx_init, at_rest_fsk_rx_start_execute};
+static const at_rest_operation_t RX_STOP_OPERATION = {"rx/stop", NULL, 0, NULL, at_rest_rx_stop_execute};
+
+static const char *at_rest_operation_run(const at_rest_operation_t *operation, bool cbor, const cJSON *root, at_rest_scratch_t *scratch) {
+  at_rest_radio_request_t request;
+  memset(&request, 0, sizeof(request));
+  if (operation->init != NULL) {
+    operation->init(&request, scratch);
   }
-  if (cJSON_HasObjectItem(root, "pin")) {
-    fsk_req->pin = (uint8_t) cJSON_GetObjectItem(root, "pin")->valueint;
+  esp_err_t code = at_rest_decode_struct(cbor, root, operation->fields, operation->fields_length, &request, scratch);
+  if (code != ESP_OK) {
+    return at_rest_request_error_message(code);
   }
+  return operation->execute(&request, scratch->rest);
 }
 
-static esp_err_t at_rest_fsk_tx(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
-  esp_err_t code = at_rest_read_body(req);
+static esp_err_t at_rest_handle_operation(const at_rest_operation_t *operation, httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  esp_err_t code = at_rest_read_body(req, scratch);
   if (code != ESP_OK) {
-    return code;
-  }
-  at_rest *rest = (at_rest *) req->user_ctx;
-  cJSON *root = cJSON_Parse(rest->temp_buffer);
-  if (root == NULL) {
-    return at_rest_respond("FAILURE", "unable to parse request", req);
-  }
-  fsk_config_t fsk_req;
-  uint8_t syncword_hex[16];
-  at_rest_read_fsk_request(&fsk_req, root, syncword_hex);
-  size_t message_hex_length = 0;
-  uint8_t message_hex[255];
-  code = at_util_string2hex(cJSON_GetObjectItem(root, "data")->valuestring, message_hex, &message_hex_length);
+    return at_rest_respond_request_error(code, req);
+  }
+  bool cbor = at_rest_header_contains(req, "Content-Type", AT_REST_CBOR);
+  cJSON *root = cbor ? NULL : cJSON_Parse(scratch->temp_buffer);
+  const char *failure = at_rest_operation_run(operation, cbor, root, scratch);
   cJSON_Delete(root);
+  if (failure != NULL) {
+    return at_rest_respond("FAILURE", failure, req);
+  }
+  return at_rest_respond("SUCCESS", NULL, req);
+}
+
+static esp_err_t at_rest_fsk_tx(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  return at_rest_handle_operation(&FSK_TX_OPERATION, req, scratch);
+}
+
+static esp_err_t at_rest_fsk_rx_start(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  return at_rest_handle_operation(&FSK_RX_START_OPERATION, req, scratch);
+}
+
+static esp_err_t at_rest_lora_tx(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  return at_rest_handle_operation(&LORA_TX_OPERATION, req, scratch);
+}
+
+static esp_err_t at_rest_lora_rx_start(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  return at_rest_handle_operation(&LORA_RX_START_OPERATION, req, scratch);
+}
+
+static esp_err_t at_rest_rx_stop(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  esp_err_t code = at_rest_rx_pull(req, scratch);
   if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "unable to convert data to hex", req);
+    return at_rest_respond("FAILURE", "Unable to handle", req);
+  }
+  // rx/stop returns everything, so frames are not kept for pull anymore
+  xSemaphoreTake(scratch->rest->lock, portMAX_DELAY);
+  scratch->rest->pull_attached = false;
+  xSemaphoreGive(scratch->rest->lock);
+  at_rest_rx_stop_execute(NULL, scratch->rest);
+  return ESP_OK;
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+static const at_rest_operation_t *WS_OPERATIONS[] = {&LORA_TX_OPERATION, &LORA_RX_START_OPERATION, &FSK_TX_OPERATION, &FSK_RX_START_OPERATION, &RX_STOP_OPERATION};
+
+static esp_err_t at_rest_ws_respond(uint32_t id, const char *failure, bool status, bool cbor, at_rest_scratch_t *scratch) {
+  scratch->ws_binary = cbor;
+  const char *result = (failure == NULL ? "SUCCESS" : "FAILURE");
+  if (cbor) {
+    uint8_t buffer[128];
+    at_cbor_writer_t writer;
+    at_cbor_writer_init(buffer, sizeof(buffer), &writer);
+    ERROR_CHECK_RETURN(at_cbor_write_head(AT_CBOR_MAJOR_MAP, 2 + (failure != NULL ? 1 : 0) + (status ? 2 : 0), &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("id", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_uint(id, &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text("status", &writer));
+    ERROR_CHECK_RETURN(at_cbor_write_text(result, &writer));
+    if (failure != NULL) {
+      ERROR_CHECK_RETURN(at_cbor_write_text("failureMessage", &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_text(failure, &writer));
+    }
+    if (status) {
+      ERROR_CHECK_RETURN(at_cbor_write_text("minFreq", &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_uint(sx127x_util_get_min_frequency(), &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_text("maxFreq", &writer));
+      ERROR_CHECK_RETURN(at_cbor_write_uint(sx127x_util_get_max_frequency(), &writer));
+    }
+    ERROR_CHECK_RETURN(at_rest_chunk_write((const char *) buffer, writer.length, NULL, scratch));
+  } else {
+    ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "{\"id\":%" PRIu32 ",\"status\":\"%s\"", id, result));
+    if (failure != NULL) {
+      ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, ",\"failureMessage\":\"%s\"", failure));
+    }
+    if (status) {
+      ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, ",\"minFreq\":%" PRIu64 ",\"maxFreq\":%" PRIu64, sx127x_util_get_min_frequency(), sx127x_util_get_max_frequency()));
+    }
+    ERROR_CHECK_RETURN(at_rest_chunk_printf(NULL, scratch, "}"));
   }
-  code = sx127x_util_fsk_tx(message_hex, message_hex_length, &fsk_req, rest->device);
+  return at_rest_ws_message_end(scratch);
+}
+
+// requests and responses in one connection. text messages are JSON, binary are CBOR. received frames are pushed as well
+static esp_err_t at_rest_ws(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  at_rest *rest = scratch->rest;
+  // handshake is already sent. returning error closes the connection
+  if (req->method == HTTP_GET) {
+    if (!at_rest_is_authorized(req, scratch)) {
+      return ESP_FAIL;
+    }
+    at_rest_subscriber_t *subscriber = at_rest_subscriber_find_free(rest);
+    if (subscriber == NULL) {
+      ESP_LOGI(TAG, "too many subscribers");
+      return ESP_FAIL;
+    }
+    uint32_t cursor = 0;
+    ERROR_CHECK_RETURN(at_rest_stream_cursor(req, scratch, &cursor));
+    at_rest_subscribe(subscriber, req, cursor, true, rest);
+    return ESP_OK;
+  }
+  httpd_ws_frame_t frame = {0};
+  ERROR_CHECK_RETURN(httpd_ws_recv_frame(req, &frame, 0));
+  // 1 is for \0
+  if (frame.len >= TEMP_BUFFER_LENGTH) {
+    ESP_LOGI(TAG, "message is too long: %zu", frame.len);
+    return ESP_FAIL;
+  }
+  frame.payload = (uint8_t *) scratch->temp_buffer;
+  ERROR_CHECK_RETURN(httpd_ws_recv_frame(req, &frame, frame.len));
+  if (frame.type != HTTPD_WS_TYPE_TEXT && frame.type != HTTPD_WS_TYPE_BINARY) {
+    return ESP_OK;
+  }
+  scratch->temp_buffer[frame.len] = '\0';
+  scratch->body_length = frame.len;
+  bool cbor = (frame.type == HTTPD_WS_TYPE_BINARY);
+  cJSON *root = cbor ? NULL : cJSON_Parse(scratch->temp_buffer);
+  at_rest_ws_envelope_t envelope = {0};
+  const char *failure = NULL;
+  bool status = false;
+  esp_err_t code = at_rest_decode_struct(cbor, root, WS_ENVELOPE_FIELDS, FIELDS_LENGTH(WS_ENVELOPE_FIELDS), &envelope, scratch);
   if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "unable to start tx", req);
+    failure = at_rest_request_error_message(code);
+  } else if (strcmp(envelope.type, "status") == 0) {
+    status = true;
+  } else {
+    failure = "unknown type";
+    for (size_t i = 0; i < FIELDS_LENGTH(WS_OPERATIONS); i++) {
+      if (strcmp(envelope.type, WS_OPERATIONS[i]->type) == 0) {
+        failure = at_rest_operation_run(WS_OPERATIONS[i], cbor, root, scratch);
+        break;
+      }
+    }
   }
-  return at_rest_respond("SUCCESS", NULL, req);
+  cJSON_Delete(root);
+  // response is not dropped if the client is slow
+  at_rest_stream_begin(httpd_req_to_sockfd(req), true, 0, scratch);
+  return at_rest_ws_respond(envelope.id, failure, status, cbor, scratch);
 }
+#endif
 
-static esp_err_t at_rest_fsk_rx_start(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
-  esp_err_t code = at_rest_read_body(req);
+static esp_err_t at_rest_lora_scan_start(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  at_rest *rest = scratch->rest;
+  at_rest_scan_request_t scan_req = {0};
+  esp_err_t code = at_rest_read_request(req, scratch, SCAN_FIELDS, FIELDS_LENGTH(SCAN_FIELDS), &scan_req);
   if (code != ESP_OK) {
-    return code;
+    return at_rest_respond_request_error(code, req);
   }
-  at_rest *rest = (at_rest *) req->user_ctx;
-  cJSON *root = cJSON_Parse(rest->temp_buffer);
-  if (root == NULL) {
-    return at_rest_respond("FAILURE", "unable to parse request", req);
+  if (scan_req.channels_length == 0) {
+    return at_rest_respond("FAILURE", "unexpected number of channels", req);
   }
-  fsk_config_t fsk_req;
-  uint8_t syncword_hex[16];
-  at_rest_read_fsk_request(&fsk_req, root, syncword_hex);
-  cJSON_Delete(root);
-  code = sx127x_util_fsk_rx(&fsk_req, rest->device);
+  code = sx127x_util_scan_start(scan_req.channels, (uint8_t) scan_req.channels_length, rest->scan);
   if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "unable to rx", req);
+    return at_rest_respond("FAILURE", "unable to scan", req);
   }
   return at_rest_respond("SUCCESS", NULL, req);
 }
 
-static esp_err_t at_rest_lora_tx(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
-  esp_err_t code = at_rest_read_body(req);
-  if (code != ESP_OK) {
-    return code;
-  }
-  at_rest *rest = (at_rest *) req->user_ctx;
-  cJSON *root = cJSON_Parse(rest->temp_buffer);
-  if (root == NULL) {
-    return at_rest_respond("FAILURE", "unable to parse request", req);
-  }
-  lora_config_t lora_req;
-  at_rest_read_request(&lora_req, root);
-  size_t message_hex_length = 0;
-  uint8_t message_hex[255];
-  code = at_util_string2hex(cJSON_GetObjectItem(root, "data")->valuestring, message_hex, &message_hex_length);
+static esp_err_t at_rest_lora_scan(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  ERROR_CHECK_RETURN(httpd_resp_set_type(req, "application/json"));
+  at_rest *rest = scratch->rest;
+  cJSON *root = cJSON_CreateObject();
+  cJSON_AddStringToObject(root, "status", "SUCCESS");
+  cJSON_AddBoolToObject(root, "running", sx127x_util_scan_running(rest->scan));
+  cJSON *channels = cJSON_AddArrayToObject(root, "channels");
+  for (uint8_t i = 0; i < rest->scan->channels_length; i++) {
+    sx127x_util_scan_stats_t stats;
+    if (sx127x_util_scan_get_stats(i, &stats, rest->scan) != ESP_OK) {
+      break;
+    }
+    sx127x_util_scan_channel_t *channel = &rest->scan->channels[i];
+    cJSON *cur_item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(cur_item, "freq", channel->config.freq);
+    cJSON_AddNumberToObject(cur_item, "sf", channel->config.sf);
+    cJSON_AddNumberToObject(cur_item, "dwellMillis", channel->dwell_millis);
+    cJSON_AddNumberToObject(cur_item, "priority", channel->priority);
+    cJSON_AddNumberToObject(cur_item, "visits", stats.visits);
+    cJSON_AddNumberToObject(cur_item, "hits", stats.hits);
+    cJSON_AddNumberToObject(cur_item, "misses", stats.misses);
+    cJSON_AddNumberToObject(cur_item, "frames", stats.frames);
+    cJSON_AddItemToArray(channels, cur_item);
+  }
+  const char *response = cJSON_PrintUnformatted(root);
+  esp_err_t code = httpd_resp_sendstr(req, response);
+  free((void *) response);
   cJSON_Delete(root);
+  return code;
+}
+
+static esp_err_t at_rest_schedule_load(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  at_rest *rest = scratch->rest;
+  at_rest_schedule_request_t *schedule_req = &rest->schedule_request;
+  memset(schedule_req, 0, sizeof(at_rest_schedule_request_t));
+  esp_err_t code = at_rest_read_request(req, scratch, SCHEDULE_FIELDS, FIELDS_LENGTH(SCHEDULE_FIELDS), schedule_req);
   if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "unable to convert data to hex", req);
+    return at_rest_respond_request_error(code, req);
   }
-  code = sx127x_util_lora_tx(message_hex, message_hex_length, &lora_req, rest->device);
+  struct timeval tm_vl;
+  gettimeofday(&tm_vl, NULL);
+  uint64_t now_millis = (uint64_t) tm_vl.tv_sec * 1000 + tm_vl.tv_usec / 1000;
+  for (size_t i = 0; i < schedule_req->observations_length; i++) {
+    // clock is synchronized using sntp
+    schedule_req->observations[i].currentTimeMillis = now_millis;
+  }
+  code = at_schedule_load(schedule_req->observations, schedule_req->observations_length, rest->schedule);
   if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "unable to start tx", req);
+    return at_rest_respond("FAILURE", "unable to load schedule", req);
   }
   return at_rest_respond("SUCCESS", NULL, req);
 }
 
-static esp_err_t at_rest_lora_rx_start(httpd_req_t *req) {
-  ERROR_CHECK_RETURN(at_rest_authenticate(req));
-  esp_err_t code = at_rest_read_body(req);
+static esp_err_t at_rest_schedule(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  ERROR_CHECK_RETURN(httpd_resp_set_type(req, "application/json"));
+  at_rest *rest = scratch->rest;
+  cJSON *root = cJSON_CreateObject();
+  cJSON_AddStringToObject(root, "status", "SUCCESS");
+  cJSON_AddNumberToObject(root, "rejected", rest->schedule->rejected);
+  cJSON *observations = cJSON_AddArrayToObject(root, "observations");
+  lora_config_t cur;
+  for (uint8_t i = 0; at_schedule_get(i, &cur, rest->schedule) == ESP_OK; i++) {
+    cJSON *cur_item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(cur_item, "startTimeMillis", cur.startTimeMillis);
+    cJSON_AddNumberToObject(cur_item, "endTimeMillis", cur.endTimeMillis);
+    cJSON_AddNumberToObject(cur_item, "freq", cur.freq);
+    cJSON_AddNumberToObject(cur_item, "bw", cur.bw);
+    cJSON_AddNumberToObject(cur_item, "sf", cur.sf);
+    cJSON_AddItemToArray(observations, cur_item);
+  }
+  const char *response = cJSON_PrintUnformatted(root);
+  esp_err_t code = httpd_resp_sendstr(req, response);
+  free((void *) response);
+  cJSON_Delete(root);
+  return code;
+}
+
+static esp_err_t at_rest_journal(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  ERROR_CHECK_RETURN(httpd_resp_set_type(req, "application/json"));
+  at_rest *rest = scratch->rest;
+  size_t length = 0;
+  esp_err_t code = at_journal_peek(rest->journal_batch, JOURNAL_BATCH_LENGTH, &length, rest->journal);
   if (code != ESP_OK) {
-    return code;
+    return at_rest_respond("FAILURE", "unable to read journal", req);
   }
-  at_rest *rest = (at_rest *) req->user_ctx;
-  cJSON *root = cJSON_Parse(rest->temp_buffer);
-  if (root == NULL) {
-    return at_rest_respond("FAILURE", "unable to parse request", req);
+  cJSON *root = cJSON_CreateObject();
+  cJSON_AddStringToObject(root, "status", "SUCCESS");
+  cJSON_AddNumberToObject(root, "pending", at_journal_pending(rest->journal));
+  cJSON *frames = cJSON_AddArrayToObject(root, "frames");
+  for (size_t i = 0; i < length; i++) {
+    sx127x_frame_t *cur_frame = &rest->journal_batch[i].frame;
+    code = at_util_hex_encode(cur_frame->data, cur_frame->data_length, scratch->temp_buffer, sizeof(scratch->temp_buffer), false, '\0', NULL);
+    if (code != ESP_OK) {
+      ESP_LOGE(TAG, "unable to serialize string");
+      continue;
+    }
+    cJSON *cur_item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(cur_item, "sequence", rest->journal_batch[i].sequence);
+    cJSON_AddStringToObject(cur_item, "data", scratch->temp_buffer);
+    cJSON_AddNumberToObject(cur_item, "rssi", cur_frame->rssi);
+    cJSON_AddNumberToObject(cur_item, "snr", cur_frame->snr);
+    cJSON_AddNumberToObject(cur_item, "frequencyError", cur_frame->frequency_error);
+    cJSON_AddNumberToObject(cur_item, "timestamp", cur_frame->timestamp);
+    cJSON_AddNumberToObject(cur_item, "timestampMicros", cur_frame->timestamp_micros);
+    cJSON_AddItemToArray(frames, cur_item);
   }
-  lora_config_t lora_req;
-  at_rest_read_request(&lora_req, root);
+  const char *response = cJSON_PrintUnformatted(root);
+  code = httpd_resp_sendstr(req, response);
+  free((void *) response);
   cJSON_Delete(root);
-  code = sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &lora_req, rest->device);
+  return code;
+}
+
+static esp_err_t at_rest_journal_ack(httpd_req_t *req, at_rest_scratch_t *scratch) {
+  ERROR_CHECK_RETURN(at_rest_authenticate(req, scratch));
+  at_rest *rest = scratch->rest;
+  at_rest_ack_request_t ack_req = {0};
+  esp_err_t code = at_rest_read_request(req, scratch, ACK_FIELDS, FIELDS_LENGTH(ACK_FIELDS), &ack_req);
   if (code != ESP_OK) {
-    return at_rest_respond("FAILURE", "unable to rx", req);
+    return at_rest_respond_request_error(code, req);
+  }
+  code = at_journal_ack(ack_req.sequence, rest->journal);
+  if (code != ESP_OK) {
+    return at_rest_respond("FAILURE", "unable to ack", req);
   }
   return at_rest_respond("SUCCESS", NULL, req);
 }
 
+static const at_rest_route_t ROUTES[] = {
+    {.uri = "/api/v2/lora/rx/start", .method = HTTP_POST, .handler = at_rest_lora_rx_start, .async = true},
+    {.uri = "/api/v2/lora/tx", .method = HTTP_POST, .handler = at_rest_lora_tx, .async = true},
+    {.uri = "/api/v2/fsk/tx", .method = HTTP_POST, .handler = at_rest_fsk_tx, .async = true},
+    {.uri = "/api/v2/fsk/rx/start", .method = HTTP_POST, .handler = at_rest_fsk_rx_start, .async = true},
+    {.uri = "/api/v2/rx/stop", .method = HTTP_POST, .handler = at_rest_rx_stop, .async = true},
+    {.uri = "/api/v2/rx/pull", .method = HTTP_GET, .handler = at_rest_rx_pull, .async = true},
+    // subscribers are accessed only from the server task
+    {.uri = "/api/v2/rx/stream", .method = HTTP_GET, .handler = at_rest_rx_stream},
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    {.uri = "/api/v2/ws", .method = HTTP_GET, .handler = at_rest_ws, .websocket = true},
+#endif
+    {.uri = "/api/v2/status", .method = HTTP_GET, .handler = at_rest_status, .async = true},
+    {.uri = "/api/v2/perf", .method = HTTP_GET, .handler = at_rest_perf, .async = true},
+    {.uri = "/api/v2/lora/scan/start", .method = HTTP_POST, .handler = at_rest_lora_scan_start, .async = true},
+    {.uri = "/api/v2/lora/scan", .method = HTTP_GET, .handler = at_rest_lora_scan, .async = true},
+    {.uri = "/api/v2/schedule", .method = HTTP_POST, .handler = at_rest_schedule_load, .async = true, .exclusive = true},
+    {.uri = "/api/v2/schedule", .method = HTTP_GET, .handler = at_rest_schedule, .async = true},
+    {.uri = "/api/v2/journal", .method = HTTP_GET, .handler = at_rest_journal, .async = true, .exclusive = true},
+    {.uri = "/api/v2/journal/ack", .method = HTTP_POST, .handler = at_rest_journal_ack, .async = true}
+};
+
+static esp_err_t at_rest_handle(httpd_req_t *req, const at_rest_route_t *route, at_rest *rest) {
+  // every worker and the server task have their own block
+  at_rest_scratch_t *scratch = at_util_pool_acquire(&rest->scratch_pool);
+  if (scratch == NULL) {
+    ESP_LOGE(TAG, "no buffers for %s", route->uri);
+    return ESP_ERR_NO_MEM;
+  }
+  scratch->rest = rest;
+  if (route->exclusive) {
+    xSemaphoreTake(rest->exclusive_lock, portMAX_DELAY);
+  }
+  esp_err_t code = route->handler(req, scratch);
+  if (route->exclusive) {
+    xSemaphoreGive(rest->exclusive_lock);
+  }
+  at_util_pool_release(scratch, &rest->scratch_pool);
+  return code;
+}
+
+static esp_err_t at_rest_dispatch(httpd_req_t *req) {
+  at_rest_endpoint_t *endpoint = (at_rest_endpoint_t *) req->user_ctx;
+  at_rest *rest = endpoint->rest;
+  if (endpoint->route->async && rest->jobs != NULL) {
+    at_rest_job_t job = {.req = NULL, .route = endpoint->route};
+    if (httpd_req_async_handler_begin(req, &job.req) == ESP_OK) {
+      if (xQueueSend(rest->jobs, &job, 0) == pdTRUE) {
+        return ESP_OK;
+      }
+      httpd_req_async_handler_complete(job.req);
+    }
+    // all workers are busy. the request is handled in the server task
+  }
+  return at_rest_handle(req, endpoint->route, rest);
+}
+
+static void at_rest_worker(void *arg) {
+  at_rest *rest = (at_rest *) arg;
+  at_rest_job_t job;
+  while (1) {
+    if (xQueueReceive(rest->jobs, &job, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (job.req == NULL) {
+      break;
+    }
+    int sockfd = httpd_req_to_sockfd(job.req);
+    esp_err_t code = at_rest_handle(job.req, job.route, rest);
+    httpd_req_async_handler_complete(job.req);
+    // the same as returning error from the handler in the server task
+    if (code != ESP_OK) {
+      httpd_sess_trigger_close(rest->server, sockfd);
+    }
+  }
+  xSemaphoreGive(rest->workers_stopped);
+  vTaskDelete(NULL);
+}
+
 static esp_err_t at_rest_digest(const char *username, const char *password, char **result) {
   char *user_info = NULL;
   int rc = asprintf(&user_info, "%s:%s", username, password);
@@ -350,91 +1685,145 @@ static esp_err_t at_rest_digest(const char *username, const char *password, char
   return ESP_OK;
 }
 
-esp_err_t at_rest_create(sx127x_wrapper *device, at_rest **rest) {
-  struct at_rest_t *result = malloc(sizeof(struct at_rest_t));
+esp_err_t at_rest_create(sx127x_wrapper *device, sx127x_util_scan_t *scan, at_schedule_t *schedule, at_journal_t *journal, at_rest **rest) {
+  struct at_rest_t *result = calloc(1, sizeof(struct at_rest_t));
   if (result == NULL) {
     return ESP_ERR_NO_MEM;
   }
   result->device = device;
+  result->scan = scan;
+  result->schedule = schedule;
+  result->journal = journal;
   result->server = NULL;
   result->digest = NULL;
+  result->frames = NULL;
+  for (size_t i = 0; i < CONFIG_AT_REST_STREAM_SUBSCRIBERS; i++) {
+    result->subscribers[i].active = false;
+  }
+  atomic_init(&result->subscribers_length, 0);
+  atomic_init(&result->stream_queued, false);
+  result->pending_first = 0;
+  result->pending_length = 0;
+  // cursor from before restart shouldn't ack new frames
+  result->pending_id = esp_random();
+  result->pull_id = result->pending_id;
+  result->pull_attached = false;
+  result->pull_active_micros = 0;
 
-  ERROR_CHECK(at_util_vector_create(&result->frames));
+  result->lock = xSemaphoreCreateMutex();
+  result->pull_lock = xSemaphoreCreateMutex();
+  result->exclusive_lock = xSemaphoreCreateMutex();
+  result->scratch_arena = malloc(SCRATCH_BLOCK_SIZE * (CONFIG_AT_REST_WORKERS + 1));
+  result->endpoints = malloc(sizeof(at_rest_endpoint_t) * FIELDS_LENGTH(ROUTES));
+  if (result->lock == NULL || result->pull_lock == NULL || result->exclusive_lock == NULL || result->scratch_arena == NULL || result->endpoints == NULL) {
+    at_rest_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  ERROR_CHECK(at_util_pool_init(result->scratch_arena, SCRATCH_BLOCK_SIZE, CONFIG_AT_REST_WORKERS + 1, &result->scratch_pool));
+  ERROR_CHECK(at_util_ring_create(CONFIG_AT_FRAME_BUFFER_CAPACITY, AT_FRAME_BUFFER_POLICY, &result->frames));
   ERROR_CHECK(at_rest_digest(CONFIG_AT_API_USERNAME, CONFIG_AT_API_PASSWORD, &result->digest));
 
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
   config.uri_match_fn = httpd_uri_match_wildcard;
+  config.max_uri_handlers = 20;
+  // stream subscribers are removed when their connection is closed
+  config.global_user_ctx = result;
+  config.global_user_ctx_free_fn = at_rest_free_ctx;
+  config.close_fn = at_rest_close_fn;
 
   ESP_LOGI(TAG, "Starting HTTP Server");
   ERROR_CHECK(httpd_start(&result->server, &config));
 
-  httpd_uri_t lora_rx_start_uri = {
-      .uri = "/api/v2/lora/rx/start",
-      .method = HTTP_POST,
-      .handler = at_rest_lora_rx_start,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &lora_rx_start_uri));
-  httpd_uri_t lora_tx_uri = {
-      .uri = "/api/v2/lora/tx",
-      .method = HTTP_POST,
-      .handler = at_rest_lora_tx,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &lora_tx_uri));
-  httpd_uri_t fsk_tx_uri = {
-      .uri = "/api/v2/fsk/tx",
-      .method = HTTP_POST,
-      .handler = at_rest_fsk_tx,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &fsk_tx_uri));
-  httpd_uri_t fsk_rx_start_uri = {
-      .uri = "/api/v2/fsk/rx/start",
-      .method = HTTP_POST,
-      .handler = at_rest_fsk_rx_start,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &fsk_rx_start_uri));
-  httpd_uri_t rx_stop_uri = {
-      .uri = "/api/v2/rx/stop",
-      .method = HTTP_POST,
-      .handler = at_rest_rx_stop,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &rx_stop_uri));
-  httpd_uri_t rx_pull_uri = {
-      .uri = "/api/v2/rx/pull",
-      .method = HTTP_GET,
-      .handler = at_rest_rx_pull,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &rx_pull_uri));
-  httpd_uri_t status_uri = {
-      .uri = "/api/v2/status",
-      .method = HTTP_GET,
-      .handler = at_rest_status,
-      .user_ctx = result
-  };
-  ERROR_CHECK(httpd_register_uri_handler(result->server, &status_uri));
+  if (CONFIG_AT_REST_WORKERS > 0) {
+    result->jobs = xQueueCreate(CONFIG_AT_REST_WORKERS, sizeof(at_rest_job_t));
+    result->workers_stopped = xSemaphoreCreateCounting(CONFIG_AT_REST_WORKERS, 0);
+    if (result->jobs == NULL || result->workers_stopped == NULL) {
+      at_rest_destroy(result);
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  for (uint8_t i = 0; i < CONFIG_AT_REST_WORKERS; i++) {
+    BaseType_t task_code = xTaskCreatePinnedToCore(at_rest_worker, "rest worker", config.stack_size, result, config.task_priority, NULL, config.core_id);
+    if (task_code != pdPASS) {
+      ESP_LOGE(TAG, "can't create task %d", task_code);
+      at_rest_destroy(result);
+      return ESP_ERR_INVALID_STATE;
+    }
+    result->workers_length++;
+  }
+
+  for (size_t i = 0; i < FIELDS_LENGTH(ROUTES); i++) {
+    result->endpoints[i] = (at_rest_endpoint_t) {.rest = result, .route = &ROUTES[i]};
+    httpd_uri_t uri = {
+        .uri = ROUTES[i].uri,
+        .method = ROUTES[i].method,
+        .handler = at_rest_dispatch,
+        .user_ctx = &result->endpoints[i],
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        .is_websocket = ROUTES[i].websocket
+#endif
+    };
+    ERROR_CHECK(httpd_register_uri_handler(result->server, &uri));
+  }
 
   *rest = result;
   return ESP_OK;
 }
 
 esp_err_t at_rest_add_frame(sx127x_frame_t *frame, at_rest *handler) {
-  return at_util_vector_add(frame, handler->frames);
+  sx127x_frame_t *dropped = NULL;
+  esp_err_t code = at_util_ring_push(frame, (void **) &dropped, handler->frames);
+  sx127x_util_frame_destroy(dropped);
+  if (atomic_load(&handler->subscribers_length) > 0) {
+    at_rest_stream_schedule(handler);
+  }
+  return code;
 }
 
 void at_rest_destroy(at_rest *result) {
   if (result == NULL) {
     return;
   }
+  // requests in progress are finished before the server is stopped
+  for (uint8_t i = 0; i < result->workers_length; i++) {
+    at_rest_job_t job = {.req = NULL, .route = NULL};
+    xQueueSend(result->jobs, &job, portMAX_DELAY);
+  }
+  for (uint8_t i = 0; i < result->workers_length; i++) {
+    xSemaphoreTake(result->workers_stopped, portMAX_DELAY);
+  }
   if (result->server != NULL) {
     httpd_stop(result->server);
   }
+  if (result->jobs != NULL) {
+    vQueueDelete(result->jobs);
+  }
+  if (result->workers_stopped != NULL) {
+    vSemaphoreDelete(result->workers_stopped);
+  }
   if (result->digest != NULL) {
     free(result->digest);
   }
+  for (uint32_t i = 0; i < result->pending_length; i++) {
+    sx127x_util_frame_destroy(result->pending[(result->pending_first + i) % CONFIG_AT_FRAME_BUFFER_CAPACITY]);
+  }
+  if (result->frames != NULL) {
+    sx127x_frame_t *cur_frame = NULL;
+    while (at_util_ring_pop((void **) &cur_frame, result->frames) == ESP_OK) {
+      sx127x_util_frame_destroy(cur_frame);
+    }
+    at_util_ring_destroy(result->frames);
+  }
+  if (result->lock != NULL) {
+    vSemaphoreDelete(result->lock);
+  }
+  if (result->pull_lock != NULL) {
+    vSemaphoreDelete(result->pull_lock);
+  }
+  if (result->exclusive_lock != NULL) {
+    vSemaphoreDelete(result->exclusive_lock);
+  }
+  free(result->scratch_arena);
+  free(result->endpoints);
   free(result);
 }
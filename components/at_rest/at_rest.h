@@ -3,11 +3,15 @@
 
 #include <esp_err.h>
 #include <sx127x_util.h>
+#include <sx127x_util_scan.h>
+#include <at_schedule.h>
+#include <at_journal.h>
 
 typedef struct at_rest_t at_rest;
 
-esp_err_t at_rest_create(sx127x_wrapper *device, at_rest **result);
+esp_err_t at_rest_create(sx127x_wrapper *device, sx127x_util_scan_t *scan, at_schedule_t *schedule, at_journal_t *journal, at_rest **result);
 
+// should be called from one task only. frames are passed to the request handlers through a lock-free ring
 esp_err_t at_rest_add_frame(sx127x_frame_t *frame, at_rest *handler);
 
 void at_rest_destroy(at_rest *result);
@@ -0,0 +1,149 @@
+#include "at_schedule.h"
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+
+// table is shared between REST handlers and deep sleep scheduling
+static portMUX_TYPE at_schedule_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool at_schedule_convert(const lora_config_t *request, at_schedule_entry_t *entry) {
+  if (request->startTimeMillis > request->endTimeMillis || request->endTimeMillis - request->startTimeMillis > UINT32_MAX) {
+    return false;
+  }
+  // already finished according to the server's clock
+  if (request->currentTimeMillis != 0 && request->endTimeMillis <= request->currentTimeMillis) {
+    return false;
+  }
+  if (request->freq > UINT32_MAX) {
+    return false;
+  }
+  entry->start_millis = request->startTimeMillis;
+  entry->duration_millis = (uint32_t) (request->endTimeMillis - request->startTimeMillis);
+  entry->freq = (uint32_t) request->freq;
+  entry->bw = request->bw;
+  entry->preamble_length = request->preambleLength;
+  entry->ocp = request->ocp;
+  entry->sf = request->sf;
+  entry->cr = request->cr;
+  entry->sync_word = request->syncWord;
+  entry->power = request->power;
+  entry->gain = request->gain;
+  entry->ldo = request->ldo;
+  entry->use_crc = request->useCrc;
+  entry->use_explicit_header = request->useExplicitHeader;
+  entry->length = request->length;
+  entry->pin = request->pin;
+  return true;
+}
+
+static void at_schedule_to_request(const at_schedule_entry_t *entry, lora_config_t *request) {
+  *request = (lora_config_t) {0};
+  request->startTimeMillis = entry->start_millis;
+  request->endTimeMillis = entry->start_millis + entry->duration_millis;
+  request->freq = entry->freq;
+  request->bw = entry->bw;
+  request->preambleLength = entry->preamble_length;
+  request->ocp = entry->ocp;
+  request->sf = entry->sf;
+  request->cr = entry->cr;
+  request->syncWord = entry->sync_word;
+  request->power = entry->power;
+  request->gain = entry->gain;
+  request->ldo = entry->ldo;
+  request->useCrc = entry->use_crc;
+  request->useExplicitHeader = entry->use_explicit_header;
+  request->length = entry->length;
+  request->pin = entry->pin;
+}
+
+// should be called with lock taken
+static void at_schedule_remove(uint8_t count, at_schedule_t *schedule) {
+  if (count == 0) {
+    return;
+  }
+  schedule->length -= count;
+  memmove(schedule->entries, schedule->entries + count, sizeof(at_schedule_entry_t) * schedule->length);
+}
+
+// should be called with lock taken. keeps the earliest entries if table is full
+static void at_schedule_insert(const at_schedule_entry_t *entry, at_schedule_t *schedule) {
+  uint8_t index = schedule->length;
+  // entries with the same start time keep the server's order
+  while (index > 0 && schedule->entries[index - 1].start_millis > entry->start_millis) {
+    index--;
+  }
+  if (index >= CONFIG_AT_SCHEDULE_CAPACITY) {
+    schedule->rejected++;
+    return;
+  }
+  uint8_t moved = schedule->length - index;
+  if (schedule->length == CONFIG_AT_SCHEDULE_CAPACITY) {
+    // the latest entry doesn't fit anymore
+    moved--;
+    schedule->rejected++;
+  } else {
+    schedule->length++;
+  }
+  memmove(schedule->entries + index + 1, schedule->entries + index, sizeof(at_schedule_entry_t) * moved);
+  schedule->entries[index] = *entry;
+}
+
+esp_err_t at_schedule_load(const lora_config_t *requests, size_t requests_length, at_schedule_t *schedule) {
+  if (requests == NULL && requests_length != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  portENTER_CRITICAL(&at_schedule_lock);
+  schedule->length = 0;
+  schedule->rejected = 0;
+  for (size_t i = 0; i < requests_length; i++) {
+    at_schedule_entry_t entry;
+    if (!at_schedule_convert(&requests[i], &entry)) {
+      schedule->rejected++;
+      continue;
+    }
+    at_schedule_insert(&entry, schedule);
+  }
+  portEXIT_CRITICAL(&at_schedule_lock);
+  return ESP_OK;
+}
+
+esp_err_t at_schedule_next(uint64_t now_millis, lora_config_t *request, at_schedule_t *schedule) {
+  portENTER_CRITICAL(&at_schedule_lock);
+  uint8_t expired = 0;
+  while (expired < schedule->length && schedule->entries[expired].start_millis + schedule->entries[expired].duration_millis <= now_millis) {
+    expired++;
+  }
+  at_schedule_remove(expired, schedule);
+  if (schedule->length == 0) {
+    portEXIT_CRITICAL(&at_schedule_lock);
+    return ESP_ERR_NOT_FOUND;
+  }
+  at_schedule_to_request(&schedule->entries[0], request);
+  if (schedule->entries[0].start_millis <= now_millis) {
+    at_schedule_remove(1, schedule);
+  }
+  portEXIT_CRITICAL(&at_schedule_lock);
+  request->currentTimeMillis = now_millis;
+  return ESP_OK;
+}
+
+esp_err_t at_schedule_get(uint8_t index, lora_config_t *request, at_schedule_t *schedule) {
+  portENTER_CRITICAL(&at_schedule_lock);
+  if (index >= schedule->length) {
+    portEXIT_CRITICAL(&at_schedule_lock);
+    return ESP_ERR_INVALID_ARG;
+  }
+  at_schedule_to_request(&schedule->entries[index], request);
+  portEXIT_CRITICAL(&at_schedule_lock);
+  return ESP_OK;
+}
+
+uint8_t at_schedule_length(at_schedule_t *schedule) {
+  return schedule->length;
+}
+
+void at_schedule_clear(at_schedule_t *schedule) {
+  portENTER_CRITICAL(&at_schedule_lock);
+  schedule->length = 0;
+  schedule->rejected = 0;
+  portEXIT_CRITICAL(&at_schedule_lock);
+}
@@ -0,0 +1,58 @@
+#ifndef LORA_AT_AT_SCHEDULE_H
+#define LORA_AT_AT_SCHEDULE_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sx127x_util.h>
+#include <sdkconfig.h>
+
+// table is kept in RTC slow memory. every entry takes 34 bytes
+#ifndef CONFIG_AT_SCHEDULE_CAPACITY
+#define CONFIG_AT_SCHEDULE_CAPACITY 16
+#endif
+
+#pragma pack(push, 1)
+typedef struct {
+  uint64_t start_millis;
+  uint32_t duration_millis;
+  uint32_t freq;
+  uint32_t bw;
+  uint16_t preamble_length;
+  int16_t ocp;
+  uint8_t sf;
+  uint8_t cr;
+  uint8_t sync_word;
+  int8_t power;
+  uint8_t gain;
+  uint8_t ldo;
+  uint8_t use_crc;
+  uint8_t use_explicit_header;
+  uint8_t length;
+  uint8_t pin;
+} at_schedule_entry_t;
+#pragma pack(pop)
+
+typedef struct {
+  // sorted by start_millis
+  at_schedule_entry_t entries[CONFIG_AT_SCHEDULE_CAPACITY];
+  uint8_t length;
+  // requests rejected during the last load: invalid times or not enough capacity
+  uint8_t rejected;
+} at_schedule_t;
+
+// replaces the table with the requests. the server is the source of truth,
+// so entries left from the previous load are dropped
+esp_err_t at_schedule_load(const lora_config_t *requests, size_t requests_length, at_schedule_t *schedule);
+
+// drops observations finished before now_millis and copies the next one into request.
+// observation is removed from the table once started. returns ESP_ERR_NOT_FOUND if table is empty
+esp_err_t at_schedule_next(uint64_t now_millis, lora_config_t *request, at_schedule_t *schedule);
+
+esp_err_t at_schedule_get(uint8_t index, lora_config_t *request, at_schedule_t *schedule);
+
+uint8_t at_schedule_length(at_schedule_t *schedule);
+
+void at_schedule_clear(at_schedule_t *schedule);
+
+#endif //LORA_AT_AT_SCHEDULE_H
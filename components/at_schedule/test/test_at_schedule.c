@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <string.h>
+#include <at_schedule.h>
+
+static void create_request(uint64_t start, uint64_t end, uint64_t freq, lora_config_t *request) {
+  memset(request, 0, sizeof(lora_config_t));
+  request->startTimeMillis = start;
+  request->endTimeMillis = end;
+  request->freq = freq;
+  request->bw = 125000;
+  request->sf = 9;
+  request->cr = 7;
+  request->syncWord = 18;
+  request->preambleLength = 8;
+  request->useCrc = 1;
+  request->useExplicitHeader = 1;
+}
+
+TEST_CASE("schedule sorted", "[at_schedule]") {
+  lora_config_t requests[3];
+  create_request(3000, 4000, 433000000, &requests[0]);
+  create_request(1000, 2000, 434000000, &requests[1]);
+  create_request(2000, 3000, 435000000, &requests[2]);
+  at_schedule_t schedule = {0};
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_load(requests, 3, &schedule));
+  TEST_ASSERT_EQUAL(3, at_schedule_length(&schedule));
+  TEST_ASSERT_EQUAL(0, schedule.rejected);
+
+  lora_config_t actual;
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_get(0, &actual, &schedule));
+  TEST_ASSERT_EQUAL(1000, actual.startTimeMillis);
+  TEST_ASSERT_EQUAL(2000, actual.endTimeMillis);
+  TEST_ASSERT_EQUAL(434000000, actual.freq);
+  TEST_ASSERT_EQUAL(125000, actual.bw);
+  TEST_ASSERT_EQUAL(9, actual.sf);
+  TEST_ASSERT_EQUAL(8, actual.preambleLength);
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_get(2, &actual, &schedule));
+  TEST_ASSERT_EQUAL(3000, actual.startTimeMillis);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_schedule_get(3, &actual, &schedule));
+}
+
+TEST_CASE("schedule next", "[at_schedule]") {
+  lora_config_t requests[3];
+  create_request(1000, 2000, 433000000, &requests[0]);
+  create_request(3000, 4000, 434000000, &requests[1]);
+  create_request(5000, 6000, 435000000, &requests[2]);
+  at_schedule_t schedule = {0};
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_load(requests, 3, &schedule));
+
+  // not started yet. sleep until start
+  lora_config_t actual;
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_next(500, &actual, &schedule));
+  TEST_ASSERT_EQUAL(1000, actual.startTimeMillis);
+  TEST_ASSERT_EQUAL(500, actual.currentTimeMillis);
+  TEST_ASSERT_EQUAL(3, at_schedule_length(&schedule));
+
+  // started. removed from the table
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_next(1000, &actual, &schedule));
+  TEST_ASSERT_EQUAL(433000000, actual.freq);
+  TEST_ASSERT_EQUAL(2, at_schedule_length(&schedule));
+
+  // woke up late. the second observation is finished, the third has started
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_next(5500, &actual, &schedule));
+  TEST_ASSERT_EQUAL(435000000, actual.freq);
+  TEST_ASSERT_EQUAL(0, at_schedule_length(&schedule));
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, at_schedule_next(5600, &actual, &schedule));
+}
+
+TEST_CASE("schedule invalid", "[at_schedule]") {
+  lora_config_t requests[4];
+  create_request(2000, 1000, 433000000, &requests[0]);
+  create_request(1000, 2000, 5000000000ULL, &requests[1]);
+  create_request(1000, 2000, 433000000, &requests[2]);
+  requests[2].currentTimeMillis = 2000;
+  create_request(1000, 2000, 433000000, &requests[3]);
+  requests[3].currentTimeMillis = 1500;
+  at_schedule_t schedule = {0};
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_load(requests, 4, &schedule));
+  TEST_ASSERT_EQUAL(1, at_schedule_length(&schedule));
+  TEST_ASSERT_EQUAL(3, schedule.rejected);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_schedule_load(NULL, 1, &schedule));
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_load(NULL, 0, &schedule));
+  TEST_ASSERT_EQUAL(0, at_schedule_length(&schedule));
+}
+
+TEST_CASE("schedule capacity", "[at_schedule]") {
+  lora_config_t requests[CONFIG_AT_SCHEDULE_CAPACITY + 2];
+  // latest first. the earliest entries should be kept
+  for (int i = 0; i < CONFIG_AT_SCHEDULE_CAPACITY + 2; i++) {
+    uint64_t start = (uint64_t) (CONFIG_AT_SCHEDULE_CAPACITY + 2 - i) * 1000;
+    create_request(start, start + 500, 433000000, &requests[i]);
+  }
+  at_schedule_t schedule = {0};
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_load(requests, CONFIG_AT_SCHEDULE_CAPACITY + 2, &schedule));
+  TEST_ASSERT_EQUAL(CONFIG_AT_SCHEDULE_CAPACITY, at_schedule_length(&schedule));
+  TEST_ASSERT_EQUAL(2, schedule.rejected);
+  lora_config_t actual;
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_get(0, &actual, &schedule));
+  TEST_ASSERT_EQUAL(1000, actual.startTimeMillis);
+  TEST_ASSERT_EQUAL(ESP_OK, at_schedule_get(CONFIG_AT_SCHEDULE_CAPACITY - 1, &actual, &schedule));
+  TEST_ASSERT_EQUAL(CONFIG_AT_SCHEDULE_CAPACITY * 1000, actual.startTimeMillis);
+
+  at_schedule_clear(&schedule);
+  TEST_ASSERT_EQUAL(0, at_schedule_length(&schedule));
+}
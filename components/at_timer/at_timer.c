@@ -2,9 +2,18 @@
 #include <esp_attr.h>
 #include <esp_log.h>
 #include <inttypes.h>
+#include <sdkconfig.h>
 
 #define TIMER_RESOLUTION      1000000 // 1MHz, 1 tick = 1us
 
+#ifndef CONFIG_AT_INTERRUPT_TASK_PRIORITY
+#define CONFIG_AT_INTERRUPT_TASK_PRIORITY 2
+#endif
+
+#ifndef CONFIG_AT_INTERRUPT_TASK_CORE
+#define CONFIG_AT_INTERRUPT_TASK_CORE -1
+#endif
+
 static const char *TAG = "lora-at";
 
 #define ERROR_CHECK(x)        \
@@ -25,14 +34,15 @@ static const char *TAG = "lora-at";
 
 bool IRAM_ATTR at_timer_interrupt_fromisr(gptimer_handle_t timer_handle, const gptimer_alarm_event_data_t *edata, void *user_ctx) {
   at_timer_t *timer = (at_timer_t *) user_ctx;
-  xTaskResumeFromISR(timer->task_handle);
-  return true;
+  return at_util_irq_notify_fromisr(&timer->irq) == pdTRUE;
 }
 
 void at_timer_interrupt_task(void *arg) {
   at_timer_t *timer = (at_timer_t *) arg;
   while (1) {
-    vTaskSuspend(NULL);
+    if (at_util_irq_wait(portMAX_DELAY, &timer->irq) == 0) {
+      continue;
+    }
     timer->at_timer_callback(timer->callback_ctx);
   }
 }
@@ -46,7 +56,7 @@ esp_err_t at_timer_create(void (*at_timer_callback)(void *arg), void *ctx, at_ti
   result->at_timer_callback = at_timer_callback;
   result->callback_ctx = ctx;
   result->handle = NULL;
-  result->task_handle = NULL;
+  at_util_irq_init(&result->irq);
 
   *timer = result;
   return ESP_OK;
@@ -54,8 +64,9 @@ esp_err_t at_timer_create(void (*at_timer_callback)(void *arg), void *ctx, at_ti
 
 esp_err_t at_timer_start(uint64_t inactivity_period_micros, at_timer_t *timer) {
   at_timer_stop(timer);
-  if (timer->task_handle == NULL) {
-    BaseType_t task_code = xTaskCreatePinnedToCore(at_timer_interrupt_task, "handle timer", 8196, timer, 2, &timer->task_handle, xPortGetCoreID());
+  if (timer->irq.task == NULL) {
+    BaseType_t core = (CONFIG_AT_INTERRUPT_TASK_CORE < 0 ? xPortGetCoreID() : CONFIG_AT_INTERRUPT_TASK_CORE);
+    BaseType_t task_code = xTaskCreatePinnedToCore(at_timer_interrupt_task, "handle timer", 8196, timer, CONFIG_AT_INTERRUPT_TASK_PRIORITY, &timer->irq.task, core);
     if (task_code != pdPASS) {
       return ESP_ERR_INVALID_STATE;
     }
@@ -108,9 +119,10 @@ esp_err_t at_timer_stop(at_timer_t *timer) {
     timer->handle = NULL;
     actually_stopped = true;
   }
-  if (timer->task_handle != NULL) {
-    vTaskDelete(timer->task_handle);
-    timer->task_handle = NULL;
+  if (timer->irq.task != NULL) {
+    TaskHandle_t task = timer->irq.task;
+    timer->irq.task = NULL;
+    vTaskDelete(task);
     actually_stopped = true;
   }
   if (actually_stopped) {
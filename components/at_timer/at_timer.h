@@ -7,12 +7,13 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <driver/gptimer.h>
+#include <at_util.h>
 
 typedef struct {
   void *callback_ctx;
   void (*at_timer_callback)(void *arg);
   gptimer_handle_t handle;
-  TaskHandle_t task_handle;
+  at_util_irq_t irq;
 } at_timer_t;
 
 esp_err_t at_timer_create(void (*at_timer_callback)(void *arg), void *ctx, at_timer_t **timer);
@@ -1,59 +1,120 @@
 #include "at_util.h"
 #include <stdlib.h>
 #include <string.h>
+#include <esp_attr.h>
 
-const char SYMBOLS[] = "0123456789ABCDEF";
+#define HEX_SEPARATOR 0x10
+#define HEX_INVALID 0xFF
 
-esp_err_t at_util_string2hex(const char *str, uint8_t *output, size_t *output_len) {
-  size_t len = 0;
-  size_t str_len = strlen(str);
-  for (size_t i = 0; i < str_len; i++) {
-    if (str[i] == ' ' || str[i] == ':') {
-      continue;
+// values are stored xor HEX_INVALID, so all missing entries become HEX_INVALID after lookup
+#define HEX_VALUE(x) ((uint8_t) ((x) ^ HEX_INVALID))
+#define HEX_LOOKUP(x) (HEX_DECODE[(uint8_t) (x)] ^ HEX_INVALID)
+
+static const uint8_t HEX_DECODE[256] = {
+    [' '] = HEX_VALUE(HEX_SEPARATOR), [':'] = HEX_VALUE(HEX_SEPARATOR),
+    ['0'] = HEX_VALUE(0), ['1'] = HEX_VALUE(1), ['2'] = HEX_VALUE(2), ['3'] = HEX_VALUE(3), ['4'] = HEX_VALUE(4),
+    ['5'] = HEX_VALUE(5), ['6'] = HEX_VALUE(6), ['7'] = HEX_VALUE(7), ['8'] = HEX_VALUE(8), ['9'] = HEX_VALUE(9),
+    ['A'] = HEX_VALUE(10), ['B'] = HEX_VALUE(11), ['C'] = HEX_VALUE(12), ['D'] = HEX_VALUE(13), ['E'] = HEX_VALUE(14), ['F'] = HEX_VALUE(15),
+    ['a'] = HEX_VALUE(10), ['b'] = HEX_VALUE(11), ['c'] = HEX_VALUE(12), ['d'] = HEX_VALUE(13), ['e'] = HEX_VALUE(14), ['f'] = HEX_VALUE(15),
+};
+
+#define HEX_UPPER_ROW(x) x "0" x "1" x "2" x "3" x "4" x "5" x "6" x "7" x "8" x "9" x "A" x "B" x "C" x "D" x "E" x "F"
+#define HEX_LOWER_ROW(x) x "0" x "1" x "2" x "3" x "4" x "5" x "6" x "7" x "8" x "9" x "a" x "b" x "c" x "d" x "e" x "f"
+
+// two characters for every byte value
+static const char HEX_ENCODE_UPPER[512 + 1] =
+    HEX_UPPER_ROW("0") HEX_UPPER_ROW("1") HEX_UPPER_ROW("2") HEX_UPPER_ROW("3") HEX_UPPER_ROW("4") HEX_UPPER_ROW("5") HEX_UPPER_ROW("6") HEX_UPPER_ROW("7")
+    HEX_UPPER_ROW("8") HEX_UPPER_ROW("9") HEX_UPPER_ROW("A") HEX_UPPER_ROW("B") HEX_UPPER_ROW("C") HEX_UPPER_ROW("D") HEX_UPPER_ROW("E") HEX_UPPER_ROW("F");
+static const char HEX_ENCODE_LOWER[512 + 1] =
+    HEX_LOWER_ROW("0") HEX_LOWER_ROW("1") HEX_LOWER_ROW("2") HEX_LOWER_ROW("3") HEX_LOWER_ROW("4") HEX_LOWER_ROW("5") HEX_LOWER_ROW("6") HEX_LOWER_ROW("7")
+    HEX_LOWER_ROW("8") HEX_LOWER_ROW("9") HEX_LOWER_ROW("a") HEX_LOWER_ROW("b") HEX_LOWER_ROW("c") HEX_LOWER_ROW("d") HEX_LOWER_ROW("e") HEX_LOWER_ROW("f");
+
+esp_err_t at_util_hex_decode(const char *str, size_t str_len, uint8_t *output, size_t output_capacity, size_t *output_len) {
+  *output_len = 0;
+  size_t bytes = 0;
+  uint8_t high = HEX_INVALID;
+  size_t i = 0;
+  while (i < str_len) {
+    // fast path: two hex digits in a row
+    if (high == HEX_INVALID && i + 1 < str_len) {
+      uint8_t first = HEX_LOOKUP(str[i]);
+      uint8_t second = HEX_LOOKUP(str[i + 1]);
+      if (((first | second) & 0xF0) == 0) {
+        if (bytes >= output_capacity) {
+          return ESP_ERR_INVALID_SIZE;
+        }
+        output[bytes++] = (first << 4) | second;
+        i += 2;
+        continue;
+      }
     }
-    len++;
-  }
-  if (len % 2 != 0) {
-    *output_len = 0;
-    return ESP_ERR_INVALID_SIZE;
-  }
-  size_t bytes = len / 2;
-  uint8_t curByte = 0;
-  for (size_t i = 0, j = 0; i < strlen(str); i++) {
-    char curChar = str[i];
-    if (curChar == ' ' || str[i] == ':') {
+    uint8_t cur = HEX_LOOKUP(str[i]);
+    i++;
+    if (cur == HEX_SEPARATOR) {
       continue;
     }
-    curByte *= 16;
-    if (curChar >= '0' && curChar <= '9') {
-      curByte += curChar - '0';
-    } else if (curChar >= 'A' && curChar <= 'F') {
-      curByte += (curChar - 'A') + 10;
-    } else if (curChar >= 'a' && curChar <= 'f') {
-      curByte += (curChar - 'a') + 10;
-    } else {
+    if (cur == HEX_INVALID) {
       return ESP_ERR_INVALID_ARG;
     }
-    j++;
-    if (j % 2 == 0) {
-      output[j / 2 - 1] = curByte;
-      curByte = 0;
+    if (high == HEX_INVALID) {
+      high = cur;
+      continue;
+    }
+    if (bytes >= output_capacity) {
+      return ESP_ERR_INVALID_SIZE;
     }
+    output[bytes++] = (high << 4) | cur;
+    high = HEX_INVALID;
+  }
+  if (high != HEX_INVALID) {
+    // odd number of hex digits
+    return ESP_ERR_INVALID_SIZE;
   }
   *output_len = bytes;
   return ESP_OK;
 }
 
-esp_err_t at_util_hex2string(const uint8_t *input, size_t input_len, char *output) {
-  for (size_t i = 0; i < input_len; i++) {
-    uint8_t cur = input[i];
-    output[2 * i] = SYMBOLS[cur >> 4];
-    output[2 * i + 1] = SYMBOLS[cur & 0x0F];
+esp_err_t at_util_hex_encode(const uint8_t *input, size_t input_len, char *output, size_t output_capacity, bool lowercase, char separator, size_t *output_len) {
+  size_t required = input_len * 2;
+  if (separator != '\0' && input_len > 0) {
+    required += input_len - 1;
+  }
+  // 1 is for \0
+  if (required + 1 > output_capacity) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  const char *table = (lowercase ? HEX_ENCODE_LOWER : HEX_ENCODE_UPPER);
+  char *cur = output;
+  if (separator == '\0') {
+    for (size_t i = 0; i < input_len; i++) {
+      memcpy(cur, table + input[i] * 2, 2);
+      cur += 2;
+    }
+  } else {
+    for (size_t i = 0; i < input_len; i++) {
+      if (i != 0) {
+        *cur = separator;
+        cur++;
+      }
+      memcpy(cur, table + input[i] * 2, 2);
+      cur += 2;
+    }
+  }
+  *cur = '\0';
+  if (output_len != NULL) {
+    *output_len = required;
   }
-  output[input_len * 2] = '\0';
   return ESP_OK;
 }
 
+esp_err_t at_util_string2hex(const char *str, uint8_t *output, size_t *output_len) {
+  return at_util_hex_decode(str, strlen(str), output, SIZE_MAX, output_len);
+}
+
+esp_err_t at_util_hex2string(const uint8_t *input, size_t input_len, char *output) {
+  return at_util_hex_encode(input, input_len, output, input_len * 2 + 1, false, '\0', NULL);
+}
+
 esp_err_t at_util_vector_create(at_util_vector_t **vector) {
   at_util_vector_t *result = malloc(sizeof(at_util_vector_t));
   if (result == NULL) {
@@ -123,4 +184,165 @@ void at_util_vector_destroy(at_util_vector_t *vector) {
   }
   at_util_vector_clear(vector);
   free(vector);
-}
\ No newline at end of file
+}
+
+esp_err_t at_util_ring_create(uint32_t capacity, at_util_ring_policy_t policy, at_util_ring_t **ring) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  at_util_ring_t *result = malloc(sizeof(at_util_ring_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  result->items = malloc(sizeof(void *) * capacity);
+  if (result->items == NULL) {
+    at_util_ring_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  result->capacity = capacity;
+  result->policy = policy;
+  atomic_init(&result->head, 0);
+  atomic_init(&result->tail, 0);
+  atomic_init(&result->dropped, 0);
+  *ring = result;
+  return ESP_OK;
+}
+
+esp_err_t at_util_ring_push(void *item, void **dropped, at_util_ring_t *ring) {
+  *dropped = NULL;
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail >= ring->capacity) {
+    if (ring->policy == AT_UTIL_RING_DROP_NEWEST) {
+      atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+      *dropped = item;
+      return ESP_OK;
+    }
+    // take the oldest item from consumer. if consumer was faster, then there is free slot already
+    if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire)) {
+      *dropped = ring->items[tail & (ring->capacity - 1)];
+      atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    }
+  }
+  ring->items[head & (ring->capacity - 1)] = item;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return ESP_OK;
+}
+
+esp_err_t at_util_ring_pop(void **item, at_util_ring_t *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  while (1) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+      *item = NULL;
+      return ESP_ERR_NOT_FOUND;
+    }
+    void *result = ring->items[tail & (ring->capacity - 1)];
+    // producer might evict this item while it is being read
+    if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire)) {
+      *item = result;
+      return ESP_OK;
+    }
+  }
+}
+
+uint32_t at_util_ring_size(at_util_ring_t *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return head - tail;
+}
+
+uint32_t at_util_ring_dropped(at_util_ring_t *ring) {
+  return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+void at_util_ring_destroy(at_util_ring_t *ring) {
+  if (ring == NULL) {
+    return;
+  }
+  if (ring->items != NULL) {
+    free(ring->items);
+  }
+  free(ring);
+}
+
+esp_err_t at_util_pool_init(void *arena, size_t block_size, uint16_t capacity, at_util_pool_t *pool) {
+  if (arena == NULL || capacity == 0 || block_size < sizeof(void *) || block_size % sizeof(void *) != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pool->arena = arena;
+  pool->block_size = block_size;
+  pool->capacity = capacity;
+  pool->used = 0;
+  pool->high_water_mark = 0;
+  pool->exhausted = 0;
+  portMUX_INITIALIZE(&pool->lock);
+  // each free block stores pointer to the next free block
+  pool->free_list = NULL;
+  for (uint16_t i = capacity; i > 0; i--) {
+    void *block = pool->arena + (i - 1) * block_size;
+    *((void **) block) = pool->free_list;
+    pool->free_list = block;
+  }
+  return ESP_OK;
+}
+
+void *at_util_pool_acquire(at_util_pool_t *pool) {
+  portENTER_CRITICAL(&pool->lock);
+  void *result = pool->free_list;
+  if (result == NULL) {
+    pool->exhausted++;
+  } else {
+    pool->free_list = *((void **) result);
+    pool->used++;
+    if (pool->used > pool->high_water_mark) {
+      pool->high_water_mark = pool->used;
+    }
+  }
+  portEXIT_CRITICAL(&pool->lock);
+  return result;
+}
+
+bool at_util_pool_owns(const void *block, at_util_pool_t *pool) {
+  const uint8_t *ptr = block;
+  return ptr >= pool->arena && ptr < pool->arena + pool->block_size * pool->capacity;
+}
+
+void at_util_pool_release(void *block, at_util_pool_t *pool) {
+  if (block == NULL) {
+    return;
+  }
+  portENTER_CRITICAL(&pool->lock);
+  *((void **) block) = pool->free_list;
+  pool->free_list = block;
+  pool->used--;
+  portEXIT_CRITICAL(&pool->lock);
+}
+
+void at_util_irq_init(at_util_irq_t *irq) {
+  *irq = (at_util_irq_t) {0};
+}
+
+BaseType_t IRAM_ATTR at_util_irq_notify_fromisr(at_util_irq_t *irq) {
+  irq->interrupts++;
+  if (irq->task == NULL) {
+    irq->missed++;
+    return pdFALSE;
+  }
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(irq->task, &woken);
+  return woken;
+}
+
+uint32_t at_util_irq_wait(TickType_t timeout, at_util_irq_t *irq) {
+  uint32_t pending = ulTaskNotifyTake(pdTRUE, timeout);
+  if (pending == 0) {
+    return 0;
+  }
+  irq->handled++;
+  irq->coalesced += pending - 1;
+  if (pending > irq->max_pending) {
+    irq->max_pending = pending;
+  }
+  return pending;
+}
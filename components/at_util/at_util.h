@@ -4,6 +4,16 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <esp_err.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// ' ' and ':' are skipped. ESP_ERR_INVALID_SIZE if output doesn't fit into output_capacity or number of digits is odd
+esp_err_t at_util_hex_decode(const char *str, size_t str_len, uint8_t *output, size_t output_capacity, size_t *output_len);
+
+// separator '\0' means no separator. output is null-terminated and output_capacity should include it
+esp_err_t at_util_hex_encode(const uint8_t *input, size_t input_len, char *output, size_t output_capacity, bool lowercase, char separator, size_t *output_len);
 
 esp_err_t at_util_string2hex(const char *str, uint8_t *output, size_t *output_len);
 
@@ -26,4 +36,80 @@ void at_util_vector_clear(at_util_vector_t *vector);
 
 void at_util_vector_destroy(at_util_vector_t *vector);
 
+typedef enum {
+  AT_UTIL_RING_DROP_OLDEST = 0,
+  AT_UTIL_RING_DROP_NEWEST = 1
+} at_util_ring_policy_t;
+
+// single-producer/single-consumer ring buffer
+// producer is the sx127x interrupt task, consumer is either uart or rest handler
+// head and tail are free-running counters. capacity must be power of 2
+typedef struct {
+  void **items;
+  uint32_t capacity;
+  at_util_ring_policy_t policy;
+  _Atomic uint32_t head;
+  _Atomic uint32_t tail;
+  _Atomic uint32_t dropped;
+} at_util_ring_t;
+
+esp_err_t at_util_ring_create(uint32_t capacity, at_util_ring_policy_t policy, at_util_ring_t **ring);
+
+// dropped will contain item evicted from the ring (the oldest or the new one depending on policy) or NULL
+// caller is responsible for freeing it
+esp_err_t at_util_ring_push(void *item, void **dropped, at_util_ring_t *ring);
+
+// returns ESP_ERR_NOT_FOUND if ring is empty
+esp_err_t at_util_ring_pop(void **item, at_util_ring_t *ring);
+
+uint32_t at_util_ring_size(at_util_ring_t *ring);
+
+uint32_t at_util_ring_dropped(at_util_ring_t *ring);
+
+void at_util_ring_destroy(at_util_ring_t *ring);
+
+// fixed-size block allocator on top of caller-provided arena
+// acquire and release are O(1) and can be called from different tasks
+typedef struct {
+  uint8_t *arena;
+  size_t block_size;
+  uint16_t capacity;
+  void *free_list;
+  uint16_t used;
+  uint16_t high_water_mark;
+  uint32_t exhausted;
+  portMUX_TYPE lock;
+} at_util_pool_t;
+
+// arena must be at least block_size * capacity bytes and aligned to pointer size
+esp_err_t at_util_pool_init(void *arena, size_t block_size, uint16_t capacity, at_util_pool_t *pool);
+
+// returns NULL if there are no free blocks
+void *at_util_pool_acquire(at_util_pool_t *pool);
+
+bool at_util_pool_owns(const void *block, at_util_pool_t *pool);
+
+void at_util_pool_release(void *block, at_util_pool_t *pool);
+
+// interrupt handoff from ISR to the worker task using task notifications
+// edges are counted, so they are not lost if the worker is still busy with the previous one
+typedef struct {
+  TaskHandle_t task;
+  volatile uint32_t interrupts;
+  // interrupts received before the worker task was assigned
+  volatile uint32_t missed;
+  uint32_t handled;
+  // interrupts handled together with the previous one
+  uint32_t coalesced;
+  uint32_t max_pending;
+} at_util_irq_t;
+
+void at_util_irq_init(at_util_irq_t *irq);
+
+// returns pdTRUE if higher priority task was woken
+BaseType_t at_util_irq_notify_fromisr(at_util_irq_t *irq);
+
+// should be called from irq->task. returns number of pending interrupts or 0 on timeout
+uint32_t at_util_irq_wait(TickType_t timeout, at_util_irq_t *irq);
+
 #endif
\ No newline at end of file
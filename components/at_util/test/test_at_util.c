@@ -1,5 +1,6 @@
 #include <unity.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "at_util.h"
 
 at_util_vector_t *vector = NULL;
@@ -72,3 +73,161 @@ TEST_CASE("vector", "[at_util]") {
   TEST_ASSERT_EQUAL(0, at_util_vector_size(vector));
   at_util_vector_destroy(vector);
 }
+
+TEST_CASE("ring", "[at_util]") {
+  at_util_ring_t *ring = NULL;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_util_ring_create(3, AT_UTIL_RING_DROP_OLDEST, &ring));
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_create(2, AT_UTIL_RING_DROP_OLDEST, &ring));
+  at_util_test_t items[3] = {
+      {.data = "TEST", .timestamp = 1234},
+      {.data = "TEST2", .timestamp = 1235},
+      {.data = "TEST3", .timestamp = 1236}
+  };
+  at_util_test_t *result = NULL;
+  at_util_test_t *dropped = NULL;
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_NULL(result);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_push(&items[i], (void *) &dropped, ring));
+  }
+  TEST_ASSERT_EQUAL(&items[0], dropped);
+  TEST_ASSERT_EQUAL(2, at_util_ring_size(ring));
+  TEST_ASSERT_EQUAL(1, at_util_ring_dropped(ring));
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_EQUAL_STRING(items[1].data, result->data);
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_EQUAL_STRING(items[2].data, result->data);
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_EQUAL(0, at_util_ring_size(ring));
+  at_util_ring_destroy(ring);
+
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_create(2, AT_UTIL_RING_DROP_NEWEST, &ring));
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_push(&items[i], (void *) &dropped, ring));
+  }
+  TEST_ASSERT_EQUAL(&items[2], dropped);
+  TEST_ASSERT_EQUAL(1, at_util_ring_dropped(ring));
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_EQUAL_STRING(items[0].data, result->data);
+  // wrap around
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_push(&items[2], (void *) &dropped, ring));
+  TEST_ASSERT_NULL(dropped);
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_EQUAL_STRING(items[1].data, result->data);
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_pop((void *) &result, ring));
+  TEST_ASSERT_EQUAL_STRING(items[2].data, result->data);
+  at_util_ring_destroy(ring);
+}
+
+TEST_CASE("pool", "[at_util]") {
+  void *arena[3 * 2];
+  at_util_pool_t pool;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, at_util_pool_init(arena, 3, 2, &pool));
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_pool_init(arena, sizeof(void *) * 3, 2, &pool));
+  void *first = at_util_pool_acquire(&pool);
+  void *second = at_util_pool_acquire(&pool);
+  TEST_ASSERT_NOT_NULL(first);
+  TEST_ASSERT_NOT_NULL(second);
+  TEST_ASSERT_TRUE(first != second);
+  TEST_ASSERT_TRUE(at_util_pool_owns(first, &pool));
+  TEST_ASSERT_TRUE(at_util_pool_owns(second, &pool));
+  TEST_ASSERT_NULL(at_util_pool_acquire(&pool));
+  TEST_ASSERT_EQUAL(1, pool.exhausted);
+  TEST_ASSERT_EQUAL(2, pool.high_water_mark);
+  at_util_pool_release(first, &pool);
+  TEST_ASSERT_EQUAL(1, pool.used);
+  TEST_ASSERT_EQUAL(first, at_util_pool_acquire(&pool));
+  at_util_pool_release(first, &pool);
+  at_util_pool_release(second, &pool);
+  TEST_ASSERT_EQUAL(0, pool.used);
+  TEST_ASSERT_EQUAL(2, pool.high_water_mark);
+  int outside = 0;
+  TEST_ASSERT_FALSE(at_util_pool_owns(&outside, &pool));
+}
+
+static int reference_hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+TEST_CASE("hex decode all pairs", "[at_util]") {
+  for (int first = 0; first < 256; first++) {
+    for (int second = 0; second < 256; second++) {
+      char input[2] = {(char) first, (char) second};
+      uint8_t output[1];
+      size_t output_len = 0;
+      esp_err_t code = at_util_hex_decode(input, sizeof(input), output, sizeof(output), &output_len);
+      int high = reference_hex_value((char) first);
+      int low = reference_hex_value((char) second);
+      if (high >= 0 && low >= 0) {
+        TEST_ASSERT_EQUAL(ESP_OK, code);
+        TEST_ASSERT_TRUE(output_len == 1);
+        TEST_ASSERT_EQUAL_HEX8((high << 4) | low, output[0]);
+      } else if ((first == ' ' || first == ':') && (second == ' ' || second == ':')) {
+        TEST_ASSERT_EQUAL(ESP_OK, code);
+        TEST_ASSERT_TRUE(output_len == 0);
+      } else {
+        TEST_ASSERT_NOT_EQUAL(ESP_OK, code);
+      }
+    }
+  }
+}
+
+TEST_CASE("hex encode all bytes", "[at_util]") {
+  uint8_t input[256];
+  for (int i = 0; i < 256; i++) {
+    input[i] = (uint8_t) i;
+  }
+  char output[256 * 3];
+  size_t output_len = 0;
+  char expected[4];
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_encode(input, sizeof(input), output, sizeof(output), false, '\0', &output_len));
+  TEST_ASSERT_TRUE(output_len == 512);
+  for (int i = 0; i < 256; i++) {
+    snprintf(expected, sizeof(expected), "%02X", i);
+    TEST_ASSERT_EQUAL_MEMORY(expected, output + i * 2, 2);
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_encode(input, sizeof(input), output, sizeof(output), true, ':', &output_len));
+  TEST_ASSERT_TRUE(output_len == 256 * 3 - 1);
+  TEST_ASSERT_EQUAL('\0', output[output_len]);
+  for (int i = 0; i < 256; i++) {
+    snprintf(expected, sizeof(expected), "%02x", i);
+    TEST_ASSERT_EQUAL_MEMORY(expected, output + i * 3, 2);
+    if (i != 255) {
+      TEST_ASSERT_EQUAL(':', output[i * 3 + 2]);
+    }
+  }
+  // round trip with separators
+  uint8_t decoded[256];
+  size_t decoded_len = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_decode(output, output_len, decoded, sizeof(decoded), &decoded_len));
+  TEST_ASSERT_TRUE(decoded_len == sizeof(input));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(input, decoded, sizeof(input));
+}
+
+TEST_CASE("hex capacity", "[at_util]") {
+  uint8_t output[2];
+  size_t output_len = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_decode("cafe", 4, output, sizeof(output), &output_len));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_util_hex_decode("cafe10", 6, output, sizeof(output), &output_len));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_util_hex_decode("c:a:f:e:1:0", 11, output, sizeof(output), &output_len));
+  TEST_ASSERT_TRUE(output_len == 0);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_util_hex_decode("caf", 3, output, sizeof(output), &output_len));
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_decode("", 0, output, 0, &output_len));
+  TEST_ASSERT_TRUE(output_len == 0);
+
+  uint8_t input[] = {0xca, 0xfe};
+  char str[5];
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_encode(input, sizeof(input), str, sizeof(str), false, '\0', &output_len));
+  TEST_ASSERT_EQUAL_STRING("CAFE", str);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_util_hex_encode(input, sizeof(input), str, sizeof(str), false, ':', &output_len));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, at_util_hex_encode(input, sizeof(input), str, 4, false, '\0', &output_len));
+}
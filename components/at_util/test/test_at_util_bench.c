@@ -0,0 +1,139 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_timer.h>
+#include "at_util.h"
+
+static const uint16_t bench_sizes[] = {10, 100, 1000};
+
+static int64_t bench_vector(uint16_t size, void *item) {
+  at_util_vector_t *vector = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_vector_create(&vector));
+  int64_t start = esp_timer_get_time();
+  for (uint16_t i = 0; i < size; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, at_util_vector_add(item, vector));
+  }
+  // same access pattern as AT+PULL used to have
+  for (uint16_t i = 0; i < at_util_vector_size(vector); i++) {
+    void *result = NULL;
+    at_util_vector_get(i, &result, vector);
+  }
+  at_util_vector_clear(vector);
+  int64_t result = esp_timer_get_time() - start;
+  at_util_vector_destroy(vector);
+  return result;
+}
+
+static int64_t bench_ring(uint16_t size, void *item) {
+  at_util_ring_t *ring = NULL;
+  TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_create(1024, AT_UTIL_RING_DROP_OLDEST, &ring));
+  int64_t start = esp_timer_get_time();
+  for (uint16_t i = 0; i < size; i++) {
+    void *dropped = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, at_util_ring_push(item, &dropped, ring));
+  }
+  void *result = NULL;
+  while (at_util_ring_pop(&result, ring) == ESP_OK) {
+  }
+  int64_t took = esp_timer_get_time() - start;
+  at_util_ring_destroy(ring);
+  return took;
+}
+
+TEST_CASE("ring vs vector benchmark", "[at_util][bench]") {
+  int item = 0;
+  for (size_t i = 0; i < sizeof(bench_sizes) / sizeof(uint16_t); i++) {
+    int64_t vector_micros = bench_vector(bench_sizes[i], &item);
+    int64_t ring_micros = bench_ring(bench_sizes[i], &item);
+    printf("frames: %d vector: %" PRId64 "us ring: %" PRId64 "us\n", bench_sizes[i], vector_micros, ring_micros);
+  }
+}
+
+#define HEX_BENCH_ITERATIONS 1000
+
+static const char LEGACY_SYMBOLS[] = "0123456789ABCDEF";
+
+// implementation before the lookup table codec
+static esp_err_t legacy_string2hex(const char *str, uint8_t *output, size_t *output_len) {
+  size_t len = 0;
+  size_t str_len = strlen(str);
+  for (size_t i = 0; i < str_len; i++) {
+    if (str[i] == ' ' || str[i] == ':') {
+      continue;
+    }
+    len++;
+  }
+  if (len % 2 != 0) {
+    *output_len = 0;
+    return ESP_ERR_INVALID_SIZE;
+  }
+  size_t bytes = len / 2;
+  uint8_t curByte = 0;
+  for (size_t i = 0, j = 0; i < strlen(str); i++) {
+    char curChar = str[i];
+    if (curChar == ' ' || str[i] == ':') {
+      continue;
+    }
+    curByte *= 16;
+    if (curChar >= '0' && curChar <= '9') {
+      curByte += curChar - '0';
+    } else if (curChar >= 'A' && curChar <= 'F') {
+      curByte += (curChar - 'A') + 10;
+    } else if (curChar >= 'a' && curChar <= 'f') {
+      curByte += (curChar - 'a') + 10;
+    } else {
+      return ESP_ERR_INVALID_ARG;
+    }
+    j++;
+    if (j % 2 == 0) {
+      output[j / 2 - 1] = curByte;
+      curByte = 0;
+    }
+  }
+  *output_len = bytes;
+  return ESP_OK;
+}
+
+static void legacy_hex2string(const uint8_t *input, size_t input_len, char *output) {
+  for (size_t i = 0; i < input_len; i++) {
+    uint8_t cur = input[i];
+    output[2 * i] = LEGACY_SYMBOLS[cur >> 4];
+    output[2 * i + 1] = LEGACY_SYMBOLS[cur & 0x0F];
+  }
+  output[input_len * 2] = '\0';
+}
+
+TEST_CASE("hex codec benchmark", "[at_util][bench]") {
+  uint8_t data[255];
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t) (i * 7);
+  }
+  char str[sizeof(data) * 2 + 1];
+  uint8_t decoded[sizeof(data)];
+  size_t decoded_len = 0;
+
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < HEX_BENCH_ITERATIONS; i++) {
+    legacy_hex2string(data, sizeof(data), str);
+  }
+  int64_t legacy_encode = esp_timer_get_time() - start;
+  start = esp_timer_get_time();
+  for (int i = 0; i < HEX_BENCH_ITERATIONS; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_encode(data, sizeof(data), str, sizeof(str), false, '\0', NULL));
+  }
+  int64_t encode = esp_timer_get_time() - start;
+
+  start = esp_timer_get_time();
+  for (int i = 0; i < HEX_BENCH_ITERATIONS; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, legacy_string2hex(str, decoded, &decoded_len));
+  }
+  int64_t legacy_decode = esp_timer_get_time() - start;
+  start = esp_timer_get_time();
+  for (int i = 0; i < HEX_BENCH_ITERATIONS; i++) {
+    TEST_ASSERT_EQUAL(ESP_OK, at_util_hex_decode(str, sizeof(str) - 1, decoded, sizeof(decoded), &decoded_len));
+  }
+  int64_t decode = esp_timer_get_time() - start;
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, decoded, sizeof(data));
+  printf("payload: %zu bytes x %d encode legacy: %" PRId64 "us lut: %" PRId64 "us decode legacy: %" PRId64 "us lut: %" PRId64 "us\n", sizeof(data), HEX_BENCH_ITERATIONS, legacy_encode, encode, legacy_decode, decode);
+}
@@ -0,0 +1,78 @@
+#include <unity.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <esp_attr.h>
+#include <rom/ets_sys.h>
+#include <driver/gptimer.h>
+#include "at_util.h"
+
+// interrupt periods in microseconds. from 1kHz to 20kHz
+static const uint32_t irq_periods[] = {1000, 500, 200, 100, 50};
+
+static at_util_irq_t test_irq;
+
+static void irq_worker(void *arg) {
+  while (1) {
+    if (at_util_irq_wait(portMAX_DELAY, &test_irq) > 0) {
+      // roughly the time needed to read irq flags and the packet over SPI
+      ets_delay_us(150);
+    }
+  }
+}
+
+static bool IRAM_ATTR irq_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *ctx) {
+  return at_util_irq_notify_fromisr(&test_irq) == pdTRUE;
+}
+
+static void irq_run(uint32_t period_micros, at_util_irq_t *result) {
+  at_util_irq_init(&test_irq);
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(irq_worker, "irq worker", 2048, NULL, 2, &test_irq.task, xPortGetCoreID()));
+  gptimer_config_t timer_config = {
+      .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+      .direction = GPTIMER_COUNT_UP,
+      .resolution_hz = 1000000,
+  };
+  gptimer_handle_t timer;
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_new_timer(&timer_config, &timer));
+  gptimer_alarm_config_t alarm_config = {
+      .reload_count = 0,
+      .alarm_count = period_micros,
+      .flags.auto_reload_on_alarm = true,
+  };
+  gptimer_event_callbacks_t cbs = {
+      .on_alarm = irq_alarm,
+  };
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_register_event_callbacks(timer, &cbs, NULL));
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_set_alarm_action(timer, &alarm_config));
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_enable(timer));
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_start(timer));
+  vTaskDelay(pdMS_TO_TICKS(200));
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_stop(timer));
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_disable(timer));
+  TEST_ASSERT_EQUAL(ESP_OK, gptimer_del_timer(timer));
+  // let worker drain the remaining notifications
+  vTaskDelay(pdMS_TO_TICKS(50));
+  vTaskDelete(test_irq.task);
+  *result = test_irq;
+}
+
+TEST_CASE("irq handoff under load", "[at_util][bench]") {
+  for (size_t i = 0; i < sizeof(irq_periods) / sizeof(uint32_t); i++) {
+    at_util_irq_t result;
+    irq_run(irq_periods[i], &result);
+    printf("period: %" PRIu32 "us interrupts: %" PRIu32 " handled: %" PRIu32 " coalesced: %" PRIu32 " max pending: %" PRIu32 " lost: %" PRIu32 "\n", irq_periods[i], result.interrupts, result.handled, result.coalesced,
+           result.max_pending, result.interrupts - result.handled - result.coalesced);
+    TEST_ASSERT_GREATER_THAN(0, result.interrupts);
+    TEST_ASSERT_EQUAL(0, result.missed);
+    // every interrupt is either handled or coalesced with the previous one
+    TEST_ASSERT_EQUAL(result.interrupts, result.handled + result.coalesced);
+  }
+}
+
+TEST_CASE("irq without worker", "[at_util]") {
+  at_util_irq_t irq;
+  at_util_irq_init(&irq);
+  TEST_ASSERT_EQUAL(pdFALSE, at_util_irq_notify_fromisr(&irq));
+  TEST_ASSERT_EQUAL(1, irq.interrupts);
+  TEST_ASSERT_EQUAL(1, irq.missed);
+}
@@ -8,9 +8,11 @@
 #include <services/gap/ble_svc_gap.h>
 #include <host/ble_gap.h>
 #include <host/util/util.h>
+#include <os/os_mbuf.h>
 #include <arpa/inet.h>
 #include <sdkconfig.h>
 #include <driver/gpio.h>
+#include <at_perf.h>
 
 #ifndef CONFIG_BLUETOOTH_CONNECTION_TIMEOUT
 #define CONFIG_BLUETOOTH_CONNECTION_TIMEOUT 30000
@@ -20,7 +22,12 @@
 #define CONFIG_BLUETOOTH_POWER_PROFILING -1
 #endif
 
-#define PROTOCOL_VERSION 2
+// version 3 added timestamp_micros to frames
+#define PROTOCOL_VERSION 3
+// lora_config_t is the same in versions 2 and 3
+#define MIN_REQUEST_PROTOCOL_VERSION 2
+// protocol_version + frequency_error + rssi + snr + timestamp + timestamp_micros + data_length
+#define FRAME_HEADER_LENGTH (1 + 4 + 2 + 4 + 8 + 8 + 2)
 #define MUTEX_TIMEOUT_DELTA 1000
 #define BLE_ADDRESS_SIZE 6
 #define ERROR_CHECK(x)        \
@@ -49,7 +56,11 @@ struct ble_client_t {
   uint8_t *address;
   SemaphoreHandle_t semaphore;
   esp_err_t semaphore_result;
-  lora_config_t *last_request;
+  // destination of the long read
+  lora_config_t *schedule;
+  size_t schedule_capacity;
+  size_t schedule_bytes;
+  size_t schedule_length;
   bool controller_initialized;
 
   uint16_t conn_handle;
@@ -109,57 +120,78 @@ void ble_client_reset_internally(ble_client *result) {
   result->service_found = false;
   result->characteristic_found = false;
   result->status_characteristic_found = false;
-  result->last_request = NULL;
+  result->schedule = NULL;
+  result->schedule_capacity = 0;
+  result->schedule_bytes = 0;
+  result->schedule_length = 0;
 }
 
 int ble_client_gatt_attr_fn(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg) {
   struct ble_client_t *client = (struct ble_client_t *) arg;
-  ESP_LOGD(TAG, "characteristic value response received: %d status: %d", conn_handle, error->status);
+  ESP_LOGD(TAG, "characteristic write response received: %d status: %d", conn_handle, error->status);
   if (client->conn_handle != conn_handle) {
     return 0;
   }
-  if (error->status != 0) {
-    client->semaphore_result = ble_client_convert_ble_code(error->status);
-    xSemaphoreGive(client->semaphore);
+  client->semaphore_result = ble_client_convert_ble_code(error->status);
+  xSemaphoreGive(client->semaphore);
+  return 0;
+}
+
+static esp_err_t ble_client_read_schedule(ble_client *client) {
+  size_t entry_length = sizeof(lora_config_t);
+  if (client->schedule_bytes % entry_length != 0) {
+    ESP_LOGE(TAG, "unexpected schedule length %zu. expected multiple of %zu", client->schedule_bytes, entry_length);
+    return ESP_ERR_INVALID_SIZE;
+  }
+  client->schedule_length = client->schedule_bytes / entry_length;
+  for (size_t i = 0; i < client->schedule_length; i++) {
+    lora_config_t *request = &client->schedule[i];
+    if (request->protocol_version < MIN_REQUEST_PROTOCOL_VERSION || request->protocol_version > PROTOCOL_VERSION) {
+      ESP_LOGE(TAG, "unsupported protocol %d expected %d - %d", request->protocol_version, MIN_REQUEST_PROTOCOL_VERSION, PROTOCOL_VERSION);
+      return ESP_ERR_INVALID_ARG;
+    }
+    request->startTimeMillis = ntohll(request->startTimeMillis);
+    request->endTimeMillis = ntohll(request->endTimeMillis);
+    request->currentTimeMillis = ntohll(request->currentTimeMillis);
+    request->freq = ntohll(request->freq);
+    request->bw = ntohl(request->bw);
+    request->preambleLength = ntohs(request->preambleLength);
+  }
+  return ESP_OK;
+}
+
+// called for every chunk of the long read and once more with BLE_HS_EDONE
+int ble_client_gatt_read_long_fn(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg) {
+  struct ble_client_t *client = (struct ble_client_t *) arg;
+  ESP_LOGD(TAG, "characteristic value response received: %d status: %d", conn_handle, error->status);
+  if (client->conn_handle != conn_handle) {
     return 0;
   }
-  // no observations scheduled
-  if (attr->om == NULL || attr->om->om_len == 0) {
-    client->semaphore_result = ESP_OK;
+  if (error->status == BLE_HS_EDONE) {
+    ESP_LOGI(TAG, "received bytes: %zu", client->schedule_bytes);
+    client->semaphore_result = ble_client_read_schedule(client);
     xSemaphoreGive(client->semaphore);
     return 0;
   }
-  ESP_LOGI(TAG, "received bytes: %d", attr->om->om_len);
-  client->last_request = malloc(sizeof(lora_config_t));
-  if (client->last_request == NULL) {
-    client->semaphore_result = ESP_ERR_NO_MEM;
+  if (error->status != 0) {
+    client->semaphore_result = ble_client_convert_ble_code(error->status);
     xSemaphoreGive(client->semaphore);
     return 0;
   }
-
-  if (attr->om->om_len != sizeof(lora_config_t)) {
-    ESP_LOGE(TAG, "not enough bytes. expected %d", sizeof(lora_config_t));
-    client->semaphore_result = ESP_ERR_NO_MEM;
-    xSemaphoreGive(client->semaphore);
+  // no observations scheduled
+  if (attr->om == NULL || attr->om->om_len == 0) {
     return 0;
   }
-
-  memcpy(client->last_request, attr->om->om_data, sizeof(lora_config_t));
-  if (client->last_request->protocol_version != PROTOCOL_VERSION) {
-    ESP_LOGE(TAG, "unsupported protocol %d expected %d", client->last_request->protocol_version, PROTOCOL_VERSION);
-    client->semaphore_result = ESP_ERR_INVALID_ARG;
+  uint16_t chunk_length = OS_MBUF_PKTLEN(attr->om);
+  if (attr->offset != client->schedule_bytes || client->schedule_bytes + chunk_length > client->schedule_capacity * sizeof(lora_config_t)) {
+    ESP_LOGE(TAG, "schedule doesn't fit. capacity %zu", client->schedule_capacity);
+    client->semaphore_result = ESP_ERR_INVALID_SIZE;
     xSemaphoreGive(client->semaphore);
-    return 0;
+    // stop the procedure. callback is not called anymore
+    return BLE_HS_EDONE;
   }
-  client->last_request->startTimeMillis = ntohll(client->last_request->startTimeMillis);
-  client->last_request->endTimeMillis = ntohll(client->last_request->endTimeMillis);
-  client->last_request->currentTimeMillis = ntohll(client->last_request->currentTimeMillis);
-  client->last_request->freq = ntohll(client->last_request->freq);
-  client->last_request->bw = ntohl(client->last_request->bw);
-  client->last_request->preambleLength = ntohs(client->last_request->preambleLength);
-
-  client->semaphore_result = ESP_OK;
-  xSemaphoreGive(client->semaphore);
+  os_mbuf_copydata(attr->om, 0, chunk_length, ((uint8_t *) client->schedule) + client->schedule_bytes);
+  client->schedule_bytes += chunk_length;
   return 0;
 }
 
@@ -442,27 +474,33 @@ esp_err_t ble_client_get_rssi(ble_client *client, int8_t *rssi) {
   return ble_gap_conn_rssi(client->conn_handle, rssi);
 }
 
-esp_err_t ble_client_load_request(lora_config_t **request, ble_client *client) {
+esp_err_t ble_client_load_schedule(lora_config_t *requests, size_t capacity, size_t *length, ble_client *client) {
   if (CONFIG_BLUETOOTH_POWER_PROFILING > 0) {
     gpio_set_level((gpio_num_t) CONFIG_BLUETOOTH_POWER_PROFILING, 1);
   }
   if (!client->characteristic_found) {
     ERROR_CHECK(ble_client_reconnect(client->address, client));
   }
+  *length = 0;
   client->semaphore_result = ESP_FAIL;
-  client->last_request = NULL;
-  int code = ble_gattc_read(client->conn_handle, client->request_characteristic_handle, ble_client_gatt_attr_fn, client);
+  client->schedule = requests;
+  client->schedule_capacity = capacity;
+  client->schedule_bytes = 0;
+  client->schedule_length = 0;
+  // whole schedule in one procedure. value can be longer than MTU
+  int code = ble_gattc_read_long(client->conn_handle, client->request_characteristic_handle, 0, ble_client_gatt_read_long_fn, client);
   if (code != 0) {
-    ESP_LOGE(TAG, "unable to load request. ble code: %d", code);
+    ESP_LOGE(TAG, "unable to load schedule. ble code: %d", code);
     return ble_client_convert_ble_code(code);
   }
   WAIT_FOR_SYNC("timeout waiting for the data");
   if (client->semaphore_result == ESP_OK) {
-    *request = client->last_request;
+    *length = client->schedule_length;
   }
-  if (*request != NULL) {
-    sx127x_util_log_request(*request);
+  for (size_t i = 0; i < *length; i++) {
+    sx127x_util_log_request(&requests[i]);
   }
+  client->schedule = NULL;
   // assume success route during power profiling
   if (CONFIG_BLUETOOTH_POWER_PROFILING > 0) {
     gpio_set_level((gpio_num_t) CONFIG_BLUETOOTH_POWER_PROFILING, 0);
@@ -483,12 +521,13 @@ esp_err_t ble_client_send_frame(sx127x_frame_t *frame, ble_client *client) {
   length += sizeof(frame->rssi);
   length += sizeof(frame->snr);
   length += sizeof(frame->timestamp);
+  length += sizeof(frame->timestamp_micros);
   length += sizeof(frame->data_length);
   length += frame->data_length;
 
-  uint8_t *message = (uint8_t *) malloc(sizeof(uint8_t) * length);
-  if (message == NULL) {
-    return ESP_ERR_NO_MEM;
+  uint8_t message[FRAME_HEADER_LENGTH + SX127X_UTIL_MAX_PACKET_LENGTH];
+  if (length > sizeof(message)) {
+    return ESP_ERR_INVALID_SIZE;
   }
   size_t offset = 0;
   uint8_t protocol_version = PROTOCOL_VERSION;
@@ -513,6 +552,10 @@ esp_err_t ble_client_send_frame(sx127x_frame_t *frame, ble_client *client) {
   memcpy(message + offset, &timestamp, sizeof(frame->timestamp));
   offset += sizeof(frame->timestamp);
 
+  uint64_t timestamp_micros = htonll(frame->timestamp_micros);
+  memcpy(message + offset, &timestamp_micros, sizeof(frame->timestamp_micros));
+  offset += sizeof(frame->timestamp_micros);
+
   uint16_t data_length_network_encoding = htons(frame->data_length);
   memcpy(message + offset, &data_length_network_encoding, sizeof(frame->data_length));
   offset += sizeof(frame->data_length);
@@ -523,12 +566,14 @@ esp_err_t ble_client_send_frame(sx127x_frame_t *frame, ble_client *client) {
   client->semaphore_result = ESP_FAIL;
   int code = ble_gattc_write_flat(client->conn_handle, client->request_characteristic_handle, message, length, ble_client_gatt_attr_fn, client);
   if (code != 0) {
-    free(message);
     ESP_LOGE(TAG, "unable to send frame. ble code: %d", code);
     return ble_client_convert_ble_code(code);
   }
   WAIT_FOR_SYNC("timeout waiting for writing");
-  free(message);
+  // frames from the journal were received before deep sleep
+  if (frame->interrupt_micros != 0) {
+    at_perf_record(AT_PERF_ISR_TO_BLE, frame->interrupt_stamp);
+  }
   // assume success route during power profiling
   if (CONFIG_BLUETOOTH_POWER_PROFILING > 0) {
     gpio_set_level((gpio_num_t) CONFIG_BLUETOOTH_POWER_PROFILING, 0);
@@ -26,7 +26,8 @@ esp_err_t ble_client_connect(uint8_t *address, ble_client *client);
 
 esp_err_t ble_client_disconnect(ble_client *client);
 
-esp_err_t ble_client_load_request(lora_config_t **request, ble_client *client);
+// reads observations in one long read. a characteristic value is a sequence of lora_config_t
+esp_err_t ble_client_load_schedule(lora_config_t *requests, size_t capacity, size_t *length, ble_client *client);
 
 esp_err_t ble_client_send_frame(sx127x_frame_t *frame, ble_client *client);
 
@@ -16,8 +16,8 @@ esp_err_t ble_client_disconnect(ble_client *client) {
   return ESP_OK;
 }
 
-esp_err_t ble_client_load_request(lora_config_t **request, ble_client *client) {
-  //do nothing
+esp_err_t ble_client_load_schedule(lora_config_t *requests, size_t capacity, size_t *length, ble_client *client) {
+  *length = 0;
   return ESP_OK;
 }
 
@@ -8,8 +8,11 @@
 #include "ble_common.h"
 #include "sdkconfig.h"
 #include "sx127x_util.h"
+#include <at_perf.h>
 
-#define PROTOCOL_VERSION 2
+#define PROTOCOL_VERSION 3
+// protocol_version + frequency_error + rssi + snr + timestamp + timestamp_micros + data_length
+#define FRAME_HEADER_LENGTH (1 + 4 + 2 + 4 + 8 + 8 + 2)
 
 static const char *SX127X_SVC_TAG = "sx127x_svc";
 
@@ -97,11 +100,13 @@ void ble_sx127x_send_frame(sx127x_frame_t *frame) {
   length += sizeof(frame->rssi);
   length += sizeof(frame->snr);
   length += sizeof(frame->timestamp);
+  length += sizeof(frame->timestamp_micros);
   length += sizeof(frame->data_length);
   length += frame->data_length;
 
-  uint8_t *message = (uint8_t *) malloc(sizeof(uint8_t) * length);
-  if (message == NULL) {
+  uint8_t message[FRAME_HEADER_LENGTH + SX127X_UTIL_MAX_PACKET_LENGTH];
+  if (length > sizeof(message)) {
+    ESP_LOGE(SX127X_SVC_TAG, "frame is too big: %d", frame->data_length);
     return;
   }
   size_t offset = 0;
@@ -122,13 +127,16 @@ void ble_sx127x_send_frame(sx127x_frame_t *frame) {
   uint64_t timestamp = htonll(frame->timestamp);
   memcpy(message + offset, &timestamp, sizeof(frame->timestamp));
   offset += sizeof(frame->timestamp);
+  uint64_t timestamp_micros = htonll(frame->timestamp_micros);
+  memcpy(message + offset, &timestamp_micros, sizeof(frame->timestamp_micros));
+  offset += sizeof(frame->timestamp_micros);
   uint16_t data_length_network_order = htons(frame->data_length);
   memcpy(message + offset, &data_length_network_order, sizeof(frame->data_length));
   offset += sizeof(frame->data_length);
   memcpy(message + offset, frame->data, frame->data_length);
 
   ble_server_send_update(ble_server_sx127x_frame_handle, message, length);
-  free(message);
+  at_perf_record(AT_PERF_ISR_TO_BLE, frame->interrupt_stamp);
 }
 
 esp_err_t ble_sx127x_svc_register() {
@@ -0,0 +1,17 @@
+#include "deep_sleep.h"
+#include <stdlib.h>
+#include <inttypes.h>
+#include <esp_log.h>
+
+static const char *TAG = "lora-at";
+
+// there is no wake up on the host. process exits and should be restarted
+void deep_sleep_enter(uint64_t micros_to_wait) {
+  ESP_LOGI(TAG, "entering deep sleep mode for %" PRIu64 " seconds. exit", (micros_to_wait / 1000000));
+  exit(0);
+}
+
+void deep_sleep_rx_enter(uint64_t micros_to_wait) {
+  ESP_LOGI(TAG, "entering rx deep sleep for %" PRIu64 " seconds or first packet. exit", (micros_to_wait / 1000000));
+  exit(0);
+}
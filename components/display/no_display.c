@@ -0,0 +1,49 @@
+#include "display.h"
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+static const char *TAG = "lora-at";
+
+struct lora_at_display_t {
+  char status[10];
+};
+
+esp_err_t lora_at_display_create(lora_at_display **display) {
+  struct lora_at_display_t *result = malloc(sizeof(struct lora_at_display_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  memset(result->status, '\0', sizeof(result->status));
+  *display = result;
+  return ESP_OK;
+}
+
+esp_err_t lora_at_display_start(lora_at_display *display) {
+  //do nothing
+  return ESP_OK;
+}
+
+esp_err_t lora_at_display_stop(lora_at_display *display) {
+  //do nothing
+  return ESP_OK;
+}
+
+esp_err_t lora_at_display_set_status(const char *status, lora_at_display *display) {
+  memset(display->status, '\0', sizeof(display->status));
+  strncpy(display->status, status, sizeof(display->status) - 1);
+  ESP_LOGD(TAG, "status: %s", display->status);
+  return ESP_OK;
+}
+
+esp_err_t lora_at_display_deep_sleep_enter() {
+  //do nothing
+  return ESP_OK;
+}
+
+void lora_at_display_destroy(lora_at_display *display) {
+  if (display == NULL) {
+    return;
+  }
+  free(display);
+}
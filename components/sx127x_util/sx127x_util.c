@@ -13,6 +13,8 @@
 #include <inttypes.h>
 #include <sys/time.h>
 #include <sdkconfig.h>
+#include <at_util.h>
+#include <esp_timer.h>
 
 #define MAX_LOWER_BAND_HZ 525000000
 
@@ -52,6 +54,27 @@
 #define CONFIG_SX127X_POWER_PROFILING -1
 #endif
 
+#ifndef CONFIG_AT_FRAME_POOL_SIZE
+#define CONFIG_AT_FRAME_POOL_SIZE 40
+#endif
+
+#ifndef CONFIG_AT_FRAME_POOL_HEAP_FALLBACK
+#define CONFIG_AT_FRAME_POOL_HEAP_FALLBACK 0
+#endif
+
+#ifndef CONFIG_AT_LARGE_FRAME_POOL_SIZE
+#define CONFIG_AT_LARGE_FRAME_POOL_SIZE 2
+#endif
+
+#ifndef CONFIG_AT_INTERRUPT_TASK_PRIORITY
+#define CONFIG_AT_INTERRUPT_TASK_PRIORITY 2
+#endif
+
+// -1 - the same core where sx127x_util_init was called
+#ifndef CONFIG_AT_INTERRUPT_TASK_CORE
+#define CONFIG_AT_INTERRUPT_TASK_CORE -1
+#endif
+
 #define ERROR_CHECK(x)        \
   do {                        \
     esp_err_t __err_rc = (x); \
@@ -61,20 +84,162 @@
   } while (0)
 
 static const char *TAG = "lora-at";
-TaskHandle_t handle_interrupt;
+static at_util_irq_t interrupt_irq;
+
+typedef struct {
+  sx127x_frame_t frame;
+  uint8_t data[SX127X_UTIL_MAX_PACKET_LENGTH];
+} sx127x_util_frame_slot_t;
+
+// all received frames are stored here until pulled
+// sizeof is a multiple of the slot alignment, so every slot is aligned for 64-bit fields of sx127x_frame_t
+#define FRAME_SLOT_SIZE sizeof(sx127x_util_frame_slot_t)
+static _Alignas(sx127x_util_frame_slot_t) uint8_t frame_arena[FRAME_SLOT_SIZE * CONFIG_AT_FRAME_POOL_SIZE];
+static at_util_pool_t frame_pool;
+
+typedef struct {
+  sx127x_frame_t frame;
+  uint8_t data[SX127X_UTIL_MAX_FSK_PACKET_LENGTH];
+} sx127x_util_large_frame_slot_t;
+
+// fsk packets longer than SX127X_UTIL_MAX_PACKET_LENGTH
+#define LARGE_FRAME_SLOT_SIZE sizeof(sx127x_util_large_frame_slot_t)
+static _Alignas(sx127x_util_large_frame_slot_t) uint8_t large_frame_arena[LARGE_FRAME_SLOT_SIZE * CONFIG_AT_LARGE_FRAME_POOL_SIZE];
+static at_util_pool_t large_frame_pool;
+
+// DIO lines fired since the last run of the interrupt task
+static portMUX_TYPE dio_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t dio_pending = 0;
+static uint32_t dio_interrupts[SX127X_UTIL_DIO_LINES];
+static uint32_t dio_ignored = 0;
+static uint32_t dio_direct = 0;
+// time of the last interrupt on each line. used to timestamp frames and measure delivery latency
+static int64_t dio_micros[SX127X_UTIL_DIO_LINES];
+static at_perf_stamp_t interrupt_stamp;
 
 void IRAM_ATTR sx127x_util_interrupt_fromisr(void *arg) {
-  xTaskResumeFromISR(handle_interrupt);
+  at_perf_stamp_t start = at_perf_now();
+  uint32_t dio = (uint32_t) (uintptr_t) arg;
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL_ISR(&dio_lock);
+  dio_pending |= (1 << dio);
+  dio_interrupts[dio]++;
+  dio_micros[dio] = now;
+  interrupt_stamp = start;
+  portEXIT_CRITICAL_ISR(&dio_lock);
+  BaseType_t woken = at_util_irq_notify_fromisr(&interrupt_irq);
+  at_perf_record(AT_PERF_DIO_ISR, start);
+  portYIELD_FROM_ISR(woken);
+}
+
+uint8_t sx127x_util_dio_take() {
+  portENTER_CRITICAL(&dio_lock);
+  uint8_t result = (uint8_t) dio_pending;
+  dio_pending = 0;
+  portEXIT_CRITICAL(&dio_lock);
+  return result;
+}
+
+// default dio mapping is used for all modes. see "Table 18 DIO Mapping LoRa Mode" and "Table 29 DIO Mapping in Packet Mode"
+static uint8_t sx127x_util_dio_line_events(uint8_t dio, sx127x_modulation_t modulation, sx127x_mode_t mode) {
+  switch (dio) {
+    case 0:
+      if (mode == SX127x_MODE_TX) {
+        return SX127X_UTIL_EVENT_TX_DONE;
+      }
+      if (mode == SX127x_MODE_RX_CONT || mode == SX127x_MODE_RX_SINGLE) {
+        return SX127X_UTIL_EVENT_RX_DONE;
+      }
+      // cad callback switches into rx single directly, so mode might be outdated
+      if (mode == SX127x_MODE_CAD) {
+        return SX127X_UTIL_EVENT_CAD_DONE | SX127X_UTIL_EVENT_RX_DONE;
+      }
+      return SX127X_UTIL_EVENT_UNKNOWN;
+    case 1:
+      if (modulation == SX127x_MODULATION_FSK) {
+        if (mode == SX127x_MODE_TX || mode == SX127x_MODE_RX_CONT) {
+          return SX127X_UTIL_EVENT_FIFO_LEVEL;
+        }
+        return SX127X_UTIL_EVENT_UNKNOWN;
+      }
+      if (mode == SX127x_MODE_TX || mode == SX127x_MODE_RX_CONT) {
+        return SX127X_UTIL_EVENT_NONE;
+      }
+      if (mode == SX127x_MODE_RX_SINGLE || mode == SX127x_MODE_CAD) {
+        return SX127X_UTIL_EVENT_RX_TIMEOUT;
+      }
+      return SX127X_UTIL_EVENT_UNKNOWN;
+    default:
+      // lora: FhssChangeChannel, frequency hopping is not used
+      // fsk: FifoFull is not latched and always follows FifoLevel on DIO1
+      return SX127X_UTIL_EVENT_NONE;
+  }
+}
+
+uint8_t sx127x_util_dio_events(uint8_t dio_mask, sx127x_modulation_t modulation, sx127x_mode_t mode) {
+  uint8_t result = SX127X_UTIL_EVENT_NONE;
+  for (uint8_t i = 0; i < SX127X_UTIL_DIO_LINES; i++) {
+    if (dio_mask & (1 << i)) {
+      result |= sx127x_util_dio_line_events(i, modulation, mode);
+    }
+  }
+  return result;
+}
+
+// RegIrqFlags in lora mode. flags are cleared by writing 1
+#define REG_LORA_IRQ_FLAGS 0x12
+
+static esp_err_t sx127x_util_lora_clear_irq_flags(sx127x_wrapper *device) {
+  spi_transaction_t t = {
+      .addr = REG_LORA_IRQ_FLAGS | 0x80,
+      .length = 8,
+      .flags = SPI_TRANS_USE_TXDATA,
+      .tx_data = {0xFF}};
+  return spi_device_polling_transmit(device->spi, &t);
+}
+
+void sx127x_util_dio_dispatch(uint8_t dio_mask, sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  uint8_t events = sx127x_util_dio_events(dio_mask, device->modulation, device->mode);
+  // edge without any event. irq flags are not read at all
+  if (events == SX127X_UTIL_EVENT_NONE) {
+    dio_ignored++;
+    xSemaphoreGiveRecursive(device->lock);
+    return;
+  }
+  // TxDone is the only lora irq in tx mode, so flags can be cleared without reading them.
+  // other events need irq flags (crc error, cad detected) or fifo state of the sx127x library
+  if (events == SX127X_UTIL_EVENT_TX_DONE && device->modulation == SX127x_MODULATION_LORA && device->tx_callback != NULL && device->spi != NULL) {
+    esp_err_t code = sx127x_util_lora_clear_irq_flags(device);
+    if (code == ESP_OK) {
+      dio_direct++;
+      device->tx_callback(device->device);
+      xSemaphoreGiveRecursive(device->lock);
+      return;
+    }
+    ESP_LOGE(TAG, "can't clear irq flags: %s", esp_err_to_name(code));
+  }
+  // irq flags are decoded by the sx127x library. it also clears them
+  sx127x_handle_interrupt(device->device);
+  xSemaphoreGiveRecursive(device->lock);
 }
 
 void sx127x_util_interrupt_task(void *arg) {
+  sx127x_wrapper *device = (sx127x_wrapper *) arg;
   while (1) {
-    vTaskSuspend(NULL);
-    sx127x_handle_interrupt((sx127x *) arg);
+    // several pending edges are handled together
+    if (at_util_irq_wait(portMAX_DELAY, &interrupt_irq) == 0) {
+      continue;
+    }
+    at_perf_record(AT_PERF_ISR_TO_TASK, interrupt_stamp);
+    at_perf_stamp_t start = at_perf_now();
+    // callbacks can call sx127x_util_* again. the lock is recursive
+    sx127x_util_dio_dispatch(sx127x_util_dio_take(), device);
+    at_perf_record(AT_PERF_INTERRUPT_TASK, start);
   }
 }
 
-void setup_gpio_interrupts(gpio_num_t gpio, sx127x *device, gpio_int_type_t type) {
+void setup_gpio_interrupts(gpio_num_t gpio, uint8_t dio, gpio_int_type_t type) {
   if (gpio == GPIO_NUM_NC) {
     return;
   }
@@ -82,7 +247,7 @@ void setup_gpio_interrupts(gpio_num_t gpio, sx127x *device, gpio_int_type_t type
   gpio_pulldown_en(gpio);
   gpio_pullup_dis(gpio);
   gpio_set_intr_type(gpio, type);
-  gpio_isr_handler_add(gpio, sx127x_util_interrupt_fromisr, (void *) device);
+  gpio_isr_handler_add(gpio, sx127x_util_interrupt_fromisr, (void *) (uintptr_t) dio);
 }
 
 esp_err_t sx127x_util_init(sx127x_wrapper **device) {
@@ -94,6 +259,11 @@ esp_err_t sx127x_util_init(sx127x_wrapper **device) {
   result->modulation = SX127x_MODULATION_FSK;
   result->mode = SX127x_MODE_SLEEP;
   result->temperature = -128;
+  result->lock = xSemaphoreCreateRecursiveMutex();
+  if (result->lock == NULL) {
+    free(result);
+    return SX127X_ERR_NO_MEM;
+  }
   spi_bus_config_t config = {
       .mosi_io_num = CONFIG_PIN_MOSI,
       .miso_io_num = CONFIG_PIN_MISO,
@@ -102,6 +272,8 @@ esp_err_t sx127x_util_init(sx127x_wrapper **device) {
       .quadhd_io_num = -1,
       .max_transfer_sz = 0,
   };
+  ERROR_CHECK(at_util_pool_init(frame_arena, FRAME_SLOT_SIZE, CONFIG_AT_FRAME_POOL_SIZE, &frame_pool));
+  ERROR_CHECK(at_util_pool_init(large_frame_arena, LARGE_FRAME_SLOT_SIZE, CONFIG_AT_LARGE_FRAME_POOL_SIZE, &large_frame_pool));
   ERROR_CHECK(spi_bus_initialize(HSPI_HOST, &config, 1));
   spi_device_interface_config_t dev_cfg = {
       .clock_speed_hz = 3000000,
@@ -114,20 +286,24 @@ esp_err_t sx127x_util_init(sx127x_wrapper **device) {
   spi_device_handle_t spi_device;
   ERROR_CHECK(spi_bus_add_device(HSPI_HOST, &dev_cfg, &spi_device));
   ERROR_CHECK(sx127x_create(spi_device, &result->device));
+  result->spi = spi_device;
 
-  BaseType_t task_code = xTaskCreatePinnedToCore(sx127x_util_interrupt_task, "handle interrupt", 8196, result->device, 2, &handle_interrupt, xPortGetCoreID());
+  at_util_irq_init(&interrupt_irq);
+  BaseType_t core = (CONFIG_AT_INTERRUPT_TASK_CORE < 0 ? xPortGetCoreID() : CONFIG_AT_INTERRUPT_TASK_CORE);
+  BaseType_t task_code = xTaskCreatePinnedToCore(sx127x_util_interrupt_task, "handle interrupt", 8196, result, CONFIG_AT_INTERRUPT_TASK_PRIORITY, &interrupt_irq.task, core);
   if (task_code != pdPASS) {
     ESP_LOGE(TAG, "can't create task %d", task_code);
     sx127x_destroy(result->device);
+    vSemaphoreDelete(result->lock);
     free(result);
     return ESP_ERR_INVALID_STATE;
   }
 
   gpio_install_isr_service(0);
-  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO0, result->device, GPIO_INTR_POSEDGE);
+  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO0, 0, GPIO_INTR_POSEDGE);
   //tx require negedge, rx require posedge
-  //setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO1, result, GPIO_INTR_NEGEDGE);
-  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO2, result->device, GPIO_INTR_POSEDGE);
+  //setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO1, 1, GPIO_INTR_NEGEDGE);
+  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO2, 2, GPIO_INTR_POSEDGE);
 
   if (CONFIG_SX127X_POWER_PROFILING > 0) {
     ESP_LOGI(TAG, "power profiling initialized");
@@ -139,127 +315,227 @@ esp_err_t sx127x_util_init(sx127x_wrapper **device) {
   return SX127X_OK;
 }
 
-esp_err_t sx127x_util_lora_common(lora_config_t *request, sx127x *device) {
-  ERROR_CHECK(sx127x_set_frequency(request->freq, device));
-  ERROR_CHECK(sx127x_lora_reset_fifo(device));
-  sx127x_bw_t bw;
-  if (request->bw == 7800) {
-    bw = SX127x_BW_7800;
-  } else if (request->bw == 10400) {
-    bw = SX127x_BW_10400;
-  } else if (request->bw == 15600) {
-    bw = SX127x_BW_15600;
-  } else if (request->bw == 20800) {
-    bw = SX127x_BW_20800;
-  } else if (request->bw == 31250) {
-    bw = SX127x_BW_31250;
-  } else if (request->bw == 41700) {
-    bw = SX127x_BW_41700;
-  } else if (request->bw == 62500) {
-    bw = SX127x_BW_62500;
-  } else if (request->bw == 125000) {
-    bw = SX127x_BW_125000;
-  } else if (request->bw == 250000) {
-    bw = SX127x_BW_250000;
-  } else if (request->bw == 500000) {
-    bw = SX127x_BW_500000;
+// each bit marks registers that were written and match the shadow copy in sx127x_wrapper
+#define APPLIED_FREQUENCY (1 << 0)
+#define APPLIED_PA (1 << 1)
+#define APPLIED_OCP (1 << 2)
+#define APPLIED_LNA_BOOST (1 << 3)
+#define APPLIED_LNA_GAIN (1 << 4)
+#define APPLIED_LORA_HEADER (1 << 5)
+#define APPLIED_LORA_CODING (1 << 6)
+#define APPLIED_LORA_BANDWIDTH (1 << 7)
+#define APPLIED_LORA_SF (1 << 8)
+#define APPLIED_LORA_SYNCWORD (1 << 9)
+#define APPLIED_LORA_PREAMBLE (1 << 10)
+#define APPLIED_LORA_LDO (1 << 11)
+#define APPLIED_FSK_BITRATE (1 << 12)
+#define APPLIED_FSK_FDEV (1 << 13)
+#define APPLIED_FSK_SYNCWORD (1 << 14)
+#define APPLIED_FSK_ADDRESS_FILTERING (1 << 15)
+#define APPLIED_FSK_PACKET_FORMAT (1 << 16)
+#define APPLIED_FSK_ENCODING (1 << 17)
+#define APPLIED_FSK_DATA_SHAPING (1 << 18)
+#define APPLIED_FSK_CRC (1 << 19)
+#define APPLIED_FSK_PREAMBLE (1 << 20)
+#define APPLIED_FSK_AFC_AUTO (1 << 21)
+#define APPLIED_FSK_AFC_BANDWIDTH (1 << 22)
+#define APPLIED_FSK_RX_BANDWIDTH (1 << 23)
+#define APPLIED_FSK_RX_TRIGGER (1 << 24)
+#define APPLIED_FSK_RSSI_CONFIG (1 << 25)
+#define APPLIED_FSK_PREAMBLE_DETECTOR (1 << 26)
+
+// execute x only if registers were not written yet or value has changed
+#define APPLY_IF_CHANGED(setting, changed, x)                         \
+  do {                                                                \
+    if ((device->applied & (setting)) == (setting) && !(changed)) {   \
+      device->settings_skipped++;                                     \
+      break;                                                          \
+    }                                                                 \
+    device->applied &= ~(setting);                                    \
+    ERROR_CHECK(x);                                                   \
+    device->applied |= (setting);                                     \
+    device->settings_written++;                                       \
+  } while (0)
+
+static esp_err_t sx127x_util_set_modulation(sx127x_modulation_t modulation, sx127x_wrapper *device) {
+  if (device->modulation == modulation) {
+    // registers can be written in sleep or standby modes
+    if (device->mode != SX127x_MODE_SLEEP && device->mode != SX127x_MODE_STANDBY) {
+      ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, modulation, device->device));
+      device->mode = SX127x_MODE_STANDBY;
+    }
+    return ESP_OK;
+  }
+  // modulation can be changed only in sleep mode
+  if (device->mode != SX127x_MODE_SLEEP) {
+    ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
+  }
+  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, modulation, device->device));
+  device->modulation = modulation;
+  device->mode = SX127x_MODE_SLEEP;
+  // lora and fsk registers share the same addresses
+  device->applied = 0;
+  return ESP_OK;
+}
+
+static esp_err_t sx127x_util_set_standby(sx127x_wrapper *device) {
+  if (device->mode == SX127x_MODE_STANDBY) {
+    return ESP_OK;
+  }
+  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, device->modulation, device->device));
+  device->mode = SX127x_MODE_STANDBY;
+  return ESP_OK;
+}
+
+static esp_err_t sx127x_util_lora_bandwidth(uint32_t value, sx127x_bw_t *bw) {
+  if (value == 7800) {
+    *bw = SX127x_BW_7800;
+  } else if (value == 10400) {
+    *bw = SX127x_BW_10400;
+  } else if (value == 15600) {
+    *bw = SX127x_BW_15600;
+  } else if (value == 20800) {
+    *bw = SX127x_BW_20800;
+  } else if (value == 31250) {
+    *bw = SX127x_BW_31250;
+  } else if (value == 41700) {
+    *bw = SX127x_BW_41700;
+  } else if (value == 62500) {
+    *bw = SX127x_BW_62500;
+  } else if (value == 125000) {
+    *bw = SX127x_BW_125000;
+  } else if (value == 250000) {
+    *bw = SX127x_BW_250000;
+  } else if (value == 500000) {
+    *bw = SX127x_BW_500000;
   } else {
-    ESP_LOGE(TAG, "unsupported bw: %" PRIu32, request->bw);
+    ESP_LOGE(TAG, "unsupported bw: %" PRIu32, value);
     return ESP_ERR_INVALID_ARG;
   }
-  ERROR_CHECK(sx127x_lora_set_bandwidth(bw, device));
-  ERROR_CHECK(sx127x_lora_set_modem_config_2((sx127x_sf_t) (request->sf << 4), device));
-  ERROR_CHECK(sx127x_lora_set_syncword(request->syncWord, device));
-  ERROR_CHECK(sx127x_set_preamble_length(request->preambleLength, device));
-  // force ldo settings
-  if (request->ldo == LDO_ON) {
-    return sx127x_lora_set_low_datarate_optimization(true, device);
-  } else if (request->ldo == LDO_OFF) {
-    return sx127x_lora_set_low_datarate_optimization(false, device);
-  }
-  return SX127X_OK;
+  return ESP_OK;
 }
 
-esp_err_t sx127x_util_lora_rx(sx127x_mode_t opmod, lora_config_t *req, sx127x_wrapper *device) {
-  if (device->modulation != SX127x_MODULATION_LORA) {
-    ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
+static esp_err_t sx127x_util_lna_boost(uint64_t freq, sx127x_wrapper *device) {
+  bool lna_boost_hf = (freq > MAX_LOWER_BAND_HZ);
+  APPLY_IF_CHANGED(APPLIED_LNA_BOOST, device->lna_boost_hf != lna_boost_hf, sx127x_rx_set_lna_boost_hf(lna_boost_hf, device->device));
+  device->lna_boost_hf = lna_boost_hf;
+  return ESP_OK;
+}
+
+static esp_err_t sx127x_util_pa(uint8_t pin, int8_t power, int16_t ocp, sx127x_wrapper *device, uint8_t *shadow_pin, int8_t *shadow_power, int16_t *shadow_ocp) {
+  APPLY_IF_CHANGED(APPLIED_PA, *shadow_pin != pin || *shadow_power != power, sx127x_tx_set_pa_config(pin << 7, power, device->device));
+  *shadow_pin = pin;
+  *shadow_power = power;
+  if (ocp > 0) {
+    APPLY_IF_CHANGED(APPLIED_OCP, *shadow_ocp != ocp, sx127x_tx_set_ocp(true, (uint8_t) ocp, device->device));
+    *shadow_ocp = ocp;
   }
-  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_LORA, device->device));
-  device->modulation = SX127x_MODULATION_LORA;
-  device->mode = SX127x_MODE_SLEEP;
+  return ESP_OK;
+}
+
+static esp_err_t sx127x_util_lora_apply(lora_config_t *req, bool tx, sx127x_wrapper *device) {
+  sx127x_bw_t bw;
+  ERROR_CHECK(sx127x_util_lora_bandwidth(req->bw, &bw));
+  lora_config_t *shadow = &device->lora_config;
+  APPLY_IF_CHANGED(APPLIED_FREQUENCY, shadow->freq != req->freq, sx127x_set_frequency(req->freq, device->device));
+  shadow->freq = req->freq;
   if (req->useExplicitHeader) {
-    ERROR_CHECK(sx127x_lora_set_implicit_header(NULL, device->device));
+    APPLY_IF_CHANGED(APPLIED_LORA_HEADER, !shadow->useExplicitHeader, sx127x_lora_set_implicit_header(NULL, device->device));
+    shadow->useExplicitHeader = 1;
+    if (tx) {
+      sx127x_tx_header_t header = {
+          .enable_crc = req->useCrc,
+          .coding_rate = ((sx127x_cr_t) (req->cr - 4)) << 1
+      };
+      APPLY_IF_CHANGED(APPLIED_LORA_CODING, shadow->cr != req->cr || shadow->useCrc != req->useCrc, sx127x_lora_tx_set_explicit_header(&header, device->device));
+      shadow->cr = req->cr;
+      shadow->useCrc = req->useCrc;
+    }
   } else {
     sx127x_implicit_header_t header = {
         .coding_rate = ((sx127x_cr_t) (req->cr - 4)) << 1,
         .enable_crc = req->useCrc,
         .length = req->length};
-    ERROR_CHECK(sx127x_lora_set_implicit_header(&header, device->device));
+    APPLY_IF_CHANGED(APPLIED_LORA_HEADER | APPLIED_LORA_CODING, shadow->useExplicitHeader || shadow->cr != req->cr || shadow->useCrc != req->useCrc || shadow->length != req->length, sx127x_lora_set_implicit_header(&header, device->device));
+    shadow->useExplicitHeader = 0;
+    shadow->cr = req->cr;
+    shadow->useCrc = req->useCrc;
+    shadow->length = req->length;
+  }
+  // low data rate optimization is re-calculated when bandwidth or spreading factor are set
+  if (shadow->bw != req->bw || shadow->sf != req->sf || shadow->ldo != req->ldo) {
+    device->applied &= ~(APPLIED_LORA_BANDWIDTH | APPLIED_LORA_SF | APPLIED_LORA_LDO);
+  }
+  APPLY_IF_CHANGED(APPLIED_LORA_BANDWIDTH, false, sx127x_lora_set_bandwidth(bw, device->device));
+  shadow->bw = req->bw;
+  APPLY_IF_CHANGED(APPLIED_LORA_SF, false, sx127x_lora_set_modem_config_2((sx127x_sf_t) (req->sf << 4), device->device));
+  shadow->sf = req->sf;
+  APPLY_IF_CHANGED(APPLIED_LORA_SYNCWORD, shadow->syncWord != req->syncWord, sx127x_lora_set_syncword(req->syncWord, device->device));
+  shadow->syncWord = req->syncWord;
+  APPLY_IF_CHANGED(APPLIED_LORA_PREAMBLE, shadow->preambleLength != req->preambleLength, sx127x_set_preamble_length(req->preambleLength, device->device));
+  shadow->preambleLength = req->preambleLength;
+  // force ldo settings
+  if (req->ldo == LDO_ON || req->ldo == LDO_OFF) {
+    APPLY_IF_CHANGED(APPLIED_LORA_LDO, false, sx127x_lora_set_low_datarate_optimization(req->ldo == LDO_ON, device->device));
   }
-  ERROR_CHECK(sx127x_util_lora_common(req, device->device));
-  if (req->freq > MAX_LOWER_BAND_HZ) {
-    ERROR_CHECK(sx127x_rx_set_lna_boost_hf(true, device->device));
-  } else {
-    ERROR_CHECK(sx127x_rx_set_lna_boost_hf(false, device->device));
+  shadow->ldo = req->ldo;
+  if (tx) {
+    return sx127x_util_pa(req->pin, req->power, req->ocp, device, &shadow->pin, &shadow->power, &shadow->ocp);
   }
-  ERROR_CHECK(sx127x_rx_set_lna_gain((sx127x_gain_t) (req->gain << 5), device->device));
+  ERROR_CHECK(sx127x_util_lna_boost(req->freq, device));
+  APPLY_IF_CHANGED(APPLIED_LNA_GAIN, shadow->gain != req->gain, sx127x_rx_set_lna_gain((sx127x_gain_t) (req->gain << 5), device->device));
+  shadow->gain = req->gain;
+  return ESP_OK;
+}
+
+static esp_err_t sx127x_util_lora_rx_locked(sx127x_mode_t opmod, lora_config_t *req, sx127x_wrapper *device) {
+  ERROR_CHECK(sx127x_util_set_modulation(SX127x_MODULATION_LORA, device));
+  ERROR_CHECK(sx127x_util_lora_apply(req, false, device));
+  ERROR_CHECK(sx127x_lora_reset_fifo(device->device));
   int result = sx127x_set_opmod(opmod, SX127x_MODULATION_LORA, device->device);
   if (result == SX127X_OK) {
+    device->lora_rx_config = *req;
     device->mode = opmod;
     ESP_LOGI(TAG, "rx started on %" PRIu64, req->freq);
   }
   return result;
 }
 
-esp_err_t sx127x_util_lora_tx(uint8_t *data, uint8_t data_length, lora_config_t *req, sx127x_wrapper *device) {
-  if (device->modulation != SX127x_MODULATION_LORA) {
-    ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
-  }
-  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_LORA, device->device));
-  device->modulation = SX127x_MODULATION_LORA;
-  device->mode = SX127x_MODE_SLEEP;
-  if (req->useExplicitHeader) {
-    ERROR_CHECK(sx127x_lora_set_implicit_header(NULL, device->device));
-    sx127x_tx_header_t header = {
-        .enable_crc = req->useCrc,
-        .coding_rate = ((sx127x_cr_t) (req->cr - 4)) << 1
-    };
-    ERROR_CHECK(sx127x_lora_tx_set_explicit_header(&header, device->device));
-  } else {
-    sx127x_implicit_header_t header = {
-        .coding_rate = ((sx127x_cr_t) (req->cr - 4)) << 1,
-        .enable_crc = req->useCrc,
-        .length = req->length};
-    ERROR_CHECK(sx127x_lora_set_implicit_header(&header, device->device));
-  }
-  ERROR_CHECK(sx127x_util_lora_common(req, device->device));
-  ERROR_CHECK(sx127x_tx_set_pa_config(req->pin << 7, req->power, device->device));
-  if (req->ocp > 0) {
-    ERROR_CHECK(sx127x_tx_set_ocp(true, (uint8_t) req->ocp, device->device));
-  }
-  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, SX127x_MODULATION_LORA, device->device));
+esp_err_t sx127x_util_lora_rx(sx127x_mode_t opmod, lora_config_t *req, sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_lora_rx_locked(opmod, req, device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+static esp_err_t sx127x_util_lora_tx_locked(uint8_t *data, uint8_t data_length, lora_config_t *req, sx127x_wrapper *device) {
+  ERROR_CHECK(sx127x_util_set_modulation(SX127x_MODULATION_LORA, device));
+  ERROR_CHECK(sx127x_util_lora_apply(req, true, device));
+  ERROR_CHECK(sx127x_lora_reset_fifo(device->device));
+  // fifo is not accessible in sleep mode
+  ERROR_CHECK(sx127x_util_set_standby(device));
   ERROR_CHECK(sx127x_lora_tx_set_for_transmission(data, data_length, device->device));
   if (CONFIG_SX127X_POWER_PROFILING > 0) {
     gpio_set_level((gpio_num_t) CONFIG_SX127X_POWER_PROFILING, 1);
   }
   int result = sx127x_set_opmod(SX127x_MODE_TX, SX127x_MODULATION_LORA, device->device);
   if (result == SX127X_OK) {
+    device->mode = SX127x_MODE_TX;
     ESP_LOGI(TAG, "transmitting %d bytes on %" PRIu64, data_length, req->freq);
   }
   return result;
 }
 
-esp_err_t sx127x_util_common_fsk(fsk_config_t *config, sx127x *device) {
-  ERROR_CHECK(sx127x_set_frequency(config->freq, device));
-  ERROR_CHECK(sx127x_fsk_ook_set_bitrate(config->bitrate, device));
-  ERROR_CHECK(sx127x_fsk_set_fdev(config->freq_deviation, device));
-  ERROR_CHECK(sx127x_fsk_ook_set_syncword(config->syncword, config->syncword_length, device));
-  ERROR_CHECK(sx127x_fsk_ook_set_address_filtering(SX127X_FILTER_NONE, 0, 0, device));
-  ERROR_CHECK(sx127x_fsk_ook_set_packet_encoding((config->encoding << 5), device));
-  ERROR_CHECK(sx127x_fsk_ook_set_packet_format(SX127X_VARIABLE, 255, device));
-  ERROR_CHECK(sx127x_fsk_set_data_shaping((config->data_shaping << 5), SX127X_PA_RAMP_10, device));
+esp_err_t sx127x_util_lora_tx(uint8_t *data, uint8_t data_length, lora_config_t *req, sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_lora_tx_locked(data, data_length, req, device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+static esp_err_t sx127x_util_fsk_apply(fsk_config_t *req, bool tx, sx127x_wrapper *device) {
   sx127x_crc_type_t crc;
-  switch (config->crc) {
+  switch (req->crc) {
     case 0:
       crc = SX127X_CRC_NONE;
       break;
@@ -272,32 +548,57 @@ esp_err_t sx127x_util_common_fsk(fsk_config_t *config, sx127x *device) {
     default:
       return ESP_ERR_INVALID_ARG;
   }
-  ERROR_CHECK(sx127x_fsk_ook_set_crc(crc, device));
-  return SX127X_OK;
+  if (req->syncword_length > sizeof(device->fsk_syncword)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  fsk_config_t *shadow = &device->fsk_config;
+  APPLY_IF_CHANGED(APPLIED_FREQUENCY, shadow->freq != req->freq, sx127x_set_frequency(req->freq, device->device));
+  shadow->freq = req->freq;
+  APPLY_IF_CHANGED(APPLIED_FSK_BITRATE, shadow->bitrate != req->bitrate, sx127x_fsk_ook_set_bitrate(req->bitrate, device->device));
+  shadow->bitrate = req->bitrate;
+  APPLY_IF_CHANGED(APPLIED_FSK_FDEV, shadow->freq_deviation != req->freq_deviation, sx127x_fsk_set_fdev(req->freq_deviation, device->device));
+  shadow->freq_deviation = req->freq_deviation;
+  APPLY_IF_CHANGED(APPLIED_FSK_SYNCWORD, shadow->syncword_length != req->syncword_length || memcmp(device->fsk_syncword, req->syncword, req->syncword_length) != 0, sx127x_fsk_ook_set_syncword(req->syncword, req->syncword_length, device->device));
+  memcpy(device->fsk_syncword, req->syncword, req->syncword_length);
+  shadow->syncword = device->fsk_syncword;
+  shadow->syncword_length = req->syncword_length;
+  APPLY_IF_CHANGED(APPLIED_FSK_ADDRESS_FILTERING, false, sx127x_fsk_ook_set_address_filtering(SX127X_FILTER_NONE, 0, 0, device->device));
+  APPLY_IF_CHANGED(APPLIED_FSK_ENCODING, shadow->encoding != req->encoding, sx127x_fsk_ook_set_packet_encoding((req->encoding << 5), device->device));
+  shadow->encoding = req->encoding;
+  // fifo is serviced on FifoLevel interrupts (DIO1), so fixed length packets can be longer than fifo
+  APPLY_IF_CHANGED(APPLIED_FSK_PACKET_FORMAT, shadow->packet_length != req->packet_length,
+                   sx127x_fsk_ook_set_packet_format((req->packet_length == 0 ? SX127X_VARIABLE : SX127X_FIXED), (req->packet_length == 0 ? SX127X_UTIL_MAX_PACKET_LENGTH : req->packet_length), device->device));
+  shadow->packet_length = req->packet_length;
+  APPLY_IF_CHANGED(APPLIED_FSK_DATA_SHAPING, shadow->data_shaping != req->data_shaping, sx127x_fsk_set_data_shaping((req->data_shaping << 5), SX127X_PA_RAMP_10, device->device));
+  shadow->data_shaping = req->data_shaping;
+  APPLY_IF_CHANGED(APPLIED_FSK_CRC, shadow->crc != req->crc, sx127x_fsk_ook_set_crc(crc, device->device));
+  shadow->crc = req->crc;
+  if (tx) {
+    APPLY_IF_CHANGED(APPLIED_FSK_PREAMBLE, shadow->preamble != req->preamble, sx127x_set_preamble_length(req->preamble, device->device));
+    shadow->preamble = req->preamble;
+    return sx127x_util_pa(req->pin, req->power, req->ocp, device, &shadow->pin, &shadow->power, &shadow->ocp);
+  }
+  APPLY_IF_CHANGED(APPLIED_FSK_AFC_AUTO, false, sx127x_fsk_ook_rx_set_afc_auto(true, device->device));
+  APPLY_IF_CHANGED(APPLIED_FSK_AFC_BANDWIDTH, shadow->rx_afc_bandwidth != req->rx_afc_bandwidth, sx127x_fsk_ook_rx_set_afc_bandwidth(req->rx_afc_bandwidth, device->device));
+  shadow->rx_afc_bandwidth = req->rx_afc_bandwidth;
+  APPLY_IF_CHANGED(APPLIED_FSK_RX_BANDWIDTH, shadow->rx_bandwidth != req->rx_bandwidth, sx127x_fsk_ook_rx_set_bandwidth(req->rx_bandwidth, device->device));
+  shadow->rx_bandwidth = req->rx_bandwidth;
+  APPLY_IF_CHANGED(APPLIED_FSK_RX_TRIGGER, false, sx127x_fsk_ook_rx_set_trigger(SX127X_RX_TRIGGER_RSSI_PREAMBLE, device->device));
+  APPLY_IF_CHANGED(APPLIED_FSK_RSSI_CONFIG, false, sx127x_fsk_ook_rx_set_rssi_config(SX127X_8, 0, device->device));
+  APPLY_IF_CHANGED(APPLIED_FSK_PREAMBLE_DETECTOR, false, sx127x_fsk_ook_rx_set_preamble_detector(true, 2, 0x0A, device->device));
+  ERROR_CHECK(sx127x_util_lna_boost(req->freq, device));
+  // manual gain don't start FSK Receiver
+  APPLY_IF_CHANGED(APPLIED_LNA_GAIN, false, sx127x_rx_set_lna_gain(SX127x_LNA_GAIN_AUTO, device->device));
+  return ESP_OK;
 }
 
-esp_err_t sx127x_util_fsk_rx(fsk_config_t *req, sx127x_wrapper *device) {
-  if (device->modulation != SX127x_MODULATION_FSK) {
-    ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
-  }
-  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_FSK, device->device));
-  device->modulation = SX127x_MODULATION_FSK;
-  device->mode = SX127x_MODE_SLEEP;
-  ERROR_CHECK(sx127x_util_common_fsk(req, device->device));
-  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO1, device->device, GPIO_INTR_POSEDGE);
-  ERROR_CHECK(sx127x_fsk_ook_rx_set_afc_auto(true, device->device));
-  ERROR_CHECK(sx127x_fsk_ook_rx_set_afc_bandwidth(req->rx_afc_bandwidth, device->device));
-  ERROR_CHECK(sx127x_fsk_ook_rx_set_bandwidth(req->rx_bandwidth, device->device));
-  ERROR_CHECK(sx127x_fsk_ook_rx_set_trigger(SX127X_RX_TRIGGER_RSSI_PREAMBLE, device->device));
-  ERROR_CHECK(sx127x_fsk_ook_rx_set_rssi_config(SX127X_8, 0, device->device));
-  ERROR_CHECK(sx127x_fsk_ook_rx_set_preamble_detector(true, 2, 0x0A, device->device));
-  if (req->freq > MAX_LOWER_BAND_HZ) {
-    ERROR_CHECK(sx127x_rx_set_lna_boost_hf(true, device->device));
-  } else {
-    ERROR_CHECK(sx127x_rx_set_lna_boost_hf(false, device->device));
+static esp_err_t sx127x_util_fsk_rx_locked(fsk_config_t *req, sx127x_wrapper *device) {
+  if (req->packet_length > SX127X_UTIL_MAX_FSK_PACKET_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
   }
-  // manual gain don't start FSK Receiver
-  ERROR_CHECK(sx127x_rx_set_lna_gain(SX127x_LNA_GAIN_AUTO, device->device));
+  ERROR_CHECK(sx127x_util_set_modulation(SX127x_MODULATION_FSK, device));
+  ERROR_CHECK(sx127x_util_fsk_apply(req, false, device));
+  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO1, 1, GPIO_INTR_POSEDGE);
   int result = sx127x_set_opmod(SX127x_MODE_RX_CONT, SX127x_MODULATION_FSK, device->device);
   if (result == SX127X_OK) {
     device->mode = SX127x_MODE_RX_CONT;
@@ -306,44 +607,106 @@ esp_err_t sx127x_util_fsk_rx(fsk_config_t *req, sx127x_wrapper *device) {
   return result;
 }
 
-esp_err_t sx127x_util_fsk_tx(uint8_t *data, size_t data_length, fsk_config_t *req, sx127x_wrapper *device) {
-  if (device->modulation != SX127x_MODULATION_FSK) {
-    ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
-  }
-  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_FSK, device->device));
-  device->modulation = SX127x_MODULATION_FSK;
-  device->mode = SX127x_MODE_SLEEP;
-  ERROR_CHECK(sx127x_util_common_fsk(req, device->device));
-  ERROR_CHECK(sx127x_set_preamble_length(req->preamble, device->device));
-  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO1, device->device, GPIO_INTR_NEGEDGE);
-  ERROR_CHECK(sx127x_tx_set_pa_config(req->pin << 7, req->power, device->device));
-  if (req->ocp > 0) {
-    ERROR_CHECK(sx127x_tx_set_ocp(true, (uint8_t) req->ocp, device->device));
-  }
-  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, SX127x_MODULATION_FSK, device->device));
+esp_err_t sx127x_util_fsk_rx(fsk_config_t *req, sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_fsk_rx_locked(req, device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+static esp_err_t sx127x_util_fsk_tx_locked(uint8_t *data, size_t data_length, fsk_config_t *req, sx127x_wrapper *device) {
+  // variable length is limited by the length byte. fixed length should match the data
+  if ((req->packet_length == 0 && data_length > SX127X_UTIL_MAX_PACKET_LENGTH) || (req->packet_length != 0 && req->packet_length != data_length) || data_length > SX127X_UTIL_MAX_FSK_PACKET_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  ERROR_CHECK(sx127x_util_set_modulation(SX127x_MODULATION_FSK, device));
+  ERROR_CHECK(sx127x_util_fsk_apply(req, true, device));
+  setup_gpio_interrupts((gpio_num_t) CONFIG_PIN_DIO1, 1, GPIO_INTR_NEGEDGE);
+  ERROR_CHECK(sx127x_util_set_standby(device));
   ERROR_CHECK(sx127x_fsk_ook_tx_set_for_transmission(data, data_length, device->device));
   if (CONFIG_SX127X_POWER_PROFILING > 0) {
     gpio_set_level((gpio_num_t) CONFIG_SX127X_POWER_PROFILING, 1);
   }
   int result = sx127x_set_opmod(SX127x_MODE_TX, SX127x_MODULATION_FSK, device->device);
   if (result == SX127X_OK) {
+    device->mode = SX127x_MODE_TX;
     ESP_LOGI(TAG, "transmitting %d bytes on %" PRIu64, data_length, req->freq);
   }
   return result;
 }
 
-esp_err_t sx127x_util_read_frame(sx127x_wrapper *device, uint8_t *data, uint16_t data_length, sx127x_frame_t **frame) {
-  sx127x_frame_t *result = malloc(sizeof(sx127x_frame_t));
+esp_err_t sx127x_util_fsk_tx(uint8_t *data, size_t data_length, fsk_config_t *req, sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_fsk_tx_locked(data, data_length, req, device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+static sx127x_frame_t *sx127x_util_frame_create(uint16_t data_length) {
+  if (data_length <= SX127X_UTIL_MAX_PACKET_LENGTH) {
+    sx127x_util_frame_slot_t *slot = at_util_pool_acquire(&frame_pool);
+    if (slot != NULL) {
+      slot->frame.data = slot->data;
+      return &slot->frame;
+    }
+    if (!CONFIG_AT_FRAME_POOL_HEAP_FALLBACK) {
+      return NULL;
+    }
+  } else if (data_length <= SX127X_UTIL_MAX_FSK_PACKET_LENGTH) {
+    sx127x_util_large_frame_slot_t *slot = at_util_pool_acquire(&large_frame_pool);
+    if (slot != NULL) {
+      slot->frame.data = slot->data;
+      return &slot->frame;
+    }
+    if (!CONFIG_AT_FRAME_POOL_HEAP_FALLBACK) {
+      return NULL;
+    }
+  }
+  // single allocation for both frame and data
+  sx127x_frame_t *result = malloc(sizeof(sx127x_frame_t) + sizeof(uint8_t) * data_length);
   if (result == NULL) {
-    return ESP_ERR_NO_MEM;
+    return NULL;
   }
-  result->data_length = data_length;
-  result->data = malloc(sizeof(uint8_t) * result->data_length);
-  if (result->data == NULL) {
-    sx127x_util_frame_destroy(result);
+  result->data = (uint8_t *) (result + 1);
+  return result;
+}
+
+uint32_t sx127x_util_lora_time_after_preamble(const lora_config_t *config, uint16_t data_length) {
+  if (config->bw == 0 || config->sf < 6 || config->sf > 12) {
+    return 0;
+  }
+  // see "4.1.1.7. Time on air" in the datasheet
+  uint64_t symbol_nanos = ((uint64_t) 1 << config->sf) * 1000000000 / config->bw;
+  // low data rate optimization is mandated when symbol is longer than 16ms
+  bool ldo = (config->ldo == LDO_ON || (config->ldo == LDO_AUTO && symbol_nanos > 16000000));
+  int32_t bits = 8 * data_length - 4 * config->sf + 28 + 16 * (config->useCrc ? 1 : 0) - 20 * (config->useExplicitHeader ? 0 : 1);
+  int32_t bits_per_block = 4 * (config->sf - 2 * (ldo ? 1 : 0));
+  uint8_t cr = (config->cr < 5 || config->cr > 8 ? 5 : config->cr);
+  uint32_t symbols = 8;
+  if (bits > 0) {
+    symbols += (bits + bits_per_block - 1) / bits_per_block * cr;
+  }
+  return (uint32_t) (symbols * symbol_nanos / 1000);
+}
+
+uint32_t sx127x_util_fsk_time_after_preamble(const fsk_config_t *config, uint16_t data_length) {
+  if (config->bitrate == 0) {
+    return 0;
+  }
+  // sync word, length byte for variable packet format, payload and crc
+  uint64_t bits = 8 * ((uint64_t) config->syncword_length + (config->packet_length == 0 ? 1 : 0) + data_length + (config->crc != 0 ? 2 : 0));
+  return (uint32_t) (bits * 1000000 / config->bitrate);
+}
+
+static esp_err_t sx127x_util_read_frame_locked(sx127x_wrapper *device, uint8_t *data, uint16_t data_length, sx127x_frame_t **frame) {
+  at_perf_stamp_t start = at_perf_now();
+  sx127x_frame_t *result = sx127x_util_frame_create(data_length);
+  if (result == NULL) {
     return ESP_ERR_NO_MEM;
   }
+  result->data_length = data_length;
   memcpy(result->data, data, sizeof(uint8_t) * result->data_length);
+  result->channel = -1;
   int32_t frequency_error;
   esp_err_t code = sx127x_rx_get_frequency_error(device->device, &frequency_error);
   if (code == ESP_OK) {
@@ -373,14 +736,38 @@ esp_err_t sx127x_util_read_frame(sx127x_wrapper *device, uint8_t *data, uint16_t
   } else {
     result->snr = -255;
   }
+  // RxDone and PayloadReady are mapped to DIO0. DIO1 fires while fifo is drained
+  portENTER_CRITICAL(&dio_lock);
+  result->interrupt_micros = dio_micros[0];
+  result->interrupt_stamp = interrupt_stamp;
+  portEXIT_CRITICAL(&dio_lock);
+  // convert time of the interrupt into wall clock, so spi reads above don't add jitter
   struct timeval tm_vl;
   gettimeofday(&tm_vl, NULL);
+  int64_t elapsed = esp_timer_get_time() - result->interrupt_micros;
   uint64_t now_micros = tm_vl.tv_sec * 1000000 + tm_vl.tv_usec;
-  result->timestamp = now_micros / 1000;
+  uint64_t interrupt_micros = (result->interrupt_micros == 0 || elapsed < 0 ? now_micros : now_micros - elapsed);
+  result->timestamp = interrupt_micros / 1000;
+  uint32_t after_preamble;
+  if (device->modulation == SX127x_MODULATION_LORA) {
+    after_preamble = sx127x_util_lora_time_after_preamble(&device->lora_rx_config, data_length);
+  } else {
+    after_preamble = sx127x_util_fsk_time_after_preamble(&device->fsk_config, data_length);
+  }
+  result->timestamp_micros = interrupt_micros - after_preamble;
+  at_perf_record(AT_PERF_READ_FRAME, start);
+  at_perf_record(AT_PERF_ISR_TO_FRAME, result->interrupt_stamp);
   *frame = result;
   return ESP_OK;
 }
 
+esp_err_t sx127x_util_read_frame(sx127x_wrapper *device, uint8_t *data, uint16_t data_length, sx127x_frame_t **frame) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_read_frame_locked(device, data, data_length, frame);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
 uint64_t sx127x_util_get_min_frequency() {
   return CONFIG_MIN_FREQUENCY;
 }
@@ -404,9 +791,11 @@ esp_err_t sx127x_util_reset() {
   return ESP_OK;
 }
 
-esp_err_t sx127x_util_deep_sleep_enter(sx127x_wrapper *device) {
+static esp_err_t sx127x_util_deep_sleep_enter_locked(sx127x_wrapper *device) {
   ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, SX127x_MODULATION_LORA, device->device));
   ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_LORA, device->device));
+  device->mode = SX127x_MODE_SLEEP;
+  device->applied = 0;
   int8_t pins[] = {
       CONFIG_PIN_CS,
       CONFIG_PIN_MOSI,
@@ -433,18 +822,95 @@ esp_err_t sx127x_util_deep_sleep_enter(sx127x_wrapper *device) {
   return gpio_config(&conf);
 }
 
-esp_err_t sx127x_util_stop_rx(sx127x_wrapper *device) {
+esp_err_t sx127x_util_deep_sleep_enter(sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_deep_sleep_enter_locked(device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+void sx127x_util_reset_state(sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  // chip is in fsk standby mode after reset
+  device->modulation = SX127x_MODULATION_FSK;
+  device->mode = SX127x_MODE_STANDBY;
+  device->applied = 0;
+  xSemaphoreGiveRecursive(device->lock);
+}
+
+esp_err_t sx127x_util_restart(sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_reset();
+  sx127x_util_reset_state(device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+void sx127x_util_tx_set_callback(void (*tx_callback)(sx127x *), sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  device->tx_callback = tx_callback;
+  sx127x_tx_set_callback(tx_callback, device->device);
+  xSemaphoreGiveRecursive(device->lock);
+}
+
+void sx127x_util_tx_done(sx127x_wrapper *device) {
+  if (CONFIG_SX127X_POWER_PROFILING > 0) {
+    gpio_set_level((gpio_num_t) CONFIG_SX127X_POWER_PROFILING, 0);
+  }
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  if (device->mode == SX127x_MODE_TX) {
+    device->mode = SX127x_MODE_STANDBY;
+  }
+  xSemaphoreGiveRecursive(device->lock);
+}
+
+static esp_err_t sx127x_util_stop_rx_locked(sx127x_wrapper *device) {
   ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
   device->mode = SX127x_MODE_SLEEP;
   return ESP_OK;
 }
 
-esp_err_t sx127x_util_read_temperature(sx127x_wrapper *device, int8_t *temperature) {
-  if (device->mode != SX127x_MODE_SLEEP) {
+static esp_err_t sx127x_util_tx_abort_locked(sx127x_wrapper *device) {
+  ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, device->modulation, device->device));
+  device->mode = SX127x_MODE_STANDBY;
+  // fsk PacketSent is cleared when leaving tx
+  if (device->modulation == SX127x_MODULATION_LORA && device->spi != NULL) {
+    ERROR_CHECK(sx127x_util_lora_clear_irq_flags(device));
+  }
+  // edge from the aborted transmission shouldn't be handled as TxDone of the next one
+  sx127x_util_dio_take();
+  return ESP_OK;
+}
+
+esp_err_t sx127x_util_tx_abort(sx127x_wrapper *device) {
+  if (CONFIG_SX127X_POWER_PROFILING > 0) {
+    gpio_set_level((gpio_num_t) CONFIG_SX127X_POWER_PROFILING, 0);
+  }
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_tx_abort_locked(device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+esp_err_t sx127x_util_stop_rx(sx127x_wrapper *device) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_stop_rx_locked(device);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
+static esp_err_t sx127x_util_read_temperature_locked(sx127x_wrapper *device, int8_t *temperature) {
+  if (device->mode != SX127x_MODE_SLEEP && device->mode != SX127x_MODE_STANDBY) {
     // read cached if RX is currently running
     *temperature = device->temperature;
     return ESP_OK;
   }
+  // temperature sensor uses fsk registers
+  device->applied = 0;
+  if (device->mode == SX127x_MODE_STANDBY) {
+    // modulation can be changed only in sleep mode
+    ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, device->modulation, device->device));
+  }
   ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_FSK, device->device));
   ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_FSRX, SX127x_MODULATION_FSK, device->device));
   ERROR_CHECK(sx127x_fsk_ook_set_temp_monitor(true, device->device));
@@ -458,6 +924,13 @@ esp_err_t sx127x_util_read_temperature(sx127x_wrapper *device, int8_t *temperatu
   return result;
 }
 
+esp_err_t sx127x_util_read_temperature(sx127x_wrapper *device, int8_t *temperature) {
+  xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+  esp_err_t result = sx127x_util_read_temperature_locked(device, temperature);
+  xSemaphoreGiveRecursive(device->lock);
+  return result;
+}
+
 void sx127x_util_log_request(lora_config_t *req) {
   char buf[80];
   struct tm *ts;
@@ -482,8 +955,35 @@ void sx127x_util_frame_destroy(sx127x_frame_t *frame) {
   if (frame == NULL) {
     return;
   }
-  if (frame->data != NULL) {
-    free(frame->data);
+  if (at_util_pool_owns(frame, &frame_pool)) {
+    at_util_pool_release(frame, &frame_pool);
+  } else if (at_util_pool_owns(frame, &large_frame_pool)) {
+    at_util_pool_release(frame, &large_frame_pool);
+  } else {
+    free(frame);
   }
-  free(frame);
+}
+
+void sx127x_util_interrupt_stats(at_util_irq_t *stats) {
+  *stats = interrupt_irq;
+}
+
+void sx127x_util_dio_stats(sx127x_util_dio_stats_t *stats) {
+  portENTER_CRITICAL(&dio_lock);
+  for (uint8_t i = 0; i < SX127X_UTIL_DIO_LINES; i++) {
+    stats->interrupts[i] = dio_interrupts[i];
+    stats->last_micros[i] = dio_micros[i];
+  }
+  portEXIT_CRITICAL(&dio_lock);
+  stats->ignored = dio_ignored;
+  stats->direct = dio_direct;
+}
+
+void sx127x_util_frame_pool_stats(sx127x_util_frame_pool_stats_t *stats) {
+  portENTER_CRITICAL(&frame_pool.lock);
+  stats->capacity = frame_pool.capacity;
+  stats->used = frame_pool.used;
+  stats->high_water_mark = frame_pool.high_water_mark;
+  stats->exhausted = frame_pool.exhausted;
+  portEXIT_CRITICAL(&frame_pool.lock);
 }
\ No newline at end of file
@@ -5,16 +5,58 @@
 #include <stdint.h>
 #include <sx127x.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <at_perf.h>
+#include <at_util.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <driver/spi_master.h>
+
+#define SX127X_UTIL_MAX_PACKET_LENGTH 255
+// fixed length fsk packets
+#define SX127X_UTIL_MAX_FSK_PACKET_LENGTH 2047
+#define SX127X_UTIL_DIO_LINES 3
+
+// events signalled by DIO lines. see sx127x_util_dio_events
+#define SX127X_UTIL_EVENT_NONE 0
+#define SX127X_UTIL_EVENT_RX_DONE (1 << 0)
+#define SX127X_UTIL_EVENT_TX_DONE (1 << 1)
+#define SX127X_UTIL_EVENT_CAD_DONE (1 << 2)
+#define SX127X_UTIL_EVENT_FIFO_LEVEL (1 << 3)
+#define SX127X_UTIL_EVENT_RX_TIMEOUT (1 << 4)
+// mode is not tracked by sx127x_wrapper. irq flags should be checked
+#define SX127X_UTIL_EVENT_UNKNOWN (1 << 5)
 
 typedef struct {
   int32_t frequency_error;
   int16_t rssi;
   float snr;
-  uint64_t timestamp;
+  uint64_t timestamp; // wall clock in milliseconds when DIO0 interrupt fired
+  uint64_t timestamp_micros; // wall clock in microseconds of the end of preamble
+  int64_t interrupt_micros; // esp_timer_get_time() when DIO0 interrupt fired
+  at_perf_stamp_t interrupt_stamp;
+  // index of the scan channel. -1 if received outside of scan
+  int16_t channel;
   uint8_t *data;
   uint16_t data_length;
 } sx127x_frame_t;
 
+typedef struct {
+  uint16_t capacity;
+  uint16_t used;
+  uint16_t high_water_mark;
+  uint32_t exhausted;
+} sx127x_util_frame_pool_stats_t;
+
+typedef struct {
+  uint32_t interrupts[SX127X_UTIL_DIO_LINES];
+  int64_t last_micros[SX127X_UTIL_DIO_LINES];
+  // interrupts without any event. irq flags were not read
+  uint32_t ignored;
+  // events dispatched without reading irq flags
+  uint32_t direct;
+} sx127x_util_dio_stats_t;
+
 typedef enum {
   LDO_AUTO = 0,
   LDO_ON = 1,
@@ -61,14 +103,30 @@ typedef struct {
   uint32_t rx_afc_bandwidth;
   int16_t ocp;
   uint8_t pin;
+  // 0 - variable length up to SX127X_UTIL_MAX_PACKET_LENGTH, otherwise fixed length up to SX127X_UTIL_MAX_FSK_PACKET_LENGTH
+  uint16_t packet_length;
 } fsk_config_t;
 #pragma pack(pop)
 
 typedef struct {
   sx127x *device;
+  spi_device_handle_t spi;
+  // recursive. taken by every sx127x_util_* call and the interrupt task, so the shadow state matches the chip
+  SemaphoreHandle_t lock;
   sx127x_modulation_t modulation;
   sx127x_mode_t mode;
   int8_t temperature;
+  // shadow copies of the applied configuration. only changed registers are written
+  lora_config_t lora_config;
+  fsk_config_t fsk_config;
+  // coding rate and crc in explicit header mode are not written in rx. used to calculate airtime
+  lora_config_t lora_rx_config;
+  uint8_t fsk_syncword[8];
+  bool lna_boost_hf;
+  uint32_t applied;
+  uint32_t settings_written;
+  uint32_t settings_skipped;
+  void (*tx_callback)(sx127x *device);
 } sx127x_wrapper;
 
 esp_err_t sx127x_util_init(sx127x_wrapper **device);
@@ -81,18 +139,58 @@ esp_err_t sx127x_util_lora_rx(sx127x_mode_t opmod, lora_config_t *req, sx127x_wr
 
 esp_err_t sx127x_util_reset();
 
+// should be called after sx127x_util_reset. all registers have default values
+void sx127x_util_reset_state(sx127x_wrapper *device);
+
+// sx127x_util_reset and sx127x_util_reset_state without other tasks using the chip in between
+esp_err_t sx127x_util_restart(sx127x_wrapper *device);
+
 esp_err_t sx127x_util_lora_tx(uint8_t *data, uint8_t data_length, lora_config_t *req, sx127x_wrapper *device);
 
 esp_err_t sx127x_util_fsk_rx(fsk_config_t *req, sx127x_wrapper *device);
 
 esp_err_t sx127x_util_fsk_tx(uint8_t *data, size_t data_length, fsk_config_t *req, sx127x_wrapper *device);
 
+// the same as sx127x_tx_set_callback. lora TxDone is dispatched without reading irq flags
+void sx127x_util_tx_set_callback(void (*tx_callback)(sx127x *), sx127x_wrapper *device);
+
+// should be called from tx callback. chip goes into standby mode after transmission
+void sx127x_util_tx_done(sx127x_wrapper *device);
+
+// puts the chip into standby if TxDone didn't come. irq flags and pending DIO edges of the transmission are discarded
+esp_err_t sx127x_util_tx_abort(sx127x_wrapper *device);
+
 esp_err_t sx127x_util_stop_rx(sx127x_wrapper *device);
 
 esp_err_t sx127x_util_deep_sleep_enter(sx127x_wrapper *device);
 
 void sx127x_util_frame_destroy(sx127x_frame_t *frame);
 
+// time in microseconds from the end of preamble until RxDone. lora preamble includes sync word
+uint32_t sx127x_util_lora_time_after_preamble(const lora_config_t *config, uint16_t data_length);
+
+// time in microseconds from the end of preamble until PayloadReady
+uint32_t sx127x_util_fsk_time_after_preamble(const fsk_config_t *config, uint16_t data_length);
+
+void sx127x_util_frame_pool_stats(sx127x_util_frame_pool_stats_t *stats);
+
+// DIO interrupts received and handled by the interrupt task
+void sx127x_util_interrupt_stats(at_util_irq_t *stats);
+
+// arg is the DIO line number
+void sx127x_util_interrupt_fromisr(void *arg);
+
+// returns bit mask of DIO lines fired since the previous call. used by the interrupt task
+uint8_t sx127x_util_dio_take();
+
+// returns SX127X_UTIL_EVENT_* for the fired DIO lines in the given mode
+uint8_t sx127x_util_dio_events(uint8_t dio_mask, sx127x_modulation_t modulation, sx127x_mode_t mode);
+
+// handles fired DIO lines. irq flags are read by the sx127x library only if the event can't be derived from the lines
+void sx127x_util_dio_dispatch(uint8_t dio_mask, sx127x_wrapper *device);
+
+void sx127x_util_dio_stats(sx127x_util_dio_stats_t *stats);
+
 uint64_t sx127x_util_get_min_frequency();
 
 uint64_t sx127x_util_get_max_frequency();
@@ -0,0 +1,222 @@
+#include "sx127x_util_scan.h"
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <inttypes.h>
+
+#define SCAN_EVENT_START (1 << 0)
+#define SCAN_EVENT_CAD_CLEAR (1 << 1)
+#define SCAN_EVENT_CAD_DETECTED (1 << 2)
+#define SCAN_EVENT_FRAME (1 << 3)
+
+static const char *TAG = "lora-at";
+
+static uint8_t sx127x_util_scan_priority(const sx127x_util_scan_channel_t *channel) {
+  return (channel->priority == 0 ? 1 : channel->priority);
+}
+
+uint8_t sx127x_util_scan_next(sx127x_util_scan_t *scan) {
+  int32_t total = 0;
+  uint8_t result = 0;
+  for (uint8_t i = 0; i < scan->channels_length; i++) {
+    int32_t priority = sx127x_util_scan_priority(&scan->channels[i]);
+    scan->weights[i] += priority;
+    total += priority;
+    if (scan->weights[i] > scan->weights[result]) {
+      result = i;
+    }
+  }
+  scan->weights[result] -= total;
+  return result;
+}
+
+static void sx127x_util_scan_extend(int64_t now, sx127x_util_scan_t *scan) {
+  int64_t deadline = now + (int64_t) scan->channels[scan->current].dwell_millis * 1000;
+  if (deadline > scan->deadline_micros) {
+    scan->deadline_micros = deadline;
+  }
+}
+
+// should be called with radio taken
+static esp_err_t sx127x_util_scan_hop(sx127x_util_scan_t *scan) {
+  uint8_t next = sx127x_util_scan_next(scan);
+  portENTER_CRITICAL(&scan->lock);
+  if (scan->current >= 0 && !scan->activity) {
+    scan->stats[scan->current].misses++;
+  }
+  scan->current = next;
+  scan->activity = false;
+  scan->stats[next].visits++;
+  portEXIT_CRITICAL(&scan->lock);
+  scan->deadline_micros = esp_timer_get_time() + (int64_t) scan->channels[next].dwell_millis * 1000;
+  // preamble is detected using CAD. rx is started only if something is on air
+  return sx127x_util_lora_rx(SX127x_MODE_CAD, &scan->channels[next].config, scan->device);
+}
+
+static esp_err_t sx127x_util_scan_handle(uint32_t events, sx127x_util_scan_t *scan) {
+  if ((events & SCAN_EVENT_START) || scan->current < 0) {
+    return sx127x_util_scan_hop(scan);
+  }
+  int64_t now = esp_timer_get_time();
+  if (events & (SCAN_EVENT_CAD_DETECTED | SCAN_EVENT_FRAME)) {
+    portENTER_CRITICAL(&scan->lock);
+    if (!scan->activity) {
+      scan->stats[scan->current].hits++;
+    }
+    scan->activity = true;
+    portEXIT_CRITICAL(&scan->lock);
+    sx127x_util_scan_extend(now, scan);
+  }
+  if (now >= scan->deadline_micros) {
+    return sx127x_util_scan_hop(scan);
+  }
+  int result = ESP_OK;
+  // mode is changed directly, so the radio lock is taken here
+  xSemaphoreTakeRecursive(scan->device->lock, portMAX_DELAY);
+  if (events & SCAN_EVENT_CAD_DETECTED) {
+    // stay in rx until dwell time expires
+    result = sx127x_set_opmod(SX127x_MODE_RX_CONT, SX127x_MODULATION_LORA, scan->device->device);
+    if (result == SX127X_OK) {
+      scan->device->mode = SX127x_MODE_RX_CONT;
+    }
+  } else if (events & SCAN_EVENT_CAD_CLEAR) {
+    result = sx127x_set_opmod(SX127x_MODE_CAD, SX127x_MODULATION_LORA, scan->device->device);
+  }
+  xSemaphoreGiveRecursive(scan->device->lock);
+  return result;
+}
+
+static void sx127x_util_scan_worker(void *arg) {
+  sx127x_util_scan_t *scan = (sx127x_util_scan_t *) arg;
+  while (1) {
+    TickType_t timeout = portMAX_DELAY;
+    if (scan->running && scan->current >= 0) {
+      int64_t remaining = scan->deadline_micros - esp_timer_get_time();
+      timeout = (remaining <= 0 ? 0 : pdMS_TO_TICKS(remaining / 1000) + 1);
+    }
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, timeout);
+    xSemaphoreTake(scan->radio, portMAX_DELAY);
+    if (scan->running) {
+      esp_err_t code = sx127x_util_scan_handle(events, scan);
+      if (code != ESP_OK) {
+        ESP_LOGE(TAG, "unable to scan channel %d: %s", scan->current, esp_err_to_name(code));
+      }
+    }
+    xSemaphoreGive(scan->radio);
+  }
+}
+
+esp_err_t sx127x_util_scan_create(sx127x_wrapper *device, sx127x_util_scan_t **scan) {
+  sx127x_util_scan_t *result = malloc(sizeof(sx127x_util_scan_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  *result = (sx127x_util_scan_t) {0};
+  result->device = device;
+  result->current = -1;
+  portMUX_INITIALIZE(&result->lock);
+  result->radio = xSemaphoreCreateMutex();
+  if (result->radio == NULL) {
+    sx127x_util_scan_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  BaseType_t task_code = xTaskCreatePinnedToCore(sx127x_util_scan_worker, "scan", 4096, result, 2, &result->worker, xPortGetCoreID());
+  if (task_code != pdPASS) {
+    ESP_LOGE(TAG, "can't create task %d", task_code);
+    result->worker = NULL;
+    sx127x_util_scan_destroy(result);
+    return ESP_ERR_INVALID_STATE;
+  }
+  *scan = result;
+  return ESP_OK;
+}
+
+esp_err_t sx127x_util_scan_start(const sx127x_util_scan_channel_t *channels, uint8_t channels_length, sx127x_util_scan_t *scan) {
+  if (channels_length == 0 || channels_length > SX127X_UTIL_SCAN_MAX_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (uint8_t i = 0; i < channels_length; i++) {
+    if (channels[i].dwell_millis == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+  xSemaphoreTake(scan->radio, portMAX_DELAY);
+  portENTER_CRITICAL(&scan->lock);
+  memcpy(scan->channels, channels, sizeof(sx127x_util_scan_channel_t) * channels_length);
+  scan->channels_length = channels_length;
+  memset(scan->stats, 0, sizeof(scan->stats));
+  memset(scan->weights, 0, sizeof(scan->weights));
+  scan->current = -1;
+  scan->activity = false;
+  scan->running = true;
+  portEXIT_CRITICAL(&scan->lock);
+  xSemaphoreGive(scan->radio);
+  xTaskNotify(scan->worker, SCAN_EVENT_START, eSetBits);
+  return ESP_OK;
+}
+
+esp_err_t sx127x_util_scan_stop(sx127x_util_scan_t *scan) {
+  if (scan == NULL || !scan->running) {
+    return ESP_OK;
+  }
+  xSemaphoreTake(scan->radio, portMAX_DELAY);
+  portENTER_CRITICAL(&scan->lock);
+  scan->running = false;
+  scan->current = -1;
+  portEXIT_CRITICAL(&scan->lock);
+  esp_err_t code = sx127x_util_stop_rx(scan->device);
+  xSemaphoreGive(scan->radio);
+  return code;
+}
+
+esp_err_t sx127x_util_scan_cad_done(bool detected, sx127x_util_scan_t *scan) {
+  if (scan == NULL || !scan->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xTaskNotify(scan->worker, (detected ? SCAN_EVENT_CAD_DETECTED : SCAN_EVENT_CAD_CLEAR), eSetBits);
+  return ESP_OK;
+}
+
+esp_err_t sx127x_util_scan_rx_done(sx127x_frame_t *frame, sx127x_util_scan_t *scan) {
+  if (scan == NULL || !scan->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  portENTER_CRITICAL(&scan->lock);
+  frame->channel = scan->current;
+  if (scan->current >= 0) {
+    scan->stats[scan->current].frames++;
+  }
+  portEXIT_CRITICAL(&scan->lock);
+  xTaskNotify(scan->worker, SCAN_EVENT_FRAME, eSetBits);
+  return ESP_OK;
+}
+
+bool sx127x_util_scan_running(sx127x_util_scan_t *scan) {
+  return scan != NULL && scan->running;
+}
+
+esp_err_t sx127x_util_scan_get_stats(uint8_t channel, sx127x_util_scan_stats_t *stats, sx127x_util_scan_t *scan) {
+  portENTER_CRITICAL(&scan->lock);
+  if (channel >= scan->channels_length) {
+    portEXIT_CRITICAL(&scan->lock);
+    return ESP_ERR_INVALID_ARG;
+  }
+  *stats = scan->stats[channel];
+  portEXIT_CRITICAL(&scan->lock);
+  return ESP_OK;
+}
+
+void sx127x_util_scan_destroy(sx127x_util_scan_t *scan) {
+  if (scan == NULL) {
+    return;
+  }
+  if (scan->worker != NULL) {
+    vTaskDelete(scan->worker);
+  }
+  if (scan->radio != NULL) {
+    vSemaphoreDelete(scan->radio);
+  }
+  free(scan);
+}
@@ -0,0 +1,72 @@
+#ifndef LORA_AT_SX127X_UTIL_SCAN_H
+#define LORA_AT_SX127X_UTIL_SCAN_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "sx127x_util.h"
+
+#define SX127X_UTIL_SCAN_MAX_CHANNELS 8
+
+typedef struct {
+  lora_config_t config;
+  // time spent on the channel if no activity detected
+  uint32_t dwell_millis;
+  // number of visits per cycle. 0 is treated as 1
+  uint8_t priority;
+} sx127x_util_scan_channel_t;
+
+typedef struct {
+  uint32_t visits;
+  // visits with detected preamble or received frame
+  uint32_t hits;
+  // visits without any activity
+  uint32_t misses;
+  uint32_t frames;
+} sx127x_util_scan_stats_t;
+
+typedef struct {
+  sx127x_wrapper *device;
+  TaskHandle_t worker;
+  // held while the worker or the caller changes the radio mode
+  SemaphoreHandle_t radio;
+  portMUX_TYPE lock;
+  sx127x_util_scan_channel_t channels[SX127X_UTIL_SCAN_MAX_CHANNELS];
+  uint8_t channels_length;
+  sx127x_util_scan_stats_t stats[SX127X_UTIL_SCAN_MAX_CHANNELS];
+  // smooth weighted round-robin state
+  int32_t weights[SX127X_UTIL_SCAN_MAX_CHANNELS];
+  volatile bool running;
+  // channel the radio is tuned to. -1 if not scanning
+  int16_t current;
+  bool activity;
+  int64_t deadline_micros;
+} sx127x_util_scan_t;
+
+esp_err_t sx127x_util_scan_create(sx127x_wrapper *device, sx127x_util_scan_t **scan);
+
+// restarts scan with the new channels. statistics are reset
+esp_err_t sx127x_util_scan_start(const sx127x_util_scan_channel_t *channels, uint8_t channels_length, sx127x_util_scan_t *scan);
+
+// puts radio into standby. does nothing if scan is not running
+esp_err_t sx127x_util_scan_stop(sx127x_util_scan_t *scan);
+
+// should be called from cad callback. returns ESP_ERR_INVALID_STATE if scan is not running
+esp_err_t sx127x_util_scan_cad_done(bool detected, sx127x_util_scan_t *scan);
+
+// should be called from rx callback. sets frame channel. returns ESP_ERR_INVALID_STATE if scan is not running
+esp_err_t sx127x_util_scan_rx_done(sx127x_frame_t *frame, sx127x_util_scan_t *scan);
+
+// index of the next channel. higher priority channels are interleaved with the others
+uint8_t sx127x_util_scan_next(sx127x_util_scan_t *scan);
+
+bool sx127x_util_scan_running(sx127x_util_scan_t *scan);
+
+esp_err_t sx127x_util_scan_get_stats(uint8_t channel, sx127x_util_scan_stats_t *stats, sx127x_util_scan_t *scan);
+
+void sx127x_util_scan_destroy(sx127x_util_scan_t *scan);
+
+#endif //LORA_AT_SX127X_UTIL_SCAN_H
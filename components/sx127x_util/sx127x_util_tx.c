@@ -0,0 +1,158 @@
+#include "sx127x_util_tx.h"
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <inttypes.h>
+#include <sdkconfig.h>
+
+#ifndef CONFIG_AT_TX_TIMEOUT
+#define CONFIG_AT_TX_TIMEOUT 60000
+#endif
+
+static const char *TAG = "lora-at";
+
+static void sx127x_util_tx_queue_worker(void *arg) {
+  sx127x_util_tx_queue_t *queue = (sx127x_util_tx_queue_t *) arg;
+  sx127x_util_tx_job_t *job = &queue->current;
+  while (1) {
+    if (xQueueReceive(queue->jobs, job, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    queue->busy = true;
+    // scan could be started after the job was submitted
+    esp_err_t code = sx127x_util_scan_stop(queue->scan);
+    if (code != ESP_OK) {
+      ESP_LOGE(TAG, "unable to stop scan: %s", esp_err_to_name(code));
+    } else if (job->modulation == SX127x_MODULATION_LORA) {
+      code = sx127x_util_lora_tx(job->data, job->data_length, &job->lora, queue->device);
+    } else {
+      job->fsk.syncword = job->syncword;
+      code = sx127x_util_fsk_tx(job->data, job->data_length, &job->fsk, queue->device);
+    }
+    if (code == ESP_OK && xSemaphoreTake(queue->done, pdMS_TO_TICKS(CONFIG_AT_TX_TIMEOUT)) != pdTRUE) {
+      ESP_LOGE(TAG, "tx job %" PRIu32 " timed out", job->id);
+      code = ESP_ERR_TIMEOUT;
+      // late TxDone can't complete the next job after the chip is in standby
+      esp_err_t abort_code = sx127x_util_tx_abort(queue->device);
+      if (abort_code != ESP_OK) {
+        ESP_LOGE(TAG, "unable to abort tx: %s", esp_err_to_name(abort_code));
+      }
+      // tx callback could signal between the timeout and the abort
+      xSemaphoreTake(queue->done, 0);
+    }
+    queue->busy = false;
+    portENTER_CRITICAL(&queue->lock);
+    queue->pending--;
+    queue->completed++;
+    portEXIT_CRITICAL(&queue->lock);
+    queue->callback(job->id, code, queue->ctx);
+  }
+}
+
+esp_err_t sx127x_util_tx_queue_create(uint8_t depth, sx127x_wrapper *device, sx127x_util_scan_t *scan, void (*callback)(uint32_t id, esp_err_t code, void *ctx), void *ctx, sx127x_util_tx_queue_t **queue) {
+  if (depth == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sx127x_util_tx_queue_t *result = malloc(sizeof(sx127x_util_tx_queue_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  *result = (sx127x_util_tx_queue_t) {0};
+  result->device = device;
+  result->scan = scan;
+  result->callback = callback;
+  result->ctx = ctx;
+  portMUX_INITIALIZE(&result->lock);
+  result->jobs = xQueueCreate(depth, sizeof(sx127x_util_tx_job_t));
+  if (result->jobs == NULL) {
+    sx127x_util_tx_queue_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  result->done = xSemaphoreCreateBinary();
+  if (result->done == NULL) {
+    sx127x_util_tx_queue_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  BaseType_t task_code = xTaskCreatePinnedToCore(sx127x_util_tx_queue_worker, "tx queue", 4096, result, 2, &result->worker, xPortGetCoreID());
+  if (task_code != pdPASS) {
+    ESP_LOGE(TAG, "can't create task %d", task_code);
+    result->worker = NULL;
+    sx127x_util_tx_queue_destroy(result);
+    return ESP_ERR_INVALID_STATE;
+  }
+  *queue = result;
+  return ESP_OK;
+}
+
+static esp_err_t sx127x_util_tx_queue_submit(sx127x_util_tx_job_t *job, sx127x_util_tx_queue_t *queue, uint32_t *id) {
+  portENTER_CRITICAL(&queue->lock);
+  job->id = queue->next_id++;
+  queue->pending++;
+  portEXIT_CRITICAL(&queue->lock);
+  if (xQueueSend(queue->jobs, job, 0) != pdTRUE) {
+    portENTER_CRITICAL(&queue->lock);
+    queue->pending--;
+    portEXIT_CRITICAL(&queue->lock);
+    return ESP_ERR_NO_MEM;
+  }
+  *id = job->id;
+  return ESP_OK;
+}
+
+esp_err_t sx127x_util_tx_queue_submit_lora(uint8_t *data, size_t data_length, lora_config_t *config, sx127x_util_tx_queue_t *queue, uint32_t *id) {
+  if (data_length > SX127X_UTIL_MAX_PACKET_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  sx127x_util_tx_job_t job;
+  job.modulation = SX127x_MODULATION_LORA;
+  job.lora = *config;
+  memcpy(job.data, data, data_length);
+  job.data_length = data_length;
+  return sx127x_util_tx_queue_submit(&job, queue, id);
+}
+
+esp_err_t sx127x_util_tx_queue_submit_fsk(uint8_t *data, size_t data_length, fsk_config_t *config, sx127x_util_tx_queue_t *queue, uint32_t *id) {
+  if (data_length > SX127X_UTIL_MAX_PACKET_LENGTH || config->syncword_length > SX127X_UTIL_TX_MAX_SYNCWORD_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  sx127x_util_tx_job_t job;
+  job.modulation = SX127x_MODULATION_FSK;
+  job.fsk = *config;
+  memcpy(job.syncword, config->syncword, config->syncword_length);
+  // pointer will be restored by the worker
+  job.fsk.syncword = NULL;
+  memcpy(job.data, data, data_length);
+  job.data_length = data_length;
+  return sx127x_util_tx_queue_submit(&job, queue, id);
+}
+
+esp_err_t sx127x_util_tx_queue_done(sx127x_util_tx_queue_t *queue) {
+  if (queue == NULL || !queue->busy) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xSemaphoreGive(queue->done);
+  return ESP_OK;
+}
+
+uint32_t sx127x_util_tx_queue_pending(sx127x_util_tx_queue_t *queue) {
+  portENTER_CRITICAL(&queue->lock);
+  uint32_t result = queue->pending;
+  portEXIT_CRITICAL(&queue->lock);
+  return result;
+}
+
+void sx127x_util_tx_queue_destroy(sx127x_util_tx_queue_t *queue) {
+  if (queue == NULL) {
+    return;
+  }
+  if (queue->worker != NULL) {
+    vTaskDelete(queue->worker);
+  }
+  if (queue->jobs != NULL) {
+    vQueueDelete(queue->jobs);
+  }
+  if (queue->done != NULL) {
+    vSemaphoreDelete(queue->done);
+  }
+  free(queue);
+}
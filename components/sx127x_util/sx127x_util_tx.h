@@ -0,0 +1,59 @@
+#ifndef LORA_AT_SX127X_UTIL_TX_H
+#define LORA_AT_SX127X_UTIL_TX_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "sx127x_util.h"
+#include "sx127x_util_scan.h"
+
+#define SX127X_UTIL_TX_MAX_SYNCWORD_LENGTH 8
+
+typedef struct {
+  uint32_t id;
+  sx127x_modulation_t modulation;
+  lora_config_t lora;
+  fsk_config_t fsk;
+  uint8_t syncword[SX127X_UTIL_TX_MAX_SYNCWORD_LENGTH];
+  uint8_t data[SX127X_UTIL_MAX_PACKET_LENGTH];
+  size_t data_length;
+} sx127x_util_tx_job_t;
+
+typedef struct {
+  sx127x_wrapper *device;
+  // stopped before each job. can be NULL
+  sx127x_util_scan_t *scan;
+  QueueHandle_t jobs;
+  SemaphoreHandle_t done;
+  TaskHandle_t worker;
+  // job currently transmitted by the worker
+  sx127x_util_tx_job_t current;
+  volatile bool busy;
+  portMUX_TYPE lock;
+  uint32_t next_id;
+  uint32_t pending;
+  uint32_t completed;
+  void (*callback)(uint32_t id, esp_err_t code, void *ctx);
+  void *ctx;
+} sx127x_util_tx_queue_t;
+
+// callback is called from the worker task once job is transmitted or failed
+esp_err_t sx127x_util_tx_queue_create(uint8_t depth, sx127x_wrapper *device, sx127x_util_scan_t *scan, void (*callback)(uint32_t id, esp_err_t code, void *ctx), void *ctx, sx127x_util_tx_queue_t **queue);
+
+// returns ESP_ERR_NO_MEM if queue is full
+esp_err_t sx127x_util_tx_queue_submit_lora(uint8_t *data, size_t data_length, lora_config_t *config, sx127x_util_tx_queue_t *queue, uint32_t *id);
+
+esp_err_t sx127x_util_tx_queue_submit_fsk(uint8_t *data, size_t data_length, fsk_config_t *config, sx127x_util_tx_queue_t *queue, uint32_t *id);
+
+// should be called from tx callback. returns ESP_ERR_INVALID_STATE if transmission was not started by the queue
+esp_err_t sx127x_util_tx_queue_done(sx127x_util_tx_queue_t *queue);
+
+uint32_t sx127x_util_tx_queue_pending(sx127x_util_tx_queue_t *queue);
+
+void sx127x_util_tx_queue_destroy(sx127x_util_tx_queue_t *queue);
+
+#endif //LORA_AT_SX127X_UTIL_TX_H
@@ -0,0 +1,459 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <driver/spi_master.h>
+#include <rom/ets_sys.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sx127x_util.h>
+
+// registers of the emulated chip
+static uint8_t registers[128];
+static uint32_t register_writes = 0;
+// reads of RegIrqFlags (lora) and RegIrqFlags1/RegIrqFlags2 (fsk)
+static uint32_t irq_flags_reads = 0;
+static int mock_spi_device;
+static sx127x_wrapper device;
+
+esp_err_t __real_spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t __real_spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+
+static esp_err_t mock_transmit(spi_transaction_t *trans) {
+  uint8_t reg = trans->addr & 0x7F;
+  if (trans->addr & 0x80) {
+    const uint8_t *data = ((trans->flags & SPI_TRANS_USE_TXDATA) ? trans->tx_data : trans->tx_buffer);
+    register_writes++;
+    for (size_t i = 0; i < trans->length / 8; i++) {
+      // address is not incremented when writing into fifo
+      if (reg == 0x12) {
+        // irq flags are cleared by writing 1
+        registers[reg] &= ~data[i];
+      } else if (reg != 0) {
+        registers[(reg + i) & 0x7F] = data[i];
+      }
+    }
+  } else {
+    uint8_t *data = ((trans->flags & SPI_TRANS_USE_RXDATA) ? trans->rx_data : trans->rx_buffer);
+    size_t length = (trans->rxlength != 0 ? trans->rxlength : trans->length) / 8;
+    if (reg == 0x12 || reg == 0x3E || reg == 0x3F) {
+      irq_flags_reads++;
+    }
+    for (size_t i = 0; i < length; i++) {
+      data[i] = registers[(reg == 0 ? 0 : (reg + i) & 0x7F)];
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t __wrap_spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans) {
+  if (handle != (spi_device_handle_t) &mock_spi_device) {
+    return __real_spi_device_polling_transmit(handle, trans);
+  }
+  return mock_transmit(trans);
+}
+
+esp_err_t __wrap_spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans) {
+  if (handle != (spi_device_handle_t) &mock_spi_device) {
+    return __real_spi_device_transmit(handle, trans);
+  }
+  return mock_transmit(trans);
+}
+
+static void create_device() {
+  memset(registers, 0, sizeof(registers));
+  // RegVersion
+  registers[0x42] = 0x12;
+  // lock is reused by all tests
+  SemaphoreHandle_t lock = device.lock;
+  device = (sx127x_wrapper) {0};
+  device.lock = (lock != NULL ? lock : xSemaphoreCreateRecursiveMutex());
+  TEST_ASSERT_NOT_NULL(device.lock);
+  device.modulation = SX127x_MODULATION_FSK;
+  device.mode = SX127x_MODE_SLEEP;
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_create((spi_device_handle_t) &mock_spi_device, &device.device));
+  device.spi = (spi_device_handle_t) &mock_spi_device;
+}
+
+static lora_config_t create_lora_config() {
+  lora_config_t result = {0};
+  result.freq = 437200012;
+  result.bw = 125000;
+  result.sf = 9;
+  result.cr = 5;
+  result.syncWord = 18;
+  result.preambleLength = 8;
+  result.gain = 0;
+  result.ldo = LDO_AUTO;
+  result.useCrc = 1;
+  result.useExplicitHeader = 1;
+  result.power = 10;
+  result.ocp = 240;
+  result.pin = 1;
+  return result;
+}
+
+static fsk_config_t create_fsk_config(uint8_t *syncword) {
+  fsk_config_t result = {0};
+  result.freq = 437200012;
+  result.bitrate = 4800;
+  result.freq_deviation = 5000;
+  result.preamble = 4;
+  result.syncword = syncword;
+  result.syncword_length = 2;
+  result.encoding = 0;
+  result.data_shaping = 2;
+  result.crc = 1;
+  result.power = 10;
+  result.ocp = 240;
+  result.pin = 1;
+  result.rx_bandwidth = 5000;
+  result.rx_afc_bandwidth = 20000;
+  return result;
+}
+
+static uint32_t lora_tx(lora_config_t *config) {
+  uint8_t data[] = {0xCA, 0xFE};
+  register_writes = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_tx(data, sizeof(data), config, &device));
+  sx127x_util_tx_done(&device);
+  return register_writes;
+}
+
+static uint32_t fsk_tx(fsk_config_t *config) {
+  uint8_t data[] = {0xCA, 0xFE};
+  register_writes = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_fsk_tx(data, sizeof(data), config, &device));
+  sx127x_util_tx_done(&device);
+  return register_writes;
+}
+
+TEST_CASE("lora tx with the same config", "[sx127x_util]") {
+  create_device();
+  lora_config_t config = create_lora_config();
+  uint32_t first = lora_tx(&config);
+  uint32_t settings = device.settings_written;
+  uint32_t repeated = lora_tx(&config);
+  printf("lora tx register writes: first %" PRIu32 " repeated %" PRIu32 "\n", first, repeated);
+  TEST_ASSERT_LESS_THAN(first, repeated);
+  TEST_ASSERT_EQUAL(settings, device.settings_written);
+  TEST_ASSERT_EQUAL(repeated, lora_tx(&config));
+
+  config.freq = 868000000;
+  TEST_ASSERT_GREATER_THAN(repeated, lora_tx(&config));
+  TEST_ASSERT_EQUAL(settings + 1, device.settings_written);
+
+  config.sf = 10;
+  lora_tx(&config);
+  // bandwidth is written again to re-calculate low data rate optimization
+  TEST_ASSERT_EQUAL(settings + 3, device.settings_written);
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("lora rx with the same config", "[sx127x_util]") {
+  create_device();
+  lora_config_t config = create_lora_config();
+  register_writes = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &config, &device));
+  uint32_t first = register_writes;
+  uint32_t settings = device.settings_written;
+  register_writes = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &config, &device));
+  printf("lora rx register writes: first %" PRIu32 " repeated %" PRIu32 "\n", first, register_writes);
+  TEST_ASSERT_LESS_THAN(first, register_writes);
+  TEST_ASSERT_EQUAL(settings, device.settings_written);
+
+  config.gain = 1;
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &config, &device));
+  TEST_ASSERT_EQUAL(settings + 1, device.settings_written);
+
+  // coding rate for explicit header, pa and ocp are not written in rx mode
+  uint32_t before_tx = device.settings_written;
+  lora_tx(&config);
+  TEST_ASSERT_EQUAL(before_tx + 3, device.settings_written);
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("fsk tx with the same config", "[sx127x_util]") {
+  create_device();
+  uint8_t syncword[] = {0x12, 0xAD};
+  fsk_config_t config = create_fsk_config(syncword);
+  uint32_t first = fsk_tx(&config);
+  uint32_t settings = device.settings_written;
+  uint32_t repeated = fsk_tx(&config);
+  printf("fsk tx register writes: first %" PRIu32 " repeated %" PRIu32 "\n", first, repeated);
+  TEST_ASSERT_LESS_THAN(first, repeated);
+  TEST_ASSERT_EQUAL(settings, device.settings_written);
+
+  uint8_t other_syncword[] = {0x12, 0xAE};
+  config.syncword = other_syncword;
+  fsk_tx(&config);
+  TEST_ASSERT_EQUAL(settings + 1, device.settings_written);
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("modulation change", "[sx127x_util]") {
+  create_device();
+  lora_config_t lora_config = create_lora_config();
+  uint8_t syncword[] = {0x12, 0xAD};
+  fsk_config_t fsk_config = create_fsk_config(syncword);
+  lora_tx(&lora_config);
+  uint32_t settings = device.settings_written;
+  fsk_tx(&fsk_config);
+  uint32_t before_lora = device.settings_written;
+  // lora and fsk registers share the same addresses
+  lora_tx(&lora_config);
+  TEST_ASSERT_EQUAL(settings, device.settings_written - before_lora);
+  TEST_ASSERT_EQUAL(SX127x_MODULATION_LORA, device.modulation);
+
+  sx127x_util_reset_state(&device);
+  TEST_ASSERT_EQUAL(0, device.applied);
+  sx127x_destroy(device.device);
+}
+
+static volatile bool stopped = false;
+
+static void stop_rx_task(void *arg) {
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_stop_rx(&device));
+  stopped = true;
+  vTaskDelete(NULL);
+}
+
+TEST_CASE("radio calls wait for the lock", "[sx127x_util]") {
+  create_device();
+  lora_config_t config = create_lora_config();
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &config, &device));
+  stopped = false;
+  // the lock is taken by another task, e.g. the interrupt task
+  xSemaphoreTakeRecursive(device.lock, portMAX_DELAY);
+  // nested calls from callbacks don't block
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &config, &device));
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(stop_rx_task, "stop rx", 4096, NULL, uxTaskPriorityGet(NULL) + 1, NULL));
+  vTaskDelay(pdMS_TO_TICKS(20));
+  TEST_ASSERT_FALSE(stopped);
+  TEST_ASSERT_EQUAL(SX127x_MODE_RX_CONT, device.mode);
+  xSemaphoreGiveRecursive(device.lock);
+  vTaskDelay(pdMS_TO_TICKS(20));
+  TEST_ASSERT_TRUE(stopped);
+  TEST_ASSERT_EQUAL(SX127x_MODE_SLEEP, device.mode);
+  sx127x_destroy(device.device);
+}
+
+static uint32_t tx_callbacks = 0;
+
+static void count_tx_callback(sx127x *sx127x_device) {
+  tx_callbacks++;
+  sx127x_util_tx_done(&device);
+}
+
+// emulate edges on DIO lines and return fired lines the interrupt task will take
+static uint8_t fire_edges(uint8_t dio_mask) {
+  sx127x_util_dio_take();
+  for (uint8_t i = 0; i < SX127X_UTIL_DIO_LINES; i++) {
+    if (dio_mask & (1 << i)) {
+      sx127x_util_interrupt_fromisr((void *) (uintptr_t) i);
+    }
+  }
+  uint8_t fired = sx127x_util_dio_take();
+  TEST_ASSERT_EQUAL(dio_mask, fired);
+  return fired;
+}
+
+// returns events the interrupt task will handle
+static uint8_t fire_dio(uint8_t dio_mask) {
+  return sx127x_util_dio_events(fire_edges(dio_mask), device.modulation, device.mode);
+}
+
+// the same as the interrupt task. returns number of irq flags reads
+static uint32_t dispatch_dio(uint8_t dio_mask) {
+  uint8_t fired = fire_edges(dio_mask);
+  uint32_t reads = irq_flags_reads;
+  sx127x_util_dio_dispatch(fired, &device);
+  return irq_flags_reads - reads;
+}
+
+TEST_CASE("lora dio routing", "[sx127x_util]") {
+  create_device();
+  lora_config_t config = create_lora_config();
+  uint8_t data[] = {0xCA, 0xFE};
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_tx(data, sizeof(data), &config, &device));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_TX_DONE, fire_dio(1 << 0));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_NONE, fire_dio(1 << 1));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_NONE, fire_dio(1 << 2));
+  sx127x_util_tx_done(&device);
+
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &config, &device));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_RX_DONE, fire_dio(1 << 0));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_NONE, fire_dio(1 << 1));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_RX_DONE, fire_dio((1 << 0) | (1 << 2)));
+
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_SINGLE, &config, &device));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_RX_DONE, fire_dio(1 << 0));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_RX_TIMEOUT, fire_dio(1 << 1));
+
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_CAD, &config, &device));
+  TEST_ASSERT_TRUE(fire_dio(1 << 0) & SX127X_UTIL_EVENT_CAD_DONE);
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_NONE, fire_dio(1 << 2));
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("fsk dio routing", "[sx127x_util]") {
+  create_device();
+  uint8_t syncword[] = {0x12, 0xAD};
+  fsk_config_t config = create_fsk_config(syncword);
+  uint8_t data[] = {0xCA, 0xFE};
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_fsk_tx(data, sizeof(data), &config, &device));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_TX_DONE, fire_dio(1 << 0));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_FIFO_LEVEL, fire_dio(1 << 1));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_NONE, fire_dio(1 << 2));
+  sx127x_util_tx_done(&device);
+
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_fsk_rx(&config, &device));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_RX_DONE, fire_dio(1 << 0));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_FIFO_LEVEL, fire_dio(1 << 1));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_RX_DONE | SX127X_UTIL_EVENT_FIFO_LEVEL, fire_dio((1 << 0) | (1 << 1) | (1 << 2)));
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("dio in untracked mode", "[sx127x_util]") {
+  create_device();
+  // mode was changed outside of sx127x_util. irq flags should be read
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_UNKNOWN, fire_dio(1 << 0));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_UNKNOWN, fire_dio(1 << 1));
+  TEST_ASSERT_EQUAL(SX127X_UTIL_EVENT_NONE, fire_dio(1 << 2));
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("lora tx done is dispatched without reading irq flags", "[sx127x_util]") {
+  create_device();
+  sx127x_util_tx_set_callback(count_tx_callback, &device);
+  lora_config_t config = create_lora_config();
+  uint8_t data[] = {0xCA, 0xFE};
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_tx(data, sizeof(data), &config, &device));
+  sx127x_util_dio_stats_t before;
+  sx127x_util_dio_stats(&before);
+  tx_callbacks = 0;
+  // TxDone
+  registers[0x12] = 0x08;
+  TEST_ASSERT_EQUAL(0, dispatch_dio(1 << 0));
+  TEST_ASSERT_EQUAL(1, tx_callbacks);
+  TEST_ASSERT_EQUAL(0, registers[0x12]);
+  TEST_ASSERT_EQUAL(SX127x_MODE_STANDBY, device.mode);
+  sx127x_util_dio_stats_t after;
+  sx127x_util_dio_stats(&after);
+  TEST_ASSERT_EQUAL(before.direct + 1, after.direct);
+
+  // no event on DIO1 and DIO2 in lora tx
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_tx(data, sizeof(data), &config, &device));
+  TEST_ASSERT_EQUAL(0, dispatch_dio((1 << 1) | (1 << 2)));
+  TEST_ASSERT_EQUAL(1, tx_callbacks);
+  TEST_ASSERT_EQUAL(SX127x_MODE_TX, device.mode);
+  sx127x_util_tx_done(&device);
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("late tx done after abort", "[sx127x_util]") {
+  create_device();
+  sx127x_util_tx_set_callback(count_tx_callback, &device);
+  tx_callbacks = 0;
+  lora_config_t config = create_lora_config();
+  uint8_t data[] = {0xCA, 0xFE};
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_tx(data, sizeof(data), &config, &device));
+  // TxDone fired, but the interrupt task didn't handle it yet
+  registers[0x12] = 0x08;
+  sx127x_util_dio_take();
+  sx127x_util_interrupt_fromisr((void *) (uintptr_t) 0);
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_tx_abort(&device));
+  TEST_ASSERT_EQUAL(SX127x_MODE_STANDBY, device.mode);
+  TEST_ASSERT_EQUAL(0, registers[0x12]);
+
+  // the next transmission is not completed by the late edge
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_tx(data, sizeof(data), &config, &device));
+  sx127x_util_dio_dispatch(sx127x_util_dio_take(), &device);
+  TEST_ASSERT_EQUAL(0, tx_callbacks);
+  TEST_ASSERT_EQUAL(SX127x_MODE_TX, device.mode);
+  sx127x_util_tx_done(&device);
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("other dio events read irq flags", "[sx127x_util]") {
+  create_device();
+  sx127x_util_tx_set_callback(count_tx_callback, &device);
+  tx_callbacks = 0;
+  lora_config_t lora = create_lora_config();
+  // crc status is needed for RxDone
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &lora, &device));
+  TEST_ASSERT_GREATER_THAN(0, dispatch_dio(1 << 0));
+  TEST_ASSERT_EQUAL(0, dispatch_dio(1 << 2));
+  // cad detected is needed for CadDone
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_lora_rx(SX127x_MODE_CAD, &lora, &device));
+  TEST_ASSERT_GREATER_THAN(0, dispatch_dio(1 << 0));
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_stop_rx(&device));
+
+  // fifo state is kept by the sx127x library
+  uint8_t syncword[] = {0x12, 0xAD};
+  fsk_config_t fsk = create_fsk_config(syncword);
+  uint8_t data[] = {0xCA, 0xFE};
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_fsk_tx(data, sizeof(data), &fsk, &device));
+  TEST_ASSERT_GREATER_THAN(0, dispatch_dio(1 << 0));
+  sx127x_util_tx_done(&device);
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_fsk_rx(&fsk, &device));
+  TEST_ASSERT_GREATER_THAN(0, dispatch_dio(1 << 1));
+  TEST_ASSERT_EQUAL(0, tx_callbacks);
+  sx127x_destroy(device.device);
+}
+
+TEST_CASE("dio timestamps", "[sx127x_util]") {
+  sx127x_util_dio_stats_t before;
+  sx127x_util_dio_stats(&before);
+  sx127x_util_interrupt_fromisr((void *) (uintptr_t) 0);
+  ets_delay_us(100);
+  sx127x_util_interrupt_fromisr((void *) (uintptr_t) 1);
+  sx127x_util_interrupt_fromisr((void *) (uintptr_t) 1);
+  sx127x_util_dio_take();
+  sx127x_util_dio_stats_t after;
+  sx127x_util_dio_stats(&after);
+  TEST_ASSERT_EQUAL(before.interrupts[0] + 1, after.interrupts[0]);
+  TEST_ASSERT_EQUAL(before.interrupts[1] + 2, after.interrupts[1]);
+  TEST_ASSERT_EQUAL(before.interrupts[2], after.interrupts[2]);
+  // frames are timestamped using DIO0 even if fifo level fired later
+  TEST_ASSERT_GREATER_OR_EQUAL(100, after.last_micros[1] - after.last_micros[0]);
+}
+
+TEST_CASE("time after preamble", "[sx127x_util]") {
+  lora_config_t lora = create_lora_config();
+  lora.bw = 125000;
+  lora.sf = 7;
+  // 41.216ms time on air including 8 symbols of preamble
+  TEST_ASSERT_EQUAL(28672, sx127x_util_lora_time_after_preamble(&lora, 10));
+  // low data rate optimization is enabled automatically
+  lora.sf = 12;
+  TEST_ASSERT_EQUAL(1245184, sx127x_util_lora_time_after_preamble(&lora, 30));
+  lora.ldo = LDO_OFF;
+  TEST_ASSERT_EQUAL(1081344, sx127x_util_lora_time_after_preamble(&lora, 30));
+  lora.bw = 0;
+  TEST_ASSERT_EQUAL(0, sx127x_util_lora_time_after_preamble(&lora, 10));
+
+  uint8_t syncword[] = {0x12, 0xAD};
+  fsk_config_t fsk = create_fsk_config(syncword);
+  // syncword + length + payload + crc
+  TEST_ASSERT_EQUAL(11666, sx127x_util_fsk_time_after_preamble(&fsk, 2));
+  fsk.crc = 0;
+  TEST_ASSERT_EQUAL(8333, sx127x_util_fsk_time_after_preamble(&fsk, 2));
+}
+
+TEST_CASE("fsk packet length", "[sx127x_util]") {
+  create_device();
+  uint8_t syncword[] = {0x12, 0xAD};
+  fsk_config_t config = create_fsk_config(syncword);
+  static uint8_t data[SX127X_UTIL_MAX_FSK_PACKET_LENGTH + 1];
+  // variable length is limited by the length byte
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, sx127x_util_fsk_tx(data, SX127X_UTIL_MAX_PACKET_LENGTH + 1, &config, &device));
+  config.packet_length = SX127X_UTIL_MAX_FSK_PACKET_LENGTH;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, sx127x_util_fsk_tx(data, 10, &config, &device));
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_fsk_tx(data, SX127X_UTIL_MAX_FSK_PACKET_LENGTH, &config, &device));
+  sx127x_util_tx_done(&device);
+  config.packet_length = SX127X_UTIL_MAX_FSK_PACKET_LENGTH + 1;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, sx127x_util_fsk_rx(&config, &device));
+  sx127x_destroy(device.device);
+}
@@ -0,0 +1,58 @@
+#include <unity.h>
+#include <string.h>
+#include <sx127x_util_scan.h>
+
+static void create_scan(sx127x_util_scan_t *scan, const uint8_t *priorities, uint8_t channels_length) {
+  memset(scan, 0, sizeof(sx127x_util_scan_t));
+  scan->current = -1;
+  scan->channels_length = channels_length;
+  for (uint8_t i = 0; i < channels_length; i++) {
+    scan->channels[i].dwell_millis = 100;
+    scan->channels[i].priority = priorities[i];
+  }
+}
+
+TEST_CASE("scan round robin", "[sx127x_util]") {
+  uint8_t priorities[] = {0, 1, 1};
+  sx127x_util_scan_t scan;
+  create_scan(&scan, priorities, sizeof(priorities));
+  for (int i = 0; i < 6; i++) {
+    TEST_ASSERT_EQUAL(i % 3, sx127x_util_scan_next(&scan));
+  }
+}
+
+TEST_CASE("scan priorities", "[sx127x_util]") {
+  uint8_t priorities[] = {2, 1};
+  sx127x_util_scan_t scan;
+  create_scan(&scan, priorities, sizeof(priorities));
+  uint8_t expected[] = {0, 1, 0, 0, 1, 0};
+  for (int i = 0; i < sizeof(expected); i++) {
+    TEST_ASSERT_EQUAL(expected[i], sx127x_util_scan_next(&scan));
+  }
+
+  // low priority channel is interleaved, not starved
+  uint8_t other[] = {3, 1, 1};
+  create_scan(&scan, other, sizeof(other));
+  uint32_t visits[3] = {0};
+  uint8_t previous = 0;
+  for (int i = 0; i < 50; i++) {
+    uint8_t next = sx127x_util_scan_next(&scan);
+    if (next != 0) {
+      TEST_ASSERT_NOT_EQUAL(previous, next);
+    }
+    visits[next]++;
+    previous = next;
+  }
+  TEST_ASSERT_EQUAL(30, visits[0]);
+  TEST_ASSERT_EQUAL(10, visits[1]);
+  TEST_ASSERT_EQUAL(10, visits[2]);
+}
+
+TEST_CASE("scan not running", "[sx127x_util]") {
+  sx127x_frame_t frame = {.channel = -1};
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, sx127x_util_scan_rx_done(&frame, NULL));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, sx127x_util_scan_cad_done(true, NULL));
+  TEST_ASSERT_EQUAL(ESP_OK, sx127x_util_scan_stop(NULL));
+  TEST_ASSERT_FALSE(sx127x_util_scan_running(NULL));
+  TEST_ASSERT_EQUAL(-1, frame.channel);
+}
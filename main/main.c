@@ -1,15 +1,16 @@
 #include <esp_log.h>
 #include <sx127x_util.h>
+#include <sx127x_util_tx.h>
+#include <sx127x_util_scan.h>
 #include <display.h>
 #include <at_config.h>
 #include <at_handler.h>
 #include <ble_client.h>
 #include <ble_server.h>
 #include <string.h>
+#include <stdio.h>
 #include "uart_at.h"
-#include "i2cdev.h"
 #include <deep_sleep.h>
-#include <esp_sleep.h>
 #include <at_timer.h>
 #include <sys/time.h>
 #include <sdkconfig.h>
@@ -17,21 +18,38 @@
 #include <at_sensors.h>
 #include <at_wifi.h>
 #include <at_rest.h>
+#include <at_schedule.h>
+#include <at_journal.h>
 
-static const char *TAG = "lora-at";
-
-#ifndef CONFIG_SX127X_POWER_PROFILING
-#define CONFIG_SX127X_POWER_PROFILING -1
+#if !CONFIG_IDF_TARGET_LINUX
+#include <esp_sleep.h>
+#include "i2cdev.h"
 #endif
 
+static const char *TAG = "lora-at";
+
 #ifndef CONFIG_BLUETOOTH_RECONNECTION_INTERVAL
 #define CONFIG_BLUETOOTH_RECONNECTION_INTERVAL 5000
 #endif
 
+#ifndef CONFIG_AT_TX_QUEUE_LENGTH
+#define CONFIG_AT_TX_QUEUE_LENGTH 8
+#endif
+
 #ifndef CONFIG_AT_WIFI_ENABLED
 #define CONFIG_AT_WIFI_ENABLED 0
 #endif
 
+#ifndef CONFIG_AT_SCHEDULE_REFILL_THRESHOLD
+#define CONFIG_AT_SCHEDULE_REFILL_THRESHOLD 2
+#endif
+
+#ifndef CONFIG_AT_JOURNAL_DRAIN_THRESHOLD
+#define CONFIG_AT_JOURNAL_DRAIN_THRESHOLD 16
+#endif
+
+#define JOURNAL_BATCH_LENGTH 4
+
 #define ERROR_CHECK(y, x)        \
   do {                        \
     esp_err_t __err_rc = (x); \
@@ -54,6 +72,8 @@ static const char *TAG = "lora-at";
 
 typedef struct {
   sx127x_wrapper *device;
+  sx127x_util_tx_queue_t *tx_queue;
+  sx127x_util_scan_t *scan;
   lora_at_display *display;
   at_handler_t *at_handler;
   uart_at_handler_t *uart_at_handler;
@@ -62,18 +82,32 @@ typedef struct {
   at_timer_t *timer;
   at_rest *rest;
   at_sensors *sensors;
+  at_schedule_t *schedule;
+  at_journal_t *journal;
   int cad_mode;
 } main_t;
 
 main_t *lora_at_main = NULL;
 
 RTC_DATA_ATTR uint64_t rx_end_micros;
+// observations survive deep sleep. server is contacted only when the table is running low
+RTC_DATA_ATTR at_schedule_t rtc_schedule;
+// frames received in deep sleep. delivered when connected to the server
+RTC_DATA_ATTR at_journal_rtc_t rtc_journal;
+// too big for the stack of app_main
+static lora_config_t schedule_batch[CONFIG_AT_SCHEDULE_CAPACITY];
+static at_journal_frame_t journal_batch[JOURNAL_BATCH_LENGTH];
 
 static void uart_rx_task(void *arg) {
   main_t *main = (main_t *) arg;
   uart_at_handler_process(main->uart_at_handler);
 }
 
+static void uart_push_task(void *arg) {
+  main_t *main = (main_t *) arg;
+  uart_at_handler_push_process(main->uart_at_handler);
+}
+
 static void update_sensors(void *arg) {
   // every 15 seconds
   const TickType_t xDelay = 15000 / portTICK_PERIOD_MS;
@@ -89,6 +123,34 @@ void main_deep_sleep_enter(uint64_t remaining_micros) {
   deep_sleep_enter(remaining_micros);
 }
 
+// sends frames in batches. every batch is acked by the sequence of the last delivered frame
+static esp_err_t main_drain_journal(main_t *main) {
+  while (at_journal_pending(main->journal) > 0) {
+    size_t length = 0;
+    esp_err_t code = at_journal_peek(journal_batch, JOURNAL_BATCH_LENGTH, &length, main->journal);
+    if (code != ESP_OK || length == 0) {
+      return code;
+    }
+    size_t sent = 0;
+    for (; sent < length; sent++) {
+      code = ble_client_send_frame(&journal_batch[sent].frame, main->bluetooth);
+      if (code != ESP_OK) {
+        break;
+      }
+    }
+    if (sent > 0) {
+      esp_err_t ack_code = at_journal_ack(journal_batch[sent - 1].sequence, main->journal);
+      if (ack_code != ESP_OK) {
+        return ack_code;
+      }
+    }
+    if (code != ESP_OK) {
+      return code;
+    }
+  }
+  return ESP_OK;
+}
+
 static void rx_callback_deep_sleep(sx127x *device, uint8_t *data, uint16_t data_length) {
   struct timeval tm_vl;
   gettimeofday(&tm_vl, NULL);
@@ -110,14 +172,17 @@ static void rx_callback_deep_sleep(sx127x *device, uint8_t *data, uint16_t data_
     return;
   }
   ESP_LOGI(TAG, "received frame: %d rssi: %d snr: %f freq_error: %" PRId32, data_length, frame->rssi, frame->snr, frame->frequency_error);
-  //do not store received frames in RTC memory.
-  //currently only push via bluetooth is supported
-  if (lora_at_main->config->bt_address != NULL) {
-    code = ble_client_send_frame(frame, lora_at_main->bluetooth);
+  // keep the frame until the next connection instead of connecting on every frame
+  code = at_journal_append(frame, lora_at_main->journal);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to store frame: %s", esp_err_to_name(code));
+  }
+  sx127x_util_frame_destroy(frame);
+  if (lora_at_main->config->bt_address != NULL && at_journal_pending(lora_at_main->journal) >= CONFIG_AT_JOURNAL_DRAIN_THRESHOLD) {
+    code = main_drain_journal(lora_at_main);
     if (code != ESP_OK) {
-      ESP_LOGE(TAG, "unable to send frame: %s", esp_err_to_name(code));
+      ESP_LOGE(TAG, "unable to send frames: %s", esp_err_to_name(code));
     }
-    sx127x_util_frame_destroy(frame);
   }
   deep_sleep_rx_enter(remaining_micros);
 }
@@ -125,6 +190,8 @@ static void rx_callback_deep_sleep(sx127x *device, uint8_t *data, uint16_t data_
 static void rx_callback(sx127x *device, uint8_t *data, uint16_t data_length) {
   sx127x_frame_t *frame = NULL;
   ERROR_CHECK("sx127x frame", sx127x_util_read_frame(lora_at_main->device, data, data_length, &frame));
+  // scan keeps the radio in rx until dwell time expires
+  bool scanning = (sx127x_util_scan_rx_done(frame, lora_at_main->scan) == ESP_OK);
   ESP_LOGI(TAG, "received frame: %d rssi: %d snr: %f freq_error: %" PRId32, data_length, frame->rssi, frame->snr, frame->frequency_error);
   if (lora_at_main->config->bt_address != NULL) {
     ble_server_send_frame(frame);
@@ -133,26 +200,54 @@ static void rx_callback(sx127x *device, uint8_t *data, uint16_t data_length) {
 #if CONFIG_AT_WIFI_ENABLED
     ERROR_CHECK("lora frame", at_rest_add_frame(frame, lora_at_main->rest));
 #else
-    ERROR_CHECK("sx127x frame", at_handler_add_frame(frame, lora_at_main->at_handler));
+    // push frame immediately if enabled, otherwise keep it until AT+PULL
+    if (uart_at_handler_push_frame(frame, lora_at_main->uart_at_handler) != ESP_OK) {
+      ERROR_CHECK("sx127x frame", at_handler_add_frame(frame, lora_at_main->at_handler));
+    }
 #endif
   }
   // this rx message was received using CAD<->RX mode
   // put back into CAD mode
-  if (lora_at_main->cad_mode == 1) {
+  if (!scanning && lora_at_main->cad_mode == 1) {
     ERROR_CHECK("cad mode", sx127x_set_opmod(SX127x_MODE_CAD, SX127x_MODULATION_LORA, device));
   }
 }
 
 void tx_callback(sx127x *device) {
-  if (CONFIG_SX127X_POWER_PROFILING > 0) {
-    gpio_set_level((gpio_num_t) CONFIG_SX127X_POWER_PROFILING, 0);
+  sx127x_util_tx_done(lora_at_main->device);
+  if (sx127x_util_tx_queue_done(lora_at_main->tx_queue) == ESP_OK) {
+    // completion will be reported by the tx queue
+    return;
   }
   const char *output = "OK\r\n";
-  uart_at_handler_send((char *) output, strlen(output), lora_at_main->uart_at_handler);
+  // interrupt task shouldn't wait for the current command
+  if (uart_at_handler_notify(output, strlen(output), lora_at_main->uart_at_handler) != ESP_OK) {
+    ESP_LOGE(TAG, "unable to report tx done");
+  }
   lora_at_display_set_status("IDLE", lora_at_main->display);
 }
 
+static void tx_job_callback(uint32_t id, esp_err_t code, void *ctx) {
+  main_t *main = (main_t *) ctx;
+  char output[64];
+  int length = snprintf(output, sizeof(output), "+TXDONE:%" PRIu32 ",%s\r\n", id, (code == ESP_OK ? "OK" : esp_err_to_name(code)));
+  // truncated error name is still useful
+  if (length >= (int) sizeof(output)) {
+    length = sizeof(output) - 1;
+  }
+  if (length < 0 || uart_at_handler_notify(output, length, main->uart_at_handler) != ESP_OK) {
+    ESP_LOGE(TAG, "unable to report tx job %" PRIu32, id);
+  }
+  if (sx127x_util_tx_queue_pending(main->tx_queue) == 0) {
+    lora_at_display_set_status("IDLE", main->display);
+  }
+}
+
 void cad_callback(sx127x *device, int cad_detected) {
+  if (sx127x_util_scan_cad_done(cad_detected != 0, lora_at_main->scan) == ESP_OK) {
+    // next mode will be set by the scan
+    return;
+  }
   if (cad_detected == 0) {
     ESP_LOGD(TAG, "cad not detected");
     lora_at_main->cad_mode = 0;
@@ -167,7 +262,9 @@ void cad_callback(sx127x *device, int cad_detected) {
 
 void send_status(main_t *main) {
   ble_client_status status;
+#if !CONFIG_IDF_TARGET_LINUX
   ERROR_CHECK("i2c", i2cdev_init());
+#endif
   at_sensors *sensors = NULL;
   ERROR_CHECK("sensors", at_sensors_init(&sensors));
   ERROR_CHECK("solar", at_sensors_get_solar_voltage(&status.solar_voltage, sensors));
@@ -175,42 +272,82 @@ void send_status(main_t *main) {
   ERROR_CHECK("battery", at_sensors_get_battery_voltage(&status.battery_voltage, sensors));
   ERROR_CHECK("battery", at_sensors_get_battery_current(&status.battery_current, sensors));
   at_sensors_destroy(sensors);
+#if !CONFIG_IDF_TARGET_LINUX
   i2cdev_done();
+#endif
   ERROR_CHECK("sx127x temperature", sx127x_util_read_temperature(main->device, &(status.sx127x_raw_temperature)));
   ERROR_CHECK("bluetooth rssi", ble_client_get_rssi(main->bluetooth, &(status.rssi)));
   ERROR_CHECK("send status", ble_client_send_status(&status, main->bluetooth));
 }
 
+static uint64_t main_current_millis() {
+  struct timeval tm_vl;
+  gettimeofday(&tm_vl, NULL);
+  return (uint64_t) tm_vl.tv_sec * 1000 + tm_vl.tv_usec / 1000;
+}
+
+// server is contacted only when the schedule is running low or too many frames are waiting
+static esp_err_t main_sync(main_t *main) {
+  if (main->config->bt_address == NULL) {
+    return ESP_OK;
+  }
+  bool refill = at_schedule_length(main->schedule) <= CONFIG_AT_SCHEDULE_REFILL_THRESHOLD;
+  if (!refill && at_journal_pending(main->journal) < CONFIG_AT_JOURNAL_DRAIN_THRESHOLD) {
+    return ESP_OK;
+  }
+  send_status(main);
+  esp_err_t code = main_drain_journal(main);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to send frames: %s", esp_err_to_name(code));
+  }
+  if (!refill) {
+    return code;
+  }
+  size_t length = 0;
+  code = ble_client_load_schedule(schedule_batch, CONFIG_AT_SCHEDULE_CAPACITY, &length, main->bluetooth);
+  if (code != ESP_OK) {
+    return code;
+  }
+  if (length > 0 && schedule_batch[0].currentTimeMillis != 0) {
+    // time will be used in rx callback to figure out how long to sleep
+    struct timeval tm_vl;
+    tm_vl.tv_sec = schedule_batch[0].currentTimeMillis / 1000;
+    tm_vl.tv_usec = (schedule_batch[0].currentTimeMillis % 1000) * 1000;
+    settimeofday(&tm_vl, NULL);
+  }
+  code = at_schedule_load(schedule_batch, length, main->schedule);
+  if (code != ESP_OK) {
+    return code;
+  }
+  ESP_LOGI(TAG, "schedule loaded: %d rejected: %d", at_schedule_length(main->schedule), main->schedule->rejected);
+  return ESP_OK;
+}
+
 void schedule_observation_and_go_ds(main_t *main) {
-  lora_config_t *req = NULL;
-  if (main->config->bt_address != NULL) {
-    send_status(main);
-    ERROR_CHECK_DS("rx request", ble_client_load_request(&req, main->bluetooth));
+  esp_err_t code = main_sync(main);
+  if (code != ESP_OK) {
+    // keep going with the remaining observations
+    ESP_LOGE(TAG, "unable to sync with server: %s", esp_err_to_name(code));
   }
-  if (req == NULL) {
+  lora_config_t req;
+  if (at_schedule_next(main_current_millis(), &req, main->schedule) != ESP_OK) {
+    if (code != ESP_OK) {
+      deep_sleep_enter(CONFIG_BLUETOOTH_RECONNECTION_INTERVAL * 1000);
+      return;
+    }
     ESP_LOGI(TAG, "no active requests");
     main_deep_sleep_enter(main->config->deep_sleep_period_micros);
     return;
   }
-  if (req->currentTimeMillis > req->endTimeMillis || req->startTimeMillis > req->endTimeMillis) {
-    ESP_LOGE(TAG, "incorrect schedule found on server current: %" PRIu64 " start: %" PRIu64 " end: %" PRIu64, req->currentTimeMillis, req->startTimeMillis, req->endTimeMillis);
-    main_deep_sleep_enter(main->config->deep_sleep_period_micros);
+  if (req.startTimeMillis > req.currentTimeMillis) {
+    main_deep_sleep_enter((req.startTimeMillis - req.currentTimeMillis) * 1000);
     return;
   }
-  if (req->startTimeMillis > req->currentTimeMillis) {
-    main_deep_sleep_enter((req->startTimeMillis - req->currentTimeMillis) * 1000);
-    return;
-  }
-  // set time before doing rx
-  // time will be used in rx callback to figure out how long to sleep
-  struct timeval tm_vl;
-  tm_vl.tv_sec = req->currentTimeMillis / 1000;
-  tm_vl.tv_usec = 0;
-  settimeofday(&tm_vl, NULL);
   // observation actually should start now
-  ERROR_CHECK_DS("start rx", sx127x_util_lora_rx(SX127x_MODE_RX_CONT, req, main->device));
-  rx_end_micros = req->endTimeMillis * 1000;
-  deep_sleep_rx_enter((req->endTimeMillis - req->currentTimeMillis) * 1000);
+  ESP_LOGI(TAG, "observation started. remaining: %d", at_schedule_length(main->schedule));
+  ERROR_CHECK_DS("start rx", sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &req, main->device));
+  rx_end_micros = req.endTimeMillis * 1000;
+  deep_sleep_rx_enter((req.endTimeMillis - req.currentTimeMillis) * 1000);
 }
 
 static void at_timer_callback(void *arg) {
@@ -236,10 +373,24 @@ void app_main(void) {
   }
   lora_at_main->cad_mode = 0;
   lora_at_main->device = NULL;
+  lora_at_main->tx_queue = NULL;
+  lora_at_main->scan = NULL;
+  lora_at_main->uart_at_handler = NULL;
+  lora_at_main->schedule = &rtc_schedule;
+  lora_at_main->journal = NULL;
 
   ERROR_CHECK("config", lora_at_config_create(&lora_at_main->config));
   ESP_LOGI(TAG, "config initialized");
 
+  const esp_partition_t *journal_partition = NULL;
+#if !CONFIG_IDF_TARGET_LINUX
+  journal_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, AT_JOURNAL_PARTITION_SUBTYPE, "journal");
+#endif
+  if (journal_partition == NULL) {
+    ESP_LOGI(TAG, "journal partition not found. frames are kept in RTC memory only");
+  }
+  ERROR_CHECK("journal", at_journal_create(journal_partition, &rtc_journal, &lora_at_main->journal));
+
   ERROR_CHECK("bluetooth", ble_client_create(lora_at_main->config->bt_address, &lora_at_main->bluetooth));
   if (lora_at_main->config->bt_address != NULL) {
     ESP_LOGI(TAG, "bluetooth initialized");
@@ -247,6 +398,8 @@ void app_main(void) {
     ESP_LOGI(TAG, "bluetooth not initialized");
   }
 
+  // simulation on the host always starts from the reset
+#if !CONFIG_IDF_TARGET_LINUX
   esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
   if (cause == ESP_SLEEP_WAKEUP_TIMER) {
     ESP_LOGI(TAG, "woken up by timer. loading new rx request");
@@ -265,6 +418,7 @@ void app_main(void) {
     sx127x_handle_interrupt(lora_at_main->device->device); // should always put esp32 into deep sleep. so can return from here
     return;
   }
+#endif
 //  esp_log_level_set("*", ESP_LOG_INFO);
   // reset whatever state was before
   esp_err_t code = sx127x_util_reset();
@@ -274,9 +428,11 @@ void app_main(void) {
   ERROR_CHECK("lora", sx127x_util_init(&lora_at_main->device));
   ERROR_CHECK("lora sleep", sx127x_set_opmod(SX127x_MODE_SLEEP, SX127x_MODULATION_LORA, lora_at_main->device->device));
   sx127x_rx_set_callback(rx_callback, lora_at_main->device->device);
-  sx127x_tx_set_callback(tx_callback, lora_at_main->device->device);
+  sx127x_util_tx_set_callback(tx_callback, lora_at_main->device);
   sx127x_lora_cad_set_callback(cad_callback, lora_at_main->device->device);
   ESP_LOGI(TAG, "sx127x initialized");
+  ERROR_CHECK("scan", sx127x_util_scan_create(lora_at_main->device, &lora_at_main->scan));
+  ERROR_CHECK("tx queue", sx127x_util_tx_queue_create(CONFIG_AT_TX_QUEUE_LENGTH, lora_at_main->device, lora_at_main->scan, tx_job_callback, lora_at_main, &lora_at_main->tx_queue));
 
   ERROR_CHECK("display", lora_at_display_create(&lora_at_main->display));
   lora_at_display_set_status("IDLE", lora_at_main->display);
@@ -292,10 +448,12 @@ void app_main(void) {
     ERROR_CHECK("timer", at_timer_start(lora_at_main->config->inactivity_period_micros, lora_at_main->timer));
   }
 
-  ERROR_CHECK("at_handler", at_handler_create(lora_at_main->config, lora_at_main->display, lora_at_main->device, lora_at_main->bluetooth, lora_at_main->timer, &lora_at_main->at_handler));
+  ERROR_CHECK("at_handler", at_handler_create(lora_at_main->config, lora_at_main->display, lora_at_main->device, lora_at_main->bluetooth, lora_at_main->timer, lora_at_main->tx_queue, lora_at_main->scan, &lora_at_main->at_handler));
   ESP_LOGI(TAG, "at handler initialized");
 
+#if !CONFIG_IDF_TARGET_LINUX
   ERROR_CHECK("i2c", i2cdev_init());
+#endif
   ERROR_CHECK("sensors", at_sensors_init(&lora_at_main->sensors));
   ERROR_CHECK("ble_server", ble_server_create(lora_at_main->sensors, lora_at_main->device, lora_at_main->config));
   xTaskCreate(update_sensors, "update_sensors_task", 1024 * 4, lora_at_main, configMAX_PRIORITIES - 1, NULL);
@@ -303,8 +461,9 @@ void app_main(void) {
   ERROR_CHECK("uart_at", uart_at_handler_create(lora_at_main->at_handler, lora_at_main->timer, &lora_at_main->uart_at_handler));
   ESP_LOGI(TAG, "uart initialized");
   xTaskCreate(uart_rx_task, "uart_rx_task", 1024 * 4, lora_at_main, configMAX_PRIORITIES - 1, NULL);
+  xTaskCreate(uart_push_task, "uart_push_task", 1024 * 4, lora_at_main, configMAX_PRIORITIES - 1, NULL);
 
   ERROR_CHECK("at_wifi", at_wifi_connect());
-  ERROR_CHECK("at_rest", at_rest_create(lora_at_main->device, &lora_at_main->rest));
+  ERROR_CHECK("at_rest", at_rest_create(lora_at_main->device, lora_at_main->scan, lora_at_main->schedule, lora_at_main->journal, &lora_at_main->rest));
   ESP_LOGI(TAG, "lora-at initialized");
 }
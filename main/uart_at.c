@@ -2,8 +2,14 @@
 #include <errno.h>
 #include <driver/uart.h>
 #include <string.h>
+#include <stdlib.h>
 #include <esp_log.h>
 #include <sdkconfig.h>
+#include <at_codec.h>
+#include <at_command.h>
+#include <inttypes.h>
+#include <esp_timer.h>
+#include <at_perf.h>
 
 #ifndef CONFIG_AT_UART_PORT_NUM
 #define CONFIG_AT_UART_PORT_NUM UART_NUM_0
@@ -25,6 +31,46 @@
 #define CONFIG_AT_UART_TX_PIN UART_PIN_NO_CHANGE
 #endif
 
+#ifndef CONFIG_AT_UART_RTS_PIN
+#define CONFIG_AT_UART_RTS_PIN UART_PIN_NO_CHANGE
+#endif
+
+#ifndef CONFIG_AT_UART_CTS_PIN
+#define CONFIG_AT_UART_CTS_PIN UART_PIN_NO_CHANGE
+#endif
+
+#ifndef CONFIG_AT_UART_CONFIRM_TIMEOUT
+#define CONFIG_AT_UART_CONFIRM_TIMEOUT 5000
+#endif
+
+#define UART_MIN_BAUD_RATE 9600
+#define UART_MAX_BAUD_RATE 2000000
+// RTS is de-asserted when RX FIFO reaches this level
+#define UART_FLOW_CONTROL_THRESHOLD 100
+
+#ifndef CONFIG_AT_RX_PUSH_QUEUE_LENGTH
+#define CONFIG_AT_RX_PUSH_QUEUE_LENGTH 8
+#endif
+
+#ifndef CONFIG_AT_UART_NOTIFY_QUEUE_LENGTH
+#define CONFIG_AT_UART_NOTIFY_QUEUE_LENGTH 8
+#endif
+
+#define PUSH_WRITER_CHUNK_LENGTH 256
+#define NOTIFICATION_LENGTH 64
+#define NOTIFICATION_TIMEOUT_MILLIS 100
+
+// received frame or short text written by the push task
+typedef struct {
+  // NULL for text notification
+  sx127x_frame_t *frame;
+  uint8_t length;
+  char text[NOTIFICATION_LENGTH];
+} uart_at_push_t;
+
+// upper bounds of the latency histogram buckets. the last bucket is everything else
+static const uint32_t LATENCY_BUCKETS_MICROS[UART_AT_LATENCY_BUCKETS - 1] = {500, 1000, 2000, 5000, 10000, 50000, 100000};
+
 #define ERROR_CHECK_ON_CREATE(x)        \
   do {                        \
     esp_err_t __err_rc = (x); \
@@ -45,32 +91,315 @@ esp_err_t uart_at_handler_create(at_handler_t *at_handler, at_timer_t *timer, ua
   result->handler = at_handler;
   result->timer = timer;
   result->last_active_micros = 0;
+  result->binary = false;
+  result->rx_push = false;
+  result->pushed = 0;
+  result->push_fallback = 0;
+  memset(result->push_latency, 0, sizeof(result->push_latency));
+  result->overflows = 0;
+  result->uart_pending = false;
+  result->baud_rate = CONFIG_AT_UART_BAUD_RATE;
+  result->flow_control = 0;
+  if (at_handler->at_config->uart_baud_rate != 0) {
+    result->baud_rate = at_handler->at_config->uart_baud_rate;
+    // pins might be re-configured since the last run
+    if (CONFIG_AT_UART_RTS_PIN >= 0 && CONFIG_AT_UART_CTS_PIN >= 0) {
+      result->flow_control = at_handler->at_config->uart_flow_control;
+    }
+  }
+  result->push_queue = NULL;
+  result->push_writer = NULL;
+  result->buffer = NULL;
+  result->binary_payload = NULL;
+  result->binary_output = NULL;
+  result->driver_installed = false;
+  result->output_mutex = xSemaphoreCreateRecursiveMutex();
+  if (result->output_mutex == NULL) {
+    uart_at_handler_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  // notifications have their own slots
+  result->push_queue = xQueueCreate(CONFIG_AT_RX_PUSH_QUEUE_LENGTH + CONFIG_AT_UART_NOTIFY_QUEUE_LENGTH, sizeof(uart_at_push_t));
+  if (result->push_queue == NULL) {
+    uart_at_handler_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  ERROR_CHECK_ON_CREATE(at_writer_create(PUSH_WRITER_CHUNK_LENGTH, &result->push_writer));
   result->buffer = malloc(sizeof(uint8_t) * (CONFIG_AT_UART_BUFFER_LENGTH + 1)); // 1 is for \0
-  memset(result->buffer, 0, (CONFIG_AT_UART_BUFFER_LENGTH + 1));
   if (result->buffer == NULL) {
     uart_at_handler_destroy(result);
     return ESP_ERR_NO_MEM;
   }
+  memset(result->buffer, 0, (CONFIG_AT_UART_BUFFER_LENGTH + 1));
+  result->binary_payload = malloc(sizeof(uint8_t) * AT_CODEC_MAX_PAYLOAD_LENGTH);
+  if (result->binary_payload == NULL) {
+    uart_at_handler_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
+  result->binary_output = malloc(sizeof(uint8_t) * AT_CODEC_MAX_ENCODED_LENGTH(AT_CODEC_MAX_PAYLOAD_LENGTH));
+  if (result->binary_output == NULL) {
+    uart_at_handler_destroy(result);
+    return ESP_ERR_NO_MEM;
+  }
   uart_config_t uart_config = {
-      .baud_rate = CONFIG_AT_UART_BAUD_RATE,
+      .baud_rate = (int) result->baud_rate,
       .data_bits = UART_DATA_8_BITS,
       .parity = UART_PARITY_DISABLE,
       .stop_bits = UART_STOP_BITS_1,
-      .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+      .flow_ctrl = (result->flow_control ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE),
+      .rx_flow_ctrl_thresh = UART_FLOW_CONTROL_THRESHOLD,
       .source_clk = UART_SCLK_DEFAULT,
   };
   ERROR_CHECK_ON_CREATE(uart_driver_install(result->uart_port_num, CONFIG_AT_UART_BUFFER_LENGTH * 2, CONFIG_AT_UART_BUFFER_LENGTH * 2, 20, &result->uart_queue, 0));
+  result->driver_installed = true;
   ERROR_CHECK_ON_CREATE(uart_param_config(result->uart_port_num, &uart_config));
-  ERROR_CHECK_ON_CREATE(uart_set_pin(result->uart_port_num, CONFIG_AT_UART_TX_PIN, CONFIG_AT_UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+  ERROR_CHECK_ON_CREATE(uart_set_pin(result->uart_port_num, CONFIG_AT_UART_TX_PIN, CONFIG_AT_UART_RX_PIN, CONFIG_AT_UART_RTS_PIN, CONFIG_AT_UART_CTS_PIN));
   ERROR_CHECK_ON_CREATE(uart_enable_pattern_det_baud_intr(result->uart_port_num, '\n', 1, 9, 0, 0));
   ERROR_CHECK_ON_CREATE(uart_pattern_queue_reset(result->uart_port_num, 20));
   *handler = result;
   return ESP_OK;
 }
 
+// text responses are split into chunks of this size in binary mode
+#define BINARY_RESPONSE_LENGTH 256
+
+static void uart_at_handler_send_binary(uint8_t type, const uint8_t *payload, size_t payload_length, uart_at_handler_t *handler) {
+  size_t output_length = 0;
+  xSemaphoreTakeRecursive(handler->output_mutex, portMAX_DELAY);
+  esp_err_t code = at_codec_encode(type, payload, payload_length, handler->binary_output, AT_CODEC_MAX_ENCODED_LENGTH(AT_CODEC_MAX_PAYLOAD_LENGTH), &output_length);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to encode message: %s", esp_err_to_name(code));
+  } else {
+    uart_write_bytes(handler->uart_port_num, handler->binary_output, output_length);
+  }
+  xSemaphoreGiveRecursive(handler->output_mutex);
+}
+
 void uart_at_handler_send(char *output, size_t output_length, void *ctx) {
   uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
-  uart_write_bytes(handler->uart_port_num, output, output_length);
+  if (!handler->binary) {
+    xSemaphoreTakeRecursive(handler->output_mutex, portMAX_DELAY);
+    uart_write_bytes(handler->uart_port_num, output, output_length);
+    xSemaphoreGiveRecursive(handler->output_mutex);
+    return;
+  }
+  for (size_t i = 0; i < output_length; i += BINARY_RESPONSE_LENGTH) {
+    size_t length = output_length - i;
+    if (length > BINARY_RESPONSE_LENGTH) {
+      length = BINARY_RESPONSE_LENGTH;
+    }
+    uart_at_handler_send_binary(AT_CODEC_RESPONSE, (uint8_t *) output + i, length, handler);
+  }
+}
+
+static void uart_at_handler_send_frame(sx127x_frame_t *frame, void *ctx) {
+  uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
+  at_codec_frame_t header = {
+      .frequency_error = frame->frequency_error,
+      .rssi = frame->rssi,
+      .snr = frame->snr,
+      .timestamp = frame->timestamp,
+      .timestamp_micros = frame->timestamp_micros,
+      .data_length = frame->data_length
+  };
+  // payload buffer is shared. fsk frames can be up to SX127X_UTIL_MAX_FSK_PACKET_LENGTH
+  xSemaphoreTakeRecursive(handler->output_mutex, portMAX_DELAY);
+  memcpy(handler->binary_payload, &header, sizeof(header));
+  memcpy(handler->binary_payload + sizeof(header), frame->data, frame->data_length);
+  uart_at_handler_send_binary(AT_CODEC_FRAME, handler->binary_payload, sizeof(header) + frame->data_length, handler);
+  xSemaphoreGiveRecursive(handler->output_mutex);
+}
+
+static esp_err_t uart_at_handler_set_binary(bool binary, uart_at_handler_t *handler) {
+  // binary messages are delimited by 0x00 instead of '\n'
+  esp_err_t code = uart_disable_pattern_det_intr(handler->uart_port_num);
+  if (code != ESP_OK) {
+    return code;
+  }
+  code = uart_enable_pattern_det_baud_intr(handler->uart_port_num, (binary ? AT_CODEC_DELIMITER : '\n'), 1, 9, 0, 0);
+  if (code != ESP_OK) {
+    return code;
+  }
+  code = uart_pattern_queue_reset(handler->uart_port_num, 20);
+  if (code != ESP_OK) {
+    return code;
+  }
+  handler->binary = binary;
+  return ESP_OK;
+}
+
+static void uart_at_handler_respond(const char *output, uart_at_handler_t *handler) {
+  uart_at_handler_send((char *) output, strlen(output), handler);
+}
+
+static void uart_at_handler_mode(at_command_arg_t *args, uint8_t args_length, void *ctx) {
+  uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
+  bool binary;
+  if (strcmp("BIN", args[0].s) == 0) {
+    binary = true;
+  } else if (strcmp("TEXT", args[0].s) == 0) {
+    binary = false;
+  } else {
+    uart_at_handler_respond("unknown mode\r\nERROR\r\n", handler);
+    return;
+  }
+  // respond using current mode
+  uart_at_handler_respond("OK\r\n", handler);
+  esp_err_t code = uart_at_handler_set_binary(binary, handler);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to switch mode: %s", esp_err_to_name(code));
+  }
+}
+
+static void uart_at_handler_rx_push_set(at_command_arg_t *args, uint8_t args_length, void *ctx) {
+  uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
+  handler->rx_push = (args[0].u != 0);
+  uart_at_handler_respond("OK\r\n", handler);
+}
+
+static void uart_at_handler_rx_push_get(at_command_arg_t *args, uint8_t args_length, void *ctx) {
+  uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
+  char output[256];
+  uint32_t *latency = handler->push_latency;
+  snprintf(output, sizeof(output), "%d\r\npushed: %" PRIu32 " buffered: %" PRIu32 "\r\nlatency: 500us:%" PRIu32 " 1ms:%" PRIu32 " 2ms:%" PRIu32 " 5ms:%" PRIu32 " 10ms:%" PRIu32 " 50ms:%" PRIu32 " 100ms:%" PRIu32 " inf:%" PRIu32 "\r\nOK\r\n",
+           (handler->rx_push ? 1 : 0), handler->pushed, handler->push_fallback, latency[0], latency[1], latency[2], latency[3], latency[4], latency[5], latency[6], latency[7]);
+  uart_at_handler_respond(output, handler);
+}
+
+static esp_err_t uart_at_handler_apply(uint32_t baud_rate, uint8_t flow_control, uart_at_handler_t *handler) {
+  // finish sending everything using the current settings
+  uart_wait_tx_done(handler->uart_port_num, pdMS_TO_TICKS(100));
+  esp_err_t code = uart_set_hw_flow_ctrl(handler->uart_port_num, (flow_control ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE), UART_FLOW_CONTROL_THRESHOLD);
+  if (code != ESP_OK) {
+    return code;
+  }
+  code = uart_set_baudrate(handler->uart_port_num, baud_rate);
+  if (code != ESP_OK) {
+    return code;
+  }
+  handler->baud_rate = baud_rate;
+  handler->flow_control = flow_control;
+  return ESP_OK;
+}
+
+static void uart_at_handler_uart_set(at_command_arg_t *args, uint8_t args_length, void *ctx) {
+  uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
+  uint32_t baud_rate = (uint32_t) args[0].u;
+  uint8_t flow_control = (uint8_t) args[1].u;
+  if (baud_rate < UART_MIN_BAUD_RATE || baud_rate > UART_MAX_BAUD_RATE || flow_control > 1) {
+    uart_at_handler_respond("invalid baud rate or flow control\r\nERROR\r\n", handler);
+    return;
+  }
+  if (flow_control && (CONFIG_AT_UART_RTS_PIN < 0 || CONFIG_AT_UART_CTS_PIN < 0)) {
+    uart_at_handler_respond("RTS/CTS pins are not configured\r\nERROR\r\n", handler);
+    return;
+  }
+  uint32_t previous_baud_rate = (handler->uart_pending ? handler->previous_baud_rate : handler->baud_rate);
+  uint8_t previous_flow_control = (handler->uart_pending ? handler->previous_flow_control : handler->flow_control);
+  // respond using the current settings
+  uart_at_handler_respond("OK\r\n", handler);
+  esp_err_t code = uart_at_handler_apply(baud_rate, flow_control, handler);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to change uart settings: %s", esp_err_to_name(code));
+    uart_at_handler_apply(previous_baud_rate, previous_flow_control, handler);
+    return;
+  }
+  // host should send "AT" using new settings. otherwise previous will be restored
+  handler->previous_baud_rate = previous_baud_rate;
+  handler->previous_flow_control = previous_flow_control;
+  handler->uart_pending_deadline_micros = esp_timer_get_time() + CONFIG_AT_UART_CONFIRM_TIMEOUT * 1000LL;
+  handler->uart_pending = true;
+}
+
+static void uart_at_handler_uart_get(at_command_arg_t *args, uint8_t args_length, void *ctx) {
+  uart_at_handler_t *handler = (uart_at_handler_t *) ctx;
+  char output[128];
+  snprintf(output, sizeof(output), "%" PRIu32 ",%d\r\noverflows: %" PRIu32 "\r\nOK\r\n", handler->baud_rate, handler->flow_control, handler->overflows);
+  uart_at_handler_respond(output, handler);
+}
+
+static void uart_at_handler_uart_confirm(uart_at_handler_t *handler) {
+  handler->uart_pending = false;
+  esp_err_t code = lora_at_config_set_uart(handler->baud_rate, handler->flow_control, handler->handler->at_config);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to save uart settings: %s", esp_err_to_name(code));
+  }
+}
+
+static void uart_at_handler_uart_rollback(uart_at_handler_t *handler) {
+  handler->uart_pending = false;
+  ESP_LOGI(TAG, "uart settings were not confirmed. restoring %" PRIu32, handler->previous_baud_rate);
+  esp_err_t code = uart_at_handler_apply(handler->previous_baud_rate, handler->previous_flow_control, handler);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to restore uart settings: %s", esp_err_to_name(code));
+  }
+}
+
+// commands specific to serial interface. sorted by name
+static const at_command_t uart_at_commands[] = {
+    {"AT+MODE=", "s", false, uart_at_handler_mode},
+    {"AT+RXPUSH=", "B", false, uart_at_handler_rx_push_set},
+    {"AT+RXPUSH?", NULL, false, uart_at_handler_rx_push_get},
+    {"AT+UART=", "IB", false, uart_at_handler_uart_set},
+    {"AT+UART?", NULL, false, uart_at_handler_uart_get},
+};
+
+static void uart_at_handler_process_text(char *input, size_t input_length, uart_at_handler_t *handler) {
+  if (handler->uart_pending && strcmp("AT", input) == 0) {
+    uart_at_handler_uart_confirm(handler);
+  }
+  esp_err_t code = at_command_process(uart_at_commands, sizeof(uart_at_commands) / sizeof(at_command_t), input, handler);
+  if (code == ESP_ERR_NOT_FOUND) {
+    at_handler_process(input, input_length, uart_at_handler_send, handler, handler->handler);
+  } else if (code != ESP_OK) {
+    uart_at_handler_respond("unknown command\r\nERROR\r\n", handler);
+  }
+}
+
+static void uart_at_handler_process_binary(uint8_t *input, size_t input_length, uart_at_handler_t *handler) {
+  uint8_t type = 0;
+  uint8_t *payload = NULL;
+  size_t payload_length = 0;
+  esp_err_t code = at_codec_decode(input, input_length, &type, &payload, &payload_length);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to decode message: %s", esp_err_to_name(code));
+    uart_at_handler_respond("invalid message\r\nERROR\r\n", handler);
+    return;
+  }
+  lora_config_t config;
+  switch (type) {
+    case AT_CODEC_COMMAND:
+      // crc is not needed anymore
+      payload[payload_length] = '\0';
+      uart_at_handler_process_text((char *) payload, payload_length, handler);
+      break;
+    case AT_CODEC_LORA_RX:
+      if (payload_length != sizeof(lora_config_t)) {
+        uart_at_handler_respond("invalid config\r\nERROR\r\n", handler);
+        break;
+      }
+      memcpy(&config, payload, sizeof(lora_config_t));
+      at_handler_lora_rx(SX127x_MODE_RX_CONT, &config, uart_at_handler_send, handler, handler->handler);
+      break;
+    case AT_CODEC_LORA_TX:
+      if (payload_length <= sizeof(lora_config_t) || payload_length > sizeof(lora_config_t) + SX127X_UTIL_MAX_PACKET_LENGTH) {
+        uart_at_handler_respond("invalid config\r\nERROR\r\n", handler);
+        break;
+      }
+      memcpy(&config, payload, sizeof(lora_config_t));
+      at_handler_lora_tx(payload + sizeof(lora_config_t), payload_length - sizeof(lora_config_t), &config, uart_at_handler_send, handler, handler->handler);
+      break;
+    case AT_CODEC_PULL:
+      at_handler_pull_frames(uart_at_handler_send_frame, handler, handler->handler);
+      uart_at_handler_respond("OK\r\n", handler);
+      break;
+    case AT_CODEC_ECHO:
+      uart_at_handler_send_binary(AT_CODEC_ECHO, payload, payload_length, handler);
+      break;
+    default:
+      uart_at_handler_respond("unknown command\r\nERROR\r\n", handler);
+      break;
+  }
 }
 
 void uart_at_handler_process(uart_at_handler_t *handler) {
@@ -78,13 +407,29 @@ void uart_at_handler_process(uart_at_handler_t *handler) {
   size_t current_index = 0;
   int pattern_length = 0;
   while (1) {
-    if (xQueueReceive(handler->uart_queue, (void *) &event, (TickType_t) portMAX_DELAY)) {
+    TickType_t timeout = portMAX_DELAY;
+    if (handler->uart_pending) {
+      int64_t remaining_micros = handler->uart_pending_deadline_micros - esp_timer_get_time();
+      if (remaining_micros <= 0) {
+        uart_at_handler_uart_rollback(handler);
+        continue;
+      }
+      timeout = pdMS_TO_TICKS(remaining_micros / 1000) + 1;
+    }
+    if (xQueueReceive(handler->uart_queue, (void *) &event, timeout)) {
       switch (event.type) {
         //Event of UART receving data
         /*We'd better handler data event fast, there would be much more data events than
         other types of events. If we take too much time on data event, the queue might
         be full.*/
         case UART_DATA:
+          if (current_index + event.size > CONFIG_AT_UART_BUFFER_LENGTH) {
+            // command is too long
+            handler->overflows++;
+            uart_flush_input(handler->uart_port_num);
+            current_index = 0;
+            break;
+          }
           uart_read_bytes(handler->uart_port_num, handler->buffer + current_index, event.size, portMAX_DELAY);
           current_index += event.size;
           break;
@@ -108,6 +453,7 @@ void uart_at_handler_process(uart_at_handler_t *handler) {
           // If fifo overflow happened, you should consider adding flow control for your application.
           // The ISR has already reset the rx FIFO,
           // As an example, we directly flush the rx buffer here in order to read more data.
+          handler->overflows++;
           uart_flush_input(handler->uart_port_num);
           xQueueReset(handler->uart_queue);
           current_index = 0;
@@ -119,19 +465,36 @@ void uart_at_handler_process(uart_at_handler_t *handler) {
         continue;
       }
       bool found = false;
-      // support for \r, \r\n or \n terminators
-      if (handler->buffer[current_index - 1] == '\n') {
-        handler->buffer[current_index - 1] = '\0';
-        current_index--;
-        found = true;
-      }
-      if (current_index > 0 && handler->buffer[current_index - 1] == '\r') {
-        handler->buffer[current_index - 1] = '\0';
-        current_index--;
-        found = true;
+      if (handler->binary) {
+        if (handler->buffer[current_index - 1] == AT_CODEC_DELIMITER) {
+          // lone delimiters can be used by host to re-synchronize
+          if (current_index > 1) {
+            xSemaphoreTakeRecursive(handler->output_mutex, portMAX_DELAY);
+            uart_at_handler_process_binary((uint8_t *) handler->buffer, current_index, handler);
+            xSemaphoreGiveRecursive(handler->output_mutex);
+          }
+          found = true;
+        }
+      } else {
+        // support for \r, \r\n or \n terminators
+        if (handler->buffer[current_index - 1] == '\n') {
+          handler->buffer[current_index - 1] = '\0';
+          current_index--;
+          found = true;
+        }
+        if (current_index > 0 && handler->buffer[current_index - 1] == '\r') {
+          handler->buffer[current_index - 1] = '\0';
+          current_index--;
+          found = true;
+        }
+        found = found && current_index > 0;
+        if (found) {
+          xSemaphoreTakeRecursive(handler->output_mutex, portMAX_DELAY);
+          uart_at_handler_process_text(handler->buffer, current_index, handler);
+          xSemaphoreGiveRecursive(handler->output_mutex);
+        }
       }
-      if (found && current_index > 0) {
-        at_handler_process(handler->buffer, current_index, uart_at_handler_send, handler, handler->handler);
+      if (found) {
         esp_err_t code = at_timer_get_counter(&handler->last_active_micros, handler->timer);
         if (code != ESP_OK) {
           ESP_LOGE(TAG, "unable to get current time: %s", esp_err_to_name(code));
@@ -143,6 +506,92 @@ void uart_at_handler_process(uart_at_handler_t *handler) {
   }
 }
 
+esp_err_t uart_at_handler_push_frame(sx127x_frame_t *frame, uart_at_handler_t *handler) {
+  if (handler == NULL || !handler->rx_push) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  uart_at_push_t item = {.frame = frame, .length = 0};
+  // frames are pushed only from the interrupt task, so they never take the reserved slots
+  if (uxQueueSpacesAvailable(handler->push_queue) <= CONFIG_AT_UART_NOTIFY_QUEUE_LENGTH || xQueueSend(handler->push_queue, &item, 0) != pdTRUE) {
+    handler->push_fallback++;
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t uart_at_handler_notify(const char *output, size_t output_length, uart_at_handler_t *handler) {
+  if (handler == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (output_length > NOTIFICATION_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uart_at_push_t item = {.frame = NULL, .length = (uint8_t) output_length};
+  memcpy(item.text, output, output_length);
+  if (xQueueSend(handler->push_queue, &item, pdMS_TO_TICKS(NOTIFICATION_TIMEOUT_MILLIS)) == pdTRUE) {
+    return ESP_OK;
+  }
+  // push task is stuck behind a long command. taking output_mutex might deadlock with the radio lock.
+  // uart driver writes every call atomically, so the notification can only appear between response chunks
+  ESP_LOGW(TAG, "push queue is full. writing notification directly");
+  if (!handler->binary) {
+    uart_write_bytes(handler->uart_port_num, output, output_length);
+    return ESP_OK;
+  }
+  uint8_t encoded[AT_CODEC_MAX_ENCODED_LENGTH(NOTIFICATION_LENGTH)];
+  size_t encoded_length = 0;
+  esp_err_t code = at_codec_encode(AT_CODEC_RESPONSE, (const uint8_t *) output, output_length, encoded, sizeof(encoded), &encoded_length);
+  if (code != ESP_OK) {
+    return code;
+  }
+  uart_write_bytes(handler->uart_port_num, encoded, encoded_length);
+  return ESP_OK;
+}
+
+static void uart_at_handler_record_latency(sx127x_frame_t *frame, uart_at_handler_t *handler) {
+  int64_t latency = esp_timer_get_time() - frame->interrupt_micros;
+  uint8_t bucket = 0;
+  while (bucket < UART_AT_LATENCY_BUCKETS - 1 && latency > LATENCY_BUCKETS_MICROS[bucket]) {
+    bucket++;
+  }
+  handler->push_latency[bucket]++;
+}
+
+void uart_at_handler_push_process(uart_at_handler_t *handler) {
+  uart_at_push_t item;
+  while (1) {
+    if (xQueueReceive(handler->push_queue, &item, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    // wait until the current command completes
+    xSemaphoreTakeRecursive(handler->output_mutex, portMAX_DELAY);
+    if (item.frame == NULL) {
+      uart_at_handler_send(item.text, item.length, handler);
+      xSemaphoreGiveRecursive(handler->output_mutex);
+      continue;
+    }
+    sx127x_frame_t *frame = item.frame;
+    uart_at_handler_record_latency(frame, handler);
+    if (handler->binary) {
+      uart_at_handler_send_frame(frame, handler);
+    } else {
+      at_writer_begin(uart_at_handler_send, handler, handler->push_writer);
+      at_writer_write("+RX:", 4, handler->push_writer);
+      at_writer_hex(frame->data, frame->data_length, handler->push_writer);
+      at_writer_printf(handler->push_writer, ",%d,%g,%" PRId32 ",%" PRIu64 ",%" PRIu64, frame->rssi, frame->snr, frame->frequency_error, frame->timestamp, frame->timestamp_micros);
+      if (frame->channel >= 0) {
+        at_writer_printf(handler->push_writer, ",%d", frame->channel);
+      }
+      at_writer_write("\r\n", 2, handler->push_writer);
+      at_writer_flush(handler->push_writer);
+    }
+    xSemaphoreGiveRecursive(handler->output_mutex);
+    at_perf_record(AT_PERF_ISR_TO_UART, frame->interrupt_stamp);
+    handler->pushed++;
+    sx127x_util_frame_destroy(frame);
+  }
+}
+
 esp_err_t uart_at_get_last_active(uint64_t *last_active_micros, uart_at_handler_t *handler) {
   *last_active_micros = handler->last_active_micros;
   handler->last_active_micros = 0;
@@ -156,6 +605,25 @@ void uart_at_handler_destroy(uart_at_handler_t *handler) {
   if (handler->buffer != NULL) {
     free(handler->buffer);
   }
-  uart_driver_delete(handler->uart_port_num);
+  if (handler->binary_payload != NULL) {
+    free(handler->binary_payload);
+  }
+  if (handler->binary_output != NULL) {
+    free(handler->binary_output);
+  }
+  if (handler->driver_installed) {
+    uart_driver_delete(handler->uart_port_num);
+  }
+  if (handler->push_queue != NULL) {
+    uart_at_push_t item;
+    while (xQueueReceive(handler->push_queue, &item, 0) == pdTRUE) {
+      sx127x_util_frame_destroy(item.frame);
+    }
+    vQueueDelete(handler->push_queue);
+  }
+  if (handler->output_mutex != NULL) {
+    vSemaphoreDelete(handler->output_mutex);
+  }
+  at_writer_destroy(handler->push_writer);
   free(handler);
 }
\ No newline at end of file
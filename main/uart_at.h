@@ -5,14 +5,40 @@
 #include "at_handler.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <stdbool.h>
+
+#define UART_AT_LATENCY_BUCKETS 8
 
 typedef struct {
   int uart_port_num;
   char *buffer;
+  // uart driver is deleted only if it was installed
+  bool driver_installed;
   QueueHandle_t uart_queue;
   at_handler_t *handler;
   at_timer_t *timer;
   uint64_t last_active_micros;
+  bool binary;
+  // responses and unsolicited frames should not interleave. held by the uart task for the whole command
+  SemaphoreHandle_t output_mutex;
+  // binary messages are built and encoded here under output_mutex. frames can be up to SX127X_UTIL_MAX_FSK_PACKET_LENGTH
+  uint8_t *binary_payload;
+  uint8_t *binary_output;
+  bool rx_push;
+  QueueHandle_t push_queue;
+  at_writer_t *push_writer;
+  uint32_t pushed;
+  uint32_t push_fallback;
+  uint32_t push_latency[UART_AT_LATENCY_BUCKETS];
+  uint32_t baud_rate;
+  uint8_t flow_control;
+  // new baud rate and flow control are applied, but not confirmed by host yet
+  bool uart_pending;
+  uint32_t previous_baud_rate;
+  uint8_t previous_flow_control;
+  int64_t uart_pending_deadline_micros;
+  uint32_t overflows;
 } uart_at_handler_t;
 
 esp_err_t uart_at_handler_create(at_handler_t *at_handler, at_timer_t *timer, uart_at_handler_t **result);
@@ -25,4 +51,13 @@ esp_err_t uart_at_get_last_active(uint64_t *last_active_micros, uart_at_handler_
 
 void uart_at_handler_send(char *output, size_t output_length, void *handler);
 
+// ESP_ERR_INVALID_STATE if push is disabled, ESP_ERR_NO_MEM if queue is full. Frame should be buffered then
+esp_err_t uart_at_handler_push_frame(sx127x_frame_t *frame, uart_at_handler_t *handler);
+
+// never takes output_mutex, so it can be called from the interrupt and tx tasks. output is written by the push task after the current command.
+// if the reserved slots are full for too long, output is written directly
+esp_err_t uart_at_handler_notify(const char *output, size_t output_length, uart_at_handler_t *handler);
+
+void uart_at_handler_push_process(uart_at_handler_t *handler);
+
 #endif //LORA_AT_UART_AT_H
@@ -1,6 +1,9 @@
+import re
+import time
 import pytest
 from pytest_embedded_serial import SerialDut
 from typing import Tuple
+import AtBinaryCodec
 
 # @pytest.mark.supported_targets
 @pytest.mark.parametrize('count', [
@@ -69,8 +72,131 @@ def test_common_at_commands(dut: Tuple[SerialDut, SerialDut]) -> None:
     dut_rx.expect('OK', timeout=3)
 
 
+# @pytest.mark.supported_targets
+@pytest.mark.parametrize('count', [
+    2,
+], indirect=True)
+def test_binary_mode(dut: Tuple[SerialDut, SerialDut]) -> None:
+    dut_rx = dut[1]
+    dut_rx.expect('lora-at initialized', timeout=3)
+    dut_rx.write('AT+MODE=BIN')
+    dut_rx.expect('OK', timeout=3)
+    # dut.write appends '\n' which is not a part of binary protocol
+    port = dut_rx.serial.proc
+    port.write(AtBinaryCodec.encode(AtBinaryCodec.COMMAND, b'AT+GMR'))
+    dut_rx.expect_exact(AtBinaryCodec.encode(AtBinaryCodec.RESPONSE, b'2.0\r\nOK\r\n'), timeout=3)
+    port.write(AtBinaryCodec.encode(AtBinaryCodec.PULL))
+    dut_rx.expect_exact(AtBinaryCodec.encode(AtBinaryCodec.RESPONSE, b'OK\r\n'), timeout=3)
+    # loopback with the largest frame
+    message = AtBinaryCodec.encode(AtBinaryCodec.ECHO, bytes(i % 256 for i in range(20 + 255)))
+    frames = 100
+    start = time.time()
+    for i in range(frames):
+        port.write(message)
+        dut_rx.expect_exact(message, timeout=3)
+    took = time.time() - start
+    print('binary loopback at %d baud: %.1f frames/s' % (port.baudrate, frames / took))
+    port.write(AtBinaryCodec.encode(AtBinaryCodec.COMMAND, b'AT+MODE=TEXT'))
+    dut_rx.expect_exact(AtBinaryCodec.encode(AtBinaryCodec.RESPONSE, b'OK\r\n'), timeout=3)
+    dut_rx.write('AT')
+    dut_rx.expect('OK', timeout=3)
 
 
+# @pytest.mark.supported_targets
+@pytest.mark.parametrize('count', [
+    2,
+], indirect=True)
+def test_binary_long_fsk_frame(dut: Tuple[SerialDut, SerialDut]) -> None:
+    dut_tx = dut[0]
+    dut_rx = dut[1]
+    dut_tx.expect('lora-at initialized', timeout=3)
+    dut_rx.expect('lora-at initialized', timeout=3)
+    # longer than 255 bytes
+    data = bytes(i % 256 for i in range(300))
+    for d in (dut_tx, dut_rx):
+        d.write('AT+FSKLEN={}'.format(len(data)))
+        d.expect('OK', timeout=3)
+    dut_rx.write('AT+FSKRX=437200012,4800,5000,4,12AD,0,2,1,5000,20000')
+    dut_rx.expect('OK', timeout=3)
+    dut_tx.write('AT+FSKTX={},437200012,4800,5000,4,12AD,0,2,1,10,240,1'.format(data.hex().upper()))
+    dut_tx.expect('OK', timeout=5)
+    dut_rx.expect('received frame', timeout=5)
+    dut_rx.write('AT+MODE=BIN')
+    dut_rx.expect('OK\r\n', timeout=3)
+    port = dut_rx.serial.proc
+    port.write(AtBinaryCodec.encode(AtBinaryCodec.PULL))
+    message = dut_rx.expect(re.compile(b'[^\x00]+\x00'), timeout=3).group(0)
+    message_type, payload = AtBinaryCodec.decode(message)
+    assert message_type == AtBinaryCodec.FRAME
+    assert AtBinaryCodec.unpack_frame(payload)['data'] == data
+    dut_rx.expect_exact(AtBinaryCodec.encode(AtBinaryCodec.RESPONSE, b'OK\r\n'), timeout=3)
+    port.write(AtBinaryCodec.encode(AtBinaryCodec.COMMAND, b'AT+MODE=TEXT'))
+    dut_rx.expect_exact(AtBinaryCodec.encode(AtBinaryCodec.RESPONSE, b'OK\r\n'), timeout=3)
+    dut_rx.write('AT+STOPRX')
+    dut_rx.expect('OK', timeout=3)
+    for d in (dut_tx, dut_rx):
+        d.write('AT+FSKLEN=0')
+        d.expect('OK', timeout=3)
+
+
+# @pytest.mark.supported_targets
+@pytest.mark.parametrize('count', [
+    2,
+], indirect=True)
+def test_rx_push(dut: Tuple[SerialDut, SerialDut]) -> None:
+    dut_tx = dut[0]
+    dut_rx = dut[1]
+    dut_rx.expect('lora-at initialized', timeout=3)
+    dut_rx.write('AT+RXPUSH=1')
+    dut_rx.expect('OK', timeout=3)
+    dut_rx.write('AT+LORARX=436703003,250000,10,5,18,8,4,0,1,1,0')
+    dut_rx.expect('OK', timeout=3)
+    dut_tx.write('AT+LORATX=CAFE,436703003,250000,10,5,18,8,0,1,1,255,10,240,1')
+    dut_tx.expect('OK', timeout=3)
+    # no AT+PULL required
+    dut_rx.expect('\\+RX:CAFE', timeout=3)
+    dut_rx.write('AT+RXPUSH?')
+    dut_rx.expect('pushed: 1', timeout=3)
+    dut_rx.expect('OK', timeout=3)
+    dut_rx.write('AT+RXPUSH=0')
+    dut_rx.expect('OK', timeout=3)
+    dut_rx.write('AT+STOPRX')
+    dut_rx.expect('OK', timeout=3)
 
 
+# @pytest.mark.supported_targets
+@pytest.mark.parametrize('count', [
+    2,
+], indirect=True)
+def test_tx_pipeline(dut: Tuple[SerialDut, SerialDut]) -> None:
+    dut_tx = dut[0]
+    dut_tx.expect('lora-at initialized', timeout=3)
+    total = 100
+    # should not exceed AT_TX_QUEUE_LENGTH
+    in_flight = 8
+    command = 'AT+LORATX=CAFE,436703003,250000,7,5,18,8,0,1,1,255,10,240,1'
+    start = time.time()
+    for i in range(total):
+        dut_tx.write(command)
+        dut_tx.expect('OK', timeout=3)
+    sequential = total / (time.time() - start)
 
+    dut_tx.write('AT+TXPIPE=1')
+    dut_tx.expect('OK', timeout=3)
+    start = time.time()
+    submitted = 0
+    completed = 0
+    while completed < total:
+        while submitted < total and submitted - completed < in_flight:
+            dut_tx.write(command)
+            dut_tx.expect('\\+TX:\\d+', timeout=3)
+            submitted += 1
+        dut_tx.expect('\\+TXDONE:\\d+,OK', timeout=3)
+        completed += 1
+    pipelined = total / (time.time() - start)
+    dut_tx.write('AT+TXPIPE?')
+    dut_tx.expect('completed: {}'.format(total), timeout=3)
+    dut_tx.expect('OK', timeout=3)
+    dut_tx.write('AT+TXPIPE=0')
+    dut_tx.expect('OK', timeout=3)
+    print('sequential: {:.1f} packets/s pipelined: {:.1f} packets/s'.format(sequential, pipelined))
@@ -1,3 +1,5 @@
+import threading
+import time
 import pytest
 from AtRestClient import AtRestClient
 
@@ -70,7 +72,8 @@ expected_message = {
             "frequencyError": 1234,
             "timestamp": 1234567788
         }
-    ]
+    ],
+    "remaining": 0
 }
 
 expected_status = {
@@ -98,7 +101,7 @@ def test_lora_rx_tx() -> None:
 
     status0 = client0.stopRx()
     assert status0.status_code == 200
-    assert compare_objects(expected_message, status0.json(), ignore_fields=["rssi", "snr", "frequencyError", "timestamp"])
+    assert compare_objects(expected_message, status0.json(), ignore_fields=["rssi", "snr", "frequencyError", "timestamp", "timestampMicros", "cursor"])
 
 def test_fsk_rx_tx() -> None:
     client0 = AtRestClient('lora-at-0.local', 'r2lora', 'password')
@@ -118,7 +121,130 @@ def test_fsk_rx_tx() -> None:
 
     status0 = client0.stopRx()
     assert status0.status_code == 200
-    assert compare_objects(expected_message, status0.json(), ignore_fields=["rssi", "snr", "frequencyError", "timestamp"])
+    assert compare_objects(expected_message, status0.json(), ignore_fields=["rssi", "snr", "frequencyError", "timestamp", "timestampMicros", "cursor"])
+
+
+def test_parallel_pull() -> None:
+    client0 = AtRestClient('lora-at-0.local', 'r2lora', 'password')
+    client1 = AtRestClient('lora-at-1.local', 'r2lora', 'password')
+    status0 = client0.startLoRaRx(lora_rx)
+    assert status0.status_code == 200
+    # frames left from the previous tests
+    assert client0.pullRx().status_code == 200
+
+    sent = ['%08X' % (0xCAFE0000 + i) for i in range(20)]
+    received = []
+    errors = []
+    lock = threading.Lock()
+    done = threading.Event()
+
+    def pull():
+        while True:
+            finished = done.is_set()
+            response = client0.pullRx()
+            if response.status_code != 200:
+                errors.append(response.status_code)
+                return
+            frames = response.json()['frames']
+            with lock:
+                received.extend(frame['data'] for frame in frames)
+            if finished and not frames:
+                return
+
+    pullers = [threading.Thread(target=pull) for _ in range(4)]
+    for cur in pullers:
+        cur.start()
+    for data in sent:
+        status1 = client1.loRaTx(dict(lora_tx, data=data))
+        assert status1.status_code == 200
+        time.sleep(0.5)
+    time.sleep(1)
+    done.set()
+    for cur in pullers:
+        cur.join()
+
+    status0 = client0.stopRx()
+    assert status0.status_code == 200
+    received.extend(frame['data'] for frame in status0.json()['frames'])
+    assert errors == []
+    # every frame is returned exactly once
+    assert sorted(received) == sorted(sent)
+
+
+def test_pull_cursor() -> None:
+    client0 = AtRestClient('lora-at-0.local', 'r2lora', 'password')
+    client1 = AtRestClient('lora-at-1.local', 'r2lora', 'password')
+    status0 = client0.startLoRaRx(lora_rx)
+    assert status0.status_code == 200
+    # frames left from the previous tests
+    assert client0.pullRx().status_code == 200
+
+    sent = ['%08X' % (0xBEEF0000 + i) for i in range(3)]
+    for data in sent:
+        status1 = client1.loRaTx(dict(lora_tx, data=data))
+        assert status1.status_code == 200
+        time.sleep(0.5)
+    time.sleep(1)
+
+    # unknown cursor doesn't ack anything
+    first = client0.pullRx(limit=1, cursor=0).json()
+    assert [frame['data'] for frame in first['frames']] == sent[:1]
+    assert first['remaining'] == 2
+    # the same cursor returns the same frames until the next cursor acks them
+    again = client0.pullRx(limit=1, cursor=0).json()
+    assert again['frames'] == first['frames']
+    assert again['cursor'] == first['cursor']
+
+    second = client0.pullRx(limit=1, cursor=first['cursor']).json()
+    assert [frame['data'] for frame in second['frames']] == sent[1:2]
+    assert second['cursor'] == first['cursor'] + 1
+    assert second['remaining'] == 1
+
+    third = client0.pullRx(limit=10, cursor=second['cursor']).json()
+    assert [frame['data'] for frame in third['frames']] == sent[2:]
+    assert third['cursor'] == second['cursor'] + 1
+    assert third['remaining'] == 0
+
+    last = client0.pullRx(cursor=third['cursor']).json()
+    assert last['frames'] == []
+    assert last['cursor'] == third['cursor']
+    assert last['remaining'] == 0
+
+    status0 = client0.stopRx()
+    assert status0.status_code == 200
+    assert status0.json()['frames'] == []
+
+
+def test_pull_once_then_stream() -> None:
+    client0 = AtRestClient('lora-at-0.local', 'r2lora', 'password')
+    client1 = AtRestClient('lora-at-1.local', 'r2lora', 'password')
+    status0 = client0.startLoRaRx(lora_rx)
+    assert status0.status_code == 200
+    # pull becomes a consumer and then stays idle
+    assert client0.pullRx().status_code == 200
+
+    # more than CONFIG_AT_FRAME_BUFFER_CAPACITY (32) and longer than CONFIG_AT_REST_PULL_IDLE_TIMEOUT (10s)
+    sent = ['%08X' % (0xF00D0000 + i) for i in range(40)]
+    received = []
+
+    def stream():
+        for _, frame in client0.streamRx():
+            received.append(frame['data'])
+            if len(received) == len(sent):
+                return
+
+    streamer = threading.Thread(target=stream, daemon=True)
+    streamer.start()
+    for data in sent:
+        status1 = client1.loRaTx(dict(lora_tx, data=data))
+        assert status1.status_code == 200
+        time.sleep(0.5)
+    streamer.join(timeout=5)
+
+    status0 = client0.stopRx()
+    assert status0.status_code == 200
+    # the stream doesn't stop once the buffer is full of frames pull hasn't acked
+    assert received == sent
 
 
 def compare_objects(obj1, obj2, ignore_fields=[]):
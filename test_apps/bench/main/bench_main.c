@@ -0,0 +1,392 @@
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <sx127x_util.h>
+#include <display.h>
+#include <at_config.h>
+#include <at_handler.h>
+#include <at_timer.h>
+#include <ble_client.h>
+#include <sim_sx127x.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "uart_at.h"
+
+static const char *TAG = "lora-at";
+
+#ifndef CONFIG_BENCH_FRAMES
+#define CONFIG_BENCH_FRAMES 500
+#endif
+
+#ifndef CONFIG_BENCH_PAYLOAD_LENGTH
+#define CONFIG_BENCH_PAYLOAD_LENGTH 32
+#endif
+
+#ifndef CONFIG_BENCH_PULL_INTERVAL
+#define CONFIG_BENCH_PULL_INTERVAL 10
+#endif
+
+#ifndef CONFIG_BENCH_DRAIN_TIMEOUT
+#define CONFIG_BENCH_DRAIN_TIMEOUT 1000
+#endif
+
+#define BENCH_UART_LINK "/tmp/lora-at-bench-uart"
+
+#define ERROR_CHECK(y, x)        \
+  do {                        \
+    esp_err_t __err_rc = (x); \
+    if (__err_rc != ESP_OK) {      \
+      ESP_LOGE(TAG, "unable to initialize %s: %s", y, esp_err_to_name(__err_rc));                        \
+      exit(1);        \
+    }                         \
+  } while (0)
+
+typedef enum {
+  BENCH_RX_BURST = 0,
+  BENCH_UART_PUSH = 1,
+  BENCH_UART_PULL = 2
+} bench_scenario_t;
+
+static const char *SCENARIO_NAMES[] = {"rx_burst", "uart_push", "uart_pull"};
+
+static const uint32_t RATES[] = {50, 100, 200, 500, 1000};
+
+typedef struct {
+  sx127x_wrapper *device;
+  lora_at_display *display;
+  at_handler_t *at_handler;
+  uart_at_handler_t *uart_at_handler;
+  ble_client *bluetooth;
+  lora_at_config_t *config;
+  at_timer_t *timer;
+  // host side of the simulated uart
+  int host_fd;
+  volatile bench_scenario_t scenario;
+  volatile bool pulling;
+  portMUX_TYPE lock;
+  // indexed by the sequence number
+  int64_t interrupt_micros[CONFIG_BENCH_FRAMES];
+  bool received[CONFIG_BENCH_FRAMES];
+  // in the order of delivery
+  uint32_t latencies[CONFIG_BENCH_FRAMES];
+  uint32_t delivered;
+  int64_t last_delivered_micros;
+  size_t heap_peak;
+} bench_t;
+
+static bench_t *bench = NULL;
+
+static uint32_t bench_sequence(const uint8_t *data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static void bench_record(uint32_t sequence, int64_t now) {
+  if (sequence >= CONFIG_BENCH_FRAMES) {
+    return;
+  }
+  portENTER_CRITICAL(&bench->lock);
+  if (!bench->received[sequence] && bench->interrupt_micros[sequence] != 0) {
+    bench->received[sequence] = true;
+    bench->latencies[bench->delivered++] = (uint32_t) (now - bench->interrupt_micros[sequence]);
+    bench->last_delivered_micros = now;
+  }
+  portEXIT_CRITICAL(&bench->lock);
+}
+
+static void bench_sample_heap() {
+  struct mallinfo2 info = mallinfo2();
+  if (info.uordblks > bench->heap_peak) {
+    bench->heap_peak = info.uordblks;
+  }
+}
+
+static void rx_callback(sx127x *device, uint8_t *data, uint16_t data_length) {
+  sx127x_frame_t *frame = NULL;
+  esp_err_t code = sx127x_util_read_frame(bench->device, data, data_length, &frame);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to read frame: %s", esp_err_to_name(code));
+    return;
+  }
+  uint32_t sequence = bench_sequence(frame->data);
+  if (sequence < CONFIG_BENCH_FRAMES) {
+    bench->interrupt_micros[sequence] = frame->interrupt_micros;
+  }
+  switch (bench->scenario) {
+    case BENCH_RX_BURST:
+      bench_record(sequence, esp_timer_get_time());
+      sx127x_util_frame_destroy(frame);
+      break;
+    case BENCH_UART_PUSH:
+      // same as firmware: frames which can't be pushed wait for AT+PULL and never reach the host here
+      if (uart_at_handler_push_frame(frame, bench->uart_at_handler) != ESP_OK) {
+        at_handler_add_frame(frame, bench->at_handler);
+      }
+      break;
+    case BENCH_UART_PULL:
+      at_handler_add_frame(frame, bench->at_handler);
+      break;
+  }
+}
+
+static int bench_hex(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// both "+RX:<hex>,..." and "<hex>,..." lines contain the frame
+static void bench_handle_line(const char *line, int64_t now) {
+  if (strcmp(line, "OK") == 0 || strcmp(line, "ERROR") == 0) {
+    bench->pulling = false;
+    return;
+  }
+  // leftovers from the previous run
+  if (bench->scenario == BENCH_RX_BURST) {
+    return;
+  }
+  if (strncmp(line, "+RX:", 4) == 0) {
+    line += 4;
+  }
+  uint8_t data[4];
+  for (size_t i = 0; i < sizeof(data); i++) {
+    int high = bench_hex(line[i * 2]);
+    int low = (high < 0 ? -1 : bench_hex(line[i * 2 + 1]));
+    if (low < 0) {
+      return;
+    }
+    data[i] = (high << 4) | low;
+  }
+  bench_record(bench_sequence(data), now);
+}
+
+static void bench_send(const char *command) {
+  size_t length = strlen(command);
+  if (write(bench->host_fd, command, length) != (ssize_t) length) {
+    ESP_LOGE(TAG, "unable to send %s", command);
+  }
+}
+
+static void bench_host_task(void *arg) {
+  char line[1024];
+  size_t line_length = 0;
+  char buffer[256];
+  int64_t next_pull = 0;
+  while (1) {
+    bench_sample_heap();
+    int64_t now = esp_timer_get_time();
+    if (bench->scenario == BENCH_UART_PULL && !bench->pulling && now >= next_pull) {
+      bench->pulling = true;
+      next_pull = now + CONFIG_BENCH_PULL_INTERVAL * 1000;
+      bench_send("AT+PULL\r\n");
+    }
+    ssize_t length = read(bench->host_fd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      vTaskDelay(1);
+      continue;
+    }
+    now = esp_timer_get_time();
+    for (ssize_t i = 0; i < length; i++) {
+      if (buffer[i] == '\r') {
+        continue;
+      }
+      if (buffer[i] != '\n') {
+        // long lines are truncated. only the beginning is needed
+        if (line_length < sizeof(line) - 1) {
+          line[line_length++] = buffer[i];
+        }
+        continue;
+      }
+      line[line_length] = '\0';
+      bench_handle_line(line, now);
+      line_length = 0;
+    }
+  }
+}
+
+static int bench_compare(const void *a, const void *b) {
+  uint32_t first = *(const uint32_t *) a;
+  uint32_t second = *(const uint32_t *) b;
+  return (first > second) - (first < second);
+}
+
+static uint32_t bench_percentile(const uint32_t *sorted, uint32_t length, uint32_t percentile) {
+  if (length == 0) {
+    return 0;
+  }
+  uint32_t index = (length * percentile + 99) / 100;
+  return sorted[(index == 0 ? 0 : index - 1)];
+}
+
+// returns true if all frames were delivered
+static bool bench_run(bench_scenario_t scenario, uint32_t rate) {
+  portENTER_CRITICAL(&bench->lock);
+  memset(bench->interrupt_micros, 0, sizeof(bench->interrupt_micros));
+  memset(bench->received, 0, sizeof(bench->received));
+  bench->delivered = 0;
+  bench->last_delivered_micros = 0;
+  portEXIT_CRITICAL(&bench->lock);
+  bench->scenario = scenario;
+
+  uint8_t payload[CONFIG_BENCH_PAYLOAD_LENGTH];
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = i;
+  }
+  sim_sx127x_rx_config_t config = {
+      .rssi = -80,
+      .snr = 8.0F,
+      .count = CONFIG_BENCH_FRAMES,
+      .interval_micros = 1000000 / rate,
+      .sequence = true};
+  sim_sx127x_stats_t before;
+  sim_sx127x_get_stats(&before);
+  int64_t start = esp_timer_get_time();
+  ERROR_CHECK("inject", sim_sx127x_inject(payload, sizeof(payload), &config));
+
+  sim_sx127x_stats_t stats;
+  do {
+    vTaskDelay(pdMS_TO_TICKS(10));
+    sim_sx127x_get_stats(&stats);
+  } while (stats.rx_injected - before.rx_injected < CONFIG_BENCH_FRAMES);
+  int64_t deadline = esp_timer_get_time() + CONFIG_BENCH_DRAIN_TIMEOUT * 1000;
+  while (bench->delivered < CONFIG_BENCH_FRAMES && esp_timer_get_time() < deadline) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  // late frames should not affect the next run
+  bench->scenario = BENCH_RX_BURST;
+  if (scenario != BENCH_RX_BURST) {
+    bench_send("AT+PULL\r\n");
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+  bench->pulling = false;
+
+  portENTER_CRITICAL(&bench->lock);
+  uint32_t delivered = bench->delivered;
+  int64_t last_delivered_micros = bench->last_delivered_micros;
+  portEXIT_CRITICAL(&bench->lock);
+  uint32_t injected = stats.rx_injected - before.rx_injected;
+  qsort(bench->latencies, delivered, sizeof(uint32_t), bench_compare);
+  double frames_per_sec = 0.0;
+  if (delivered > 0 && last_delivered_micros > start) {
+    frames_per_sec = delivered * 1000000.0 / (last_delivered_micros - start);
+  }
+  printf("{\"type\":\"run\",\"scenario\":\"%s\",\"rate\":%" PRIu32 ",\"injected\":%" PRIu32 ",\"delivered\":%" PRIu32 ",\"dropped\":%" PRIu32 ",\"frames_per_sec\":%.1f,\"latency_us\":{\"p50\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 "}}\n",
+         SCENARIO_NAMES[scenario], rate, injected, delivered, injected - delivered, frames_per_sec,
+         bench_percentile(bench->latencies, delivered, 50), bench_percentile(bench->latencies, delivered, 99), (delivered == 0 ? 0 : bench->latencies[delivered - 1]));
+  fflush(stdout);
+  return delivered == injected && injected == CONFIG_BENCH_FRAMES;
+}
+
+static void bench_scenario(bench_scenario_t scenario) {
+  uint32_t sustained = 0;
+  for (size_t i = 0; i < sizeof(RATES) / sizeof(RATES[0]); i++) {
+    if (!bench_run(scenario, RATES[i])) {
+      break;
+    }
+    sustained = RATES[i];
+  }
+  printf("{\"type\":\"scenario\",\"scenario\":\"%s\",\"sustained_fps\":%" PRIu32 "}\n", SCENARIO_NAMES[scenario], sustained);
+  fflush(stdout);
+}
+
+static void bench_report_resources() {
+  sx127x_util_frame_pool_stats_t pool;
+  sx127x_util_frame_pool_stats(&pool);
+  printf("{\"type\":\"memory\",\"heap_peak\":%zu,\"frame_pool_capacity\":%" PRIu16 ",\"frame_pool_high_water_mark\":%" PRIu16 ",\"frame_pool_exhausted\":%" PRIu32 "}\n",
+         bench->heap_peak, pool.capacity, pool.high_water_mark, pool.exhausted);
+  UBaseType_t tasks_length = uxTaskGetNumberOfTasks();
+  TaskStatus_t *tasks = malloc(sizeof(TaskStatus_t) * tasks_length);
+  if (tasks == NULL) {
+    return;
+  }
+  tasks_length = uxTaskGetSystemState(tasks, tasks_length, NULL);
+  for (UBaseType_t i = 0; i < tasks_length; i++) {
+    printf("{\"type\":\"task\",\"name\":\"%s\",\"stack_high_water_mark\":%" PRIu32 "}\n", tasks[i].pcTaskName, (uint32_t) tasks[i].usStackHighWaterMark);
+  }
+  free(tasks);
+  fflush(stdout);
+}
+
+static void uart_rx_task(void *arg) {
+  uart_at_handler_process(bench->uart_at_handler);
+}
+
+static void uart_push_task(void *arg) {
+  uart_at_handler_push_process(bench->uart_at_handler);
+}
+
+static void at_timer_callback(void *arg) {
+  // inactivity timer is never started
+}
+
+void app_main(void) {
+  bench = calloc(1, sizeof(bench_t));
+  if (bench == NULL) {
+    ESP_LOGE(TAG, "unable to init bench");
+    return;
+  }
+  portMUX_INITIALIZE(&bench->lock);
+  bench->scenario = BENCH_RX_BURST;
+  // must be set before the uart is created
+  setenv("SIM_UART0_LINK", BENCH_UART_LINK, 1);
+
+  ERROR_CHECK("config", lora_at_config_create(&bench->config));
+  ERROR_CHECK("bluetooth", ble_client_create(NULL, &bench->bluetooth));
+  ERROR_CHECK("lora reset", sx127x_util_reset());
+  ERROR_CHECK("lora", sx127x_util_init(&bench->device));
+  sx127x_rx_set_callback(rx_callback, bench->device->device);
+  ERROR_CHECK("display", lora_at_display_create(&bench->display));
+  ERROR_CHECK("timer", at_timer_create(at_timer_callback, bench, &bench->timer));
+  ERROR_CHECK("at_handler", at_handler_create(bench->config, bench->display, bench->device, bench->bluetooth, bench->timer, NULL, NULL, &bench->at_handler));
+  ERROR_CHECK("uart_at", uart_at_handler_create(bench->at_handler, bench->timer, &bench->uart_at_handler));
+  xTaskCreate(uart_rx_task, "uart_rx_task", 1024 * 4, bench, configMAX_PRIORITIES - 1, NULL);
+  xTaskCreate(uart_push_task, "uart_push_task", 1024 * 4, bench, configMAX_PRIORITIES - 1, NULL);
+
+  bench->host_fd = open(BENCH_UART_LINK, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (bench->host_fd < 0) {
+    ESP_LOGE(TAG, "unable to open %s", BENCH_UART_LINK);
+    exit(1);
+  }
+  xTaskCreate(bench_host_task, "bench_host_task", 1024 * 4, bench, configMAX_PRIORITIES - 2, NULL);
+
+  lora_config_t req = {0};
+  req.freq = 437200000;
+  req.bw = 125000;
+  req.sf = 9;
+  req.cr = 5;
+  req.syncWord = 18;
+  req.preambleLength = 8;
+  req.ldo = LDO_AUTO;
+  req.useCrc = 1;
+  req.useExplicitHeader = 1;
+  ERROR_CHECK("rx", sx127x_util_lora_rx(SX127x_MODE_RX_CONT, &req, bench->device));
+
+  printf("{\"type\":\"config\",\"frames\":%d,\"payload_length\":%d,\"pull_interval_ms\":%d,\"drain_timeout_ms\":%d}\n", CONFIG_BENCH_FRAMES, CONFIG_BENCH_PAYLOAD_LENGTH, CONFIG_BENCH_PULL_INTERVAL, CONFIG_BENCH_DRAIN_TIMEOUT);
+  bench_scenario(BENCH_RX_BURST);
+  bench_send("AT+RXPUSH=1\r\n");
+  vTaskDelay(pdMS_TO_TICKS(100));
+  bench_scenario(BENCH_UART_PUSH);
+  bench_send("AT+RXPUSH=0\r\n");
+  vTaskDelay(pdMS_TO_TICKS(100));
+  bench_scenario(BENCH_UART_PULL);
+  // wifi and bluetooth stacks are not available on the linux target
+  printf("{\"type\":\"scenario\",\"scenario\":\"rest_pull\",\"skipped\":\"not supported in simulation\"}\n");
+  printf("{\"type\":\"scenario\",\"scenario\":\"ble_notify\",\"skipped\":\"not supported in simulation\"}\n");
+  bench_report_resources();
+  printf("{\"type\":\"done\"}\n");
+  fflush(stdout);
+  exit(0);
+}
@@ -0,0 +1,159 @@
+#include <esp_log.h>
+#include <sx127x_util.h>
+#include <sim_sx127x.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+static const char *TAG = "lora-at";
+
+#ifndef CONFIG_FSK_STREAM_PACKETS
+#define CONFIG_FSK_STREAM_PACKETS 5
+#endif
+
+#ifndef CONFIG_FSK_STREAM_BITRATE
+#define CONFIG_FSK_STREAM_BITRATE 50000
+#endif
+
+#define ERROR_CHECK(y, x)        \
+  do {                        \
+    esp_err_t __err_rc = (x); \
+    if (__err_rc != ESP_OK) {      \
+      ESP_LOGE(TAG, "unable to initialize %s: %s", y, esp_err_to_name(__err_rc));                        \
+      exit(1);        \
+    }                         \
+  } while (0)
+
+typedef struct {
+  sx127x_wrapper *device;
+  SemaphoreHandle_t done;
+  uint8_t expected[SX127X_UTIL_MAX_FSK_PACKET_LENGTH];
+  uint32_t received;
+  uint32_t corrupted;
+  uint8_t sent[SX127X_UTIL_MAX_FSK_PACKET_LENGTH];
+} fsk_stream_t;
+
+static fsk_stream_t *stream = NULL;
+
+static void rx_callback(sx127x *device, uint8_t *data, uint16_t data_length) {
+  sx127x_frame_t *frame = NULL;
+  esp_err_t code = sx127x_util_read_frame(stream->device, data, data_length, &frame);
+  if (code != ESP_OK) {
+    ESP_LOGE(TAG, "unable to read frame: %s", esp_err_to_name(code));
+    stream->corrupted++;
+    xSemaphoreGive(stream->done);
+    return;
+  }
+  if (frame->data_length != SX127X_UTIL_MAX_FSK_PACKET_LENGTH || memcmp(frame->data, stream->expected, frame->data_length) != 0) {
+    stream->corrupted++;
+  } else {
+    stream->received++;
+  }
+  sx127x_util_frame_destroy(frame);
+  xSemaphoreGive(stream->done);
+}
+
+static void tx_callback(sx127x *device) {
+  sx127x_util_tx_done(stream->device);
+  xSemaphoreGive(stream->done);
+}
+
+static void fsk_stream_config(fsk_config_t *config) {
+  static uint8_t syncword[] = {0x12, 0xAD};
+  *config = (fsk_config_t) {0};
+  config->freq = 437200000;
+  config->bitrate = CONFIG_FSK_STREAM_BITRATE;
+  config->freq_deviation = 5000;
+  config->preamble = 8;
+  config->syncword = syncword;
+  config->syncword_length = sizeof(syncword);
+  config->crc = 1;
+  config->rx_bandwidth = 100000;
+  config->rx_afc_bandwidth = 100000;
+  config->packet_length = SX127X_UTIL_MAX_FSK_PACKET_LENGTH;
+}
+
+// time on air of the longest packet in milliseconds
+static uint32_t fsk_stream_airtime() {
+  return (uint32_t) ((uint64_t) (SX127X_UTIL_MAX_FSK_PACKET_LENGTH + 16) * 8 * 1000 / CONFIG_FSK_STREAM_BITRATE);
+}
+
+// some slack for the interrupt task
+static TickType_t fsk_stream_timeout() {
+  return pdMS_TO_TICKS(fsk_stream_airtime() * 2 + 1000);
+}
+
+static bool fsk_stream_rx() {
+  fsk_config_t config;
+  fsk_stream_config(&config);
+  ERROR_CHECK("rx", sx127x_util_fsk_rx(&config, stream->device));
+  sim_sx127x_rx_config_t rx = {
+      .rssi = -80,
+      .snr = 0.0F,
+      .count = CONFIG_FSK_STREAM_PACKETS,
+      .interval_micros = fsk_stream_airtime() * 2 * 1000,
+      .sequence = false};
+  ERROR_CHECK("inject", sim_sx127x_inject(stream->expected, sizeof(stream->expected), &rx));
+  for (uint32_t i = 0; i < CONFIG_FSK_STREAM_PACKETS; i++) {
+    if (xSemaphoreTake(stream->done, fsk_stream_timeout()) != pdTRUE) {
+      break;
+    }
+  }
+  ERROR_CHECK("stop rx", sx127x_util_stop_rx(stream->device));
+  printf("{\"type\":\"rx\",\"packets\":%d,\"received\":%" PRIu32 ",\"corrupted\":%" PRIu32 "}\n", CONFIG_FSK_STREAM_PACKETS, stream->received, stream->corrupted);
+  return stream->received == CONFIG_FSK_STREAM_PACKETS;
+}
+
+static bool fsk_stream_tx() {
+  fsk_config_t config;
+  fsk_stream_config(&config);
+  uint32_t matched = 0;
+  for (uint32_t i = 0; i < CONFIG_FSK_STREAM_PACKETS; i++) {
+    ERROR_CHECK("tx", sx127x_util_fsk_tx(stream->expected, sizeof(stream->expected), &config, stream->device));
+    if (xSemaphoreTake(stream->done, fsk_stream_timeout()) != pdTRUE) {
+      break;
+    }
+    size_t sent_length = 0;
+    if (sim_sx127x_get_tx(stream->sent, sizeof(stream->sent), &sent_length) == ESP_OK && sent_length == sizeof(stream->expected) && memcmp(stream->sent, stream->expected, sent_length) == 0) {
+      matched++;
+    }
+  }
+  printf("{\"type\":\"tx\",\"packets\":%d,\"matched\":%" PRIu32 "}\n", CONFIG_FSK_STREAM_PACKETS, matched);
+  return matched == CONFIG_FSK_STREAM_PACKETS;
+}
+
+void app_main(void) {
+  stream = calloc(1, sizeof(fsk_stream_t));
+  if (stream == NULL) {
+    ESP_LOGE(TAG, "unable to init test");
+    exit(1);
+  }
+  stream->done = xSemaphoreCreateBinary();
+  if (stream->done == NULL) {
+    ESP_LOGE(TAG, "unable to init test");
+    exit(1);
+  }
+  for (size_t i = 0; i < sizeof(stream->expected); i++) {
+    stream->expected[i] = (uint8_t) (i * 7 + (i >> 8));
+  }
+  ERROR_CHECK("lora reset", sx127x_util_reset());
+  ERROR_CHECK("lora", sx127x_util_init(&stream->device));
+  sx127x_rx_set_callback(rx_callback, stream->device->device);
+  sx127x_tx_set_callback(tx_callback, stream->device->device);
+
+  printf("{\"type\":\"config\",\"packets\":%d,\"packet_length\":%d,\"bitrate\":%d}\n", CONFIG_FSK_STREAM_PACKETS, SX127X_UTIL_MAX_FSK_PACKET_LENGTH, CONFIG_FSK_STREAM_BITRATE);
+  bool rx = fsk_stream_rx();
+  bool tx = fsk_stream_tx();
+  sim_sx127x_stats_t stats;
+  sim_sx127x_get_stats(&stats);
+  printf("{\"type\":\"fifo\",\"overruns\":%" PRIu32 ",\"underruns\":%" PRIu32 "}\n", stats.fsk_overruns, stats.fsk_underruns);
+  bool passed = rx && tx && stats.fsk_overruns == 0 && stats.fsk_underruns == 0;
+  printf("{\"type\":\"done\",\"passed\":%s}\n", (passed ? "true" : "false"));
+  fflush(stdout);
+  exit(passed ? 0 : 1);
+}
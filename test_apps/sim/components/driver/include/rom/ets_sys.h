@@ -0,0 +1,9 @@
+#ifndef LORA_AT_SIM_ETS_SYS_H
+#define LORA_AT_SIM_ETS_SYS_H
+
+#include <stdint.h>
+
+// busy waits like the rom function
+void ets_delay_us(uint32_t us);
+
+#endif //LORA_AT_SIM_ETS_SYS_H
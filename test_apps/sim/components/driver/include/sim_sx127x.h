@@ -0,0 +1,53 @@
+#ifndef LORA_AT_SIM_SX127X_H
+#define LORA_AT_SIM_SX127X_H
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "driver/spi_master.h"
+
+// register file of the simulated sx127x. transmissions complete after the calculated time on air
+
+// fixed length fsk packets
+#define SIM_SX127X_MAX_PACKET_LENGTH 2047
+
+typedef struct {
+  uint32_t spi_transactions;
+  uint32_t tx_packets;
+  uint32_t rx_injected;
+  uint32_t rx_delivered;
+  // injected while chip was not in rx mode
+  uint32_t rx_dropped;
+  // fsk bytes received while fifo was full
+  uint32_t fsk_overruns;
+  // fsk bytes sent while fifo was empty
+  uint32_t fsk_underruns;
+} sim_sx127x_stats_t;
+
+typedef struct {
+  int16_t rssi;
+  float snr;
+  uint32_t count;
+  uint32_t interval_micros;
+  // first 4 bytes of the packet are replaced with little-endian sequence number
+  bool sequence;
+} sim_sx127x_rx_config_t;
+
+esp_err_t sim_sx127x_start();
+
+esp_err_t sim_sx127x_transmit(spi_transaction_t *trans);
+
+// power on values of the registers
+void sim_sx127x_reset();
+
+// deliver lora or fsk packet count times every interval_micros. replaces previous injection
+// fsk packets are shifted into fifo at the bitrate
+esp_err_t sim_sx127x_inject(const uint8_t *data, size_t data_length, const sim_sx127x_rx_config_t *config);
+
+// bytes of the last fsk packet as they were sent: length byte for variable length format and payload
+esp_err_t sim_sx127x_get_tx(uint8_t *data, size_t data_capacity, size_t *data_length);
+
+void sim_sx127x_get_stats(sim_sx127x_stats_t *stats);
+
+#endif //LORA_AT_SIM_SX127X_H
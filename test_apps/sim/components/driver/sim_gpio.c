@@ -0,0 +1,150 @@
+#include "driver/gpio.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+  gpio_mode_t mode;
+  gpio_int_type_t intr_type;
+  uint32_t level;
+  gpio_isr_t isr_handler;
+  void *isr_arg;
+} sim_gpio_pin_t;
+
+static sim_gpio_pin_t pins[GPIO_NUM_MAX];
+static void (*output_listener)(gpio_num_t gpio_num, uint32_t level) = NULL;
+
+#define GPIO_CHECK(x)        \
+  do {                        \
+    if ((x) < 0 || (x) >= GPIO_NUM_MAX) {      \
+      return ESP_ERR_INVALID_ARG;        \
+    }                         \
+  } while (0)
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+  for (int i = 0; i < GPIO_NUM_MAX; i++) {
+    if ((config->pin_bit_mask & (1ULL << i)) == 0) {
+      continue;
+    }
+    pins[i].mode = config->mode;
+    pins[i].intr_type = config->intr_type;
+  }
+  return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num) {
+  GPIO_CHECK(gpio_num);
+  pins[gpio_num].mode = GPIO_MODE_INPUT;
+  pins[gpio_num].intr_type = GPIO_INTR_DISABLE;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+  GPIO_CHECK(gpio_num);
+  pins[gpio_num].mode = mode;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+  GPIO_CHECK(gpio_num);
+  pins[gpio_num].level = (level != 0);
+  if (output_listener != NULL) {
+    output_listener(gpio_num, pins[gpio_num].level);
+  }
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+  if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+    return 0;
+  }
+  return (int) pins[gpio_num].level;
+}
+
+esp_err_t gpio_pullup_en(gpio_num_t gpio_num) {
+  GPIO_CHECK(gpio_num);
+  return ESP_OK;
+}
+
+esp_err_t gpio_pullup_dis(gpio_num_t gpio_num) {
+  GPIO_CHECK(gpio_num);
+  return ESP_OK;
+}
+
+esp_err_t gpio_pulldown_en(gpio_num_t gpio_num) {
+  GPIO_CHECK(gpio_num);
+  return ESP_OK;
+}
+
+esp_err_t gpio_pulldown_dis(gpio_num_t gpio_num) {
+  GPIO_CHECK(gpio_num);
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+  GPIO_CHECK(gpio_num);
+  pins[gpio_num].intr_type = intr_type;
+  return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+  return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void) {
+  for (int i = 0; i < GPIO_NUM_MAX; i++) {
+    pins[i].isr_handler = NULL;
+    pins[i].isr_arg = NULL;
+  }
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+  GPIO_CHECK(gpio_num);
+  pins[gpio_num].isr_handler = isr_handler;
+  pins[gpio_num].isr_arg = args;
+  return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+  GPIO_CHECK(gpio_num);
+  pins[gpio_num].isr_handler = NULL;
+  pins[gpio_num].isr_arg = NULL;
+  return ESP_OK;
+}
+
+void sim_gpio_input_set_level(gpio_num_t gpio_num, uint32_t level) {
+  if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+    return;
+  }
+  sim_gpio_pin_t *pin = &pins[gpio_num];
+  uint32_t previous = pin->level;
+  pin->level = (level != 0);
+  bool fire;
+  switch (pin->intr_type) {
+    case GPIO_INTR_POSEDGE:
+      fire = (previous == 0 && pin->level == 1);
+      break;
+    case GPIO_INTR_NEGEDGE:
+      fire = (previous == 1 && pin->level == 0);
+      break;
+    case GPIO_INTR_ANYEDGE:
+      fire = (previous != pin->level);
+      break;
+    case GPIO_INTR_LOW_LEVEL:
+      fire = (pin->level == 0);
+      break;
+    case GPIO_INTR_HIGH_LEVEL:
+      fire = (pin->level == 1);
+      break;
+    default:
+      fire = false;
+      break;
+  }
+  // simulated "isr" runs in the context of the calling task
+  if (fire && pin->isr_handler != NULL) {
+    pin->isr_handler(pin->isr_arg);
+  }
+}
+
+void sim_gpio_set_output_listener(void (*listener)(gpio_num_t gpio_num, uint32_t level)) {
+  output_listener = listener;
+}
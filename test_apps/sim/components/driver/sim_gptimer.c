@@ -0,0 +1,156 @@
+#include "driver/gptimer.h"
+#include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+#include <esp_timer.h>
+
+struct gptimer_t {
+  uint32_t resolution_hz;
+  bool enabled;
+  bool running;
+  // count at the moment of start. actual count is calculated from the elapsed time
+  uint64_t count;
+  int64_t started_micros;
+  bool alarm_set;
+  gptimer_alarm_config_t alarm;
+  gptimer_alarm_cb_t on_alarm;
+  void *user_ctx;
+  TimerHandle_t alarm_timer;
+};
+
+static uint64_t sim_gptimer_count(gptimer_handle_t timer) {
+  if (!timer->running) {
+    return timer->count;
+  }
+  int64_t elapsed_micros = esp_timer_get_time() - timer->started_micros;
+  return timer->count + (uint64_t) elapsed_micros * timer->resolution_hz / 1000000;
+}
+
+// called from the timer service task as well. must not block
+static void sim_gptimer_schedule(gptimer_handle_t timer) {
+  xTimerStop(timer->alarm_timer, 0);
+  if (!timer->enabled || !timer->running || !timer->alarm_set || timer->on_alarm == NULL) {
+    return;
+  }
+  uint64_t current = sim_gptimer_count(timer);
+  TickType_t ticks = 1;
+  if (timer->alarm.alarm_count > current) {
+    uint64_t remaining_micros = (timer->alarm.alarm_count - current) * 1000000 / timer->resolution_hz;
+    ticks = pdMS_TO_TICKS(remaining_micros / 1000);
+    if (ticks == 0) {
+      ticks = 1;
+    }
+  }
+  xTimerChangePeriod(timer->alarm_timer, ticks, 0);
+}
+
+static void sim_gptimer_alarm(TimerHandle_t alarm_timer) {
+  gptimer_handle_t timer = (gptimer_handle_t) pvTimerGetTimerID(alarm_timer);
+  gptimer_alarm_event_data_t edata = {
+      .count_value = sim_gptimer_count(timer),
+      .alarm_value = timer->alarm.alarm_count};
+  if (timer->alarm.flags.auto_reload_on_alarm) {
+    timer->count = timer->alarm.reload_count;
+    timer->started_micros = esp_timer_get_time();
+    sim_gptimer_schedule(timer);
+  }
+  timer->on_alarm(timer, &edata, timer->user_ctx);
+}
+
+esp_err_t gptimer_new_timer(const gptimer_config_t *config, gptimer_handle_t *ret_timer) {
+  if (config->resolution_hz == 0 || config->direction != GPTIMER_COUNT_UP) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  struct gptimer_t *result = calloc(1, sizeof(struct gptimer_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  result->resolution_hz = config->resolution_hz;
+  result->alarm_timer = xTimerCreate("sim gptimer", 1, pdFALSE, result, sim_gptimer_alarm);
+  if (result->alarm_timer == NULL) {
+    free(result);
+    return ESP_ERR_NO_MEM;
+  }
+  *ret_timer = result;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_del_timer(gptimer_handle_t timer) {
+  if (timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xTimerDelete(timer->alarm_timer, portMAX_DELAY);
+  free(timer);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value) {
+  timer->count = value;
+  timer->started_micros = esp_timer_get_time();
+  sim_gptimer_schedule(timer);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_get_raw_count(gptimer_handle_t timer, uint64_t *value) {
+  *value = sim_gptimer_count(timer);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_register_event_callbacks(gptimer_handle_t timer, const gptimer_event_callbacks_t *cbs, void *user_data) {
+  if (timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->on_alarm = cbs->on_alarm;
+  timer->user_ctx = user_data;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_set_alarm_action(gptimer_handle_t timer, const gptimer_alarm_config_t *config) {
+  if (config == NULL) {
+    timer->alarm_set = false;
+  } else {
+    timer->alarm = *config;
+    timer->alarm_set = true;
+  }
+  sim_gptimer_schedule(timer);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_enable(gptimer_handle_t timer) {
+  if (timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_disable(gptimer_handle_t timer) {
+  if (!timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  gptimer_stop(timer);
+  timer->enabled = false;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_start(gptimer_handle_t timer) {
+  if (!timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!timer->running) {
+    timer->started_micros = esp_timer_get_time();
+    timer->running = true;
+  }
+  sim_gptimer_schedule(timer);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_stop(gptimer_handle_t timer) {
+  if (!timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->count = sim_gptimer_count(timer);
+  timer->running = false;
+  xTimerStop(timer->alarm_timer, portMAX_DELAY);
+  return ESP_OK;
+}
@@ -0,0 +1,92 @@
+#define _GNU_SOURCE
+#include "sim_pty.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// 1 second
+#define WRITE_MAX_RETRIES 1000
+
+static const char *TAG = "sim";
+
+esp_err_t sim_pty_open(const char *name, const char *link_env, int *fd) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0) {
+    ESP_LOGE(TAG, "unable to open pty for %s: %d", name, errno);
+    return ESP_FAIL;
+  }
+  if (grantpt(master) != 0 || unlockpt(master) != 0) {
+    close(master);
+    return ESP_FAIL;
+  }
+  const char *path = ptsname(master);
+  if (path == NULL) {
+    close(master);
+    return ESP_FAIL;
+  }
+  // keep slave open until the process exits. otherwise master reads fail with EIO until host connects
+  int slave = open(path, O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    close(master);
+    return ESP_FAIL;
+  }
+  struct termios attrs;
+  if (tcgetattr(slave, &attrs) == 0) {
+    cfmakeraw(&attrs);
+    tcsetattr(slave, TCSANOW, &attrs);
+  }
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  const char *link = getenv(link_env);
+  if (link != NULL) {
+    unlink(link);
+    if (symlink(path, link) != 0) {
+      ESP_LOGE(TAG, "unable to create link %s: %d", link, errno);
+    }
+  }
+  // always printed, so scripts can find the device
+  printf("%s: %s\n", name, (link != NULL ? link : path));
+  fflush(stdout);
+  *fd = master;
+  return ESP_OK;
+}
+
+size_t sim_pty_read(int fd, void *buf, size_t length) {
+  ssize_t result = read(fd, buf, length);
+  if (result <= 0) {
+    return 0;
+  }
+  return (size_t) result;
+}
+
+size_t sim_pty_write(int fd, const void *buf, size_t length) {
+  size_t written = 0;
+  int retries = 0;
+  while (written < length) {
+    ssize_t result = write(fd, (const uint8_t *) buf + written, length - written);
+    if (result > 0) {
+      written += result;
+      retries = 0;
+      continue;
+    }
+    if (result < 0 && errno != EAGAIN) {
+      break;
+    }
+    retries++;
+    if (retries > WRITE_MAX_RETRIES) {
+      break;
+    }
+    vTaskDelay(1);
+  }
+  return written;
+}
+
+void sim_pty_close(int fd) {
+  close(fd);
+}
@@ -0,0 +1,18 @@
+#ifndef LORA_AT_SIM_PTY_H
+#define LORA_AT_SIM_PTY_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+// opens non-blocking pseudo terminal in raw mode. slave path is symlinked to the value of link_env variable if set
+esp_err_t sim_pty_open(const char *name, const char *link_env, int *fd);
+
+// returns number of bytes read or 0 if there is no data
+size_t sim_pty_read(int fd, void *buf, size_t length);
+
+// waits until all bytes are written or receiver stops reading
+size_t sim_pty_write(int fd, const void *buf, size_t length);
+
+void sim_pty_close(int fd);
+
+#endif //LORA_AT_SIM_PTY_H
@@ -0,0 +1,761 @@
+#include "sim_sx127x.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "driver/gpio.h"
+#include "sim_pty.h"
+
+#ifndef CONFIG_PIN_DIO0
+#define CONFIG_PIN_DIO0 26
+#endif
+
+#ifndef CONFIG_PIN_DIO1
+#define CONFIG_PIN_DIO1 33
+#endif
+
+#ifndef CONFIG_PIN_DIO2
+#define CONFIG_PIN_DIO2 32
+#endif
+
+#ifndef CONFIG_PIN_RESET
+#define CONFIG_PIN_RESET -1
+#endif
+
+#define REG_FIFO 0x00
+#define REG_OP_MODE 0x01
+#define REG_BITRATE_MSB 0x02
+#define REG_BITRATE_LSB 0x03
+#define REG_FRF_MSB 0x06
+#define REG_FRF_MID 0x07
+#define REG_FRF_LSB 0x08
+#define REG_FIFO_ADDR_PTR 0x0D
+#define REG_FIFO_TX_BASE_ADDR 0x0E
+#define REG_FIFO_RX_BASE_ADDR 0x0F
+#define REG_FIFO_RX_CURRENT_ADDR 0x10
+#define REG_IRQ_FLAGS 0x12
+#define REG_RX_NB_BYTES 0x13
+#define REG_PKT_SNR_VALUE 0x19
+#define REG_PKT_RSSI_VALUE 0x1A
+#define REG_RSSI_VALUE 0x1B
+#define REG_HOP_CHANNEL 0x1C
+#define REG_MODEM_CONFIG_1 0x1D
+#define REG_MODEM_CONFIG_2 0x1E
+#define REG_PREAMBLE_MSB 0x20
+#define REG_PREAMBLE_LSB 0x21
+#define REG_PAYLOAD_LENGTH 0x22
+#define REG_MODEM_CONFIG_3 0x26
+#define REG_SYNC_WORD 0x39
+#define REG_VERSION 0x42
+// fsk registers share addresses with lora
+#define REG_FSK_RSSI_VALUE 0x11
+#define REG_FSK_PREAMBLE_MSB 0x25
+#define REG_FSK_PREAMBLE_LSB 0x26
+#define REG_FSK_SYNC_CONFIG 0x27
+#define REG_FSK_PACKET_CONFIG_1 0x30
+#define REG_FSK_PACKET_CONFIG_2 0x31
+#define REG_FSK_PAYLOAD_LENGTH 0x32
+#define REG_FSK_FIFO_THRESH 0x35
+#define REG_FSK_IRQ_FLAGS_1 0x3E
+#define REG_FSK_IRQ_FLAGS_2 0x3F
+#define REG_DIO_MAPPING_1 0x40
+
+#define MODE_LORA 0x80
+#define MODE_MASK 0x07
+#define MODE_SLEEP 0x00
+#define MODE_STANDBY 0x01
+#define MODE_TX 0x03
+#define MODE_RX_CONT 0x05
+#define MODE_RX_SINGLE 0x06
+#define MODE_CAD 0x07
+
+#define IRQ_RX_DONE 0x40
+#define IRQ_PAYLOAD_CRC_ERROR 0x20
+#define IRQ_VALID_HEADER 0x10
+#define IRQ_TX_DONE 0x08
+#define IRQ_CAD_DONE 0x04
+
+#define IRQ2_FIFO_FULL 0x80
+#define IRQ2_FIFO_EMPTY 0x40
+#define IRQ2_FIFO_LEVEL 0x20
+#define IRQ2_FIFO_OVERRUN 0x10
+#define IRQ2_PACKET_SENT 0x08
+#define IRQ2_PAYLOAD_READY 0x04
+#define IRQ2_CRC_OK 0x02
+
+#define FSK_FIFO_LENGTH 64
+#define LORA_MAX_PACKET_LENGTH 255
+
+#define LOWER_BAND_MAX_HZ 525000000
+// hex of the longest packet and parameters
+#define CONTROL_LINE_LENGTH (2 * SIM_SX127X_MAX_PACKET_LENGTH + 128)
+
+typedef struct {
+  uint8_t registers[128];
+  uint8_t fifo[256];
+  SemaphoreHandle_t lock;
+  TaskHandle_t task;
+  int control_fd;
+  bool tx_active;
+  int64_t tx_start_micros;
+  bool cad_active;
+  int64_t cad_end_micros;
+  // fsk fifo. packet bytes are shifted in or out at the bitrate
+  uint8_t fsk_fifo[FSK_FIFO_LENGTH];
+  uint8_t fsk_fifo_head;
+  uint8_t fsk_fifo_length;
+  bool fsk_rx_active;
+  uint32_t fsk_rx_sequence;
+  // bytes of the current fsk packet including length byte. 0 - not known yet
+  uint32_t fsk_packet_length;
+  uint32_t fsk_packet_done;
+  int64_t fsk_packet_start_micros;
+  uint8_t tx_data[SIM_SX127X_MAX_PACKET_LENGTH + 1];
+  size_t tx_data_length;
+  uint8_t rx_data[SIM_SX127X_MAX_PACKET_LENGTH];
+  size_t rx_data_length;
+  sim_sx127x_rx_config_t rx_config;
+  uint32_t rx_sequence;
+  int64_t rx_next_micros;
+  sim_sx127x_stats_t stats;
+} sim_sx127x_t;
+
+static const char *TAG = "sim";
+static sim_sx127x_t *chip = NULL;
+
+static const uint32_t BANDWIDTHS[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+
+static void sim_sx127x_reset_registers() {
+  memset(chip->registers, 0, sizeof(chip->registers));
+  memset(chip->fifo, 0, sizeof(chip->fifo));
+  chip->registers[REG_OP_MODE] = 0x09;
+  chip->registers[REG_BITRATE_MSB] = 0x1A;
+  chip->registers[REG_BITRATE_LSB] = 0x0B;
+  chip->registers[REG_FRF_MSB] = 0x6C;
+  chip->registers[REG_FRF_MID] = 0x80;
+  chip->registers[REG_FIFO_TX_BASE_ADDR] = 0x80;
+  chip->registers[REG_MODEM_CONFIG_1] = 0x72;
+  chip->registers[REG_MODEM_CONFIG_2] = 0x70;
+  chip->registers[REG_PREAMBLE_LSB] = 0x08;
+  chip->registers[REG_PAYLOAD_LENGTH] = 0x01;
+  chip->registers[REG_SYNC_WORD] = 0x12;
+  chip->registers[REG_FSK_PACKET_CONFIG_1] = 0x90;
+  chip->registers[REG_FSK_PACKET_CONFIG_2] = 0x40;
+  chip->registers[REG_FSK_PAYLOAD_LENGTH] = 0x40;
+  chip->registers[REG_FSK_FIFO_THRESH] = 0x8F;
+  chip->registers[REG_FSK_IRQ_FLAGS_2] = IRQ2_FIFO_EMPTY;
+  chip->registers[REG_VERSION] = 0x12;
+  chip->tx_active = false;
+  chip->cad_active = false;
+  chip->fsk_fifo_head = 0;
+  chip->fsk_fifo_length = 0;
+  chip->fsk_rx_active = false;
+}
+
+static bool sim_sx127x_is_lora() {
+  return (chip->registers[REG_OP_MODE] & MODE_LORA) != 0;
+}
+
+static uint8_t sim_sx127x_mode() {
+  return chip->registers[REG_OP_MODE] & MODE_MASK;
+}
+
+static void sim_sx127x_set_standby() {
+  chip->registers[REG_OP_MODE] = (chip->registers[REG_OP_MODE] & ~MODE_MASK) | MODE_STANDBY;
+}
+
+static uint64_t sim_sx127x_frequency() {
+  uint64_t frf = ((uint64_t) chip->registers[REG_FRF_MSB] << 16) | ((uint64_t) chip->registers[REG_FRF_MID] << 8) | chip->registers[REG_FRF_LSB];
+  return frf * 32000000 / (1 << 19);
+}
+
+static double sim_sx127x_lora_symbol_micros() {
+  uint8_t bw_index = chip->registers[REG_MODEM_CONFIG_1] >> 4;
+  if (bw_index >= sizeof(BANDWIDTHS) / sizeof(BANDWIDTHS[0])) {
+    bw_index = sizeof(BANDWIDTHS) / sizeof(BANDWIDTHS[0]) - 1;
+  }
+  int sf = chip->registers[REG_MODEM_CONFIG_2] >> 4;
+  if (sf < 6) {
+    sf = 6;
+  }
+  return (double) (1 << sf) * 1000000.0 / BANDWIDTHS[bw_index];
+}
+
+// semtech AN1200.13
+static int64_t sim_sx127x_lora_airtime_micros(uint8_t payload_length) {
+  int sf = chip->registers[REG_MODEM_CONFIG_2] >> 4;
+  if (sf < 6) {
+    sf = 6;
+  }
+  int cr = (chip->registers[REG_MODEM_CONFIG_1] >> 1) & 0x07;
+  int implicit_header = chip->registers[REG_MODEM_CONFIG_1] & 0x01;
+  int crc = (chip->registers[REG_MODEM_CONFIG_2] >> 2) & 0x01;
+  int ldo = (chip->registers[REG_MODEM_CONFIG_3] >> 3) & 0x01;
+  int preamble = (chip->registers[REG_PREAMBLE_MSB] << 8) | chip->registers[REG_PREAMBLE_LSB];
+  double symbol_micros = sim_sx127x_lora_symbol_micros();
+  int numerator = 8 * payload_length - 4 * sf + 28 + 16 * crc - 20 * implicit_header;
+  int denominator = 4 * (sf - 2 * ldo);
+  int payload_symbols = 8;
+  if (numerator > 0) {
+    payload_symbols += (numerator + denominator - 1) / denominator * (cr + 4);
+  }
+  return (int64_t) ((preamble + 4.25) * symbol_micros + payload_symbols * symbol_micros);
+}
+
+static uint32_t sim_sx127x_fsk_bitrate() {
+  uint32_t divider = (chip->registers[REG_BITRATE_MSB] << 8) | chip->registers[REG_BITRATE_LSB];
+  if (divider == 0) {
+    divider = 1;
+  }
+  return 32000000 / divider;
+}
+
+static bool sim_sx127x_fsk_variable_length() {
+  return (chip->registers[REG_FSK_PACKET_CONFIG_1] & 0x80) != 0;
+}
+
+// 0 - unlimited length
+static uint32_t sim_sx127x_fsk_fixed_length() {
+  return ((chip->registers[REG_FSK_PACKET_CONFIG_2] & 0x07) << 8) | chip->registers[REG_FSK_PAYLOAD_LENGTH];
+}
+
+static uint32_t sim_sx127x_fsk_crc_length() {
+  return (chip->registers[REG_FSK_PACKET_CONFIG_1] & 0x10) ? 2 : 0;
+}
+
+// time when the first byte after preamble and sync word is shifted
+static int64_t sim_sx127x_fsk_payload_start(int64_t now) {
+  uint32_t preamble = (chip->registers[REG_FSK_PREAMBLE_MSB] << 8) | chip->registers[REG_FSK_PREAMBLE_LSB];
+  uint32_t syncword = ((chip->registers[REG_FSK_SYNC_CONFIG] & 0x10) ? (chip->registers[REG_FSK_SYNC_CONFIG] & 0x07) + 1 : 0);
+  return now + (int64_t) ((uint64_t) (preamble + syncword) * 8 * 1000000 / sim_sx127x_fsk_bitrate());
+}
+
+// number of bytes shifted since the payload start
+static uint32_t sim_sx127x_fsk_bytes_due(int64_t now) {
+  if (now < chip->fsk_packet_start_micros) {
+    return 0;
+  }
+  return (uint32_t) ((uint64_t) (now - chip->fsk_packet_start_micros) * sim_sx127x_fsk_bitrate() / 8 / 1000000);
+}
+
+static void sim_sx127x_fsk_update_flags() {
+  uint8_t flags = chip->registers[REG_FSK_IRQ_FLAGS_2] & ~(IRQ2_FIFO_FULL | IRQ2_FIFO_EMPTY | IRQ2_FIFO_LEVEL);
+  if (chip->fsk_fifo_length == FSK_FIFO_LENGTH) {
+    flags |= IRQ2_FIFO_FULL;
+  }
+  if (chip->fsk_fifo_length == 0) {
+    flags |= IRQ2_FIFO_EMPTY;
+  }
+  // strictly exceeds threshold
+  if (chip->fsk_fifo_length > (chip->registers[REG_FSK_FIFO_THRESH] & 0x3F)) {
+    flags |= IRQ2_FIFO_LEVEL;
+  }
+  chip->registers[REG_FSK_IRQ_FLAGS_2] = flags;
+}
+
+static void sim_sx127x_fsk_clear_fifo() {
+  chip->fsk_fifo_head = 0;
+  chip->fsk_fifo_length = 0;
+  sim_sx127x_fsk_update_flags();
+}
+
+static void sim_sx127x_fsk_push(uint8_t value) {
+  if (chip->fsk_fifo_length == FSK_FIFO_LENGTH) {
+    chip->registers[REG_FSK_IRQ_FLAGS_2] |= IRQ2_FIFO_OVERRUN;
+    chip->stats.fsk_overruns++;
+    return;
+  }
+  chip->fsk_fifo[(chip->fsk_fifo_head + chip->fsk_fifo_length) % FSK_FIFO_LENGTH] = value;
+  chip->fsk_fifo_length++;
+  sim_sx127x_fsk_update_flags();
+}
+
+static bool sim_sx127x_fsk_pop(uint8_t *value) {
+  if (chip->fsk_fifo_length == 0) {
+    return false;
+  }
+  *value = chip->fsk_fifo[chip->fsk_fifo_head];
+  chip->fsk_fifo_head = (chip->fsk_fifo_head + 1) % FSK_FIFO_LENGTH;
+  chip->fsk_fifo_length--;
+  sim_sx127x_fsk_update_flags();
+  return true;
+}
+
+// injected data with sequence number
+static uint8_t sim_sx127x_rx_byte(size_t index, uint32_t sequence) {
+  if (index >= chip->rx_data_length) {
+    return 0;
+  }
+  if (chip->rx_config.sequence && index < sizeof(sequence)) {
+    return (sequence >> (index * 8)) & 0xFF;
+  }
+  return chip->rx_data[index];
+}
+
+static void sim_sx127x_mode_changed(int64_t now) {
+  uint8_t mode = sim_sx127x_mode();
+  chip->tx_active = false;
+  chip->cad_active = false;
+  if (mode == MODE_TX) {
+    chip->tx_active = true;
+    chip->tx_start_micros = now;
+    chip->stats.tx_packets++;
+    if (!sim_sx127x_is_lora()) {
+      // length of variable packet is known once the first byte is shifted
+      chip->fsk_packet_length = (sim_sx127x_fsk_variable_length() ? 0 : sim_sx127x_fsk_fixed_length());
+      chip->fsk_packet_done = 0;
+      chip->fsk_packet_start_micros = sim_sx127x_fsk_payload_start(now);
+      chip->tx_data_length = 0;
+    }
+  } else if (mode == MODE_CAD && sim_sx127x_is_lora()) {
+    chip->cad_active = true;
+    chip->cad_end_micros = now + (int64_t) (2 * sim_sx127x_lora_symbol_micros());
+  }
+  if (!sim_sx127x_is_lora() && mode != MODE_TX) {
+    chip->registers[REG_FSK_IRQ_FLAGS_2] &= ~IRQ2_PACKET_SENT;
+  }
+  if (!sim_sx127x_is_lora() && mode != MODE_RX_CONT) {
+    chip->fsk_rx_active = false;
+    chip->registers[REG_FSK_IRQ_FLAGS_2] &= ~(IRQ2_PAYLOAD_READY | IRQ2_CRC_OK);
+  }
+  if (mode == MODE_SLEEP) {
+    sim_sx127x_fsk_clear_fifo();
+  }
+}
+
+static void sim_sx127x_write(uint8_t reg, uint8_t value, int64_t now) {
+  switch (reg) {
+    case REG_FIFO:
+      if (sim_sx127x_is_lora()) {
+        chip->fifo[chip->registers[REG_FIFO_ADDR_PTR]++] = value;
+      } else {
+        sim_sx127x_fsk_push(value);
+      }
+      return;
+    case REG_OP_MODE:
+      chip->registers[REG_OP_MODE] = value;
+      sim_sx127x_mode_changed(now);
+      return;
+    case REG_IRQ_FLAGS:
+      // RegRxBw in fsk mode
+      if (sim_sx127x_is_lora()) {
+        chip->registers[REG_IRQ_FLAGS] &= ~value;
+        return;
+      }
+      break;
+    case REG_FSK_IRQ_FLAGS_1:
+    case REG_VERSION:
+      return;
+    case REG_FSK_IRQ_FLAGS_2:
+      // clearing overrun also clears fifo
+      if (value & IRQ2_FIFO_OVERRUN) {
+        chip->registers[REG_FSK_IRQ_FLAGS_2] &= ~IRQ2_FIFO_OVERRUN;
+        sim_sx127x_fsk_clear_fifo();
+      }
+      return;
+    case REG_FSK_FIFO_THRESH:
+      chip->registers[reg] = value;
+      sim_sx127x_fsk_update_flags();
+      return;
+    default:
+      break;
+  }
+  chip->registers[reg] = value;
+}
+
+static uint8_t sim_sx127x_read(uint8_t reg) {
+  if (reg == REG_FIFO) {
+    if (!sim_sx127x_is_lora()) {
+      uint8_t value = 0;
+      sim_sx127x_fsk_pop(&value);
+      return value;
+    }
+    return chip->fifo[chip->registers[REG_FIFO_ADDR_PTR]++];
+  }
+  return chip->registers[reg];
+}
+
+static uint32_t sim_sx127x_dio0() {
+  if (sim_sx127x_is_lora()) {
+    return (chip->registers[REG_IRQ_FLAGS] & (IRQ_RX_DONE | IRQ_TX_DONE | IRQ_CAD_DONE)) != 0;
+  }
+  return (chip->registers[REG_FSK_IRQ_FLAGS_2] & (IRQ2_PACKET_SENT | IRQ2_PAYLOAD_READY)) != 0;
+}
+
+// packet mode mapping. see "Table 29 DIO Mapping in Packet Mode"
+static uint32_t sim_sx127x_dio1() {
+  if (sim_sx127x_is_lora()) {
+    return 0;
+  }
+  uint8_t flags = chip->registers[REG_FSK_IRQ_FLAGS_2];
+  switch ((chip->registers[REG_DIO_MAPPING_1] >> 4) & 0x03) {
+    case 0:
+      return (flags & IRQ2_FIFO_LEVEL) != 0;
+    case 1:
+      return (flags & IRQ2_FIFO_EMPTY) != 0;
+    case 2:
+      return (flags & IRQ2_FIFO_FULL) != 0;
+    default:
+      return 0;
+  }
+}
+
+static uint32_t sim_sx127x_dio2() {
+  if (sim_sx127x_is_lora() || ((chip->registers[REG_DIO_MAPPING_1] >> 2) & 0x03) != 0) {
+    return 0;
+  }
+  return (chip->registers[REG_FSK_IRQ_FLAGS_2] & IRQ2_FIFO_FULL) != 0;
+}
+
+// bit per DIO line
+static uint32_t sim_sx127x_dio_levels() {
+  return sim_sx127x_dio0() | (sim_sx127x_dio1() << 1) | (sim_sx127x_dio2() << 2);
+}
+
+// interrupt handler reads registers, so levels are set without lock
+static void sim_sx127x_set_dio(uint32_t levels) {
+  sim_gpio_input_set_level((gpio_num_t) CONFIG_PIN_DIO0, levels & 1);
+  sim_gpio_input_set_level((gpio_num_t) CONFIG_PIN_DIO1, (levels >> 1) & 1);
+  sim_gpio_input_set_level((gpio_num_t) CONFIG_PIN_DIO2, (levels >> 2) & 1);
+}
+
+static void sim_sx127x_deliver() {
+  uint8_t base = chip->registers[REG_FIFO_RX_BASE_ADDR];
+  for (size_t i = 0; i < chip->rx_data_length; i++) {
+    chip->fifo[(uint8_t) (base + i)] = sim_sx127x_rx_byte(i, chip->rx_sequence);
+  }
+  int rssi = chip->rx_config.rssi + (sim_sx127x_frequency() > LOWER_BAND_MAX_HZ ? 157 : 164);
+  if (rssi < 0) {
+    rssi = 0;
+  } else if (rssi > 255) {
+    rssi = 255;
+  }
+  chip->registers[REG_FIFO_RX_CURRENT_ADDR] = base;
+  chip->registers[REG_RX_NB_BYTES] = chip->rx_data_length;
+  chip->registers[REG_PKT_SNR_VALUE] = (uint8_t) (int8_t) lroundf(chip->rx_config.snr * 4);
+  chip->registers[REG_PKT_RSSI_VALUE] = (uint8_t) rssi;
+  if (chip->registers[REG_MODEM_CONFIG_2] & 0x04) {
+    chip->registers[REG_HOP_CHANNEL] |= 0x40;
+  } else {
+    chip->registers[REG_HOP_CHANNEL] &= ~0x40;
+  }
+  chip->registers[REG_IRQ_FLAGS] |= (IRQ_RX_DONE | IRQ_VALID_HEADER);
+  if (sim_sx127x_mode() == MODE_RX_SINGLE) {
+    sim_sx127x_set_standby();
+  }
+  chip->stats.rx_delivered++;
+}
+
+static void sim_sx127x_fsk_tx_tick(int64_t now) {
+  uint32_t due = sim_sx127x_fsk_bytes_due(now);
+  while (chip->fsk_packet_done < due && (chip->fsk_packet_length == 0 || chip->fsk_packet_done < chip->fsk_packet_length)) {
+    uint8_t value = 0;
+    if (!sim_sx127x_fsk_pop(&value)) {
+      // host didn't refill fifo in time
+      chip->stats.fsk_underruns++;
+    }
+    if (chip->fsk_packet_done == 0 && sim_sx127x_fsk_variable_length()) {
+      chip->fsk_packet_length = value + 1;
+    }
+    if (chip->tx_data_length < sizeof(chip->tx_data)) {
+      chip->tx_data[chip->tx_data_length++] = value;
+    }
+    chip->fsk_packet_done++;
+  }
+  // unlimited length packets are sent until mode is changed
+  if (chip->fsk_packet_length == 0 || chip->fsk_packet_done < chip->fsk_packet_length || due < chip->fsk_packet_length + sim_sx127x_fsk_crc_length()) {
+    return;
+  }
+  chip->tx_active = false;
+  chip->registers[REG_FSK_IRQ_FLAGS_2] |= IRQ2_PACKET_SENT;
+  sim_sx127x_set_standby();
+}
+
+static bool sim_sx127x_fsk_rx_start(int64_t now) {
+  uint32_t length;
+  if (sim_sx127x_fsk_variable_length()) {
+    if (chip->rx_data_length > LORA_MAX_PACKET_LENGTH) {
+      return false;
+    }
+    length = chip->rx_data_length + 1;
+  } else {
+    length = sim_sx127x_fsk_fixed_length();
+    // unlimited length packets can't be injected
+    if (length == 0) {
+      return false;
+    }
+  }
+  // RSSI = -RssiValue/2
+  int rssi = -chip->rx_config.rssi * 2;
+  if (rssi < 0) {
+    rssi = 0;
+  } else if (rssi > 255) {
+    rssi = 255;
+  }
+  chip->registers[REG_FSK_RSSI_VALUE] = (uint8_t) rssi;
+  chip->registers[REG_FSK_IRQ_FLAGS_2] &= ~(IRQ2_PAYLOAD_READY | IRQ2_CRC_OK);
+  chip->fsk_rx_active = true;
+  chip->fsk_rx_sequence = chip->rx_sequence;
+  chip->fsk_packet_length = length;
+  chip->fsk_packet_done = 0;
+  chip->fsk_packet_start_micros = sim_sx127x_fsk_payload_start(now);
+  return true;
+}
+
+static void sim_sx127x_fsk_rx_tick(int64_t now) {
+  uint32_t due = sim_sx127x_fsk_bytes_due(now);
+  bool variable = sim_sx127x_fsk_variable_length();
+  while (chip->fsk_packet_done < due && chip->fsk_packet_done < chip->fsk_packet_length) {
+    // length byte is stored in fifo too
+    if (variable && chip->fsk_packet_done == 0) {
+      sim_sx127x_fsk_push((uint8_t) chip->rx_data_length);
+    } else {
+      sim_sx127x_fsk_push(sim_sx127x_rx_byte(chip->fsk_packet_done - (variable ? 1 : 0), chip->fsk_rx_sequence));
+    }
+    chip->fsk_packet_done++;
+  }
+  if (chip->fsk_packet_done < chip->fsk_packet_length || due < chip->fsk_packet_length + sim_sx127x_fsk_crc_length()) {
+    return;
+  }
+  chip->fsk_rx_active = false;
+  chip->registers[REG_FSK_IRQ_FLAGS_2] |= (IRQ2_PAYLOAD_READY | IRQ2_CRC_OK);
+  chip->stats.rx_delivered++;
+}
+
+static void sim_sx127x_tick(int64_t now) {
+  bool lora = sim_sx127x_is_lora();
+  if (chip->tx_active && !lora) {
+    sim_sx127x_fsk_tx_tick(now);
+  }
+  if (chip->tx_active && lora && now >= chip->tx_start_micros + sim_sx127x_lora_airtime_micros(chip->registers[REG_PAYLOAD_LENGTH])) {
+    chip->tx_active = false;
+    chip->registers[REG_IRQ_FLAGS] |= IRQ_TX_DONE;
+    sim_sx127x_set_standby();
+  }
+  if (chip->fsk_rx_active) {
+    sim_sx127x_fsk_rx_tick(now);
+  }
+  if (chip->cad_active && now >= chip->cad_end_micros) {
+    chip->cad_active = false;
+    chip->registers[REG_IRQ_FLAGS] |= IRQ_CAD_DONE;
+    sim_sx127x_set_standby();
+  }
+  if (chip->rx_config.count > 0 && now >= chip->rx_next_micros) {
+    chip->rx_config.count--;
+    chip->rx_next_micros += chip->rx_config.interval_micros;
+    chip->stats.rx_injected++;
+    uint8_t mode = sim_sx127x_mode();
+    if (lora && (mode == MODE_RX_CONT || mode == MODE_RX_SINGLE) && chip->rx_data_length <= LORA_MAX_PACKET_LENGTH) {
+      sim_sx127x_deliver();
+    } else if (!lora && mode == MODE_RX_CONT && !chip->fsk_rx_active && sim_sx127x_fsk_rx_start(now)) {
+      // delivered once all bytes are shifted into fifo
+    } else {
+      chip->stats.rx_dropped++;
+    }
+    chip->rx_sequence++;
+  }
+}
+
+static size_t sim_sx127x_hex2binary(const char *hex, uint8_t *output, size_t output_length) {
+  size_t length = strlen(hex);
+  if (length % 2 != 0 || length / 2 > output_length) {
+    return 0;
+  }
+  for (size_t i = 0; i < length / 2; i++) {
+    char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+    char *end = NULL;
+    output[i] = (uint8_t) strtol(byte, &end, 16);
+    if (*end != '\0') {
+      return 0;
+    }
+  }
+  return length / 2;
+}
+
+// rx <hex> [rssi] [snr] [count] [interval_ms] [sequence]
+// stats
+static void sim_sx127x_control_command(char *line) {
+  char output[192];
+  char *saveptr = NULL;
+  const char *command = strtok_r(line, " \r\n", &saveptr);
+  if (command == NULL) {
+    return;
+  }
+  if (strcmp(command, "rx") == 0) {
+    uint8_t data[SIM_SX127X_MAX_PACKET_LENGTH];
+    const char *hex = strtok_r(NULL, " \r\n", &saveptr);
+    size_t data_length = (hex == NULL ? 0 : sim_sx127x_hex2binary(hex, data, sizeof(data)));
+    const char *rssi = strtok_r(NULL, " \r\n", &saveptr);
+    const char *snr = strtok_r(NULL, " \r\n", &saveptr);
+    const char *count = strtok_r(NULL, " \r\n", &saveptr);
+    const char *interval = strtok_r(NULL, " \r\n", &saveptr);
+    const char *sequence = strtok_r(NULL, " \r\n", &saveptr);
+    sim_sx127x_rx_config_t config = {
+        .rssi = (rssi == NULL ? -100 : atoi(rssi)),
+        .snr = (snr == NULL ? 10.0F : strtof(snr, NULL)),
+        .count = (count == NULL ? 1 : strtoul(count, NULL, 10)),
+        .interval_micros = (interval == NULL ? 0 : strtoul(interval, NULL, 10) * 1000),
+        .sequence = (sequence != NULL && atoi(sequence) != 0)};
+    if (data_length == 0 || sim_sx127x_inject(data, data_length, &config) != ESP_OK) {
+      sim_pty_write(chip->control_fd, "ERROR\r\n", 7);
+      return;
+    }
+    sim_pty_write(chip->control_fd, "OK\r\n", 4);
+    return;
+  }
+  if (strcmp(command, "stats") == 0) {
+    sim_sx127x_stats_t stats;
+    sim_sx127x_get_stats(&stats);
+    int length = snprintf(output, sizeof(output), "spi: %" PRIu32 " tx: %" PRIu32 " injected: %" PRIu32 " delivered: %" PRIu32 " dropped: %" PRIu32 " fsk overruns: %" PRIu32 " underruns: %" PRIu32 "\r\nOK\r\n", stats.spi_transactions, stats.tx_packets, stats.rx_injected,
+                          stats.rx_delivered, stats.rx_dropped, stats.fsk_overruns, stats.fsk_underruns);
+    sim_pty_write(chip->control_fd, output, length);
+    return;
+  }
+  sim_pty_write(chip->control_fd, "ERROR\r\n", 7);
+}
+
+static void sim_sx127x_task(void *arg) {
+  char line[CONTROL_LINE_LENGTH];
+  size_t line_length = 0;
+  while (1) {
+    xSemaphoreTake(chip->lock, portMAX_DELAY);
+    sim_sx127x_tick(esp_timer_get_time());
+    uint32_t levels = sim_sx127x_dio_levels();
+    xSemaphoreGive(chip->lock);
+    sim_sx127x_set_dio(levels);
+
+    char c;
+    while (sim_pty_read(chip->control_fd, &c, 1) == 1) {
+      if (c == '\n') {
+        line[line_length] = '\0';
+        sim_sx127x_control_command(line);
+        line_length = 0;
+      } else if (line_length < sizeof(line) - 1) {
+        line[line_length++] = c;
+      }
+    }
+    vTaskDelay(1);
+  }
+}
+
+static void sim_sx127x_gpio_listener(gpio_num_t gpio_num, uint32_t level) {
+  // chip is held in reset while pin is low
+  if (gpio_num == CONFIG_PIN_RESET && level == 0) {
+    sim_sx127x_reset();
+  }
+}
+
+esp_err_t sim_sx127x_start() {
+  if (chip != NULL) {
+    return ESP_OK;
+  }
+  sim_sx127x_t *result = calloc(1, sizeof(sim_sx127x_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  result->lock = xSemaphoreCreateMutex();
+  if (result->lock == NULL) {
+    free(result);
+    return ESP_ERR_NO_MEM;
+  }
+  esp_err_t code = sim_pty_open("sx127x control", "SIM_CONTROL_LINK", &result->control_fd);
+  if (code != ESP_OK) {
+    vSemaphoreDelete(result->lock);
+    free(result);
+    return code;
+  }
+  chip = result;
+  sim_sx127x_reset_registers();
+  sim_gpio_set_output_listener(sim_sx127x_gpio_listener);
+  if (xTaskCreate(sim_sx127x_task, "sim sx127x", 16384, NULL, configMAX_PRIORITIES - 1, &chip->task) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(TAG, "sx127x simulation started");
+  return ESP_OK;
+}
+
+esp_err_t sim_sx127x_transmit(spi_transaction_t *trans) {
+  if (chip == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  uint8_t reg = trans->addr & 0x7F;
+  int64_t now = esp_timer_get_time();
+  xSemaphoreTake(chip->lock, portMAX_DELAY);
+  chip->stats.spi_transactions++;
+  if (trans->addr & 0x80) {
+    const uint8_t *data = ((trans->flags & SPI_TRANS_USE_TXDATA) ? trans->tx_data : trans->tx_buffer);
+    for (size_t i = 0; i < trans->length / 8; i++) {
+      // address is not incremented when accessing fifo
+      sim_sx127x_write((reg == REG_FIFO ? REG_FIFO : (reg + i) & 0x7F), data[i], now);
+    }
+  } else {
+    uint8_t *data = ((trans->flags & SPI_TRANS_USE_RXDATA) ? trans->rx_data : trans->rx_buffer);
+    size_t length = (trans->rxlength != 0 ? trans->rxlength : trans->length) / 8;
+    for (size_t i = 0; i < length; i++) {
+      data[i] = sim_sx127x_read((reg == REG_FIFO ? REG_FIFO : (reg + i) & 0x7F));
+    }
+  }
+  uint32_t levels = sim_sx127x_dio_levels();
+  xSemaphoreGive(chip->lock);
+  sim_sx127x_set_dio(levels);
+  return ESP_OK;
+}
+
+void sim_sx127x_reset() {
+  if (chip == NULL) {
+    return;
+  }
+  xSemaphoreTake(chip->lock, portMAX_DELAY);
+  sim_sx127x_reset_registers();
+  xSemaphoreGive(chip->lock);
+}
+
+esp_err_t sim_sx127x_inject(const uint8_t *data, size_t data_length, const sim_sx127x_rx_config_t *config) {
+  if (chip == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (data_length == 0 || data_length > sizeof(chip->rx_data)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  xSemaphoreTake(chip->lock, portMAX_DELAY);
+  memcpy(chip->rx_data, data, data_length);
+  chip->rx_data_length = data_length;
+  chip->rx_config = *config;
+  chip->rx_sequence = 0;
+  chip->rx_next_micros = esp_timer_get_time();
+  xSemaphoreGive(chip->lock);
+  return ESP_OK;
+}
+
+esp_err_t sim_sx127x_get_tx(uint8_t *data, size_t data_capacity, size_t *data_length) {
+  if (chip == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xSemaphoreTake(chip->lock, portMAX_DELAY);
+  if (chip->tx_data_length > data_capacity) {
+    xSemaphoreGive(chip->lock);
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(data, chip->tx_data, chip->tx_data_length);
+  *data_length = chip->tx_data_length;
+  xSemaphoreGive(chip->lock);
+  return ESP_OK;
+}
+
+void sim_sx127x_get_stats(sim_sx127x_stats_t *stats) {
+  if (chip == NULL) {
+    memset(stats, 0, sizeof(sim_sx127x_stats_t));
+    return;
+  }
+  xSemaphoreTake(chip->lock, portMAX_DELAY);
+  *stats = chip->stats;
+  xSemaphoreGive(chip->lock);
+}
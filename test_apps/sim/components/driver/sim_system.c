@@ -0,0 +1,18 @@
+#include <rom/ets_sys.h>
+#include <esp_mac.h>
+#include <string.h>
+#include <esp_timer.h>
+
+void ets_delay_us(uint32_t us) {
+  int64_t end = esp_timer_get_time() + us;
+  while (esp_timer_get_time() < end) {
+    // busy wait
+  }
+}
+
+// locally administered address. makes device name stable between runs
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type) {
+  const uint8_t result[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+  memcpy(mac, result, sizeof(result));
+  return ESP_OK;
+}
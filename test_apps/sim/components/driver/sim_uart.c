@@ -0,0 +1,303 @@
+#include "driver/uart.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "sim_pty.h"
+
+// same as hardware rx fifo
+#define UART_FIFO_LENGTH 128
+
+typedef struct {
+  int fd;
+  uint32_t baud_rate;
+  uart_hw_flowcontrol_t flow_ctrl;
+  QueueHandle_t events;
+  SemaphoreHandle_t lock;
+  TaskHandle_t reader;
+  // rx ring buffer. positions are absolute byte counters
+  uint8_t *rx_buffer;
+  size_t rx_buffer_size;
+  uint64_t received;
+  uint64_t read;
+  int pattern_chr;
+  uint64_t *pattern_positions;
+  int pattern_queue_length;
+  int pattern_head;
+  int pattern_count;
+} sim_uart_t;
+
+static const char *TAG = "sim";
+static sim_uart_t *ports[UART_NUM_MAX];
+
+#define PORT_CHECK(x)        \
+  do {                        \
+    if ((x) < 0 || (x) >= UART_NUM_MAX || ports[(x)] == NULL) {      \
+      return ESP_ERR_INVALID_STATE;        \
+    }                         \
+  } while (0)
+
+static void sim_uart_post(sim_uart_t *port, uart_event_type_t type, size_t size) {
+  if (port->events == NULL) {
+    return;
+  }
+  uart_event_t event = {
+      .type = type,
+      .size = size,
+      .timeout_flag = false};
+  if (xQueueSend(port->events, &event, 0) != pdTRUE) {
+    ESP_LOGD(TAG, "uart event queue is full");
+  }
+}
+
+// called with lock held
+static void sim_uart_store(sim_uart_t *port, const uint8_t *data, size_t length) {
+  size_t last_pattern = 0;
+  for (size_t i = 0; i < length; i++) {
+    port->rx_buffer[(port->received + i) % port->rx_buffer_size] = data[i];
+  }
+  for (size_t i = 0; i < length; i++) {
+    if (port->pattern_chr < 0 || data[i] != (uint8_t) port->pattern_chr) {
+      continue;
+    }
+    if (port->pattern_count < port->pattern_queue_length) {
+      int tail = (port->pattern_head + port->pattern_count) % port->pattern_queue_length;
+      port->pattern_positions[tail] = port->received + i;
+      port->pattern_count++;
+    }
+    sim_uart_post(port, UART_PATTERN_DET, 0);
+    last_pattern = i + 1;
+  }
+  port->received += length;
+  // bytes before the pattern are read together with the pattern
+  if (last_pattern < length) {
+    sim_uart_post(port, UART_DATA, length - last_pattern);
+  }
+}
+
+static void sim_uart_reader(void *arg) {
+  sim_uart_t *port = (sim_uart_t *) arg;
+  uint8_t fifo[UART_FIFO_LENGTH];
+  while (1) {
+    size_t length = sim_pty_read(port->fd, fifo, sizeof(fifo));
+    if (length == 0) {
+      vTaskDelay(1);
+      continue;
+    }
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    if (port->received - port->read + length > port->rx_buffer_size) {
+      xSemaphoreGive(port->lock);
+      sim_uart_post(port, UART_BUFFER_FULL, 0);
+      continue;
+    }
+    sim_uart_store(port, fifo, length);
+    xSemaphoreGive(port->lock);
+  }
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags) {
+  if (uart_num < 0 || uart_num >= UART_NUM_MAX || rx_buffer_size <= UART_FIFO_LENGTH) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (ports[uart_num] != NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_uart_t *result = calloc(1, sizeof(sim_uart_t));
+  if (result == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  ports[uart_num] = result;
+  result->fd = -1;
+  result->pattern_chr = -1;
+  result->rx_buffer_size = rx_buffer_size;
+  result->rx_buffer = malloc(rx_buffer_size);
+  result->lock = xSemaphoreCreateMutex();
+  if (result->rx_buffer == NULL || result->lock == NULL) {
+    uart_driver_delete(uart_num);
+    return ESP_ERR_NO_MEM;
+  }
+  if (uart_queue != NULL && queue_size > 0) {
+    result->events = xQueueCreate(queue_size, sizeof(uart_event_t));
+    if (result->events == NULL) {
+      uart_driver_delete(uart_num);
+      return ESP_ERR_NO_MEM;
+    }
+    *uart_queue = result->events;
+  }
+  char name[16];
+  char link_env[32];
+  snprintf(name, sizeof(name), "uart%d", uart_num);
+  snprintf(link_env, sizeof(link_env), "SIM_UART%d_LINK", uart_num);
+  esp_err_t code = sim_pty_open(name, link_env, &result->fd);
+  if (code != ESP_OK) {
+    uart_driver_delete(uart_num);
+    return code;
+  }
+  if (xTaskCreate(sim_uart_reader, "sim uart", 4096, result, configMAX_PRIORITIES - 1, &result->reader) != pdPASS) {
+    result->reader = NULL;
+    uart_driver_delete(uart_num);
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num) {
+  PORT_CHECK(uart_num);
+  sim_uart_t *port = ports[uart_num];
+  ports[uart_num] = NULL;
+  if (port->reader != NULL) {
+    vTaskDelete(port->reader);
+  }
+  if (port->fd >= 0) {
+    sim_pty_close(port->fd);
+  }
+  if (port->events != NULL) {
+    vQueueDelete(port->events);
+  }
+  if (port->lock != NULL) {
+    vSemaphoreDelete(port->lock);
+  }
+  free(port->pattern_positions);
+  free(port->rx_buffer);
+  free(port);
+  return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config) {
+  PORT_CHECK(uart_num);
+  ports[uart_num]->baud_rate = uart_config->baud_rate;
+  ports[uart_num]->flow_ctrl = uart_config->flow_ctrl;
+  return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num) {
+  PORT_CHECK(uart_num);
+  return ESP_OK;
+}
+
+// pty doesn't have a baud rate. values are kept for uart_get_baudrate only
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate) {
+  PORT_CHECK(uart_num);
+  ports[uart_num]->baud_rate = baudrate;
+  return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baudrate) {
+  PORT_CHECK(uart_num);
+  *baudrate = ports[uart_num]->baud_rate;
+  return ESP_OK;
+}
+
+esp_err_t uart_set_hw_flow_ctrl(uart_port_t uart_num, uart_hw_flowcontrol_t flow_ctrl, uint8_t rx_thresh) {
+  PORT_CHECK(uart_num);
+  ports[uart_num]->flow_ctrl = flow_ctrl;
+  return ESP_OK;
+}
+
+esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t uart_num, char pattern_chr, uint8_t chr_num, int chr_tout, int post_idle, int pre_idle) {
+  PORT_CHECK(uart_num);
+  if (chr_num != 1) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  ports[uart_num]->pattern_chr = (uint8_t) pattern_chr;
+  return ESP_OK;
+}
+
+esp_err_t uart_disable_pattern_det_intr(uart_port_t uart_num) {
+  PORT_CHECK(uart_num);
+  ports[uart_num]->pattern_chr = -1;
+  return ESP_OK;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t uart_num, int queue_length) {
+  PORT_CHECK(uart_num);
+  sim_uart_t *port = ports[uart_num];
+  uint64_t *positions = malloc(sizeof(uint64_t) * queue_length);
+  if (positions == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  xSemaphoreTake(port->lock, portMAX_DELAY);
+  free(port->pattern_positions);
+  port->pattern_positions = positions;
+  port->pattern_queue_length = queue_length;
+  port->pattern_head = 0;
+  port->pattern_count = 0;
+  xSemaphoreGive(port->lock);
+  return ESP_OK;
+}
+
+int uart_pattern_pop_pos(uart_port_t uart_num) {
+  if (uart_num < 0 || uart_num >= UART_NUM_MAX || ports[uart_num] == NULL) {
+    return -1;
+  }
+  sim_uart_t *port = ports[uart_num];
+  int result = -1;
+  xSemaphoreTake(port->lock, portMAX_DELAY);
+  if (port->pattern_count > 0) {
+    // position is relative to the current read position
+    result = (int) (port->pattern_positions[port->pattern_head] - port->read);
+    port->pattern_head = (port->pattern_head + 1) % port->pattern_queue_length;
+    port->pattern_count--;
+  }
+  xSemaphoreGive(port->lock);
+  return result;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+  if (uart_num < 0 || uart_num >= UART_NUM_MAX || ports[uart_num] == NULL) {
+    return -1;
+  }
+  sim_uart_t *port = ports[uart_num];
+  uint8_t *output = (uint8_t *) buf;
+  uint32_t total = 0;
+  TickType_t waited = 0;
+  while (1) {
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    while (total < length && port->read < port->received) {
+      output[total] = port->rx_buffer[port->read % port->rx_buffer_size];
+      port->read++;
+      total++;
+    }
+    xSemaphoreGive(port->lock);
+    if (total == length || waited >= ticks_to_wait) {
+      break;
+    }
+    vTaskDelay(1);
+    waited++;
+  }
+  return (int) total;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size) {
+  if (uart_num < 0 || uart_num >= UART_NUM_MAX || ports[uart_num] == NULL) {
+    return -1;
+  }
+  return (int) sim_pty_write(ports[uart_num]->fd, src, size);
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait) {
+  PORT_CHECK(uart_num);
+  return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num) {
+  PORT_CHECK(uart_num);
+  sim_uart_t *port = ports[uart_num];
+  xSemaphoreTake(port->lock, portMAX_DELAY);
+  port->read = port->received;
+  port->pattern_head = 0;
+  port->pattern_count = 0;
+  xSemaphoreGive(port->lock);
+  return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size) {
+  PORT_CHECK(uart_num);
+  sim_uart_t *port = ports[uart_num];
+  xSemaphoreTake(port->lock, portMAX_DELAY);
+  *size = (size_t) (port->received - port->read);
+  xSemaphoreGive(port->lock);
+  return ESP_OK;
+}
@@ -0,0 +1,19 @@
+#include "esp_timer.h"
+#include <time.h>
+
+static int64_t started_micros = 0;
+
+static int64_t esp_timer_monotonic_micros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// like on the chip, time starts at boot
+__attribute__((constructor)) static void esp_timer_init() {
+  started_micros = esp_timer_monotonic_micros();
+}
+
+int64_t esp_timer_get_time(void) {
+  return esp_timer_monotonic_micros() - started_micros;
+}
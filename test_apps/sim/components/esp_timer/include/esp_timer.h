@@ -0,0 +1,9 @@
+#ifndef LORA_AT_SIM_ESP_TIMER_H
+#define LORA_AT_SIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+// microseconds since the process start, monotonic
+int64_t esp_timer_get_time(void);
+
+#endif //LORA_AT_SIM_ESP_TIMER_H